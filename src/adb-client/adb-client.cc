@@ -180,4 +180,20 @@ void sync_push_buffer(
   co_spawn_run(co_sync_push_buffer, buffer, size, dst, option);
 }
 
+std::string adb_install(
+    const std::vector<std::filesystem::path>& apks,
+    TransportOption option,
+    std::string_view args) {
+  return co_spawn_run_ret<std::string>(co_install, apks, option, args);
+}
+
+std::vector<InstallResult> adb_install_multi(
+    const std::vector<std::filesystem::path>& apks,
+    const std::vector<std::string>& serials,
+    size_t concurrency,
+    std::string_view args,
+    TransportOption option) {
+  return co_spawn_run_ret<std::vector<InstallResult>>(co_install_multi, apks, serials, concurrency, args, option);
+}
+
 } // namespace adb_client
@@ -54,6 +54,9 @@ enum class TransportType {
   Local,
 };
 
+class DeviceStateSource;
+class TransferScheduler;
+
 struct TransportOption {
   std::string_view server;
   std::string_view port;
@@ -61,6 +64,13 @@ struct TransportOption {
   TransportType transportType{TransportType::Any};
   std::optional<int64_t> transportId;
   bool launchServerIfNeed{true};
+  // wait_device is answered from here when it follows the selected server,
+  // no server connection is held while waiting
+  DeviceStateSource *stateSource{nullptr};
+  // push and pull hold a slot of transferLink (e.g. DeviceInterface::parentHub)
+  // for their sync session, the scheduler's executor rules apply to the caller
+  TransferScheduler *transferScheduler{nullptr};
+  std::string_view transferLink;
 };
 
 struct DeviceInfo {
@@ -72,6 +82,13 @@ struct DeviceInfo {
   int64_t transportId{0};
 };
 
+// a service the adb server discovered over mdns (wireless debugging)
+struct MdnsService {
+  std::string instance; // e.g. adb-R5CT1234ABC-Xy1aBc
+  std::string type;     // _adb-tls-connect._tcp, _adb-tls-pairing._tcp, _adb._tcp
+  std::string address;  // ip:port
+};
+
 
 struct Stat {
   uint64_t dev{0};
@@ -95,6 +112,14 @@ struct ListItem {
   uint32_t mtime{0};
 };
 
+struct InstallResult {
+  std::string serial;
+  bool success{false};
+  // package manager output on success, error message otherwise
+  std::string message;
+  std::chrono::milliseconds elapsed{0};
+};
+
 
 void adb_kill(TransportOption option = {}) noexcept;
 
@@ -176,4 +201,18 @@ void sync_push_buffer(
     std::string_view dst,
     TransportOption option = {});
 
+// install one apk, or a split apk set when more than one path is given.
+// args are extra `pm install` options, e.g. "-r -g"
+std::string adb_install(
+    const std::vector<std::filesystem::path>& apks,
+    TransportOption option = {},
+    std::string_view args = {});
+
+std::vector<InstallResult> adb_install_multi(
+    const std::vector<std::filesystem::path>& apks,
+    const std::vector<std::string>& serials,
+    size_t concurrency = 8,
+    std::string_view args = {},
+    TransportOption option = {});
+
 } // namespace adb_client
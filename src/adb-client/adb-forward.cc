@@ -0,0 +1,415 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "adb-forward.h"
+#include <asio.hpp>
+#include <atomic>
+#include <format>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#include "bench/fake-adb-server.h"
+#endif
+
+namespace adb_client {
+
+using asio::awaitable;
+using asio::use_awaitable;
+using asio::ip::tcp;
+
+namespace {
+
+constexpr size_t kRelayChunk = 256 * 1024;
+
+struct Session {
+  tcp::socket local;
+  AdbSocket device;
+  // keeps the owning forward (and the counters below) alive
+  std::shared_ptr<void> owner;
+  std::atomic<uint64_t> &active;
+
+  Session(tcp::socket &&l, AdbSocket &&d, std::shared_ptr<void> o, std::atomic<uint64_t> &a)
+    : local(std::move(l)), device(std::move(d)), owner(std::move(o)), active(a) {
+    active++;
+  }
+
+  ~Session() {
+    active--;
+  }
+
+  void close() noexcept {
+    asio::error_code ec;
+    local.close(ec);
+    device.close(ec);
+  }
+};
+
+// returns true on a clean end of stream, false on error
+template <class From, class To>
+awaitable<bool>
+relay_copy(From &from, To &to, std::atomic<uint64_t> &counter) {
+  std::unique_ptr<char[]> buffer(new char[kRelayChunk]);
+
+  for (;;) {
+    size_t n = 0;
+    try {
+      n = co_await from.async_read_some(asio::buffer(buffer.get(), kRelayChunk), use_awaitable);
+      co_await async_write(to, asio::buffer(buffer.get(), n), use_awaitable);
+    } catch (asio::system_error &e) {
+      co_return e.code() == asio::error::eof;
+    }
+    counter += n;
+  }
+}
+
+#ifdef __linux__
+
+struct ScopedPipe {
+  int fds[2]{-1, -1};
+
+  ScopedPipe() {
+    if (::pipe2(fds, O_CLOEXEC | O_NONBLOCK) == 0) {
+      // a larger pipe means fewer splice round trips, failure is harmless
+      ::fcntl(fds[1], F_SETPIPE_SZ, (int)kRelayChunk);
+    } else {
+      fds[0] = fds[1] = -1;
+    }
+  }
+
+  ~ScopedPipe() {
+    if (fds[0] >= 0) ::close(fds[0]);
+    if (fds[1] >= 0) ::close(fds[1]);
+  }
+
+  bool valid() const { return fds[0] >= 0; }
+};
+
+// socket -> pipe -> socket, the payload never enters user space
+template <class From, class To>
+awaitable<bool>
+relay_splice(From &from, To &to, std::atomic<uint64_t> &counter) {
+  ScopedPipe pipe;
+  if (!pipe.valid()) {
+    co_return co_await relay_copy(from, to, counter);
+  }
+
+  size_t pending = 0; // bytes sitting in the pipe
+
+  try {
+    from.native_non_blocking(true);
+    to.native_non_blocking(true);
+
+    for (;;) {
+      if (pending == 0) {
+        ssize_t n = ::splice(from.native_handle(), nullptr, pipe.fds[1], nullptr,
+                             kRelayChunk, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n == 0) {
+          co_return true;
+        }
+
+        if (n < 0) {
+          if (errno == EAGAIN) {
+            co_await from.async_wait(asio::socket_base::wait_read, use_awaitable);
+            continue;
+          }
+          if (errno == EINTR) {
+            continue;
+          }
+          co_return false;
+        }
+
+        pending = n;
+      }
+
+      ssize_t n = ::splice(pipe.fds[0], nullptr, to.native_handle(), nullptr,
+                           pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if (n < 0) {
+        if (errno == EAGAIN) {
+          co_await to.async_wait(asio::socket_base::wait_write, use_awaitable);
+          continue;
+        }
+        if (errno == EINTR) {
+          continue;
+        }
+        co_return false;
+      }
+
+      pending -= n;
+      counter += n;
+    }
+  } catch (asio::system_error &) {
+    // socket closed under us, or could not be made non-blocking
+  }
+
+  co_return false;
+}
+
+#endif
+
+template <class From, class To>
+awaitable<void>
+relay(std::shared_ptr<Session> session, From &from, To &to, std::atomic<uint64_t> &counter) {
+#ifdef __linux__
+  bool eof = co_await relay_splice(from, to, counter);
+#else
+  bool eof = co_await relay_copy(from, to, counter);
+#endif
+
+  if (eof) {
+    // half close, the other direction may still be flowing
+    asio::error_code ec;
+    to.shutdown(asio::socket_base::shutdown_send, ec);
+  } else {
+    session->close();
+  }
+}
+
+} // namespace
+
+struct PortForwarder::Forward : public std::enable_shared_from_this<Forward> {
+  tcp::acceptor acceptor;
+  uint16_t localPort{0};
+  std::string remote;
+  std::string server;
+  std::string port;
+  std::string serial;
+  TransportType transportType{TransportType::Any};
+  std::optional<int64_t> transportId;
+  bool launchServerIfNeed{true};
+
+  // resolved transport id, reused so that follow-up connections
+  // skip the server side serial lookup
+  std::optional<int64_t> cachedTransportId;
+
+  std::chrono::steady_clock::time_point started{std::chrono::steady_clock::now()};
+  std::atomic<uint64_t> accepted{0};
+  std::atomic<uint64_t> active{0};
+  std::atomic<uint64_t> failed{0};
+  std::atomic<uint64_t> toDevice{0};
+  std::atomic<uint64_t> fromDevice{0};
+
+  std::vector<std::weak_ptr<Session>> sessions;
+
+  Forward(const asio::any_io_executor &ex) : acceptor(ex) {}
+
+  TransportOption option() const {
+    return {
+      .server = server,
+      .port = port,
+      .serial = serial,
+      .transportType = transportType,
+      .transportId = transportId,
+      .launchServerIfNeed = launchServerIfNeed,
+    };
+  }
+
+  awaitable<AdbSocket> openDevice();
+  awaitable<void> serve(tcp::socket local);
+  awaitable<void> acceptLoop();
+  void shutdown() noexcept;
+};
+
+awaitable<AdbSocket>
+PortForwarder::Forward::openDevice() {
+  auto opt = option();
+
+  if (cachedTransportId && !opt.transportId) {
+    opt.transportId = cachedTransportId;
+    try {
+      co_return co_await co_open_service(remote, opt);
+    } catch (adb_error &) {
+      // the device may have re-attached with a new transport id
+      cachedTransportId.reset();
+      opt.transportId.reset();
+    }
+  }
+
+  int64_t id = 0;
+  auto device = co_await co_open_service(remote, opt, &id);
+  if (id > 0) {
+    cachedTransportId = id;
+  }
+
+  co_return device;
+}
+
+awaitable<void>
+PortForwarder::Forward::serve(tcp::socket local) {
+  auto self = shared_from_this();
+
+  std::optional<AdbSocket> device;
+  try {
+    device.emplace(co_await openDevice());
+  } catch (std::exception &) {
+    failed++;
+    co_return;
+  }
+
+  asio::error_code ec;
+  local.set_option(tcp::no_delay(true), ec);
+
+  auto session = std::make_shared<Session>(std::move(local), std::move(*device), self, active);
+
+  std::erase_if(sessions, [](auto &s) { return s.expired(); });
+  sessions.push_back(session);
+
+  auto ex = co_await asio::this_coro::executor;
+  co_spawn(ex, relay(session, session->local, session->device, toDevice), asio::detached);
+  co_spawn(ex, relay(session, session->device, session->local, fromDevice), asio::detached);
+}
+
+awaitable<void>
+PortForwarder::Forward::acceptLoop() {
+  auto self = shared_from_this();
+  auto ex = co_await asio::this_coro::executor;
+
+  for (;;) {
+    tcp::socket local(ex);
+    try {
+      co_await acceptor.async_accept(local, use_awaitable);
+    } catch (std::exception &) {
+      // acceptor closed
+      co_return;
+    }
+
+    accepted++;
+    co_spawn(ex, serve(std::move(local)), asio::detached);
+  }
+}
+
+void PortForwarder::Forward::shutdown() noexcept {
+  asio::error_code ec;
+  acceptor.close(ec);
+
+  for (auto &s : sessions) {
+    if (auto session = s.lock()) {
+      session->close();
+    }
+  }
+  sessions.clear();
+}
+
+double ForwardStats::throughputToDevice() const {
+  auto secs = std::chrono::duration<double>(elapsed).count();
+  return secs > 0 ? bytesToDevice / secs : 0;
+}
+
+double ForwardStats::throughputFromDevice() const {
+  auto secs = std::chrono::duration<double>(elapsed).count();
+  return secs > 0 ? bytesFromDevice / secs : 0;
+}
+
+PortForwarder::PortForwarder(asio::any_io_executor ex) : ex_(std::move(ex)) {}
+
+PortForwarder::~PortForwarder() {
+  close();
+}
+
+uint16_t PortForwarder::add(uint16_t local_port, std::string_view remote, TransportOption option) {
+  auto fwd = std::make_shared<Forward>(ex_);
+  fwd->remote = remote;
+  fwd->server = option.server;
+  fwd->port = option.port;
+  fwd->serial = option.serial;
+  fwd->transportType = option.transportType;
+  fwd->transportId = option.transportId;
+  fwd->launchServerIfNeed = option.launchServerIfNeed;
+
+  try {
+    tcp::endpoint ep(asio::ip::address_v4::loopback(), local_port);
+    fwd->acceptor.open(ep.protocol());
+    fwd->acceptor.set_option(tcp::acceptor::reuse_address(true));
+    fwd->acceptor.bind(ep);
+    fwd->acceptor.listen();
+  } catch (asio::system_error &e) {
+    throw adb_error(std::format("cannot bind local port {}: {}", local_port, e.what()));
+  }
+
+  fwd->localPort = fwd->acceptor.local_endpoint().port();
+
+  {
+    std::lock_guard lk(mutex_);
+    auto [it, inserted] = forwards_.emplace(fwd->localPort, fwd);
+    if (!inserted) {
+      throw adb_error(std::format("local port {} already forwarded", fwd->localPort));
+    }
+  }
+
+  co_spawn(ex_, fwd->acceptLoop(), asio::detached);
+  return fwd->localPort;
+}
+
+bool PortForwarder::remove(uint16_t local_port) {
+  std::shared_ptr<Forward> fwd;
+  {
+    std::lock_guard lk(mutex_);
+    auto it = forwards_.find(local_port);
+    if (it == forwards_.end()) {
+      return false;
+    }
+    fwd = std::move(it->second);
+    forwards_.erase(it);
+  }
+
+  asio::post(ex_, [fwd] { fwd->shutdown(); });
+  return true;
+}
+
+void PortForwarder::close() {
+  std::map<uint16_t, std::shared_ptr<Forward>> forwards;
+  {
+    std::lock_guard lk(mutex_);
+    forwards.swap(forwards_);
+  }
+
+  for (auto &[port, fwd] : forwards) {
+    asio::post(ex_, [fwd] { fwd->shutdown(); });
+  }
+}
+
+std::vector<ForwardStats> PortForwarder::stats() const {
+  std::vector<ForwardStats> out;
+  auto now = std::chrono::steady_clock::now();
+
+  std::lock_guard lk(mutex_);
+  for (auto &[port, fwd] : forwards_) {
+    ForwardStats st;
+    st.localPort = port;
+    st.remote = fwd->remote;
+    st.serial = fwd->serial;
+    st.connectionsAccepted = fwd->accepted;
+    st.connectionsActive = fwd->active;
+    st.connectionsFailed = fwd->failed;
+    st.bytesToDevice = fwd->toDevice;
+    st.bytesFromDevice = fwd->fromDevice;
+    st.elapsed = now - fwd->started;
+    out.push_back(std::move(st));
+  }
+  return out;
+}
+
+} // namespace adb_client
+
+#ifdef ENABLE_TEST
+#include "adb-forward_tests.cc"
+#endif
@@ -0,0 +1,79 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include "co-adb-client.h"
+#include <asio/any_io_executor.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace adb_client {
+
+struct ForwardStats {
+  uint16_t localPort{0};
+  std::string remote;
+  std::string serial;
+  uint64_t connectionsAccepted{0};
+  uint64_t connectionsActive{0};
+  uint64_t connectionsFailed{0};
+  uint64_t bytesToDevice{0};
+  uint64_t bytesFromDevice{0};
+  std::chrono::steady_clock::duration elapsed{};
+
+  // average bytes per second since the forward was added
+  double throughputToDevice() const;
+  double throughputFromDevice() const;
+};
+
+// in-process replacement of `adb forward`.
+// every accepted local connection opens its own device service stream through
+// the adb server and the two sockets are relayed in both directions
+// (splice(2) through a pipe on linux, buffered copy elsewhere).
+//
+// all forwards run on the given executor, which must not be used
+// from more than one thread at a time (an io_context run by one thread or a strand).
+class PortForwarder {
+public:
+  explicit PortForwarder(asio::any_io_executor ex);
+  ~PortForwarder();
+
+  PortForwarder(const PortForwarder &) = delete;
+  PortForwarder& operator=(const PortForwarder &) = delete;
+
+  // listen on local_port (0 picks an ephemeral port) and relay
+  // to remote (e.g. "tcp:8080") on the device selected by option.
+  // returns the bound local port, throws adb_error if the port can not be bound.
+  uint16_t add(uint16_t local_port, std::string_view remote, TransportOption option = {});
+
+  bool remove(uint16_t local_port);
+  void close();
+
+  std::vector<ForwardStats> stats() const;
+
+private:
+  struct Forward;
+
+  asio::any_io_executor ex_;
+  mutable std::mutex mutex_;
+  std::map<uint16_t, std::shared_ptr<Forward>> forwards_;
+};
+
+} // namespace adb_client
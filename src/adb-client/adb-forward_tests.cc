@@ -0,0 +1,56 @@
+#include <thread>
+
+namespace adb_client {
+
+TEST(PortForwarder, RelaysLoopback) {
+  asio::io_context ctx;
+  auto guard = asio::make_work_guard(ctx);
+  adb_bench::FakeAdbServer fake(ctx.get_executor());
+  auto server = fake.listenTcp();
+  std::thread io([&ctx] { ctx.run(); });
+
+  PortForwarder forwarder(ctx.get_executor());
+  auto port = forwarder.add(0, "tcp:8080", {.server = server, .launchServerIfNeed = false});
+  ASSERT_NE(port, 0);
+  EXPECT_THROW(forwarder.add(port, "tcp:8080", {.server = server}), adb_error);
+
+  // larger than one relay chunk, so both directions loop
+  std::string payload(600 * 1024, '\0');
+  for (size_t i = 0; i < payload.size(); i++) {
+    payload[i] = char(i * 131);
+  }
+
+  asio::io_context client_ctx;
+  tcp::socket client(client_ctx);
+  client.connect({asio::ip::address_v4::loopback(), port});
+  std::thread writer([&] {
+    asio::write(client, asio::buffer(payload));
+    client.shutdown(tcp::socket::shutdown_send);
+  });
+
+  // the echo ends after the half close travelled through the relay
+  std::string echoed;
+  asio::error_code ec;
+  asio::read(client, asio::dynamic_buffer(echoed), ec);
+  writer.join();
+  EXPECT_EQ(ec, asio::error::eof);
+  EXPECT_TRUE(echoed == payload) << echoed.size();
+
+  auto stats = forwarder.stats();
+  ASSERT_EQ(stats.size(), 1u);
+  EXPECT_EQ(stats[0].localPort, port);
+  EXPECT_EQ(stats[0].connectionsAccepted, 1u);
+  EXPECT_EQ(stats[0].connectionsFailed, 0u);
+  EXPECT_EQ(stats[0].bytesToDevice, payload.size());
+  EXPECT_EQ(stats[0].bytesFromDevice, payload.size());
+
+  EXPECT_TRUE(forwarder.remove(port));
+  EXPECT_FALSE(forwarder.remove(port));
+
+  forwarder.close();
+  fake.close();
+  guard.reset();
+  io.join();
+}
+
+} // namespace adb_client
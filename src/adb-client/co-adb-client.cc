@@ -19,8 +19,14 @@
 // SOFTWARE.
 
 #include "co-adb-client.h"
+#include "co-parallel.h"
+#include "mapped-file.h"
+#include "transfer-scheduler.h"
 #include "process/process.h"
+#include "tracing/trace-writer.h"
+#include "tracing/usdt.h"
 #include <asio.hpp>
+#include <charconv>
 #include <format>
 #include <ranges>
 #include <regex>
@@ -32,6 +38,10 @@
 #endif
 #include <sys/stat.h>
 #include <sys/types.h>
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#include "bench/fake-adb-server.h"
+#endif
 
 namespace  {
 
@@ -80,7 +90,7 @@ public:
 
 
 awaitable<void>
-send_protocol_string(tcp::socket &socket, std::string_view s) {
+send_protocol_string(AdbSocket &socket, std::string_view s) {
   unsigned int length = s.size();
   if (length > MAX_PAYLOAD - 4) {
     throw adb_error("message too big");
@@ -91,7 +101,7 @@ send_protocol_string(tcp::socket &socket, std::string_view s) {
 }
 
 awaitable<std::string>
-read_protocol_string(tcp::socket &socket) {
+read_protocol_string(AdbSocket &socket) {
   std::string msg;
   co_await async_read(socket,
             asio::dynamic_buffer(msg, 4), use_awaitable);
@@ -105,7 +115,7 @@ read_protocol_string(tcp::socket &socket) {
 }
 
 awaitable<void>
-adb_status(tcp::socket &socket) {
+adb_status(AdbSocket &socket) {
   std::string msg;
   co_await async_read(socket,
             asio::dynamic_buffer(msg, 4), use_awaitable);
@@ -124,7 +134,7 @@ adb_status(tcp::socket &socket) {
 }
 
 awaitable<int64_t>
-switch_socket_transport(tcp::socket &socket, TransportOption option) {
+switch_socket_transport(AdbSocket &socket, TransportOption option) {
   int64_t transportId = 0;
 
   if (option.transportId) {
@@ -297,16 +307,19 @@ auto launch_server(ResponseHandler&& handler = {}) {
         );
 }
 
-awaitable<tcp::socket>
+awaitable<AdbSocket>
 connect(
-    tcp::endpoint target,
+    AdbEndpoint target,
     std::string_view service,
     TransportOption option,
     int64_t *transportId) {
   static bool serverLaunchTried = false;
 
+  tracing::TraceSpan span("adb", "connect");
+  span.arg("service", service);
+  [[maybe_unused]] auto start = DEVICE_WATCH_PROBE_NOW(adb_connect);
   auto ex = co_await this_coro::executor;
-  tcp::socket client(ex);
+  AdbSocket client(ex);
 
   for (;;) {
     try {
@@ -338,6 +351,8 @@ connect(
 
   co_await adb_status(client);
 
+  // service is not nul terminated, pass its length along
+  DEVICE_WATCH_PROBE(adb_connect, service.data(), service.size(), DEVICE_WATCH_PROBE_SINCE(start));
   co_return client;
 }
 
@@ -365,7 +380,7 @@ format_host_command(
 }
 
 awaitable<std::tuple<uint8_t, std::vector<char>, std::vector<char>>>
-read_shell_output(tcp::socket &socket) {
+read_shell_output(AdbSocket &socket) {
   enum Id : uint8_t {
     kIdStdin = 0,
     kIdStdout = 1,
@@ -439,7 +454,7 @@ read_shell_output(tcp::socket &socket) {
 }
 
 awaitable<std::tuple<uint8_t, std::vector<char>, std::vector<char>>>
-read_output(tcp::socket &socket) {
+read_output(AdbSocket &socket) {
   std::vector<char> output;
   std::vector<char> errout;
 
@@ -461,22 +476,69 @@ read_output(tcp::socket &socket) {
   co_return std::make_tuple((uint8_t)0, std::move(output), std::move(errout));
 }
 
-awaitable<tcp::endpoint>
+// ADB_SERVER_SOCKET, used when the caller names no server
+std::string_view server_socket_from_env() {
+  static const std::string env = [] {
+    auto v = std::getenv("ADB_SERVER_SOCKET");
+    return std::string(v ? v : "");
+  }();
+  return env;
+}
+
+// connects to the server server_socket_spec() names
+awaitable<AdbEndpoint>
 resolve_endpoint(TransportOption option) {
+  auto spec = server_socket_spec(option);
+  std::string_view server = spec;
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+  constexpr std::string_view kFileSystem = "localfilesystem:";
+  constexpr std::string_view kAbstract = "localabstract:";
+
+  if (server.starts_with(kFileSystem)) {
+    co_return asio::local::stream_protocol::endpoint(
+        std::string(server.substr(kFileSystem.size())));
+  }
+
+  if (server.starts_with(kAbstract)) {
+    // a leading nul selects the linux abstract namespace
+    co_return asio::local::stream_protocol::endpoint(
+        std::string(1, '\0') + std::string(server.substr(kAbstract.size())));
+  }
+#endif
+
+  if (!server.starts_with("tcp:")) {
+    throw adb_error(std::format("unsupported adb server socket '{}'", spec));
+  }
+
+  // tcp:<host>:<port>
+  server.remove_prefix(4);
+  auto colon = server.rfind(':');
+  auto port = server.substr(colon + 1);
+  server = server.substr(0, colon);
+
+  // skip the resolver for the common local cases, it costs more than the query itself
+  asio::error_code ec;
+  auto address = server == "localhost" ? asio::ip::address(asio::ip::address_v4::loopback())
+                                       : asio::ip::make_address(server, ec);
+  unsigned long port_number = 0;
+  auto [ptr, rc] = std::from_chars(port.data(), port.data() + port.size(), port_number);
+  if (!ec && rc == std::errc() && ptr == port.data() + port.size() && port_number <= 0xffff) {
+    co_return tcp::endpoint(address, (uint16_t)port_number);
+  }
+
   auto ex = co_await this_coro::executor;
-  tcp::socket client(ex);
 
   auto resolver = use_awaitable.as_default_on(tcp::resolver(ex));
   tcp::endpoint target = *(co_await resolver.async_resolve(tcp::v4(), 
-            option.server.empty() ? default_adb_server : option.server,
-            option.port.empty() ? default_adb_port : option.port)).begin();
+            server, port)).begin();
 
   co_return target;
 }
 
 awaitable<std::string>
 co_query(
-    tcp::endpoint target,
+    AdbEndpoint target,
     std::string_view service,
     TransportOption option) {
   try {
@@ -500,7 +562,7 @@ co_query(
 
 awaitable<std::string>
 co_command_query(
-    tcp::endpoint target,
+    AdbEndpoint target,
     std::string_view command,
     TransportOption option) {
   try {
@@ -524,7 +586,7 @@ co_command_query(
 
 awaitable<void>
 co_command(
-    tcp::endpoint target,
+    AdbEndpoint target,
     std::string_view command,
     TransportOption option,
     std::optional<std::chrono::milliseconds> timeout) {
@@ -565,7 +627,7 @@ co_command(
 
 awaitable<std::vector<char>>
 co_command_connect(
-    tcp::endpoint target,
+    AdbEndpoint target,
     std::string_view command,
     TransportOption option,
     int64_t *transportId) {
@@ -597,7 +659,7 @@ co_command_connect(
 
 awaitable<std::vector<std::string>>
 co_get_features(
-    tcp::endpoint target,
+    AdbEndpoint target,
     TransportOption option) {
   auto feature_str = co_await co_command_query(
       target,
@@ -615,7 +677,7 @@ co_get_features(
 
 awaitable<void>
 co_wait_device(
-    tcp::endpoint target,
+    AdbEndpoint target,
     std::string_view state,
     TransportOption option,
     std::optional<std::chrono::milliseconds> timeout) {
@@ -637,7 +699,7 @@ co_wait_device(
 
 awaitable<std::tuple<uint8_t, std::vector<char>, std::vector<char>>>
 co_execute_shell(
-    tcp::endpoint target,
+    AdbEndpoint target,
     std::string_view command,
     TransportOption option,
     std::optional<bool> use_shell_protocol) {
@@ -664,11 +726,61 @@ co_execute_shell(
 
 } // namespace
 
+std::string
+server_socket_spec(const TransportOption &option) {
+  std::string_view server = option.server;
+  std::string_view port = option.port;
+
+  if (server.empty() && port.empty()) {
+    server = server_socket_from_env();
+  }
+
+  if (server.starts_with("localfilesystem:") || server.starts_with("localabstract:")) {
+    return std::string(server);
+  }
+
+  auto is_port = [](std::string_view s) {
+    return !s.empty() && std::ranges::all_of(s, [](char c) { return c >= '0' && c <= '9'; });
+  };
+
+  if (server.starts_with("tcp:")) {
+    // tcp:port, tcp:host or tcp:host:port
+    server.remove_prefix(4);
+    auto colon = server.rfind(':');
+    if (colon != std::string_view::npos) {
+      port = server.substr(colon + 1);
+      server = server.substr(0, colon);
+    } else if (is_port(server)) {
+      port = server;
+      server = {};
+    }
+  } else if (port.empty()) {
+    // "host:port" and a bare port, an ipv6 address stays a host
+    auto colon = server.find(':');
+    if (colon != std::string_view::npos && server.find(':', colon + 1) == std::string_view::npos) {
+      port = server.substr(colon + 1);
+      server = server.substr(0, colon);
+    } else if (is_port(server)) {
+      port = server;
+      server = {};
+    }
+  }
+
+  return std::format("tcp:{}:{}",
+      server.empty() ? default_adb_server : server,
+      port.empty() ? default_adb_port : port);
+}
+
 awaitable<void>
 co_wait_device(
     std::string_view state,
     TransportOption option,
     std::optional<std::chrono::milliseconds> timeout) {
+  if (option.stateSource && option.stateSource->covers(option)) {
+    co_await option.stateSource->co_wait(state, option, timeout);
+    co_return;
+  }
+
   co_await co_wait_device(
     co_await resolve_endpoint(option),
     state,
@@ -680,7 +792,7 @@ awaitable<void>
 co_kill(TransportOption option) noexcept {
   try {
     auto ex = co_await this_coro::executor;
-    tcp::socket client(ex);
+    AdbSocket client(ex);
 
     co_await client.async_connect(co_await resolve_endpoint(option), use_awaitable);
 
@@ -706,12 +818,8 @@ co_query(
     option);
 }
 
-awaitable<std::vector<DeviceInfo>>
-co_list_devices(TransportOption option, bool device_only, std::string_view target_serial) {
-  auto liststr = co_await co_query(
-      "host:devices-l",
-      option);
-
+std::vector<DeviceInfo>
+parse_device_list(std::string_view liststr, bool device_only, std::string_view target_serial) {
   auto v = liststr
            | std::views::split('\n')
            | std::views::transform([](auto word) {
@@ -758,7 +866,77 @@ co_list_devices(TransportOption option, bool device_only, std::string_view targe
     }
   }
 
-  co_return out;
+  return out;
+}
+
+// "<instance>\t<type>[.]\t<ip>:<port>" per line
+std::vector<MdnsService>
+parse_mdns_services(std::string_view text) {
+  std::vector<MdnsService> out;
+
+  for (auto part : text | std::views::split('\n')) {
+    std::string_view line(part.begin(), part.end());
+    if (line.ends_with('\r')) {
+      line.remove_suffix(1);
+    }
+
+    auto tab1 = line.find('\t');
+    auto tab2 = tab1 == std::string_view::npos ? tab1 : line.find('\t', tab1 + 1);
+    if (tab2 == std::string_view::npos) {
+      continue;
+    }
+
+    auto type = line.substr(tab1 + 1, tab2 - tab1 - 1);
+    if (type.ends_with('.')) {
+      type.remove_suffix(1);
+    }
+
+    out.push_back({
+      .instance = std::string(line.substr(0, tab1)),
+      .type = std::string(type),
+      .address = std::string(line.substr(tab2 + 1)),
+    });
+  }
+
+  return out;
+}
+
+awaitable<std::vector<DeviceInfo>>
+co_list_devices(TransportOption option, bool device_only, std::string_view target_serial) {
+  auto liststr = co_await co_query(
+      "host:devices-l",
+      option);
+
+  co_return parse_device_list(liststr, device_only, target_serial);
+}
+
+bool
+is_connect_success(std::string_view reply) {
+  while (!reply.empty() && isspace((unsigned char)reply.back())) {
+    reply.remove_suffix(1);
+  }
+
+  for (std::string_view prefix : {"connected to ", "already connected to "}) {
+    if (reply.starts_with(prefix) && reply.size() > prefix.size()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+awaitable<AdbSocket>
+co_track_devices(TransportOption option) {
+  co_return co_await connect(
+      co_await resolve_endpoint(option),
+      "host:track-devices-l",
+      option,
+      nullptr);
+}
+
+awaitable<std::vector<DeviceInfo>>
+co_next_devices(AdbSocket &tracker, bool device_only) {
+  auto liststr = co_await read_protocol_string(tracker);
+  co_return parse_device_list(liststr, device_only);
 }
 
 awaitable<void>
@@ -794,6 +972,18 @@ co_command_connect(
       nullptr);
 }
 
+awaitable<AdbSocket>
+co_open_service(
+    std::string_view service,
+    TransportOption option,
+    int64_t *transportId) {
+  co_return co_await connect(
+      co_await resolve_endpoint(option),
+      service,
+      option,
+      transportId);
+}
+
 awaitable<std::vector<std::string>>
 co_get_features(
     TransportOption option) {
@@ -973,12 +1163,15 @@ std::string escape_arg(const std::string& s) {
 #define S_ISLNK(mode) (((mode) & S_IFMT) == S_IFLNK)
 #define S_ISDIR(mode) (((mode) & _S_IFDIR) == _S_IFDIR)
 #define S_ISREG(mode) (((mode) & S_IFMT) == S_IFREG)
-#define S_ISEXE(mode) (!!((mode) & (S_IXUSR | S_IXGRP | S_IXOTH)))
 
 #define lstat stat
 
 #endif
 
+#ifndef S_ISEXE
+#define S_ISEXE(mode) (!!((mode) & (S_IXUSR | S_IXGRP | S_IXOTH)))
+#endif
+
 #define MKID(a, b, c, d) ((a) | ((b) << 8) | ((c) << 16) | ((d) << 24))
 
 #define ID_LSTAT_V1 MKID('S', 'T', 'A', 'T')
@@ -1040,7 +1233,7 @@ struct sync_status {
 };  // followed by `size` bytes of data.
 
 awaitable<void>
-sync_send_request(tcp::socket &socket, uint32_t id, std::string_view path) {
+sync_send_request(AdbSocket &socket, uint32_t id, std::string_view path) {
   uint32_t length = path.length();
 
   if (length > 1024) {
@@ -1055,7 +1248,7 @@ sync_send_request(tcp::socket &socket, uint32_t id, std::string_view path) {
 }
 
 awaitable<Stat>
-sync_finish_stat(tcp::socket &socket, bool have_stat_v2) {
+sync_finish_stat(AdbSocket &socket, bool have_stat_v2) {
   Stat st;
 
   if (have_stat_v2) {
@@ -1092,13 +1285,13 @@ sync_finish_stat(tcp::socket &socket, bool have_stat_v2) {
 }
 
 awaitable<Stat>
-sync_lstat(tcp::socket &socket, std::string_view path, bool have_stat_v2) {
+sync_lstat(AdbSocket &socket, std::string_view path, bool have_stat_v2) {
   co_await sync_send_request(socket, have_stat_v2 ? ID_LSTAT_V2 : ID_LSTAT_V1, path);
   co_return co_await sync_finish_stat(socket, have_stat_v2);
 }
 
 awaitable<Stat>
-sync_stat(tcp::socket &socket, std::string_view path, bool have_stat_v2) {
+sync_stat(AdbSocket &socket, std::string_view path, bool have_stat_v2) {
   co_await sync_send_request(socket, have_stat_v2 ? ID_STAT_V2 : ID_LSTAT_V1, path);
   auto st = co_await sync_finish_stat(socket, have_stat_v2);
 
@@ -1119,7 +1312,7 @@ sync_stat(tcp::socket &socket, std::string_view path, bool have_stat_v2) {
 
 template <bool v2>
 awaitable<std::vector<ListItem>>
-sync_finish_ls(tcp::socket &socket) {
+sync_finish_ls(AdbSocket &socket) {
   using dent_type =
                 std::conditional_t<v2, sync_dent_v2, sync_dent_v1>;
 
@@ -1162,7 +1355,7 @@ sync_finish_ls(tcp::socket &socket) {
 }
 
 awaitable<std::vector<ListItem>>
-sync_list(tcp::socket &socket, std::string_view path, bool has_ls_v2) {
+sync_list(AdbSocket &socket, std::string_view path, bool has_ls_v2) {
   co_await sync_send_request(socket, has_ls_v2 ? ID_LIST_V2 : ID_LIST_V1, path);
   if (has_ls_v2) {
     co_return co_await sync_finish_ls<true>(socket);
@@ -1191,14 +1384,232 @@ struct copyinfo {
   }
 };
 
+struct syncsendbuf {
+    unsigned id;
+    unsigned size;
+    char data[SYNC_DATA_MAX];
+};
+
+#if defined(ASIO_HAS_FILE)
+
+using local_file = asio::stream_file;
+
+local_file
+open_local_file(const asio::any_io_executor &ex, const LocalPath &path, bool write) {
+  return local_file(ex, path.string(), write
+      ? asio::file_base::flags::create | asio::file_base::flags::truncate | asio::file_base::flags::write_only
+      : asio::file_base::flags::read_only);
+}
+
+// returns 0 at end of file
+template <class MutableBuffer>
+awaitable<size_t>
+file_read_some(local_file &file, const MutableBuffer &buffer) {
+  asio::error_code ec;
+  auto n = co_await file.async_read_some(buffer, asio::redirect_error(use_awaitable, ec));
+  if (ec && ec != asio::error::eof) {
+    throw asio::system_error(ec);
+  }
+  co_return n;
+}
+
+template <class ConstBuffer>
+awaitable<void>
+file_write(local_file &file, const ConstBuffer &buffer) {
+  co_await async_write(file, buffer, use_awaitable);
+}
+
+#else
+
+// this asio build has no async files (linux without io_uring),
+// fall back to blocking stdio, local files are mostly page cache hits
+class local_file {
+public:
+  local_file(const LocalPath &path, bool write)
+    : file_(std::fopen(path.string().c_str(), write ? "wb" : "rb"), &std::fclose) {
+    if (!file_) {
+      throw adb_sync_error(std::format("cannot open '{}': {}", path.string(), strerror(errno)), -1);
+    }
+    std::setvbuf(file_.get(), nullptr, _IONBF, 0);
+  }
+
+  size_t read_some(asio::mutable_buffer buffer) {
+    auto n = std::fread(buffer.data(), 1, buffer.size(), file_.get());
+    if (n == 0 && std::ferror(file_.get())) {
+      throw adb_sync_error(std::format("read failed: {}", strerror(errno)), -1);
+    }
+    return n;
+  }
+
+  void write(asio::const_buffer buffer) {
+    if (std::fwrite(buffer.data(), 1, buffer.size(), file_.get()) != buffer.size()) {
+      throw adb_sync_error(std::format("write failed: {}", strerror(errno)), -1);
+    }
+  }
+
+private:
+  std::unique_ptr<FILE, int (*)(FILE *)> file_;
+};
+
+local_file
+open_local_file(const asio::any_io_executor &, const LocalPath &path, bool write) {
+  return local_file(path, write);
+}
+
+awaitable<size_t>
+file_read_some(local_file &file, asio::mutable_buffer buffer) {
+  co_return file.read_some(buffer);
+}
+
+awaitable<void>
+file_write(local_file &file, asio::const_buffer buffer) {
+  file.write(buffer);
+  co_return;
+}
+
+#endif
+
+// chunk buffers shared by the sync transfers of one execution context,
+// a push or pull reuses them instead of allocating per chunk or
+// carrying 64k in every coroutine frame.
+// with io_uring the ring is registered once, file i/o on it then takes
+// the fixed buffer path (no per-request page pinning).
+class sync_chunk_ring : public asio::execution_context::service {
+public:
+  using key_type = sync_chunk_ring;
+  static inline asio::execution_context::id id;
+
+  static constexpr size_t kChunks = 16;
+
+  explicit sync_chunk_ring(asio::execution_context &ctx)
+    : asio::execution_context::service(ctx), chunks_(new syncsendbuf[kChunks]) {
+    for (size_t i = 0; i < kChunks; i++) {
+      free_.push_back(i);
+    }
+  }
+
+  class chunk {
+  public:
+    chunk(chunk &&other) noexcept
+      : ring_(std::exchange(other.ring_, nullptr)), index_(other.index_),
+        buf_(other.buf_), heap_(std::move(other.heap_)) {}
+
+    chunk& operator=(chunk &&) = delete;
+
+    ~chunk() {
+      if (ring_) {
+        ring_->release(index_);
+      }
+    }
+
+    syncsendbuf &buf() { return *buf_; }
+
+    // fill data[], returns 0 at end of file
+    awaitable<size_t> read_file(local_file &file) {
+#if defined(ASIO_HAS_IO_URING)
+      if (auto reg = registered()) {
+        co_return co_await file_read_some(file,
+            asio::buffer(*reg + offsetof(syncsendbuf, data), SYNC_DATA_MAX));
+      }
+#endif
+      co_return co_await file_read_some(file, asio::buffer(buf_->data));
+    }
+
+    // write data[0, len)
+    awaitable<void> write_file(local_file &file, size_t len) {
+#if defined(ASIO_HAS_IO_URING)
+      if (auto reg = registered()) {
+        co_await file_write(file, asio::buffer(*reg + offsetof(syncsendbuf, data), len));
+        co_return;
+      }
+#endif
+      co_await file_write(file, asio::buffer(buf_->data, len));
+    }
+
+  private:
+    friend class sync_chunk_ring;
+
+    chunk(sync_chunk_ring *ring, size_t index, syncsendbuf *buf) : ring_(ring), index_(index), buf_(buf) {}
+    explicit chunk(std::unique_ptr<syncsendbuf> heap) : buf_(heap.get()), heap_(std::move(heap)) {}
+
+#if defined(ASIO_HAS_IO_URING)
+    std::optional<asio::mutable_registered_buffer> registered() const {
+      if (ring_ && ring_->registration_) {
+        return *(ring_->registration_->begin() + index_);
+      }
+      return std::nullopt;
+    }
+#endif
+
+    sync_chunk_ring *ring_{nullptr};
+    size_t index_{0};
+    syncsendbuf *buf_{nullptr};
+    std::unique_ptr<syncsendbuf> heap_;
+  };
+
+  static chunk acquire(const asio::any_io_executor &ex) {
+    auto &ring = asio::use_service<sync_chunk_ring>(asio::query(ex, asio::execution::context));
+    return ring.take(ex);
+  }
+
+private:
+  void shutdown() override {}
+
+  chunk take([[maybe_unused]] const asio::any_io_executor &ex) {
+    std::lock_guard lk(mutex_);
+#if defined(ASIO_HAS_IO_URING)
+    if (!registration_ && !registration_failed_) {
+      std::vector<asio::mutable_buffer> buffers;
+      for (size_t i = 0; i < kChunks; i++) {
+        buffers.push_back(asio::buffer(&chunks_[i], sizeof(syncsendbuf)));
+      }
+      try {
+        registration_.emplace(asio::register_buffers(ex, buffers));
+      } catch (asio::system_error &) {
+        // e.g. RLIMIT_MEMLOCK too low, plain buffers still work
+        registration_failed_ = true;
+      }
+    }
+#endif
+
+    if (free_.empty()) {
+      // more concurrent transfers than chunks
+      return chunk(std::make_unique<syncsendbuf>());
+    }
+
+    auto index = free_.back();
+    free_.pop_back();
+    return chunk(this, index, &chunks_[index]);
+  }
+
+  void release(size_t index) {
+    std::lock_guard lk(mutex_);
+    free_.push_back(index);
+  }
+
+  std::mutex mutex_;
+  std::unique_ptr<syncsendbuf[]> chunks_;
+  std::vector<size_t> free_;
+#if defined(ASIO_HAS_IO_URING)
+  std::optional<asio::buffer_registration<std::vector<asio::mutable_buffer>>> registration_;
+  bool registration_failed_{false};
+#endif
+};
+
 awaitable<void>
 sync_recv(
-    tcp::socket &socket,
+    AdbSocket &socket,
     std::string_view rpath,
     const LocalPath &lpath) {
+  tracing::TraceSpan span("sync", "pull");
+  span.arg("path", rpath);
+  int64_t total = 0;
+
   co_await sync_send_request(socket, ID_RECV_V1, rpath);
 
-  asio::basic_stream_file lfile(co_await this_coro::executor, lpath.string(), asio::file_base::flags::create | asio::file_base::flags::truncate | asio::file_base::flags::write_only);
+  auto ex = co_await this_coro::executor;
+  auto lfile = open_local_file(ex, lpath, true);
+  auto chunk = sync_chunk_ring::acquire(ex);
   
   try {
     for (;;) {
@@ -1215,10 +1626,12 @@ sync_recv(
         throw adb_sync_error("sync recv size too large", -1);
       }
 
-      std::vector<char> buffer;
-      co_await async_read(socket, asio::dynamic_buffer(buffer, data.u.length), use_awaitable);
-      co_await async_write(lfile, asio::buffer(buffer), use_awaitable);
+      co_await async_read(socket, asio::buffer(chunk.buf().data, data.u.length), use_awaitable);
+      DEVICE_WATCH_PROBE(sync_chunk_received, data.u.length);
+      co_await chunk.write_file(lfile, data.u.length);
+      total += data.u.length;
     }
+    span.arg("bytes", total);
   } catch (std::exception &) {
     std::error_code ec;
     std::filesystem::remove(lpath, ec);
@@ -1228,8 +1641,11 @@ sync_recv(
 
 awaitable<std::vector<char>>
 sync_recv_buffer(
-    tcp::socket &socket,
+    AdbSocket &socket,
     std::string_view rpath) {
+  tracing::TraceSpan span("sync", "pull");
+  span.arg("path", rpath);
+
   co_await sync_send_request(socket, ID_RECV_V1, rpath);
 
   std::vector<char> out_buffer;
@@ -1251,23 +1667,22 @@ sync_recv_buffer(
     auto last_pos = out_buffer.size();
     out_buffer.resize(last_pos + data.u.length);
     co_await async_read(socket, asio::buffer(&out_buffer[last_pos], data.u.length), use_awaitable);
+    DEVICE_WATCH_PROBE(sync_chunk_received, data.u.length);
   }
 
+  span.arg("bytes", out_buffer.size());
   co_return out_buffer;
 }
 
-struct syncsendbuf {
-    unsigned id;
-    unsigned size;
-    char data[SYNC_DATA_MAX];
-};
-
 awaitable<void>
 sync_send_buffer(
-    tcp::socket &socket,
+    AdbSocket &socket,
     std::string_view rpath,
     const char *buffer,
     size_t size) {
+  tracing::TraceSpan span("sync", "push");
+  span.arg("path", rpath).arg("bytes", size);
+
   uint32_t mode = 0777;
   unsigned mtime = 0;
 
@@ -1301,16 +1716,22 @@ sync_send_buffer(
     p += sizeof(sync_status);
 
     co_await async_write(socket, asio::buffer(buf), use_awaitable);
+    DEVICE_WATCH_PROBE(sync_chunk_sent, size);
   } else {
     co_await sync_send_request(socket, ID_SEND_V1, path_and_mode);
 
     size_t n = SYNC_DATA_MAX;
     for (; n > 0;) {
-      syncsendbuf sbuf;
-      sbuf.id = ID_DATA;
-      sbuf.size = n;
-      memcpy(sbuf.data, buffer, n);
-      co_await async_write(socket, asio::buffer(&sbuf, sizeof(sync_status) + n), use_awaitable);
+      // header and payload gathered in one write, no copy of the payload
+      sync_status hdr;
+      hdr.id = ID_DATA;
+      hdr.u.length = n;
+      std::array<asio::const_buffer, 2> bufs {
+        asio::buffer(&hdr, sizeof(hdr)),
+        asio::buffer(buffer, n),
+      };
+      co_await async_write(socket, bufs, use_awaitable);
+      DEVICE_WATCH_PROBE(sync_chunk_sent, n);
 
       size -= n;
       buffer += n;
@@ -1345,22 +1766,28 @@ sync_send_buffer(
 
 awaitable<void>
 sync_send(
-    tcp::socket &socket,
+    AdbSocket &socket,
     std::string_view rpath,
     const LocalPath &lpath,
     uint32_t mode,
     unsigned mtime) {
-  asio::basic_stream_file lfile(co_await this_coro::executor, lpath.string(), asio::file_base::flags::read_only);
+  tracing::TraceSpan span("sync", "push");
+  span.arg("path", rpath);
+  int64_t total = 0;
+
+  auto ex = co_await this_coro::executor;
+  auto lfile = open_local_file(ex, lpath, false);
   
   auto path_and_mode = std::format("{},{}", rpath, mode);
   if (path_and_mode.length() > 1024) {
     throw adb_sync_error("SendFile failed: path too long", -1);
   }
 
-  syncsendbuf sbuf;
+  auto chunk = sync_chunk_ring::acquire(ex);
+  auto &sbuf = chunk.buf();
   sbuf.id = ID_DATA;
 
-  auto n = co_await lfile.async_read_some(asio::buffer(sbuf.data), use_awaitable);
+  auto n = co_await chunk.read_file(lfile);
   if (n < SYNC_DATA_MAX) {
     std::vector<char> buf(sizeof(sync_status) + path_and_mode.length() + sizeof(sync_status) +
                               n + sizeof(sync_status));
@@ -1386,24 +1813,17 @@ sync_send(
     p += sizeof(sync_status);
 
     co_await async_write(socket, asio::buffer(buf), use_awaitable);
+    DEVICE_WATCH_PROBE(sync_chunk_sent, n);
+    total = n;
   } else {
     co_await sync_send_request(socket, ID_SEND_V1, path_and_mode);
 
-    for (;;) {
+    while (n > 0) {
       sbuf.size = n;
       co_await async_write(socket, asio::buffer(&sbuf, sizeof(sync_status) + n), use_awaitable);
-
-      try {
-        n = co_await lfile.async_read_some(asio::buffer(sbuf.data), use_awaitable);
-        if (n == 0) {
-          break;
-        }
-      } catch (asio::system_error &e) {
-        if (e.code() == asio::error::eof) {
-          break;
-        }
-        throw;
-      }
+      DEVICE_WATCH_PROBE(sync_chunk_sent, n);
+      total += n;
+      n = co_await chunk.read_file(lfile);
     }
 
     sync_status data;
@@ -1412,6 +1832,8 @@ sync_send(
     co_await async_write(socket, asio::buffer(&data, sizeof(data)), use_awaitable);
   }
 
+  span.arg("bytes", total);
+
   sync_status data;
   co_await async_read(socket, asio::buffer(&data, sizeof(data)), use_awaitable);
 
@@ -1435,7 +1857,7 @@ sync_send(
 
 awaitable<std::vector<copyinfo>>
 remote_build_list(
-    tcp::socket &socket,
+    AdbSocket &socket,
     std::string_view rpath,
     const LocalPath &lpath,
     bool have_stat_v2,
@@ -1498,7 +1920,7 @@ remote_build_list(
 
 awaitable<void>
 copy_remote_dir_local(
-    tcp::socket &socket,
+    AdbSocket &socket,
     std::string rpath,
     const LocalPath &lpath,
     bool have_stat_v2,
@@ -1564,12 +1986,12 @@ local_build_list(
 
 awaitable<void>
 copy_local_dir_remote(
-    tcp::socket &socket,
+    AdbSocket &socket,
     const LocalPath &lpath,
     std::string rpath,
     bool have_fixed_push_mkdir,
     bool have_shell_v2,
-    tcp::endpoint &target,
+    AdbEndpoint &target,
     TransportOption option) {
   // Make sure that both directory paths end in a slash.
   // Both paths are known to be nonempty, so we don't need to check.
@@ -1637,9 +2059,9 @@ copy_local_dir_remote(
 }
 
 struct ScopedSyncConnect {
-  tcp::socket socket;
+  AdbSocket socket;
 
-  ScopedSyncConnect(tcp::socket &&s) : socket(std::move(s)) {}
+  ScopedSyncConnect(AdbSocket &&s) : socket(std::move(s)) {}
 
   ScopedSyncConnect(const ScopedSyncConnect &) = delete;
   ScopedSyncConnect(ScopedSyncConnect &&) = default;
@@ -1651,7 +2073,7 @@ struct ScopedSyncConnect {
 };
 
 awaitable<ScopedSyncConnect>
-sync_open_connect(tcp::endpoint target, TransportOption option) {
+sync_open_connect(AdbEndpoint target, TransportOption option) {
   auto client = co_await connect(
         target,
         "sync:",
@@ -1660,6 +2082,15 @@ sync_open_connect(tcp::endpoint target, TransportOption option) {
   co_return ScopedSyncConnect{std::move(client)};
 }
 
+// an empty slot when the transfer is not scheduled
+awaitable<TransferScheduler::Slot>
+acquire_transfer_slot(TransportOption option) {
+  if (!option.transferScheduler) {
+    co_return TransferScheduler::Slot();
+  }
+  co_return co_await option.transferScheduler->co_acquire(std::string(option.transferLink));
+}
+
 } // namespace
 
 
@@ -1694,6 +2125,8 @@ co_sync_pull(
   bool have_stat_v2 = std::ranges::find(features, "stat_v2") != features.end();
   bool have_ls_v2 = std::ranges::find(features, "ls_v2") != features.end();
 
+  auto slot = co_await acquire_transfer_slot(option);
+
   auto client = co_await sync_open_connect(
         target,
         option);
@@ -1763,6 +2196,8 @@ co_sync_pull_buffer(
   auto features = co_await co_get_features(target, option);
   bool have_stat_v2 = std::ranges::find(features, "stat_v2") != features.end();
 
+  auto slot = co_await acquire_transfer_slot(option);
+
   auto client = co_await sync_open_connect(
         target,
         option);
@@ -1805,6 +2240,8 @@ co_sync_push(
   bool have_fixed_push_mkdir = std::ranges::find(features, "fixed_push_mkdir") != features.end();
   bool have_shell_v2 = std::ranges::find(features, "shell_v2") != features.end();
 
+  auto slot = co_await acquire_transfer_slot(option);
+
   auto client = co_await sync_open_connect(
         target,
         option);
@@ -1886,6 +2323,8 @@ co_sync_push_buffer(
   auto features = co_await co_get_features(target, option);
   bool have_stat_v2 = std::ranges::find(features, "stat_v2") != features.end();
 
+  auto slot = co_await acquire_transfer_slot(option);
+
   auto client = co_await sync_open_connect(
         target,
         option);
@@ -1908,4 +2347,251 @@ co_sync_push_buffer(
   co_await client.end();
 }
 
+// install
+
+namespace {
+
+std::string install_args_suffix(std::string_view args) {
+  return args.empty() ? std::string() : std::format(" {}", args);
+}
+
+// pm prints the result on a line of its own
+std::string install_result(const std::vector<char> &out) {
+  std::string result(out.begin(), out.end());
+  while (!result.empty() && isspace((unsigned char)result.back())) {
+    result.pop_back();
+  }
+  return result;
+}
+
+awaitable<std::string>
+install_read_result(AdbSocket &socket) {
+  auto [code, out, err] = co_await read_output(socket);
+  co_return install_result(out);
+}
+
+awaitable<std::string>
+install_streamed(
+    AdbEndpoint target,
+    const MappedFile &apk,
+    TransportOption option,
+    std::string_view args) {
+  auto client = co_await connect(
+        target,
+        std::format("exec:cmd package install -S {}{}", apk.size(), install_args_suffix(args)),
+        option,
+        nullptr);
+
+  co_await async_write(client, asio::buffer(apk.data(), apk.size()), use_awaitable);
+
+  auto result = co_await install_read_result(client);
+  if (!result.starts_with("Success")) {
+    throw adb_error(result.empty() ? "install failed" : result);
+  }
+  co_return result;
+}
+
+awaitable<std::string>
+install_multiple_streamed(
+    AdbEndpoint target,
+    const std::vector<const MappedFile *> &apks,
+    TransportOption option,
+    std::string_view args) {
+  uint64_t total = 0;
+  for (auto *apk : apks) {
+    total += apk->size();
+  }
+
+  std::string session_id;
+  {
+    auto client = co_await connect(
+          target,
+          std::format("exec:cmd package install-create -S {}{}", total, install_args_suffix(args)),
+          option,
+          nullptr);
+
+    // Success: created install session [1234]
+    auto out = co_await install_read_result(client);
+    auto begin = out.find('[');
+    auto end = out.find(']', begin);
+    if (!out.starts_with("Success") || begin == out.npos || end == out.npos) {
+      throw adb_error(out.empty() ? "install-create failed" : out);
+    }
+    session_id = out.substr(begin + 1, end - begin - 1);
+  }
+
+  std::string failure;
+
+  for (size_t i = 0; i < apks.size() && failure.empty(); i++) {
+    try {
+      auto client = co_await connect(
+            target,
+            std::format("exec:cmd package install-write -S {} {} {}_{} -",
+                apks[i]->size(), session_id, i, apks[i]->path().filename().string()),
+            option,
+            nullptr);
+
+      co_await async_write(client, asio::buffer(apks[i]->data(), apks[i]->size()), use_awaitable);
+
+      auto out = co_await install_read_result(client);
+      if (!out.starts_with("Success")) {
+        failure = out.empty() ? "install-write failed" : out;
+      }
+    } catch (std::exception &e) {
+      failure = e.what();
+    }
+  }
+
+  auto client = co_await connect(
+        target,
+        std::format("exec:cmd package install-{} {}", failure.empty() ? "commit" : "abandon", session_id),
+        option,
+        nullptr);
+  auto out = co_await install_read_result(client);
+
+  if (!failure.empty()) {
+    throw adb_error(failure);
+  }
+
+  if (!out.starts_with("Success")) {
+    throw adb_error(out.empty() ? "install-commit failed" : out);
+  }
+  co_return out;
+}
+
+awaitable<std::string>
+install_legacy(
+    AdbEndpoint target,
+    const MappedFile &apk,
+    TransportOption option,
+    std::string_view args) {
+  auto rpath = posix_join("/data/local/tmp", apk.path().filename().string());
+
+  {
+    auto client = co_await sync_open_connect(target, option);
+    co_await sync_send_buffer(client.socket, rpath, apk.data(), apk.size());
+    co_await client.end();
+  }
+
+  auto [code, out, err] = co_await co_execute_shell(
+        target,
+        std::format("pm install{} {}", install_args_suffix(args), escape_arg(rpath)),
+        option,
+        std::nullopt);
+
+  try {
+    co_await co_execute_shell(target, "rm -f " + escape_arg(rpath), option, std::nullopt);
+  } catch (std::exception &) {
+  }
+
+  auto result = install_result(out);
+
+  if (result.find("Success") == result.npos) {
+    result.append(err.begin(), err.end());
+    throw adb_error(result.empty() ? "install failed" : result);
+  }
+  co_return result;
+}
+
+awaitable<std::string>
+install_mapped(
+    AdbEndpoint target,
+    const std::vector<const MappedFile *> &apks,
+    TransportOption option,
+    std::string_view args) {
+  auto features = co_await co_get_features(target, option);
+  bool have_cmd = std::ranges::find(features, "cmd") != features.end();
+
+  if (!have_cmd) {
+    if (apks.size() > 1) {
+      throw adb_error("split apk install requires the cmd feature");
+    }
+    co_return co_await install_legacy(target, *apks[0], option, args);
+  }
+
+  if (apks.size() == 1) {
+    co_return co_await install_streamed(target, *apks[0], option, args);
+  }
+
+  co_return co_await install_multiple_streamed(target, apks, option, args);
+}
+
+std::vector<MappedFile>
+map_apks(const std::vector<LocalPath>& apks) {
+  if (apks.empty()) {
+    throw adb_error("no apk given");
+  }
+
+  std::vector<MappedFile> maps;
+  for (auto &apk : apks) {
+    maps.emplace_back(apk);
+  }
+  return maps;
+}
+
+} // namespace
+
+awaitable<std::string>
+co_install(
+    const std::vector<LocalPath>& apks,
+    TransportOption option,
+    std::string_view args) {
+  auto maps = map_apks(apks);
+
+  std::vector<const MappedFile *> views;
+  for (auto &m : maps) {
+    views.push_back(&m);
+  }
+
+  co_return co_await install_mapped(
+      co_await resolve_endpoint(option),
+      views,
+      option,
+      args);
+}
+
+awaitable<std::vector<InstallResult>>
+co_install_multi(
+    const std::vector<LocalPath>& apks,
+    const std::vector<std::string>& serials,
+    size_t concurrency,
+    std::string_view args,
+    TransportOption option) {
+  auto maps = map_apks(apks);
+
+  std::vector<const MappedFile *> views;
+  for (auto &m : maps) {
+    views.push_back(&m);
+  }
+
+  auto target = co_await resolve_endpoint(option);
+
+  std::vector<InstallResult> results(serials.size());
+
+  co_await co_for_each_bounded(serials.size(), concurrency, [&](size_t i) -> awaitable<void> {
+    auto &result = results[i];
+    result.serial = serials[i];
+
+    auto opt = option;
+    opt.serial = serials[i];
+    opt.transportId.reset();
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+      result.message = co_await install_mapped(target, views, opt, args);
+      result.success = true;
+    } catch (std::exception &e) {
+      result.message = e.what();
+    }
+    result.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+  });
+
+  co_return results;
+}
+
 } // namespace adb_client
+
+#ifdef ENABLE_TEST
+#include "co-adb-client_tests.cc"
+#endif
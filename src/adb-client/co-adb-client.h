@@ -21,10 +21,38 @@
 #pragma once 
 #include "adb-client.h"
 #include <asio/awaitable.hpp>
+#include <asio/generic/stream_protocol.hpp>
 
 
 namespace adb_client {
 
+// connection to the adb server, a tcp or a unix domain stream socket.
+// TransportOption::server selects the server either by host name or by a
+// socket spec (tcp:[host:]port, localfilesystem:path, localabstract:name),
+// falling back to ADB_SERVER_SOCKET and then to localhost:5037.
+using AdbSocket = asio::generic::stream_protocol::socket;
+using AdbEndpoint = asio::generic::stream_protocol::endpoint;
+
+// the server a TransportOption selects, env and defaults applied, as one of
+// tcp:<host>:<port>, localfilesystem:<path> or localabstract:<name>.
+// a server without prefix may also read "host:port" or be a bare port.
+std::string
+server_socket_spec(const TransportOption &option);
+
+// device states kept in process (e.g. fed by a host:track-devices-l stream),
+// lets co_wait_device skip the server's wait-for service.
+class DeviceStateSource {
+public:
+  virtual ~DeviceStateSource() = default;
+
+  // false: the selected server is not followed here, ask the server itself
+  virtual bool covers(const TransportOption &option) const = 0;
+
+  // same contract as co_wait_device, throws adb_error on timeout
+  virtual asio::awaitable<void>
+  co_wait(std::string_view state, TransportOption option, std::optional<std::chrono::milliseconds> timeout) = 0;
+};
+
 asio::awaitable<void>
 co_wait_device(
     std::string_view state = "device",
@@ -42,6 +70,28 @@ co_query(
 asio::awaitable<std::vector<DeviceInfo>>
 co_list_devices(TransportOption option, bool device_only = true, std::string_view target_serial = {});
 
+// parse the text of host:devices-l
+std::vector<DeviceInfo>
+parse_device_list(std::string_view liststr, bool device_only = true, std::string_view target_serial = {});
+
+// parse the text of host:mdns:services
+std::vector<MdnsService>
+parse_mdns_services(std::string_view text);
+
+// the reply of host:connect: reads "connected to <addr>" or
+// "already connected to <addr>" on success, anything else is a failure
+bool
+is_connect_success(std::string_view reply);
+
+// open a host:track-devices-l stream, the server pushes the
+// full device list on connect and again on every change.
+asio::awaitable<AdbSocket>
+co_track_devices(TransportOption option = {});
+
+// wait for the next list pushed on a co_track_devices stream
+asio::awaitable<std::vector<DeviceInfo>>
+co_next_devices(AdbSocket &tracker, bool device_only = false);
+
 asio::awaitable<void>
 co_command(
     std::string_view command,
@@ -58,6 +108,14 @@ co_command_connect(
     std::string_view command,
     TransportOption option = {});
 
+// open a raw stream to a device service, e.g. "tcp:8080" or "localabstract:name".
+// the returned socket is positioned right after the OKAY status.
+asio::awaitable<AdbSocket>
+co_open_service(
+    std::string_view service,
+    TransportOption option = {},
+    int64_t *transportId = nullptr);
+
 asio::awaitable<std::vector<std::string>>
 co_get_features(
     TransportOption option = {});
@@ -109,4 +167,22 @@ co_sync_push_buffer(
     std::string_view dst,
     TransportOption option = {});
 
+// streamed install (`cmd package install -S`), the apk is mapped and read once.
+// falls back to push + `pm install` on devices without the cmd feature.
+asio::awaitable<std::string>
+co_install(
+    const std::vector<std::filesystem::path>& apks,
+    TransportOption option = {},
+    std::string_view args = {});
+
+// install on every serial, at most `concurrency` devices at a time.
+// all devices stream from the same mapping, failures are reported per device.
+asio::awaitable<std::vector<InstallResult>>
+co_install_multi(
+    const std::vector<std::filesystem::path>& apks,
+    const std::vector<std::string>& serials,
+    size_t concurrency = 8,
+    std::string_view args = {},
+    TransportOption option = {});
+
 } // namespace adb_client
@@ -0,0 +1,137 @@
+#include <fstream>
+#include <future>
+#include <thread>
+
+namespace adb_client {
+
+// an install against the fake server, on its own io thread
+class InstallTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    apk_ = std::filesystem::temp_directory_path() /
+        std::format("co-install-{}-{}.apk", ::testing::UnitTest::GetInstance()->current_test_info()->name(),
+            std::chrono::steady_clock::now().time_since_epoch().count());
+    std::ofstream(apk_, std::ios::binary) << std::string(300 * 1024, 'k');
+
+    server_ = fake_.listenTcp();
+    io_ = std::thread([this] { ctx_.run(); });
+  }
+
+  void TearDown() override {
+    fake_.close();
+    guard_.reset();
+    io_.join();
+    std::error_code ec;
+    std::filesystem::remove(apk_, ec);
+  }
+
+  template <class T>
+  T run(asio::awaitable<T> op) {
+    return co_spawn(ctx_, std::move(op), asio::use_future).get();
+  }
+
+  TransportOption option(std::string_view serial = {}) {
+    return {.server = server_, .serial = serial, .launchServerIfNeed = false};
+  }
+
+  asio::io_context ctx_;
+  asio::executor_work_guard<asio::io_context::executor_type> guard_{ctx_.get_executor()};
+  adb_bench::FakeAdbServer fake_{ctx_.get_executor()};
+  std::filesystem::path apk_;
+  std::string server_;
+  std::thread io_;
+};
+
+TEST_F(InstallTest, Streamed) {
+  auto out = run(co_install({apk_}, option("dev1")));
+  EXPECT_EQ(out, "Success");
+  EXPECT_EQ(fake_.installs(), 1u);
+}
+
+TEST_F(InstallTest, Failure) {
+  fake_.setInstallResult("dev1", "Failure [INSTALL_FAILED_OLDER_SDK]");
+  try {
+    run(co_install({apk_}, option("dev1")));
+    FAIL() << "no error";
+  } catch (adb_error &e) {
+    EXPECT_STREQ(e.what(), "Failure [INSTALL_FAILED_OLDER_SDK]");
+  }
+  EXPECT_THROW(run(co_install({}, option("dev1"))), adb_error);
+}
+
+TEST_F(InstallTest, MultiIsBounded) {
+  fake_.setInstallDelay(std::chrono::milliseconds(30));
+  fake_.setInstallResult("dev3", "Failure [INSTALL_FAILED_INSUFFICIENT_STORAGE]");
+
+  std::vector<std::string> serials;
+  for (int i = 0; i < 7; i++) {
+    serials.push_back(std::format("dev{}", i));
+  }
+
+  auto results = run(co_install_multi({apk_}, serials, 2, {}, option()));
+  ASSERT_EQ(results.size(), serials.size());
+  for (size_t i = 0; i < results.size(); i++) {
+    EXPECT_EQ(results[i].serial, serials[i]);
+    EXPECT_EQ(results[i].success, i != 3) << serials[i];
+  }
+  EXPECT_EQ(results[3].message, "Failure [INSTALL_FAILED_INSUFFICIENT_STORAGE]");
+  EXPECT_EQ(results[0].message, "Success");
+
+  EXPECT_EQ(fake_.installs(), serials.size());
+  EXPECT_EQ(fake_.peakInstalls(), 2u);
+}
+
+TEST_F(InstallTest, PushHoldsTransferSlot) {
+  TransferScheduler scheduler;
+  scheduler.setLinkCapacity("USB1-9", 1);
+
+  std::vector<char> data(2 * 1024 * 1024, 'p');
+  auto opt = option("dev1");
+  opt.transferScheduler = &scheduler;
+  opt.transferLink = "USB1-9";
+
+  // three pushes to devices on one hub: the slot serializes their sync sessions.
+  // the scheduler lives on the io thread like the transfers
+  std::vector<std::future<void>> pushes;
+  for (int i = 0; i < 3; i++) {
+    pushes.push_back(co_spawn(ctx_, co_sync_push_buffer(data.data(), data.size(), "/data/local/tmp/x", opt), asio::use_future));
+  }
+  for (auto &p : pushes) {
+    EXPECT_NO_THROW(p.get());
+  }
+
+  EXPECT_EQ(fake_.peakSyncs(), 1u);
+  EXPECT_EQ(asio::post(ctx_, asio::use_future([&] { return scheduler.inflight("USB1-9"); })).get(), 0u);
+}
+
+// move-only, so it can only live on in the workers
+struct BoundedBody {
+  std::unique_ptr<int> factor;
+  std::vector<int> &seen;
+  size_t &running;
+  size_t &peak;
+
+  asio::awaitable<void> operator()(size_t i) {
+    peak = std::max(peak, ++running);
+    asio::steady_timer t(co_await asio::this_coro::executor, std::chrono::milliseconds(1));
+    co_await t.async_wait(asio::use_awaitable);
+    seen.push_back(int(i) * *factor);
+    running--;
+  }
+};
+
+TEST(CoForEachBounded, OwnsFn) {
+  asio::io_context ctx;
+  std::vector<int> seen;
+  size_t running = 0;
+  size_t peak = 0;
+
+  co_spawn(ctx, co_for_each_bounded(5, 3, BoundedBody{std::make_unique<int>(7), seen, running, peak}), asio::detached);
+  ctx.run();
+
+  std::ranges::sort(seen);
+  EXPECT_EQ(seen, (std::vector<int>{0, 7, 14, 21, 28}));
+  EXPECT_EQ(peak, 3u);
+}
+
+} // namespace adb_client
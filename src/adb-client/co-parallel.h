@@ -0,0 +1,97 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <asio/awaitable.hpp>
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/post.hpp>
+#include <asio/redirect_error.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/this_coro.hpp>
+#include <asio/use_awaitable.hpp>
+#include <algorithm>
+#include <memory>
+#include <concepts>
+#include <utility>
+
+namespace adb_client {
+
+// run fn(0) .. fn(count - 1) with at most `concurrency` of them in flight,
+// and resume once all of them are done.
+// fn is expected to report its own failures, exceptions escaping it are dropped.
+// the current executor must be single threaded (or a strand).
+template <class Fn>
+requires std::invocable<Fn&, size_t>
+asio::awaitable<void>
+co_for_each_bounded(size_t count, size_t concurrency, Fn fn) {
+  if (count == 0) {
+    co_return;
+  }
+
+  auto ex = co_await asio::this_coro::executor;
+
+  // owned by the workers, they may outlive this frame if it is destroyed
+  struct State {
+    Fn fn;
+    size_t next{0};
+    size_t running{0};
+    asio::steady_timer done;
+
+    State(Fn &&fn, const asio::any_io_executor &ex)
+      : fn(std::move(fn)), done(ex, asio::steady_timer::time_point::max()) {}
+  };
+
+  auto state = std::make_shared<State>(std::move(fn), ex);
+  auto workers = std::clamp<size_t>(concurrency, 1, count);
+  state->running = workers;
+
+  for (size_t w = 0; w < workers; w++) {
+    co_spawn(ex, [state, count]() -> asio::awaitable<void> {
+      while (state->next < count) {
+        auto i = state->next++;
+        try {
+          co_await state->fn(i);
+        } catch (std::exception &) {
+        }
+      }
+
+      if (--state->running == 0) {
+        // expiring (rather than cancelling) also covers a wait not started yet
+        state->done.expires_at(asio::steady_timer::time_point::min());
+      }
+    }, asio::detached);
+  }
+
+  asio::error_code ec;
+  co_await state->done.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+}
+
+// cancels a timer whose handler refers to locals of the calling frame and
+// resumes once that handler has run. cancel() only queues the aborted
+// handler, returning right away would let it run after the frame is gone.
+// the current executor must be single threaded (or a strand).
+inline asio::awaitable<void>
+co_cancel_timer(asio::steady_timer &timer) {
+  timer.cancel();
+  co_await asio::post(co_await asio::this_coro::executor, asio::use_awaitable);
+}
+
+} // namespace adb_client
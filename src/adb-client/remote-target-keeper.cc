@@ -0,0 +1,304 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "remote-target-keeper.h"
+#include "co-parallel.h"
+#include <asio.hpp>
+#include <random>
+#include <tuple>
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#include "bench/fake-adb-server.h"
+#endif
+
+namespace adb_client {
+
+using asio::awaitable;
+using asio::use_awaitable;
+using asio::ip::tcp;
+
+namespace {
+
+constexpr std::string_view kDefaultAdbdPort = "5555";
+
+std::chrono::milliseconds
+jitter(std::chrono::milliseconds base) {
+  thread_local std::mt19937 rng{std::random_device{}()};
+  // +-25%, keeps a batch of targets that dropped together from retrying in lockstep
+  std::uniform_real_distribution<double> dist(0.75, 1.25);
+  return std::chrono::milliseconds((int64_t)(base.count() * dist(rng)));
+}
+
+// host[:port], [addr][:port] or a bare ipv6 address, as adb connect takes them
+std::pair<std::string, std::string>
+split_target(std::string_view t) {
+  if (t.starts_with('[')) {
+    auto close = t.find(']');
+    if (close != std::string_view::npos) {
+      auto rest = t.substr(close + 1);
+      return {
+        std::string(t.substr(1, close - 1)),
+        std::string(rest.starts_with(':') ? rest.substr(1) : kDefaultAdbdPort),
+      };
+    }
+  }
+
+  auto colon = t.find(':');
+  if (colon == std::string_view::npos || t.find(':', colon + 1) != std::string_view::npos) {
+    return {std::string(t), std::string(kDefaultAdbdPort)};
+  }
+  return {std::string(t.substr(0, colon)), std::string(t.substr(colon + 1))};
+}
+
+awaitable<void>
+sleep_for(std::chrono::milliseconds duration) {
+  asio::steady_timer timer(co_await asio::this_coro::executor, duration);
+  co_await timer.async_wait(use_awaitable);
+}
+
+} // namespace
+
+RemoteTargetKeeper::RemoteTargetKeeper(const std::vector<std::string> &targets, Settings settings)
+  : RemoteTargetKeeper(targets, TransportOption{}, settings) {}
+
+RemoteTargetKeeper::RemoteTargetKeeper(
+    const std::vector<std::string> &targets,
+    TransportOption option,
+    Settings settings)
+  : settings_(settings),
+    server_(option.server),
+    server_port_(option.port),
+    launch_server_(option.launchServerIfNeed) {
+  for (auto &t : targets) {
+    if (t.empty()) {
+      continue;
+    }
+
+    Target target;
+    std::tie(target.host, target.port) = split_target(t);
+    // adb names an ipv6 target [addr]:port
+    bool v6 = target.host.find(':') != std::string::npos;
+    target.status.serial = v6 ? "[" + target.host + "]:" + target.port
+                              : target.host + ":" + target.port;
+    targets_.push_back(std::move(target));
+  }
+}
+
+RemoteTargetKeeper::~RemoteTargetKeeper() {
+  stop();
+}
+
+void RemoteTargetKeeper::start() {
+  if (thread_.joinable() || targets_.empty()) {
+    return;
+  }
+
+  co_spawn(ctx_, co_track(), asio::detached);
+  for (size_t i = 0; i < targets_.size(); i++) {
+    co_spawn(ctx_, co_keep(i), asio::detached);
+  }
+
+  thread_ = std::thread([this] {
+    ctx_.run();
+  });
+}
+
+void RemoteTargetKeeper::stop() noexcept {
+  ctx_.stop();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool RemoteTargetKeeper::waitSettled(std::chrono::milliseconds timeout) {
+  std::unique_lock lk(mutex_);
+  return settled_.wait_for(lk, timeout, [this] {
+    return std::ranges::none_of(targets_, [](auto &t) {
+      return t.status.state == State::Connecting;
+    });
+  });
+}
+
+std::vector<RemoteTargetKeeper::TargetStatus> RemoteTargetKeeper::status() const {
+  std::vector<TargetStatus> out;
+  std::lock_guard lk(mutex_);
+  for (auto &t : targets_) {
+    out.push_back(t.status);
+  }
+  return out;
+}
+
+void RemoteTargetKeeper::setState(Target &target, State state) {
+  {
+    std::lock_guard lk(mutex_);
+    target.status.state = state;
+    if (state == State::Connected) {
+      target.status.failures = 0;
+    } else if (state == State::Unreachable) {
+      target.status.failures++;
+    }
+  }
+  settled_.notify_all();
+}
+
+// plain tcp connect to adbd, bounded by connectTimeout
+awaitable<bool>
+RemoteTargetKeeper::co_probe(const Target &target) {
+  auto ex = co_await asio::this_coro::executor;
+
+  asio::steady_timer deadline(ex, settings_.connectTimeout);
+  tcp::resolver resolver(ex);
+  tcp::socket socket(ex);
+  bool expired = false;
+
+  deadline.async_wait([&](asio::error_code ec) {
+    if (!ec) {
+      expired = true;
+      resolver.cancel();
+      socket.close(ec);
+    }
+  });
+
+  asio::error_code ec;
+  auto endpoints = co_await resolver.async_resolve(
+        target.host, target.port, asio::redirect_error(use_awaitable, ec));
+  if (!ec && !expired) {
+    co_await asio::async_connect(socket, endpoints, asio::redirect_error(use_awaitable, ec));
+  }
+
+  co_await co_cancel_timer(deadline);
+
+  co_return !ec && !expired;
+}
+
+// connected once the server accepted the target and lists it
+awaitable<bool>
+RemoteTargetKeeper::co_connect(Target &target) {
+  if (!co_await co_probe(target)) {
+    co_return false;
+  }
+
+  try {
+    auto reply = co_await co_command_query("connect:" + target.status.serial, {
+      .server = server_,
+      .port = server_port_,
+      .launchServerIfNeed = launch_server_,
+    });
+    if (!is_connect_success(reply)) {
+      co_return false;
+    }
+  } catch (std::exception &) {
+    co_return false;
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + settings_.connectTimeout;
+  while (!alive(target)) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0) {
+      co_return false;
+    }
+    co_await co_tracked_change(left);
+  }
+  co_return true;
+}
+
+bool RemoteTargetKeeper::alive(const Target &target) const {
+  auto it = tracked_.find(target.status.serial);
+  return it != tracked_.end() && it->second != "offline";
+}
+
+awaitable<void>
+RemoteTargetKeeper::co_tracked_change(std::chrono::milliseconds timeout) {
+  auto ex = co_await asio::this_coro::executor;
+
+  // the deadline wakes every waiter, they all re-check their target
+  asio::steady_timer deadline(ex, timeout);
+  deadline.async_wait([this](asio::error_code ec) {
+    if (!ec) {
+      tracked_changed_.cancel();
+    }
+  });
+
+  asio::error_code ec;
+  co_await tracked_changed_.async_wait(asio::redirect_error(use_awaitable, ec));
+
+  co_await co_cancel_timer(deadline);
+}
+
+// one device list stream for all targets, a broken stream drops them all
+awaitable<void>
+RemoteTargetKeeper::co_track() {
+  for (;;) {
+    try {
+      auto tracker = co_await co_track_devices({
+        .server = server_,
+        .port = server_port_,
+        .launchServerIfNeed = launch_server_,
+      });
+
+      for (;;) {
+        auto devices = co_await co_next_devices(tracker);
+        tracked_.clear();
+        for (auto &dev : devices) {
+          tracked_.emplace(std::move(dev.serial), std::move(dev.state));
+        }
+        tracked_changed_.cancel();
+      }
+    } catch (std::exception &) {
+    }
+
+    tracked_.clear();
+    tracked_changed_.cancel();
+    co_await sleep_for(jitter(settings_.backoffMin));
+  }
+}
+
+awaitable<void>
+RemoteTargetKeeper::co_keep(size_t index) {
+  auto &target = targets_[index];
+  auto backoff = settings_.backoffMin;
+
+  for (;;) {
+    if (co_await co_connect(target)) {
+      setState(target, State::Connected);
+      backoff = settings_.backoffMin;
+
+      while (alive(target)) {
+        asio::error_code ec;
+        co_await tracked_changed_.async_wait(asio::redirect_error(use_awaitable, ec));
+      }
+
+      // lost, reconnect right away, backoff only applies to failed attempts
+      setState(target, State::Connecting);
+      continue;
+    }
+
+    setState(target, State::Unreachable);
+    co_await sleep_for(jitter(backoff));
+    backoff = std::min(backoff * 2, settings_.backoffMax);
+  }
+}
+
+} // namespace adb_client
+
+#ifdef ENABLE_TEST
+#include "remote-target-keeper_tests.cc"
+#endif
@@ -0,0 +1,118 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include "co-adb-client.h"
+#include <asio/io_context.hpp>
+#include <asio/steady_timer.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace adb_client {
+
+struct RemoteTargetSettings {
+  std::chrono::milliseconds connectTimeout{3000};
+  std::chrono::milliseconds backoffMin{1000};
+  std::chrono::milliseconds backoffMax{60000};
+};
+
+// keeps network adb targets (ip[:port]) connected to the adb server.
+//
+// all targets are handled concurrently on one background thread:
+// each target is first probed with a plain tcp connect bounded by
+// connectTimeout, and only a reachable target is handed to `host:connect`,
+// so an unreachable host never delays the others.
+// liveness comes from one host:track-devices-l stream: a connected target
+// is lost once the server drops it or reports it offline (or the stream
+// breaks), lost ones are reconnected with jittered exponential backoff.
+class RemoteTargetKeeper {
+public:
+  using Settings = RemoteTargetSettings;
+
+  enum class State {
+    Connecting,
+    Connected,
+    Unreachable,
+  };
+
+  struct TargetStatus {
+    std::string serial; // ip:port, [ipv6]:port
+    State state{State::Connecting};
+    uint32_t failures{0};
+  };
+
+  explicit RemoteTargetKeeper(const std::vector<std::string> &targets, Settings settings = {});
+  RemoteTargetKeeper(const std::vector<std::string> &targets, TransportOption option, Settings settings = {});
+  ~RemoteTargetKeeper();
+
+  RemoteTargetKeeper(const RemoteTargetKeeper &) = delete;
+  RemoteTargetKeeper& operator=(const RemoteTargetKeeper &) = delete;
+
+  // returns immediately, connecting happens in the background
+  void start();
+  void stop() noexcept;
+
+  // block until every target had its first connect attempt (or timeout),
+  // for callers that want a snapshot right after start
+  bool waitSettled(std::chrono::milliseconds timeout);
+
+  std::vector<TargetStatus> status() const;
+
+private:
+  struct Target {
+    std::string host;
+    std::string port;
+    TargetStatus status;
+  };
+
+  asio::awaitable<bool> co_probe(const Target &target);
+  asio::awaitable<bool> co_connect(Target &target);
+  asio::awaitable<void> co_keep(size_t index);
+  asio::awaitable<void> co_track();
+
+  // online in the last tracked list
+  bool alive(const Target &target) const;
+  // resumes on the next tracked list, or after timeout
+  asio::awaitable<void> co_tracked_change(std::chrono::milliseconds timeout);
+
+  void setState(Target &target, State state);
+
+  Settings settings_;
+  std::string server_;
+  std::string server_port_;
+  bool launch_server_{true};
+
+  std::vector<Target> targets_;
+  mutable std::mutex mutex_;
+  std::condition_variable settled_;
+
+  asio::io_context ctx_;
+  std::thread thread_;
+
+  // <serial, state> of the tracked list, only touched on the keeper thread
+  std::unordered_map<std::string, std::string> tracked_;
+  // cancelled on every tracked list to wake the targets
+  asio::steady_timer tracked_changed_{ctx_, asio::steady_timer::time_point::max()};
+};
+
+} // namespace adb_client
@@ -0,0 +1,113 @@
+#include <thread>
+
+namespace adb_client {
+
+TEST(RemoteTargetKeeper, ConnectReply) {
+  EXPECT_TRUE(is_connect_success("connected to 10.0.0.2:5555"));
+  EXPECT_TRUE(is_connect_success("already connected to 10.0.0.2:5555\n"));
+  EXPECT_FALSE(is_connect_success("failed to connect to 10.0.0.2:5555"));
+  EXPECT_FALSE(is_connect_success("failed to connect to '10.0.0.2:5555': Connection refused"));
+  EXPECT_FALSE(is_connect_success("unable to connect to 10.0.0.2:5555"));
+  EXPECT_FALSE(is_connect_success("cannot connect to 10.0.0.2:5555: connected to nothing"));
+  EXPECT_FALSE(is_connect_success("connected to "));
+  EXPECT_FALSE(is_connect_success(""));
+}
+
+TEST(RemoteTargetKeeper, TargetForms) {
+  RemoteTargetKeeper keeper({"10.0.0.2", "10.0.0.3:5557", "[::1]:5556", "[fe80::1]", "fe80::1", "fe80::1:2"});
+  std::vector<std::string> serials;
+  for (auto &s : keeper.status()) {
+    serials.push_back(s.serial);
+  }
+
+  EXPECT_EQ(serials, (std::vector<std::string>{
+    "10.0.0.2:5555",
+    "10.0.0.3:5557",
+    "[::1]:5556",
+    "[fe80::1]:5555",
+    "[fe80::1]:5555",
+    "[fe80::1:2]:5555",
+  }));
+}
+
+namespace {
+
+// poll the keeper's status until pred holds, or give up after 5s
+template <class Pred>
+bool wait_status(RemoteTargetKeeper &keeper, Pred pred) {
+  for (int i = 0; i < 500; i++) {
+    auto status = keeper.status();
+    if (status.size() == 1 && pred(status[0])) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+} // namespace
+
+TEST(RemoteTargetKeeper, FollowsTrackedState) {
+  asio::io_context ctx;
+  auto guard = asio::make_work_guard(ctx);
+  adb_bench::FakeAdbServer fake(ctx.get_executor());
+  auto server = fake.listenTcp();
+  std::thread io([&ctx] { ctx.run(); });
+
+  // the fake server's own port stands in for adbd, the probe only connects
+  auto target = "127.0.0.1:" + server.substr(server.rfind(':') + 1);
+  auto online = target + "\tdevice product:p model:m device:d transport_id:3\n";
+
+  fake.setDevices(online);
+  RemoteTargetKeeper keeper({target}, {.server = server, .launchServerIfNeed = false},
+      {.connectTimeout = std::chrono::milliseconds(500), .backoffMin = std::chrono::milliseconds(20)});
+  keeper.start();
+
+  ASSERT_TRUE(keeper.waitSettled(std::chrono::seconds(5)));
+  EXPECT_EQ(keeper.status()[0].state, RemoteTargetKeeper::State::Connected);
+  EXPECT_EQ(fake.connects(), 1u);
+
+  // while the server lists the target nothing is probed or reconnected
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(fake.connects(), 1u);
+
+  // offline in the tracked list: lost, reconnecting does not bring it back
+  fake.setDevices(target + "\toffline\n");
+  EXPECT_TRUE(wait_status(keeper, [](auto &s) { return s.state != RemoteTargetKeeper::State::Connected; }));
+  EXPECT_TRUE(wait_status(keeper, [](auto &s) { return s.failures > 0; }));
+
+  fake.setDevices(online);
+  EXPECT_TRUE(wait_status(keeper, [](auto &s) { return s.state == RemoteTargetKeeper::State::Connected; }));
+  EXPECT_GE(fake.connects(), 2u);
+
+  keeper.stop();
+  fake.close();
+  guard.reset();
+  io.join();
+}
+
+TEST(RemoteTargetKeeper, RejectedConnect) {
+  asio::io_context ctx;
+  auto guard = asio::make_work_guard(ctx);
+  adb_bench::FakeAdbServer fake(ctx.get_executor());
+  auto server = fake.listenTcp();
+  std::thread io([&ctx] { ctx.run(); });
+
+  auto target = "127.0.0.1:" + server.substr(server.rfind(':') + 1);
+  fake.setConnectReply("failed to connect to '" + target + "': Connection refused");
+  fake.setDevices(target + "\tdevice\n");
+
+  RemoteTargetKeeper keeper({target}, {.server = server, .launchServerIfNeed = false},
+      {.backoffMin = std::chrono::milliseconds(20)});
+  keeper.start();
+
+  ASSERT_TRUE(keeper.waitSettled(std::chrono::seconds(5)));
+  EXPECT_EQ(keeper.status()[0].state, RemoteTargetKeeper::State::Unreachable);
+
+  keeper.stop();
+  fake.close();
+  guard.reset();
+  io.join();
+}
+
+} // namespace adb_client
@@ -0,0 +1,354 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "telemetry-sampler.h"
+#include "co-parallel.h"
+#include <asio.hpp>
+#include <charconv>
+#include <random>
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#endif
+
+namespace adb_client {
+
+using asio::awaitable;
+using asio::use_awaitable;
+
+namespace {
+
+constexpr std::string_view kBatteryDir = "/sys/class/power_supply/battery/";
+constexpr std::string_view kThermalDir = "/sys/class/thermal/thermal_zone";
+constexpr std::string_view kCpuDir = "/sys/devices/system/cpu/cpu";
+constexpr std::string_view kStorageTag = "df:";
+
+constexpr size_t kReadChunk = 4096;
+
+// +-2% of the interval, keeps devices sharing a slot from staying in lockstep
+std::chrono::milliseconds
+jitter(std::chrono::milliseconds interval) {
+  thread_local std::mt19937 rng{std::random_device{}()};
+  auto spread = std::max<int64_t>(interval.count() / 50, 1);
+  std::uniform_int_distribution<int64_t> dist(-spread, spread);
+  return std::chrono::milliseconds(dist(rng));
+}
+
+bool to_int(std::string_view text, int64_t &value) {
+  auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+  return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+// "<n><suffix>" at the start of text
+bool index_of(std::string_view text, std::string_view suffix, uint16_t &index) {
+  auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), index);
+  return ec == std::errc() && std::string_view(ptr, text.data() + text.size()) == suffix;
+}
+
+// "/dev/block/dm-5  115412996  61205440  54076484  54% /data"
+bool parse_storage(std::string_view line, int64_t &total, int64_t &free) {
+  std::string_view fields[4];
+  size_t count = 0;
+  while (count < 4) {
+    auto start = line.find_first_not_of(' ');
+    if (start == std::string_view::npos) {
+      return false;
+    }
+    line.remove_prefix(start);
+    auto end = std::min(line.find(' '), line.size());
+    fields[count++] = line.substr(0, end);
+    line.remove_prefix(end);
+  }
+  return to_int(fields[1], total) && to_int(fields[3], free);
+}
+
+} // namespace
+
+std::string telemetry_command(uint32_t groups) {
+  std::string paths;
+  if (groups & kBattery) {
+    for (auto name : {"capacity", "temp", "voltage_now"}) {
+      paths.append(" ").append(kBatteryDir).append(name);
+    }
+  }
+  if (groups & kThermal) {
+    paths.append(" ").append(kThermalDir).append("*/temp");
+  }
+  if (groups & kCpuFreq) {
+    paths.append(" ").append(kCpuDir).append("[0-9]*/cpufreq/scaling_cur_freq");
+  }
+
+  // grep -H prints path:value, every line names its own metric
+  std::string command;
+  if (!paths.empty()) {
+    command = "grep -sH ." + paths;
+  }
+  if (groups & kStorage) {
+    command.append(command.empty() ? "" : ";").append("echo df:$(df -k /data | tail -n 1)");
+  }
+  return command;
+}
+
+size_t parse_telemetry(std::string_view output, uint32_t device, int64_t timeMs, std::vector<TelemetryRecord> &out) {
+  auto first = out.size();
+
+  auto add = [&](Metric metric, uint16_t channel, int64_t value) {
+    out.push_back({.timeMs = timeMs, .value = value, .device = device, .channel = channel, .metric = metric});
+  };
+
+  while (!output.empty()) {
+    auto eol = std::min(output.find('\n'), output.size());
+    auto line = output.substr(0, eol);
+    output.remove_prefix(std::min(eol + 1, output.size()));
+
+    if (line.ends_with('\r')) {
+      line.remove_suffix(1);
+    }
+
+    if (line.starts_with(kStorageTag)) {
+      int64_t total, free;
+      if (parse_storage(line.substr(kStorageTag.size()), total, free)) {
+        add(Metric::StorageTotal, 0, total);
+        add(Metric::StorageFree, 0, free);
+      }
+      continue;
+    }
+
+    auto colon = line.rfind(':');
+    int64_t value;
+    if (colon == std::string_view::npos || !to_int(line.substr(colon + 1), value)) {
+      continue;
+    }
+
+    auto path = line.substr(0, colon);
+    uint16_t index;
+    if (path.starts_with(kBatteryDir)) {
+      auto name = path.substr(kBatteryDir.size());
+      if (name == "capacity") {
+        add(Metric::BatteryLevel, 0, value);
+      } else if (name == "temp") {
+        add(Metric::BatteryTemp, 0, value);
+      } else if (name == "voltage_now") {
+        add(Metric::BatteryVoltage, 0, value);
+      }
+    } else if (path.starts_with(kThermalDir) && index_of(path.substr(kThermalDir.size()), "/temp", index)) {
+      add(Metric::ThermalZone, index, value);
+    } else if (path.starts_with(kCpuDir) && index_of(path.substr(kCpuDir.size()), "/cpufreq/scaling_cur_freq", index)) {
+      add(Metric::CpuFreq, index, value);
+    }
+  }
+
+  return out.size() - first;
+}
+
+struct TelemetrySampler::Device {
+  std::string serial;
+  uint32_t id{0};
+  bool removed{false};
+  asio::steady_timer timer;
+
+  // reused by every sample
+  std::vector<char> buffer;
+  std::vector<TelemetryRecord> records;
+
+  Device(const asio::any_io_executor &ex, std::string_view s, uint32_t i) : serial(s), id(i), timer(ex) {}
+};
+
+TelemetrySampler::TelemetrySampler(Sink sink, Settings settings, TransportOption option)
+  : sink_(std::move(sink)),
+    settings_(settings),
+    service_("shell:" + telemetry_command(settings.groups)),
+    server_(option.server),
+    server_port_(option.port),
+    launch_server_(option.launchServerIfNeed) {}
+
+TelemetrySampler::~TelemetrySampler() {
+  stop();
+  devices_.clear();
+}
+
+void TelemetrySampler::start() {
+  if (thread_.joinable()) {
+    return;
+  }
+
+  thread_ = std::thread([this] {
+    ctx_.run();
+  });
+}
+
+void TelemetrySampler::stop() noexcept {
+  ctx_.stop();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+uint32_t TelemetrySampler::addDevice(std::string_view serial) {
+  std::shared_ptr<Device> device;
+  {
+    std::lock_guard lk(mutex_);
+    if (auto it = devices_.find(serial); it != devices_.end()) {
+      return it->second->id;
+    }
+
+    device = std::make_shared<Device>(ctx_.get_executor(), serial, next_id_++);
+    devices_.emplace(device->serial, device);
+    serials_.emplace(device->id, device->serial);
+  }
+
+  co_spawn(ctx_, co_sample(device), asio::detached);
+  return device->id;
+}
+
+bool TelemetrySampler::removeDevice(std::string_view serial) {
+  std::shared_ptr<Device> device;
+  {
+    std::lock_guard lk(mutex_);
+    auto it = devices_.find(serial);
+    if (it == devices_.end()) {
+      return false;
+    }
+    device = std::move(it->second);
+    devices_.erase(it);
+    serials_.erase(device->id);
+  }
+
+  asio::post(ctx_, [device] {
+    device->removed = true;
+    device->timer.cancel();
+  });
+  return true;
+}
+
+std::string TelemetrySampler::serial(uint32_t device) const {
+  std::lock_guard lk(mutex_);
+  auto it = serials_.find(device);
+  return it != serials_.end() ? it->second : std::string();
+}
+
+TelemetrySampler::Stats TelemetrySampler::stats() const {
+  std::lock_guard lk(mutex_);
+  return stats_;
+}
+
+// one raw shell stream, read to its end or until the timeout closes it
+awaitable<bool>
+TelemetrySampler::co_collect(Device &device) {
+  auto ex = co_await asio::this_coro::executor;
+
+  std::optional<AdbSocket> socket;
+  try {
+    TransportOption option {
+      .server = server_,
+      .port = server_port_,
+      .serial = device.serial,
+      .launchServerIfNeed = launch_server_,
+    };
+    socket.emplace(co_await co_open_service(service_, option));
+  } catch (std::exception &) {
+    co_return false;
+  }
+
+  asio::steady_timer deadline(ex, settings_.timeout);
+  bool expired = false;
+  deadline.async_wait([&](asio::error_code ec) {
+    if (!ec) {
+      expired = true;
+      socket->close(ec);
+    }
+  });
+
+  size_t size = 0;
+  asio::error_code ec;
+  for (;;) {
+    if (device.buffer.size() - size < kReadChunk) {
+      device.buffer.resize(size + kReadChunk);
+    }
+
+    auto n = co_await socket->async_read_some(
+          asio::buffer(device.buffer.data() + size, device.buffer.size() - size),
+          asio::redirect_error(use_awaitable, ec));
+    size += n;
+    if (ec) {
+      break;
+    }
+  }
+
+  co_await co_cancel_timer(deadline);
+
+  if (expired || ec != asio::error::eof) {
+    co_return false;
+  }
+
+  auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+  device.records.clear();
+  parse_telemetry(std::string_view(device.buffer.data(), size), device.id, now, device.records);
+  co_return true;
+}
+
+awaitable<void>
+TelemetrySampler::co_sample(std::shared_ptr<Device> device) {
+  using clock = std::chrono::steady_clock;
+  auto interval = settings_.interval;
+
+  // the slot of the device inside the interval
+  auto slot = interval * (std::hash<std::string>{}(device->serial) % 1024) / 1024;
+  auto next = clock::now() + slot;
+
+  while (!device->removed) {
+    device->timer.expires_at(next + jitter(interval));
+
+    asio::error_code ec;
+    co_await device->timer.async_wait(asio::redirect_error(use_awaitable, ec));
+    if (device->removed) {
+      break;
+    }
+
+    bool ok = co_await co_collect(*device);
+    if (ok && sink_ && !device->records.empty()) {
+      sink_(device->records);
+    }
+
+    {
+      std::lock_guard lk(mutex_);
+      stats_.samples++;
+      if (ok) {
+        stats_.records += device->records.size();
+      } else {
+        stats_.failures++;
+      }
+    }
+
+    // a slow sample skips periods rather than sampling in a burst
+    next += interval;
+    if (auto now = clock::now(); next < now) {
+      next += (now - next) / interval * interval + interval;
+    }
+  }
+}
+
+} // namespace adb_client
+
+#ifdef ENABLE_TEST
+#include "telemetry-sampler_tests.cc"
+#endif
@@ -0,0 +1,138 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include "co-adb-client.h"
+#include <asio/io_context.hpp>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
+
+namespace adb_client {
+
+enum class Metric : uint8_t {
+  BatteryLevel,    // percent
+  BatteryTemp,     // 0.1 degree celsius
+  BatteryVoltage,  // microvolt
+  ThermalZone,     // millidegree celsius, channel = zone
+  CpuFreq,         // khz, channel = cpu
+  StorageTotal,    // kib of /data
+  StorageFree,     // kib of /data
+};
+
+// metric groups a sampler collects
+enum MetricGroup : uint32_t {
+  kBattery = 1 << 0,
+  kThermal = 1 << 1,
+  kCpuFreq = 1 << 2,
+  kStorage = 1 << 3,
+  kAllMetrics = kBattery | kThermal | kCpuFreq | kStorage,
+};
+
+// one point of a time series
+struct TelemetryRecord {
+  int64_t timeMs{0};   // unix time
+  int64_t value{0};
+  uint32_t device{0};  // TelemetrySampler::addDevice id
+  uint16_t channel{0};
+  Metric metric{Metric::BatteryLevel};
+};
+
+// the shell command collecting groups in one invocation
+std::string telemetry_command(uint32_t groups);
+
+// parse the output of telemetry_command in place, appends to out and
+// returns the number of records added. unknown lines are skipped.
+size_t parse_telemetry(std::string_view output, uint32_t device, int64_t timeMs, std::vector<TelemetryRecord> &out);
+
+struct TelemetrySettings {
+  std::chrono::milliseconds interval{10000};
+  // a sample still running after this is dropped
+  std::chrono::milliseconds timeout{5000};
+  uint32_t groups{kAllMetrics};
+};
+
+// samples battery, thermal, cpu frequency and storage stats of any number of devices.
+//
+// every device gets a sampling slot inside the interval, derived from its
+// serial so that devices attached together do not sample in lockstep, and
+// each period is jittered a little around it. a sample is a single raw
+// shell invocation collecting every requested group; its output is parsed
+// in the read buffer and handed to the sink as a batch of records.
+// everything runs on one background thread, the sink is called there.
+class TelemetrySampler {
+public:
+  using Settings = TelemetrySettings;
+  using Sink = std::function<void(std::span<const TelemetryRecord>)>;
+
+  struct Stats {
+    uint64_t samples{0};
+    uint64_t failures{0};
+    uint64_t records{0};
+  };
+
+  explicit TelemetrySampler(Sink sink, Settings settings = {}, TransportOption option = {});
+  ~TelemetrySampler();
+
+  TelemetrySampler(const TelemetrySampler &) = delete;
+  TelemetrySampler& operator=(const TelemetrySampler &) = delete;
+
+  void start();
+  void stop() noexcept;
+
+  // returns the id records of the device carry, the same id when already added
+  uint32_t addDevice(std::string_view serial);
+  bool removeDevice(std::string_view serial);
+
+  // empty when the id is unknown
+  std::string serial(uint32_t device) const;
+
+  Stats stats() const;
+
+private:
+  struct Device;
+
+  asio::awaitable<void> co_sample(std::shared_ptr<Device> device);
+  asio::awaitable<bool> co_collect(Device &device);
+
+  Sink sink_;
+  Settings settings_;
+  std::string service_; // shell:<telemetry_command>
+  std::string server_;
+  std::string server_port_;
+  bool launch_server_{true};
+
+  asio::io_context ctx_;
+  asio::executor_work_guard<asio::io_context::executor_type> work_{ctx_.get_executor()};
+
+  mutable std::mutex mutex_;
+  uint32_t next_id_{1};
+  std::map<std::string, std::shared_ptr<Device>, std::less<>> devices_;
+  std::unordered_map<uint32_t, std::string> serials_;
+  Stats stats_;
+
+  std::thread thread_;
+};
+
+} // namespace adb_client
@@ -0,0 +1,43 @@
+namespace adb_client {
+
+TEST(Telemetry, ParsesOneInvocation) {
+  auto command = telemetry_command(kAllMetrics);
+  EXPECT_TRUE(command.starts_with("grep -sH . /sys/class/power_supply/battery/capacity")) << command;
+  EXPECT_NE(command.find(";echo df:"), std::string::npos) << command;
+  EXPECT_EQ(telemetry_command(kStorage), "echo df:$(df -k /data | tail -n 1)");
+
+  std::string_view output =
+    "/sys/class/power_supply/battery/capacity:87\n"
+    "/sys/class/power_supply/battery/temp:312\n"
+    "/sys/class/power_supply/battery/voltage_now:4211000\n"
+    "/sys/class/thermal/thermal_zone0/temp:41200\n"
+    "/sys/class/thermal/thermal_zone17/temp:-5000\r\n"
+    "/sys/class/thermal/thermal_zone3/mode:enabled\n"
+    "/sys/devices/system/cpu/cpu7/cpufreq/scaling_cur_freq:2841600\n"
+    "grep: /sys/devices/system/cpu/cpu9/cpufreq/scaling_cur_freq: Permission denied\n"
+    "df:/dev/block/dm-48 115412996 61205440 54076484 54% /data\n";
+
+  std::vector<TelemetryRecord> records;
+  ASSERT_EQ(parse_telemetry(output, 7, 1000, records), 8u);
+
+  auto expect = [&records](size_t i, Metric metric, uint16_t channel, int64_t value) {
+    EXPECT_EQ(records[i].metric, metric) << i;
+    EXPECT_EQ(records[i].channel, channel) << i;
+    EXPECT_EQ(records[i].value, value) << i;
+    EXPECT_EQ(records[i].device, 7u) << i;
+    EXPECT_EQ(records[i].timeMs, 1000) << i;
+  };
+  expect(0, Metric::BatteryLevel, 0, 87);
+  expect(1, Metric::BatteryTemp, 0, 312);
+  expect(2, Metric::BatteryVoltage, 0, 4211000);
+  expect(3, Metric::ThermalZone, 0, 41200);
+  expect(4, Metric::ThermalZone, 17, -5000);
+  expect(5, Metric::CpuFreq, 7, 2841600);
+  expect(6, Metric::StorageTotal, 0, 115412996);
+  expect(7, Metric::StorageFree, 0, 54076484);
+
+  // df failed, nothing after the tag
+  EXPECT_EQ(parse_telemetry("df:\n", 7, 1000, records), 0u);
+}
+
+} // namespace adb_client
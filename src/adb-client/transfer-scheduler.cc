@@ -0,0 +1,191 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "transfer-scheduler.h"
+#include "co-parallel.h"
+#include <asio.hpp>
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#endif
+
+namespace adb_client {
+
+using asio::awaitable;
+using asio::use_awaitable;
+
+TransferScheduler::TransferScheduler(size_t default_capacity)
+  : default_capacity_(default_capacity ? default_capacity : 1) {}
+
+size_t TransferScheduler::capacityForSpeed(uint32_t mbps) {
+  if (mbps == 0) {
+    return 0;
+  }
+  if (mbps <= 12) {
+    return 1;
+  }
+  if (mbps <= 480) {
+    // a single adb push nearly fills a usb 2.0 link,
+    // the second one only hides per-file round trips
+    return 2;
+  }
+  if (mbps <= 5000) {
+    return 4;
+  }
+  if (mbps <= 10000) {
+    return 8;
+  }
+  return 12;
+}
+
+TransferScheduler::Link &TransferScheduler::link(const std::string &key) {
+  auto [it, inserted] = links_.try_emplace(key);
+  if (inserted) {
+    it->second.capacity = default_capacity_;
+  }
+  return it->second;
+}
+
+bool TransferScheduler::grant(Waiter &waiter) {
+  // a waiter that was cancelled has no pending wait left
+  if (waiter.timer.expires_at(asio::steady_timer::time_point::min()) == 0) {
+    return false;
+  }
+  waiter.granted = true;
+  return true;
+}
+
+void TransferScheduler::setLinkCapacity(const std::string &key, size_t capacity) {
+  auto &l = link(key);
+  l.capacity = capacity ? capacity : default_capacity_;
+
+  // a raised capacity admits queued transfers right away
+  while (l.inflight < l.capacity && !l.waiters.empty()) {
+    auto waiter = std::move(l.waiters.front());
+    l.waiters.pop_front();
+    if (grant(*waiter)) {
+      l.inflight++;
+    }
+  }
+}
+
+size_t TransferScheduler::inflight(const std::string &key) const {
+  auto it = links_.find(key);
+  return it == links_.end() ? 0 : it->second.inflight;
+}
+
+void TransferScheduler::release(const std::string &key) noexcept {
+  auto it = links_.find(key);
+  if (it == links_.end()) {
+    return;
+  }
+
+  auto &l = it->second;
+
+  // hand the slot over to the oldest live waiter
+  while (!l.waiters.empty() && l.inflight <= l.capacity) {
+    auto waiter = std::move(l.waiters.front());
+    l.waiters.pop_front();
+    if (grant(*waiter)) {
+      return;
+    }
+  }
+
+  l.inflight--;
+}
+
+awaitable<TransferScheduler::Slot>
+TransferScheduler::co_acquire(std::string key) {
+  auto &l = link(key);
+
+  if (l.inflight < l.capacity && l.waiters.empty()) {
+    l.inflight++;
+    co_return Slot(this, std::move(key));
+  }
+
+  auto waiter = std::make_shared<Waiter>(Waiter{
+      asio::steady_timer(co_await asio::this_coro::executor, asio::steady_timer::time_point::max())});
+  l.waiters.push_back(waiter);
+
+  asio::error_code ec;
+  co_await waiter->timer.async_wait(asio::redirect_error(use_awaitable, ec));
+
+  // woken by release() or setLinkCapacity(), which handed a slot over
+  if (waiter->granted) {
+    co_return Slot(this, std::move(key));
+  }
+
+  // cancelled while queued, no slot was counted for this waiter
+  std::erase(links_[key].waiters, waiter);
+  throw asio::system_error(ec ? ec : asio::error::operation_aborted);
+}
+
+awaitable<void>
+TransferScheduler::co_run(std::vector<Job> jobs) {
+  std::vector<std::string> order;
+  std::unordered_map<std::string, std::deque<Job>> by_link;
+
+  for (auto &job : jobs) {
+    auto [it, inserted] = by_link.try_emplace(job.link);
+    if (inserted) {
+      order.push_back(job.link);
+    }
+    it->second.push_back(std::move(job));
+  }
+
+  // round robin over links: the first slot of every hub starts at once
+  std::vector<Job> interleaved;
+  interleaved.reserve(jobs.size());
+  while (interleaved.size() < jobs.size()) {
+    for (auto &key : order) {
+      auto &q = by_link[key];
+      if (!q.empty()) {
+        interleaved.push_back(std::move(q.front()));
+        q.pop_front();
+      }
+    }
+  }
+
+  co_await co_for_each_bounded(interleaved.size(), interleaved.size(), [&](size_t i) -> awaitable<void> {
+    auto slot = co_await co_acquire(interleaved[i].link);
+    co_await interleaved[i].run();
+  });
+}
+
+TransferScheduler::Slot& TransferScheduler::Slot::operator=(Slot &&other) noexcept {
+  if (this != &other) {
+    release();
+    owner_ = std::exchange(other.owner_, nullptr);
+    link_ = std::move(other.link_);
+  }
+  return *this;
+}
+
+void TransferScheduler::Slot::release() noexcept {
+  if (owner_) {
+    std::exchange(owner_, nullptr)->release(link_);
+  }
+}
+
+} // namespace adb_client
+
+#ifdef ENABLE_TEST
+#include "transfer-scheduler_tests.cc"
+#endif
@@ -0,0 +1,111 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include <asio/awaitable.hpp>
+#include <asio/steady_timer.hpp>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace adb_client {
+
+// caps concurrent bulk transfers per shared usb upstream link.
+//
+// devices behind the same hub share that hub's upstream link, running more
+// pushes than the link can carry only slows every one of them down.
+// links are opaque keys (e.g. DeviceInterface::parentHub) and get a capacity
+// from their speed, unknown links use the default capacity.
+// sync push and pull take their slot through TransportOption::transferScheduler.
+//
+// the scheduler must only be used from one single threaded executor (or a strand).
+class TransferScheduler {
+public:
+  explicit TransferScheduler(size_t default_capacity = 2);
+
+  // concurrent transfers a link of the given speed is allowed to carry
+  static size_t capacityForSpeed(uint32_t mbps);
+
+  void setLinkCapacity(const std::string &link, size_t capacity);
+  void setLinkSpeed(const std::string &link, uint32_t mbps) {
+    setLinkCapacity(link, capacityForSpeed(mbps));
+  }
+
+  class Slot {
+  public:
+    Slot() = default;
+    Slot(Slot &&other) noexcept : owner_(std::exchange(other.owner_, nullptr)), link_(std::move(other.link_)) {}
+    Slot& operator=(Slot &&other) noexcept;
+    ~Slot() { release(); }
+
+    void release() noexcept;
+
+  private:
+    friend class TransferScheduler;
+    Slot(TransferScheduler *owner, std::string link) : owner_(owner), link_(std::move(link)) {}
+
+    TransferScheduler *owner_{nullptr};
+    std::string link_;
+  };
+
+  // resumes once a slot on link is free, transfers queue in fifo order per link.
+  // a cancelled wait leaves the queue and throws asio::system_error
+  asio::awaitable<Slot> co_acquire(std::string link);
+
+  struct Job {
+    std::string link;
+    std::function<asio::awaitable<void>()> run;
+  };
+
+  // run all jobs, each holding a slot of its link.
+  // jobs are interleaved across links so every link is kept busy
+  // instead of draining one hub after the other.
+  asio::awaitable<void> co_run(std::vector<Job> jobs);
+
+  size_t inflight(const std::string &link) const;
+
+private:
+  struct Waiter {
+    asio::steady_timer timer;
+    // set when a slot was handed over, the timer wakes with
+    // operation_aborted either way
+    bool granted{false};
+  };
+
+  struct Link {
+    size_t capacity{0};
+    size_t inflight{0};
+    std::deque<std::shared_ptr<Waiter>> waiters;
+  };
+
+  Link &link(const std::string &key);
+  static bool grant(Waiter &waiter);
+  void release(const std::string &key) noexcept;
+
+  size_t default_capacity_;
+  std::unordered_map<std::string, Link> links_;
+};
+
+} // namespace adb_client
@@ -0,0 +1,118 @@
+#include <map>
+
+namespace adb_client {
+
+TEST(TransferScheduler, LimitsPerHub) {
+  asio::io_context ctx;
+  TransferScheduler scheduler;
+  scheduler.setLinkCapacity("USB1-1", 1);
+  scheduler.setLinkSpeed("USB2", 5000);
+
+  std::map<std::string, size_t> running, peak, done;
+  std::vector<TransferScheduler::Job> jobs;
+  for (auto hub : {"USB1-1", "USB2", "USB3-4"}) {
+    for (int i = 0; i < 6; i++) {
+      jobs.push_back({hub, [&, hub = std::string(hub)]() -> asio::awaitable<void> {
+        peak[hub] = std::max(peak[hub], ++running[hub]);
+        // a handed over slot counts before its waiter resumes
+        EXPECT_LE(running[hub], scheduler.inflight(hub));
+        asio::steady_timer t(co_await asio::this_coro::executor, std::chrono::milliseconds(2));
+        co_await t.async_wait(asio::use_awaitable);
+        running[hub]--;
+        done[hub]++;
+      }});
+    }
+  }
+
+  co_spawn(ctx, scheduler.co_run(std::move(jobs)), asio::detached);
+  ctx.run();
+
+  EXPECT_EQ(peak["USB1-1"], 1u);
+  EXPECT_EQ(peak["USB2"], 4u);
+  // unknown hubs get the default capacity
+  EXPECT_EQ(peak["USB3-4"], 2u);
+  for (auto hub : {"USB1-1", "USB2", "USB3-4"}) {
+    EXPECT_EQ(done[hub], 6u) << hub;
+    EXPECT_EQ(scheduler.inflight(hub), 0u) << hub;
+  }
+}
+
+TEST(TransferScheduler, HandsSlotsOverInOrder) {
+  asio::io_context ctx;
+  TransferScheduler scheduler(1);
+  std::vector<int> order;
+
+  auto holder = [&](int id) -> asio::awaitable<void> {
+    auto slot = co_await scheduler.co_acquire("USB1");
+    order.push_back(id);
+    asio::steady_timer t(co_await asio::this_coro::executor, std::chrono::milliseconds(1));
+    co_await t.async_wait(asio::use_awaitable);
+  };
+  for (int i = 0; i < 4; i++) {
+    co_spawn(ctx, holder(i), asio::detached);
+  }
+
+  // the first one runs, the others queue on the link
+  ctx.run_one();
+  ctx.poll();
+  EXPECT_EQ(order, std::vector<int>{0});
+  EXPECT_EQ(scheduler.inflight("USB1"), 1u);
+
+  // a raised capacity admits queued transfers at once
+  scheduler.setLinkCapacity("USB1", 3);
+  EXPECT_EQ(scheduler.inflight("USB1"), 3u);
+
+  ctx.run();
+  EXPECT_EQ(order, (std::vector<int>{0, 1, 2, 3}));
+  EXPECT_EQ(scheduler.inflight("USB1"), 0u);
+}
+
+TEST(TransferScheduler, CancelledWaitTakesNoSlot) {
+  asio::io_context ctx;
+  TransferScheduler scheduler(1);
+  asio::cancellation_signal cancel;
+  bool aborted = false;
+  int ran = 0;
+
+  auto holder = [&]() -> asio::awaitable<void> {
+    auto slot = co_await scheduler.co_acquire("USB1");
+    ran++;
+    asio::steady_timer t(co_await asio::this_coro::executor, std::chrono::milliseconds(5));
+    co_await t.async_wait(asio::use_awaitable);
+  };
+  auto cancelled = [&]() -> asio::awaitable<void> {
+    try {
+      auto slot = co_await scheduler.co_acquire("USB1");
+      ADD_FAILURE() << "cancelled wait got a slot";
+    } catch (asio::system_error &e) {
+      aborted = e.code() == asio::error::operation_aborted;
+    }
+  };
+
+  co_spawn(ctx, holder(), asio::detached);
+  co_spawn(ctx, cancelled(), asio::bind_cancellation_slot(cancel.slot(), asio::detached));
+  co_spawn(ctx, holder(), asio::detached);
+  ctx.poll();
+  EXPECT_EQ(ran, 1);
+  EXPECT_EQ(scheduler.inflight("USB1"), 1u);
+
+  cancel.emit(asio::cancellation_type::terminal);
+  ctx.poll();
+  EXPECT_TRUE(aborted);
+  EXPECT_EQ(scheduler.inflight("USB1"), 1u);
+
+  // the slot goes to the next live waiter, capacity still holds
+  ctx.run();
+  EXPECT_EQ(ran, 2);
+  EXPECT_EQ(scheduler.inflight("USB1"), 0u);
+
+  // and the link is usable at full capacity afterwards
+  co_spawn(ctx, holder(), asio::detached);
+  ctx.restart();
+  ctx.poll();
+  EXPECT_EQ(scheduler.inflight("USB1"), 1u);
+  ctx.run();
+  EXPECT_EQ(scheduler.inflight("USB1"), 0u);
+}
+
+} // namespace adb_client
@@ -0,0 +1,142 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// throughput of the diag hdlc decoder on a recorded capture (raw bytes
+// read from a diag port) or, without one, on synthetic log packets.
+// one json line per kernel:
+//
+//   {"bench":"hdlc_decode","bytes":..,"frames":..,"gb_per_s":..}
+//
+// usage: bench-diag [--capture file] [--mb 256]
+
+#include "diag/hdlc.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+// log packets of 40..1500 bytes, mostly small counters and zero padding
+// like real diag logs, with random bytes (and so escapes) mixed in
+std::vector<uint8_t> synthesize(size_t size) {
+  std::mt19937 rng(7);
+  std::vector<uint8_t> out;
+  std::vector<uint8_t> payload;
+  out.reserve(size + 2048);
+
+  while (out.size() < size) {
+    payload.assign(std::uniform_int_distribution<size_t>(40, 1500)(rng), 0);
+    payload[0] = 0x10; // log packet
+    for (size_t i = 4; i < payload.size(); i++) {
+      auto r = rng();
+      payload[i] = (r & 3) == 0 ? uint8_t(r >> 8) : uint8_t(i);
+    }
+    diag::hdlc_encode(payload, out);
+  }
+  return out;
+}
+
+template <class Fn>
+double best_seconds(Fn &&fn) {
+  double best = 1e9;
+  for (int i = 0; i < 5; i++) {
+    auto start = steady_clock::now();
+    fn();
+    best = std::min(best, duration<double>(steady_clock::now() - start).count());
+  }
+  return best;
+}
+
+void report(const char *name, size_t bytes, uint64_t frames, double secs) {
+  std::cout << std::format(R"({{"bench":"{}","bytes":{},"frames":{},"gb_per_s":{:.2f}}})",
+                           name, bytes, frames, bytes / secs / 1e9) << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string capture;
+  size_t mb = 256;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--capture")) {
+      capture = argv[i + 1];
+    } else if (!strcmp(argv[i], "--mb")) {
+      mb = std::stoul(argv[i + 1]);
+    }
+  }
+
+  std::vector<uint8_t> data;
+  if (capture.size()) {
+    std::ifstream in(capture, std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(in), {});
+    if (data.empty()) {
+      std::cerr << "cannot read " << capture << std::endl;
+      return 1;
+    }
+  } else {
+    data = synthesize(mb << 20);
+  }
+
+  {
+    size_t hits = 0;
+    auto secs = best_seconds([&] {
+      const uint8_t *p = data.data(), *end = p + data.size();
+      while ((p = diag::hdlc_find_special(p, end)) != end) {
+        hits++;
+        p++;
+      }
+    });
+    report("hdlc_find_special", data.size(), hits / 5, secs);
+  }
+
+  {
+    volatile uint16_t sink = 0;
+    auto secs = best_seconds([&] { sink = diag::crc16(data.data(), data.size()); });
+    report("crc16", data.size(), 0, secs);
+  }
+
+  // the real stream, fed in 64KB reads like the console capture does
+  for (size_t chunk : {size_t(64 << 10), data.size()}) {
+    uint64_t frames = 0;
+    uint64_t payload_bytes = 0;
+    auto secs = best_seconds([&] {
+      diag::HdlcDecoder decoder([&](std::span<const uint8_t> payload) {
+        frames++;
+        payload_bytes += payload.size();
+      });
+      for (size_t off = 0; off < data.size(); off += chunk) {
+        decoder.feed({data.data() + off, std::min(chunk, data.size() - off)});
+      }
+    });
+    report(chunk == data.size() ? "hdlc_decode_whole" : "hdlc_decode_64k", data.size(), frames / 5, secs);
+  }
+
+  return 0;
+}
@@ -0,0 +1,479 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// microbenchmarks of the enumeration and adb client hot paths.
+// every benchmark runs a fixed input in batches, the batch size is
+// calibrated to ~10ms, and one json line per benchmark goes to stdout:
+//
+//   {"bench":"netlink_message_parse","batches":15,"iterations":..,"ns_per_op":..,"min_ns":..,"max_ns":..}
+//
+// ns_per_op is the median over batches.
+//
+// usage: bench-micro [filter]   (runs the benchmarks whose name contains filter)
+
+#include "adb-client/co-adb-client.h"
+#include "device-enumerator/device-id.h"
+#include "device-enumerator/adb-serial-set.h"
+#include "device-enumerator/shorthash.h"
+#include "device-enumerator/task-thread.h"
+#include "device-enumerator/usb-watch-base.h"
+#include "device-enumerator/watch-pipeline.h"
+#include "process/process-output.h"
+#ifdef DEVICE_WATCH_BENCH_JSON
+#include "device-json.h"
+#endif
+#ifdef __linux__
+#include "device-enumerator/sysfs-attr.h"
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace device_enumerator;
+using namespace std::chrono;
+
+namespace {
+
+constexpr int kBatches = 15;
+constexpr auto kBatchTarget = milliseconds(10);
+
+template <class T>
+inline void do_not_optimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "g"(&value) : "memory");
+#else
+  static const void *volatile sink;
+  sink = &value;
+#endif
+}
+
+std::string_view g_filter;
+
+template <class Fn>
+void bench(std::string_view name, Fn &&fn) {
+  if (!g_filter.empty() && name.find(g_filter) == std::string_view::npos) {
+    return;
+  }
+
+  auto run_batch = [&fn](uint64_t n) {
+    auto start = steady_clock::now();
+    for (uint64_t i = 0; i < n; i++) {
+      fn();
+    }
+    return duration<double, std::nano>(steady_clock::now() - start).count();
+  };
+
+  // calibrate, doubling until a batch takes long enough
+  uint64_t iterations = 1;
+  for (;;) {
+    auto ns = run_batch(iterations);
+    if (ns >= duration<double, std::nano>(kBatchTarget).count() || iterations >= (1ull << 30)) {
+      break;
+    }
+    iterations *= 2;
+  }
+
+  std::vector<double> per_op;
+  for (int b = 0; b < kBatches; b++) {
+    per_op.push_back(run_batch(iterations) / iterations);
+  }
+  std::ranges::sort(per_op);
+
+  std::cout << std::format(R"({{"bench":"{}","batches":{},"iterations":{},"ns_per_op":{:.2f},"min_ns":{:.2f},"max_ns":{:.2f}}})",
+                           name, kBatches, iterations, per_op[kBatches / 2], per_op.front(), per_op.back()) << std::endl;
+}
+
+#ifdef __linux__
+
+// a uevent as the kernel sends it for a usb interface
+std::string make_uevent() {
+  const char *fields[] = {
+    "add@/devices/pci0000:00/0000:00:14.0/usb1/1-9/1-9.1/1-9.1:1.0",
+    "ACTION=add",
+    "DEVPATH=/devices/pci0000:00/0000:00:14.0/usb1/1-9/1-9.1/1-9.1:1.0",
+    "SUBSYSTEM=usb",
+    "DEVTYPE=usb_interface",
+    "PRODUCT=18d1/4ee7/440",
+    "TYPE=0/0/0",
+    "INTERFACE=255/66/1",
+    "MODALIAS=usb:v18D1p4EE7d0440dc00dsc00dp00icFFisc42ip01in00",
+    "SEQNUM=5123",
+  };
+
+  std::string msg;
+  for (auto f : fields) {
+    msg += f;
+    msg += '\0';
+  }
+  return msg;
+}
+
+// <tmp>/bench-sysfs/1-N with the attributes the enumerator reads
+std::filesystem::path make_sysfs_tree(int devices) {
+  auto root = std::filesystem::temp_directory_path() / "bench-sysfs";
+  std::filesystem::remove_all(root);
+
+  for (int i = 1; i <= devices; i++) {
+    auto dir = root / std::format("1-{}", i);
+    std::filesystem::create_directories(dir);
+    std::ofstream(dir / "idVendor") << "18d1\n";
+    std::ofstream(dir / "idProduct") << std::format("{:04x}\n", 0x4ee0 + i);
+    std::ofstream(dir / "speed") << "480\n";
+    std::ofstream(dir / "busnum") << "1\n";
+    std::ofstream(dir / "devnum") << i << "\n";
+    std::ofstream(dir / "serial") << std::format("SERIAL{:08}\n", i);
+    std::ofstream(dir / "product") << "Pixel 8\n";
+  }
+  return root;
+}
+
+#endif
+
+DeviceInterface make_device() {
+  DeviceInterface dev;
+  dev.identity = DeviceId(0x0123456789abcdef);
+  dev.devpath = "/dev/bus/usb/001/009";
+  dev.hub = "USB1-9";
+  dev.serial = "R5CT1234ABC";
+  dev.manufacturer = "Google";
+  dev.product = "Pixel 8";
+  dev.model = "Pixel_8";
+  dev.device = "shiba";
+  dev.driver = "usbfs";
+  dev.vid = 0x18d1;
+  dev.pid = 0x4ee7;
+  dev.speed = UsbSpeed::High;
+  dev.type = static_cast<DeviceType>(DeviceType::Usb | DeviceType::Adb);
+  dev.usbClass = 0xff;
+  dev.usbSubClass = 0x42;
+  dev.usbProto = 0x01;
+  return dev;
+}
+
+// `adb devices -l` output of n devices
+std::string make_device_list(int n) {
+  std::string list;
+  for (int i = 0; i < n; i++) {
+    list += std::format("SERIAL{:08}           device usb:1-{} product:shiba model:Pixel_8 device:shiba transport_id:{}\n",
+                        i, i + 1, i + 1);
+  }
+  return list;
+}
+
+class CountingLineReader : public process_lib::ProcessLineOutputReader {
+public:
+  CountingLineReader() : ProcessLineOutputReader(4096) {}
+
+  // feed data the way Process does, in buffer sized pieces
+  void feed(std::string_view data) {
+    while (!data.empty()) {
+      size_t size = 0;
+      auto buf = static_cast<char *>(allocateReadBuffer(size));
+      auto n = std::min(size, data.size());
+      memcpy(buf, data.data(), n);
+      commitReadBuffer(n);
+      data.remove_prefix(n);
+    }
+  }
+
+  size_t lines{0};
+
+protected:
+  void onLineReceived(const char *, const size_t, bool) noexcept override {
+    lines++;
+  }
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    g_filter = argv[1];
+  }
+
+#ifdef __linux__
+  {
+    auto msg = make_uevent();
+    bench("netlink_message_parse", [&] {
+      do_not_optimize(netlink_message_parse(msg.data(), msg.size(), "ACTION"));
+      do_not_optimize(netlink_message_parse(msg.data(), msg.size(), "PRODUCT"));
+      do_not_optimize(netlink_message_parse(msg.data(), msg.size(), "INTERFACE"));
+      do_not_optimize(netlink_message_parse(msg.data(), msg.size(), "DEVPATH"));
+    });
+  }
+
+  {
+    constexpr int kDevices = 32;
+    auto root = make_sysfs_tree(kDevices);
+    std::vector<std::string> dirs;
+    for (int i = 1; i <= kDevices; i++) {
+      dirs.push_back((root / std::format("1-{}", i)).string());
+    }
+
+    size_t next = 0;
+    bench("sysfs_read_attr_int", [&] {
+      int vid = 0;
+      sysfs_read_attr(dirs[next++ % kDevices].c_str(), "idVendor", vid, true);
+      do_not_optimize(vid);
+    });
+    bench("sysfs_read_attr_string", [&] {
+      std::string serial;
+      sysfs_read_attr(dirs[next++ % kDevices].c_str(), "serial", serial, false);
+      do_not_optimize(serial);
+    });
+
+    std::filesystem::remove_all(root);
+  }
+#endif
+
+  {
+    // a linux interface key and a windows instance id
+    std::string id = "USB1-9-1:1.0";
+    std::string win_id = "USB\\VID_18D1&PID_4EE7&MI_01\\6&2A3B4C5D&0&0001";
+    bench("shorthash_hash_to_string", [&] {
+      do_not_optimize(shorthash::hash_to_string(id.begin(), id.end()));
+    });
+    bench("device_id_shorthash", [&] {
+      do_not_optimize(make_device_id(id, IdentityScheme::ShortHash));
+    });
+    bench("device_id_fold", [&] {
+      do_not_optimize(make_device_id(id));
+    });
+    bench("device_id_shorthash_win", [&] {
+      do_not_optimize(make_device_id(win_id, IdentityScheme::ShortHash));
+    });
+    bench("device_id_fold_win", [&] {
+      do_not_optimize(make_device_id(win_id));
+    });
+    char text[16];
+    bench("device_id_to_chars", [&] {
+      do_not_optimize(make_device_id(id).to_chars(text));
+    });
+  }
+
+  {
+    auto dev = make_device();
+    UsbEnumerator::WatchSettings settings;
+    settings.typeFilters = {
+      DeviceTypeConverter::stringToType("usb,adb"),
+      DeviceTypeConverter::stringToType("net"),
+    };
+    settings.includeVids = {0x05c6, 0x2717, 0x18d1};
+    settings.excludePids = {0x9008};
+    settings.drivers = {"usbfs", "qcserial"};
+    bench("should_include_device", [&] {
+      do_not_optimize(shouldIncludeDevice(dev, settings));
+    });
+  }
+
+  {
+    // classify, filter and hand an interface to the callback:
+    // one type erased hop per stage as the watcher did, and the inlined pipeline
+    struct Callback {
+      virtual ~Callback() = default;
+      virtual void onDeviceInterfaceChanged(const DeviceInterface &) = 0;
+    };
+    struct Counter final : Callback {
+      size_t events{0};
+      void onDeviceInterfaceChanged(const DeviceInterface &) override { events++; }
+    };
+
+    auto dev = make_device();
+    UsbEnumerator::WatchSettings settings;
+    settings.typeFilters = {DeviceTypeConverter::stringToType("usb,adb")};
+    settings.includeVids = {0x05c6, 0x2717, 0x18d1};
+
+    Counter counter;
+    Callback *callback = &counter;
+    do_not_optimize(callback);
+
+    std::vector<std::function<void(DeviceInterface &)>> stages = {ClassifyUsbInterface{}, ClassifyQdl{}};
+    std::function<bool(const DeviceInterface &)> filter = SettingsFilter{settings};
+    std::function<void(DeviceInterface &)> sink = [callback](DeviceInterface &d) {
+      callback->onDeviceInterfaceChanged(d);
+    };
+    bench("watch_pipeline_erased", [&] {
+      dev.type = DeviceType::Usb;
+      for (auto &stage : stages) {
+        stage(dev);
+      }
+      if (filter(dev)) {
+        sink(dev);
+      }
+    });
+
+    auto pipeline = WatchPipeline(
+      SettingsFilter{settings},
+      [&counter](DeviceInterface &d) { counter.onDeviceInterfaceChanged(d); },
+      ClassifyUsbInterface{},
+      ClassifyQdl{});
+    bench("watch_pipeline_inlined", [&] {
+      dev.type = DeviceType::Usb;
+      do_not_optimize(pipeline(dev));
+    });
+    do_not_optimize(counter.events);
+  }
+
+  bench("device_type_string_to_type", [] {
+    do_not_optimize(DeviceTypeConverter::stringToType("usb,adb"));
+  });
+
+  {
+    auto type = static_cast<DeviceType>(DeviceType::Usb | DeviceType::Adb | DeviceType::Serial);
+    bench("device_type_stringfiy_type", [&] {
+      do_not_optimize(DeviceTypeConverter::stringfiyType(type));
+    });
+  }
+
+#ifdef DEVICE_WATCH_BENCH_JSON
+  {
+    auto dev = make_device();
+    bench("device_node_to_json", [&] {
+      do_not_optimize(deviceNodeToJsonObject(dev).dump());
+    });
+  }
+#endif
+
+  for (int n : {1, 16, 128}) {
+    auto list = make_device_list(n);
+    bench(std::format("parse_device_list_{}", n), [&] {
+      do_not_optimize(adb_client::parse_device_list(list, true));
+    });
+  }
+
+  {
+    // one adb poll over 500 network devices on 4 servers, one of them
+    // dropping or coming back each round: the list scans the enumerator did
+    // (a regex per remote check) and the hashed reconciliation
+    constexpr int kServers = 4;
+    constexpr int kPerServer = 125;
+    const std::regex re_remote(R"((\d{1,3}\.\d{1,3}\.\d{1,3}\.\d{1,3}):(\d{1,5}))");
+    auto is_remote = [&re_remote](const std::string &serial) {
+      return std::regex_match(serial, re_remote);
+    };
+    auto online = [](const adb_client::DeviceInfo &d) { return d.state == "device"; };
+
+    std::vector<std::vector<adb_client::DeviceInfo>> lists(kServers);
+    for (int s = 0; s < kServers; s++) {
+      for (int i = 0; i < kPerServer; i++) {
+        lists[s].push_back({
+          .serial = std::format("10.{}.{}.{}:5555", s, i / 250, i % 250),
+          .state = "device",
+          .transportId = s * kPerServer + i + 1,
+        });
+      }
+    }
+
+    size_t events = 0;
+    uint64_t flip = 0;
+    auto next_round = [&lists, &flip] {
+      // even rounds take a device offline, odd rounds bring it back
+      auto n = flip++ / 2;
+      auto &dev = lists[n % kServers][(n / kServers) % kPerServer];
+      dev.state = dev.state == "device" ? "offline" : "device";
+    };
+
+    std::vector<std::list<std::string>> known_lists(kServers);
+    bench("adb_reconcile_list_500", [&] {
+      next_round();
+      for (int s = 0; s < kServers; s++) {
+        auto &devs = lists[s];
+        auto &known = known_lists[s];
+        std::erase_if(known, [&](const auto &serial) {
+          bool not_found = std::ranges::none_of(devs, [&serial, &online](const auto &d) {
+            return d.serial == serial && online(d);
+          });
+          if (not_found && is_remote(serial)) {
+            events++;
+          }
+          return not_found;
+        });
+        for (auto &dev : devs) {
+          if (!online(dev) || std::ranges::any_of(known, [&dev](auto &serial) { return serial == dev.serial; })) {
+            continue;
+          }
+          if (is_remote(dev.serial)) {
+            known.push_back(dev.serial);
+            events++;
+          }
+        }
+      }
+    });
+
+    std::vector<AdbSerialSet> known_sets(kServers);
+    bench("adb_reconcile_set_500", [&] {
+      next_round();
+      for (int s = 0; s < kServers; s++) {
+        auto &known = known_sets[s];
+        known.reconcile(lists[s], online,
+          [&](const adb_client::DeviceInfo &dev) {
+            if (is_remote(dev.serial)) {
+              known.insert(dev.serial, dev.transportId, true);
+              events++;
+            }
+          },
+          [&](const adb_client::DeviceInfo &, auto &) { events++; },
+          [&](const std::string &, auto &e) { events += e.remote; });
+      }
+    });
+    do_not_optimize(events);
+  }
+
+  {
+    std::string output;
+    for (int i = 0; i < 1000; i++) {
+      output += std::format("[{:6}] line of process output number {}\r\n", i, i);
+    }
+    CountingLineReader reader;
+    bench("process_line_output_reader_1000_lines", [&] {
+      reader.feed(output);
+    });
+    do_not_optimize(reader.lines);
+  }
+
+  {
+    // one request through the queue and the worker thread
+    std::atomic<uint64_t> done{0};
+    task_thread<int> task;
+    task.start([&done](int &&) {
+      done.fetch_add(1, std::memory_order_release);
+    });
+
+    uint64_t pushed = 0;
+    bench("task_thread_push_pop", [&] {
+      task.push_request(1);
+      pushed++;
+      while (done.load(std::memory_order_acquire) != pushed) {
+      }
+    });
+    task.stop();
+  }
+
+  return 0;
+}
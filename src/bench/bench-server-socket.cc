@@ -0,0 +1,121 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// small query latency of the adb client over tcp loopback vs unix domain sockets.
+// each query is a full round trip as the library issues it:
+// connect, send host:version, read status and reply, close.
+//
+// usage: bench-server-socket [iterations]
+
+#include "fake-adb-server.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace adb_client;
+using namespace std::chrono;
+
+namespace {
+
+struct Result {
+  double mean;
+  double p50;
+  double p99;
+};
+
+Result run(const std::string &server, int iterations) {
+  std::vector<double> samples;
+  samples.reserve(iterations);
+
+  asio::io_context ctx;
+  co_spawn(ctx, [&]() -> asio::awaitable<void> {
+    TransportOption option {
+      .server = server,
+      .launchServerIfNeed = false,
+    };
+
+    // warm up
+    for (int i = 0; i < 100; i++) {
+      co_await co_query("host:version", option);
+    }
+
+    for (int i = 0; i < iterations; i++) {
+      auto start = steady_clock::now();
+      auto version = co_await co_query("host:version", option);
+      samples.push_back(duration<double, std::micro>(steady_clock::now() - start).count());
+      if (version.empty()) {
+        throw adb_error("no reply from fake server");
+      }
+    }
+  }, [](std::exception_ptr e) {
+    if (e) std::rethrow_exception(e);
+  });
+  ctx.run();
+
+  std::ranges::sort(samples);
+  double sum = 0;
+  for (auto v : samples) sum += v;
+
+  return {
+    .mean = sum / samples.size(),
+    .p50 = samples[samples.size() / 2],
+    .p99 = samples[samples.size() * 99 / 100],
+  };
+}
+
+void report(std::string_view transport, int iterations, const Result &r) {
+  std::cout << std::format(R"({{"bench":"small_query","transport":"{}","iterations":{},"mean_us":{:.2f},"p50_us":{:.2f},"p99_us":{:.2f}}})",
+                           transport, iterations, r.mean, r.p50, r.p99) << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20000;
+
+  asio::io_context server_ctx;
+  auto work = asio::make_work_guard(server_ctx);
+  adb_bench::FakeAdbServer server(server_ctx.get_executor());
+  std::thread server_thread([&] { server_ctx.run(); });
+
+  auto tcp_spec = server.listenTcp();
+  report("tcp", iterations, run(tcp_spec, iterations));
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+  auto path = (std::filesystem::temp_directory_path() / "bench-adb-server.sock").string();
+  auto unix_spec = server.listenUnix(path);
+  report("unix", iterations, run(unix_spec, iterations));
+#endif
+
+  server.close();
+  work.reset();
+  server_ctx.stop();
+  server_thread.join();
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+#endif
+  return 0;
+}
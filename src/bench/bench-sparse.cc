@@ -0,0 +1,223 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// throughput of the sparse image library on an image file or, without one,
+// a synthetic image that is one third zero blocks. one json line per kernel:
+//
+//   {"bench":"sparse_stream_fastboot","bytes":..,"pieces":..,"gb_per_s":..}
+//
+// sparse_stream_fastboot flashes the image over loopback fastboot tcp into a
+// device that drops the data, sparse_copy_pieces is the same split written
+// out to memory the way tools that build per device temp files do.
+//
+// usage: bench-sparse [--image file] [--mb 512] [--max-download-mb 64]
+
+#include "fastboot/fastboot-client.h"
+#include "sparse/sparse-image.h"
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/io_context.hpp>
+#include <asio/read.hpp>
+#include <asio/redirect_error.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/write.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+using asio::ip::tcp;
+using asio::use_awaitable;
+
+namespace {
+
+std::vector<uint8_t> synthesize(size_t size) {
+  std::vector<uint8_t> out(size);
+  std::mt19937 rng(7);
+  for (size_t block = 0; block < size / 4096; block++) {
+    auto *p = out.data() + block * 4096;
+    if (block % 3 == 1) {
+      continue;
+    }
+    for (size_t i = 0; i < 4096; i += 4) {
+      auto r = uint32_t(rng());
+      std::memcpy(p + i, &r, 4);
+    }
+  }
+  return out;
+}
+
+template <class Fn>
+double best_seconds(Fn &&fn) {
+  double best = 1e9;
+  for (int i = 0; i < 5; i++) {
+    auto start = steady_clock::now();
+    fn();
+    best = std::min(best, duration<double>(steady_clock::now() - start).count());
+  }
+  return best;
+}
+
+void report(const char *name, size_t bytes, size_t pieces, double secs) {
+  std::cout << std::format(R"({{"bench":"{}","bytes":{},"pieces":{},"gb_per_s":{:.2f}}})",
+                           name, bytes, pieces, bytes / secs / 1e9) << std::endl;
+}
+
+asio::awaitable<void> co_reply(tcp::socket &s, std::string_view text) {
+  uint8_t header[8]{};
+  for (int i = 7, n = int(text.size()); i >= 0; i--, n >>= 8) header[i] = uint8_t(n);
+  std::array<asio::const_buffer, 2> buffers = {asio::buffer(header), asio::buffer(text)};
+  co_await asio::async_write(s, buffers, use_awaitable);
+}
+
+// fastboot tcp device that takes every download and drops it
+asio::awaitable<void> co_sink_device(tcp::acceptor &acceptor, size_t maxDownload) {
+  auto s = co_await acceptor.async_accept(use_awaitable);
+  char hello[4];
+  co_await asio::async_read(s, asio::buffer(hello), use_awaitable);
+  co_await asio::async_write(s, asio::buffer("FB01", 4), use_awaitable);
+
+  std::vector<uint8_t> buffer(1 << 20);
+  for (;;) {
+    uint8_t header[8];
+    asio::error_code ec;
+    co_await asio::async_read(s, asio::buffer(header), asio::redirect_error(use_awaitable, ec));
+    if (ec) {
+      co_return;
+    }
+
+    uint64_t size = 0;
+    for (auto b : header) size = (size << 8) | b;
+    std::string cmd(size, '\0');
+    co_await asio::async_read(s, asio::buffer(cmd), use_awaitable);
+
+    if (cmd == "getvar:max-download-size") {
+      auto reply = std::format("OKAY0x{:x}", maxDownload);
+      co_await co_reply(s, reply);
+    } else if (cmd.starts_with("download:")) {
+      auto left = std::stoull(cmd.substr(9), nullptr, 16);
+      auto reply = std::format("DATA{:08x}", left);
+      co_await co_reply(s, reply);
+      while (left) {
+        co_await asio::async_read(s, asio::buffer(header), use_awaitable);
+        uint64_t n = 0;
+        for (auto b : header) n = (n << 8) | b;
+        left -= std::min<uint64_t>(left, n);
+        while (n) {
+          auto part = std::min<uint64_t>(n, buffer.size());
+          co_await asio::async_read(s, asio::buffer(buffer.data(), part), use_awaitable);
+          n -= part;
+        }
+      }
+      co_await co_reply(s, "OKAY");
+    } else {
+      co_await co_reply(s, "OKAY");
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string path;
+  size_t mb = 512;
+  size_t maxDownload = 64 << 20;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--image")) {
+      path = argv[i + 1];
+    } else if (!strcmp(argv[i], "--mb")) {
+      mb = std::stoul(argv[i + 1]);
+    } else if (!strcmp(argv[i], "--max-download-mb")) {
+      maxDownload = std::stoul(argv[i + 1]) << 20;
+    }
+  }
+
+  std::vector<uint8_t> data;
+  if (path.size()) {
+    std::ifstream in(path, std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(in), {});
+    if (data.empty()) {
+      std::cerr << "cannot read " << path << std::endl;
+      return 1;
+    }
+  } else {
+    data = synthesize(mb << 20);
+  }
+
+  if (sparse_image::SparseImage::is_sparse(data)) {
+    auto secs = best_seconds([&] { sparse_image::SparseImage::parse(data); });
+    report("sparse_parse", data.size(), 0, secs);
+  } else {
+    auto secs = best_seconds([&] { sparse_image::SparseImage::from_raw(data); });
+    report("sparse_from_raw", data.size(), 0, secs);
+  }
+
+  auto image = sparse_image::SparseImage::open(data);
+
+  {
+    size_t pieces = 0;
+    auto secs = best_seconds([&] { pieces = image.split(maxDownload).size(); });
+    report("sparse_split", data.size(), pieces, secs);
+  }
+
+  // the baseline: every piece materialized before it is sent
+  {
+    auto pieces = image.split(maxDownload);
+    std::vector<uint8_t> out;
+    auto secs = best_seconds([&] {
+      for (auto &piece : pieces) {
+        out.clear();
+        for (auto b : piece.buffers()) out.insert(out.end(), b.begin(), b.end());
+      }
+    });
+    report("sparse_copy_pieces", data.size(), pieces.size(), secs);
+  }
+
+  {
+    auto pieces = image.source().size() <= maxDownload ? 1 : image.split(maxDownload).size();
+    auto secs = best_seconds([&] {
+      asio::io_context io;
+      tcp::acceptor acceptor(io, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+      co_spawn(io, co_sink_device(acceptor, maxDownload), asio::detached);
+      co_spawn(io, [&]() -> asio::awaitable<void> {
+        auto port = acceptor.local_endpoint().port();
+        auto transport = co_await fastboot::TcpTransport::co_connect("127.0.0.1", port);
+        fastboot::FastbootClient client(*transport);
+        co_await client.co_flash("userdata", image);
+        transport->close();
+      }, [](std::exception_ptr e) {
+        if (e) std::rethrow_exception(e);
+      });
+      io.run();
+    });
+    report("sparse_stream_fastboot", data.size(), pieces, secs);
+  }
+
+  return 0;
+}
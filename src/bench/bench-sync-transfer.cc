@@ -0,0 +1,141 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// sync push / pull throughput and client cpu cost against the fake server.
+// the asio backend is a build time choice, build once with and once without
+// DEVICE_WATCH_USE_IO_URING and compare the "backend" rows.
+//
+// usage: bench-sync-transfer [megabytes] [rounds]
+
+#include "fake-adb-server.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+using namespace adb_client;
+using namespace std::chrono;
+
+namespace {
+
+#if defined(ASIO_HAS_IO_URING) && defined(ASIO_DISABLE_EPOLL)
+constexpr std::string_view kBackend = "io_uring";
+#elif defined(ASIO_HAS_IO_URING)
+constexpr std::string_view kBackend = "epoll+io_uring_files";
+#else
+constexpr std::string_view kBackend = "epoll";
+#endif
+
+// cpu seconds of the calling thread, the fake server runs on its own thread
+double thread_cpu_seconds() {
+#ifdef __linux__
+  rusage ru{};
+  getrusage(RUSAGE_THREAD, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+#else
+  return double(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+template <class Fn>
+void measure(std::string_view op, size_t bytes, int rounds, Fn fn) {
+  double wall = 0;
+  double cpu = 0;
+
+  for (int i = 0; i < rounds; i++) {
+    auto cpu_start = thread_cpu_seconds();
+    auto start = steady_clock::now();
+
+    asio::io_context ctx;
+    co_spawn(ctx, fn(), [](std::exception_ptr e) {
+      if (e) std::rethrow_exception(e);
+    });
+    ctx.run();
+
+    wall += duration<double>(steady_clock::now() - start).count();
+    cpu += thread_cpu_seconds() - cpu_start;
+  }
+
+  double gb = double(bytes) * rounds / (1024.0 * 1024 * 1024);
+  std::cout << std::format(R"({{"bench":"sync_{}","backend":"{}","bytes":{},"rounds":{},"mb_per_s":{:.1f},"cpu_s_per_gb":{:.3f}}})",
+                           op, kBackend, bytes, rounds,
+                           double(bytes) * rounds / (1024.0 * 1024) / wall, cpu / gb) << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t megabytes = argc > 1 ? std::max(1, std::atoi(argv[1])) : 256;
+  int rounds = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+  size_t bytes = megabytes * 1024 * 1024;
+
+  auto dir = std::filesystem::temp_directory_path() / "bench-sync-transfer";
+  std::filesystem::create_directories(dir);
+  auto src = dir / "push.bin";
+  {
+    std::vector<char> block(1024 * 1024);
+    std::mt19937 rng(1);
+    for (auto &c : block) c = char(rng());
+    std::ofstream out(src, std::ios::binary);
+    for (size_t i = 0; i < megabytes; i++) {
+      out.write(block.data(), block.size());
+    }
+  }
+
+  asio::io_context server_ctx;
+  auto work = asio::make_work_guard(server_ctx);
+  adb_bench::FakeAdbServer server(server_ctx.get_executor());
+  server.setPullSize(bytes);
+  std::thread server_thread([&] { server_ctx.run(); });
+
+  auto spec = server.listenTcp();
+  TransportOption option {
+    .server = spec,
+    .launchServerIfNeed = false,
+  };
+
+  std::vector<std::filesystem::path> push_srcs{src};
+  std::string push_dst = "/data/local/tmp/push.bin";
+  std::vector<std::string> pull_srcs{"/data/local/tmp/pull.bin"};
+
+  measure("push", bytes, rounds, [&]() -> asio::awaitable<void> {
+    co_await co_sync_push(push_srcs, push_dst, option);
+  });
+
+  measure("pull", bytes, rounds, [&]() -> asio::awaitable<void> {
+    co_await co_sync_pull(pull_srcs, dir, option);
+  });
+
+  server.close();
+  work.reset();
+  server_ctx.stop();
+  server_thread.join();
+
+  std::error_code ec;
+  std::filesystem::remove_all(dir, ec);
+  return 0;
+}
@@ -0,0 +1,153 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// cpu cost of TelemetrySampler against the in-process fake adb server.
+// every sample is a real shell stream over tcp loopback carrying a
+// typical phone's output (3 battery, 40 thermal zones, 8 cpus, df),
+// the sampler's cpu is the process cpu minus the fake server thread.
+// the interval is scaled down and the cost reported per sampled interval:
+//
+//   {"bench":"telemetry","devices":300,"interval_ms":1000,...,"core_pct_at_10s":..}
+//
+// usage: bench-telemetry [--devices n] [--interval-ms ms] [--seconds s]
+
+#include "fake-adb-server.h"
+#include "adb-client/telemetry-sampler.h"
+#include <pthread.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <thread>
+
+using namespace adb_client;
+using namespace std::chrono;
+
+namespace {
+
+struct Options {
+  int devices{300};
+  int intervalMs{1000};
+  int seconds{10};
+};
+
+Options parse_options(int argc, char **argv) {
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string_view name = argv[i];
+    const char *value = argv[i + 1];
+    if (name == "--devices") {
+      opt.devices = std::max(1, std::atoi(value));
+    } else if (name == "--interval-ms") {
+      opt.intervalMs = std::max(10, std::atoi(value));
+    } else if (name == "--seconds") {
+      opt.seconds = std::max(1, std::atoi(value));
+    } else {
+      std::cerr << "bench-telemetry: unknown option " << name << std::endl;
+      std::exit(2);
+    }
+  }
+  return opt;
+}
+
+std::string phone_output() {
+  std::string out =
+    "/sys/class/power_supply/battery/capacity:87\n"
+    "/sys/class/power_supply/battery/temp:312\n"
+    "/sys/class/power_supply/battery/voltage_now:4211000\n";
+  for (int zone = 0; zone < 40; zone++) {
+    out += std::format("/sys/class/thermal/thermal_zone{}/temp:{}\n", zone, 35000 + zone * 100);
+  }
+  for (int cpu = 0; cpu < 8; cpu++) {
+    out += std::format("/sys/devices/system/cpu/cpu{}/cpufreq/scaling_cur_freq:{}\n", cpu, 1804800);
+  }
+  out += "df:/dev/block/dm-48 115412996 61205440 54076484 54% /data\n";
+  return out;
+}
+
+double cpu_seconds(clockid_t clock) {
+  timespec ts{};
+  clock_gettime(clock, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  auto opt = parse_options(argc, argv);
+
+  asio::io_context server_ctx;
+  auto work = asio::make_work_guard(server_ctx);
+  adb_bench::FakeAdbServer server(server_ctx.get_executor());
+  std::thread server_thread([&] { server_ctx.run(); });
+
+  auto spec = server.listenTcp();
+  server.setShellOutput(phone_output());
+
+  clockid_t server_clock;
+  pthread_getcpuclockid(server_thread.native_handle(), &server_clock);
+
+  std::atomic<uint64_t> records{0};
+  TelemetrySampler sampler([&records](std::span<const TelemetryRecord> batch) {
+    records += batch.size();
+  }, {
+    .interval = milliseconds(opt.intervalMs),
+    .timeout = milliseconds(opt.intervalMs),
+  }, {
+    .server = spec,
+    .launchServerIfNeed = false,
+  });
+
+  for (int i = 0; i < opt.devices; i++) {
+    sampler.addDevice(std::format("SERIAL{:08}", i));
+  }
+
+  double process_start = cpu_seconds(CLOCK_PROCESS_CPUTIME_ID);
+  double server_start = cpu_seconds(server_clock);
+  auto start = steady_clock::now();
+
+  sampler.start();
+  std::this_thread::sleep_for(seconds(opt.seconds));
+  sampler.stop();
+
+  double wall = duration<double>(steady_clock::now() - start).count();
+  double server_cpu = cpu_seconds(server_clock) - server_start;
+  double sampler_cpu = cpu_seconds(CLOCK_PROCESS_CPUTIME_ID) - process_start - server_cpu;
+
+  server.close();
+  work.reset();
+  server_ctx.stop();
+  server_thread.join();
+
+  auto stats = sampler.stats();
+  double intervals = wall * 1000 / opt.intervalMs;
+  double cpu_per_interval = intervals > 0 ? sampler_cpu / intervals : 0;
+
+  std::cout << std::format(R"({{"bench":"telemetry","devices":{},"interval_ms":{},"seconds":{:.1f},"samples":{},"failures":{},"records":{},"sampler_cpu_sec":{:.3f},"server_cpu_sec":{:.3f},"us_per_sample":{:.1f},"core_pct_at_10s":{:.2f}}})",
+                           opt.devices, opt.intervalMs, wall, stats.samples, stats.failures, records.load(),
+                           sampler_cpu, server_cpu,
+                           stats.samples ? sampler_cpu * 1e6 / stats.samples : 0.0,
+                           cpu_per_interval / 10 * 100) << std::endl;
+
+  return stats.failures == 0 ? 0 : 1;
+}
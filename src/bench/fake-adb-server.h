@@ -0,0 +1,444 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include "adb-client/co-adb-client.h"
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace adb_bench {
+
+using adb_client::AdbSocket;
+
+// minimal in-process stand-in for the adb server, enough to drive the
+// client against tcp or unix domain listeners: a few host services,
+// mdns discovery and connect, transport switching, raw shell with a
+// canned output, device tcp: ports that echo, streamed package installs
+// and a v1 sync service backed by nothing.
+class FakeAdbServer {
+public:
+  explicit FakeAdbServer(asio::any_io_executor ex) : ex_(std::move(ex)) {}
+
+  ~FakeAdbServer() {
+    close();
+  }
+
+  FakeAdbServer(const FakeAdbServer &) = delete;
+  FakeAdbServer& operator=(const FakeAdbServer &) = delete;
+
+  // returns the TransportOption::server spec to reach it
+  std::string listenTcp(uint16_t port = 0) {
+    auto acceptor = std::make_shared<asio::ip::tcp::acceptor>(ex_,
+          asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), port));
+    tcp_.push_back(acceptor);
+    co_spawn(ex_, acceptLoop(acceptor), asio::detached);
+    return std::format("tcp:127.0.0.1:{}", acceptor->local_endpoint().port());
+  }
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+  std::string listenUnix(const std::string &path) {
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    auto acceptor = std::make_shared<asio::local::stream_protocol::acceptor>(ex_,
+          asio::local::stream_protocol::endpoint(path));
+    unix_.push_back(acceptor);
+    co_spawn(ex_, acceptLoop(acceptor), asio::detached);
+    return "localfilesystem:" + path;
+  }
+#endif
+
+  // text served for host:devices-l and host:track-devices-l,
+  // open track-devices-l streams get the new list pushed
+  void setDevices(std::string devices) {
+    {
+      std::lock_guard lk(mutex_);
+      devices_ = std::move(devices);
+    }
+    wakeTrackers();
+  }
+
+  // output of every shell: service, the stream closes after it
+  void setShellOutput(std::string output) {
+    std::lock_guard lk(mutex_);
+    shell_output_ = std::move(output);
+  }
+
+  // text served for host:mdns:services
+  void setMdnsServices(std::string services) {
+    std::lock_guard lk(mutex_);
+    mdns_services_ = std::move(services);
+  }
+
+  // host:connect: requests seen so far
+  size_t connects() const {
+    return connects_;
+  }
+
+  // reply to host:connect:<addr>, "connected to <addr>" when empty
+  void setConnectReply(std::string reply) {
+    std::lock_guard lk(mutex_);
+    connect_reply_ = std::move(reply);
+  }
+
+  // reply to `cmd package install -S` on a serial, "Success" by default
+  void setInstallResult(const std::string &serial, std::string result) {
+    std::lock_guard lk(mutex_);
+    install_results_[serial] = std::move(result);
+  }
+
+  // time an install holds the device after the apk was received
+  void setInstallDelay(std::chrono::milliseconds delay) {
+    install_delay_ = delay;
+  }
+
+  // installs finished so far, and the most seen running at once
+  size_t installs() const {
+    return installs_;
+  }
+
+  size_t peakInstalls() const {
+    return peak_installs_;
+  }
+
+  // most sync: sessions seen open at once
+  size_t peakSyncs() const {
+    return peak_syncs_;
+  }
+
+  // size of the file served by sync RECV
+  void setPullSize(size_t bytes) {
+    pull_size_ = bytes;
+  }
+
+  void close() {
+    closed_ = true;
+    wakeTrackers();
+    asio::post(ex_, [tcp = tcp_, unx = unix_] {
+      asio::error_code ec;
+      for (auto &a : tcp) a->close(ec);
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+      for (auto &a : unx) a->close(ec);
+#endif
+    });
+    tcp_.clear();
+    unix_.clear();
+  }
+
+private:
+  using Wakeup = asio::steady_timer;
+
+  // expiring (rather than cancelling) also covers a tracker busy writing
+  void wakeTrackers() {
+    std::vector<std::shared_ptr<Wakeup>> wakeups;
+    {
+      std::lock_guard lk(mutex_);
+      std::erase_if(trackers_, [](auto &t) { return t.expired(); });
+      for (auto &t : trackers_) {
+        if (auto w = t.lock()) wakeups.push_back(std::move(w));
+      }
+    }
+
+    asio::post(ex_, [wakeups = std::move(wakeups)] {
+      for (auto &w : wakeups) w->expires_at(Wakeup::time_point::min());
+    });
+  }
+
+  asio::awaitable<void> track(AdbSocket &client) {
+    auto wakeup = std::make_shared<Wakeup>(ex_, Wakeup::time_point::max());
+    {
+      std::lock_guard lk(mutex_);
+      trackers_.push_back(wakeup);
+    }
+
+    auto sent = devices();
+    co_await reply(client, sent);
+
+    while (!closed_) {
+      asio::error_code ec;
+      co_await wakeup->async_wait(asio::redirect_error(asio::use_awaitable, ec));
+      wakeup->expires_at(Wakeup::time_point::max());
+
+      auto now = devices();
+      if (closed_ || now == sent) {
+        continue;
+      }
+      sent = std::move(now);
+      auto msg = std::format("{:04x}{}", sent.size(), sent);
+      co_await asio::async_write(client, asio::buffer(msg), asio::use_awaitable);
+    }
+  }
+
+  template <class Acceptor>
+  asio::awaitable<void> acceptLoop(std::shared_ptr<Acceptor> acceptor) {
+    for (;;) {
+      try {
+        AdbSocket client(co_await acceptor->async_accept(asio::use_awaitable));
+        co_spawn(ex_, serve(std::move(client)), asio::detached);
+      } catch (std::exception &) {
+        co_return;
+      }
+    }
+  }
+
+  static asio::awaitable<void> reply(AdbSocket &client, std::string_view payload) {
+    auto msg = std::format("OKAY{:04x}{}", payload.size(), payload);
+    co_await asio::async_write(client, asio::buffer(msg), asio::use_awaitable);
+  }
+
+  static asio::awaitable<void> fail(AdbSocket &client, std::string_view reason) {
+    auto msg = std::format("FAIL{:04x}{}", reason.size(), reason);
+    co_await asio::async_write(client, asio::buffer(msg), asio::use_awaitable);
+  }
+
+  std::string devices() {
+    std::lock_guard lk(mutex_);
+    return devices_;
+  }
+
+  std::string mdnsServices() {
+    std::lock_guard lk(mutex_);
+    return mdns_services_;
+  }
+
+  std::string connectReply(std::string_view addr) {
+    std::lock_guard lk(mutex_);
+    return connect_reply_.empty() ? std::format("connected to {}", addr) : connect_reply_;
+  }
+
+  std::string shellOutput() {
+    std::lock_guard lk(mutex_);
+    return shell_output_;
+  }
+
+  // a device port: everything received is sent back, until the client half closes
+  static asio::awaitable<void> echo(AdbSocket &client) {
+    char buffer[16 * 1024];
+    for (;;) {
+      asio::error_code ec;
+      auto n = co_await client.async_read_some(asio::buffer(buffer), asio::redirect_error(asio::use_awaitable, ec));
+      if (ec) {
+        break;
+      }
+      co_await asio::async_write(client, asio::buffer(buffer, n), asio::use_awaitable);
+    }
+    asio::error_code ec;
+    client.shutdown(asio::socket_base::shutdown_send, ec);
+  }
+
+  // counts a session while it lives and keeps the peak
+  struct Running {
+    std::atomic<size_t> &count;
+
+    Running(std::atomic<size_t> &count, std::atomic<size_t> &peak) : count(count) {
+      auto now = ++count;
+      for (auto p = peak.load(); p < now && !peak.compare_exchange_weak(p, now);) {
+      }
+    }
+    ~Running() { count--; }
+  };
+
+  std::string installResult(const std::string &serial) {
+    std::lock_guard lk(mutex_);
+    auto it = install_results_.find(serial);
+    return it == install_results_.end() ? "Success" : it->second;
+  }
+
+  // exec:cmd package install -S <size>: drain the apk, hold, then print the result
+  asio::awaitable<void> install(AdbSocket &client, const std::string &serial, size_t size) {
+    char buffer[16 * 1024];
+    for (size_t left = size; left > 0;) {
+      auto n = co_await client.async_read_some(asio::buffer(buffer, std::min(left, sizeof(buffer))), asio::use_awaitable);
+      left -= n;
+    }
+
+    {
+      Running running(running_installs_, peak_installs_);
+      asio::steady_timer hold(ex_, install_delay_.load());
+      asio::error_code ec;
+      co_await hold.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    }
+    installs_++;
+
+    auto result = installResult(serial) + "\n";
+    co_await asio::async_write(client, asio::buffer(result), asio::use_awaitable);
+  }
+
+  size_t pullSize() const {
+    return pull_size_;
+  }
+
+  static constexpr uint32_t mkid(char a, char b, char c, char d) {
+    return uint32_t(a) | uint32_t(b) << 8 | uint32_t(c) << 16 | uint32_t(d) << 24;
+  }
+
+  struct SyncHeader {
+    uint32_t id;
+    uint32_t length;
+  };
+
+  // v1 sync protocol subset: STAT, SEND (payload discarded), RECV (pull size bytes), QUIT
+  asio::awaitable<void> serveSync(AdbSocket &client) {
+    constexpr size_t kChunk = 64 * 1024;
+    std::unique_ptr<char[]> chunk(new char[kChunk + sizeof(SyncHeader)]());
+
+    for (;;) {
+      SyncHeader req;
+      co_await asio::async_read(client, asio::buffer(&req, sizeof(req)), asio::use_awaitable);
+
+      std::string path;
+      if (req.id != mkid('Q', 'U', 'I', 'T')) {
+        co_await asio::async_read(client, asio::dynamic_buffer(path, req.length), asio::use_awaitable);
+      }
+
+      if (req.id == mkid('S', 'T', 'A', 'T')) {
+        // id, mode, size, mtime
+        uint32_t st[4] = {req.id, 0100644, (uint32_t)pullSize(), 0};
+        co_await asio::async_write(client, asio::buffer(st, sizeof(st)), asio::use_awaitable);
+      } else if (req.id == mkid('S', 'E', 'N', 'D')) {
+        for (;;) {
+          SyncHeader hdr;
+          co_await asio::async_read(client, asio::buffer(&hdr, sizeof(hdr)), asio::use_awaitable);
+          if (hdr.id == mkid('D', 'O', 'N', 'E')) {
+            break;
+          }
+          for (size_t left = hdr.length; left > 0;) {
+            auto n = std::min(left, kChunk);
+            co_await asio::async_read(client, asio::buffer(chunk.get(), n), asio::use_awaitable);
+            left -= n;
+          }
+        }
+        SyncHeader okay {mkid('O', 'K', 'A', 'Y'), 0};
+        co_await asio::async_write(client, asio::buffer(&okay, sizeof(okay)), asio::use_awaitable);
+      } else if (req.id == mkid('R', 'E', 'C', 'V')) {
+        auto *hdr = reinterpret_cast<SyncHeader *>(chunk.get());
+        for (size_t left = pullSize(); left > 0;) {
+          auto n = std::min(left, kChunk);
+          *hdr = {mkid('D', 'A', 'T', 'A'), (uint32_t)n};
+          co_await asio::async_write(client, asio::buffer(chunk.get(), sizeof(SyncHeader) + n), asio::use_awaitable);
+          left -= n;
+        }
+        SyncHeader done {mkid('D', 'O', 'N', 'E'), 0};
+        co_await asio::async_write(client, asio::buffer(&done, sizeof(done)), asio::use_awaitable);
+      } else {
+        co_return;
+      }
+    }
+  }
+
+  asio::awaitable<void> serve(AdbSocket client) {
+    try {
+      // a device service is preceded by a transport switch on the same connection
+      std::string serial;
+      for (;;) {
+        std::string service;
+        co_await asio::async_read(client, asio::dynamic_buffer(service, 4), asio::use_awaitable);
+        auto len = std::stoul(service, nullptr, 16);
+        service.clear();
+        co_await asio::async_read(client, asio::dynamic_buffer(service, len), asio::use_awaitable);
+
+        if (service.starts_with("host:tport:")) {
+          if (service.starts_with("host:tport:serial:")) {
+            serial = service.substr(18);
+          }
+          int64_t transport_id = 1;
+          co_await asio::async_write(client, asio::buffer("OKAY", 4), asio::use_awaitable);
+          co_await asio::async_write(client, asio::buffer(&transport_id, 8), asio::use_awaitable);
+          continue;
+        } else if (service.starts_with("host:transport-id:")) {
+          co_await asio::async_write(client, asio::buffer("OKAY", 4), asio::use_awaitable);
+          continue;
+        }
+
+        if (service == "host:version") {
+          co_await reply(client, "0029");
+        } else if (service == "host:devices-l" || service == "host:devices") {
+          co_await reply(client, devices());
+        } else if (service == "host:mdns:services") {
+          co_await reply(client, mdnsServices());
+        } else if (service.starts_with("host:connect:")) {
+          connects_++;
+          co_await reply(client, connectReply(std::string_view(service).substr(13)));
+        } else if (service == "host:track-devices-l") {
+          co_await track(client);
+        } else if (service.ends_with(":features")) {
+          // no stat_v2 / ls_v2, the sync side only speaks v1
+          co_await reply(client, "shell_v2,cmd,fixed_push_mkdir,apex");
+        } else if (service == "sync:") {
+          co_await asio::async_write(client, asio::buffer("OKAY", 4), asio::use_awaitable);
+          Running running(running_syncs_, peak_syncs_);
+          co_await serveSync(client);
+        } else if (service.starts_with("shell:")) {
+          auto output = shellOutput();
+          co_await asio::async_write(client, asio::buffer("OKAY", 4), asio::use_awaitable);
+          co_await asio::async_write(client, asio::buffer(output), asio::use_awaitable);
+        } else if (service.starts_with("exec:cmd package install -S ")) {
+          auto size = std::stoull(service.substr(28));
+          co_await asio::async_write(client, asio::buffer("OKAY", 4), asio::use_awaitable);
+          co_await install(client, serial, size);
+        } else if (service.starts_with("tcp:")) {
+          co_await asio::async_write(client, asio::buffer("OKAY", 4), asio::use_awaitable);
+          co_await echo(client);
+        } else if (service == "host:kill") {
+          co_await asio::async_write(client, asio::buffer("OKAY", 4), asio::use_awaitable);
+        } else {
+          co_await fail(client, "unknown host service");
+        }
+        co_return;
+      }
+    } catch (std::exception &) {
+      // client went away
+    }
+  }
+
+  asio::any_io_executor ex_;
+  std::vector<std::shared_ptr<asio::ip::tcp::acceptor>> tcp_;
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+  std::vector<std::shared_ptr<asio::local::stream_protocol::acceptor>> unix_;
+#else
+  std::vector<std::shared_ptr<void>> unix_;
+#endif
+
+  std::mutex mutex_;
+  std::string devices_;
+  std::string shell_output_;
+  std::string mdns_services_;
+  std::string connect_reply_;
+  std::map<std::string, std::string> install_results_;
+  std::vector<std::weak_ptr<Wakeup>> trackers_;
+  std::atomic<bool> closed_{false};
+  std::atomic<size_t> pull_size_{0};
+  std::atomic<size_t> connects_{0};
+  std::atomic<std::chrono::milliseconds> install_delay_{};
+  std::atomic<size_t> running_installs_{0};
+  std::atomic<size_t> peak_installs_{0};
+  std::atomic<size_t> installs_{0};
+  std::atomic<size_t> running_syncs_{0};
+  std::atomic<size_t> peak_syncs_{0};
+};
+
+} // namespace adb_bench
@@ -0,0 +1,520 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// end-to-end scale simulation of the linux watcher.
+// a synthetic sysfs tree and a uevent socket stand in for the kernel,
+// a FakeAdbServer for the adb server, and the real WatchThread runs on
+// top of them through these scenarios:
+//
+//   enumerate      initial enumeration of the first half of the devices
+//   mass_attach    interface add uevents of the other half, back to back
+//   hub_cycle      every hub of bus 1 power cycled, remove + add of its devices
+//   fastboot_wave  every adb device reboots to fastboot, remove + add as fastboot
+//
+// latency is uevent sent (watch started for enumerate) -> device callback.
+// one json line per scenario goes to stdout:
+//
+//   {"scenario":"mass_attach","events":..,"missing":0,"seconds":..,"events_per_sec":..,"p50_ms":..,"p99_ms":..,"max_ms":..,"cpu_sec":..}
+//   {"scenario":"total","devices":..,"rss_mb":..,"cpu_sec":..}
+//
+// cpu_sec is the process cpu time within the scenario, building the sysfs
+// tree is left out.
+//
+// usage: sim-scale [--devices N] [--adb-every K] [--timeout-sec S]
+//                  [--min-events-per-sec X] [--max-p99-ms X] [--max-rss-mb X]
+//
+// exits 1 when a scenario misses callbacks or crosses a threshold.
+// events_per_sec is only gated on mass_attach and hub_cycle, enumerate
+// is the sysfs walk and fastboot_wave too few events for a stable rate.
+
+#include "fake-adb-server.h"
+#include "device-enumerator/device-watcher.h"
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <ranges>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace device_enumerator;
+using namespace std::chrono;
+namespace fs = std::filesystem;
+
+namespace {
+
+// 15 hubs of 15 ports per bus keeps devnum within 2..255
+constexpr int kHubsPerBus = 15;
+constexpr int kPortsPerHub = 15;
+constexpr int kDevicesPerBus = kHubsPerBus * kPortsPerHub;
+
+constexpr uint16_t kVid = 0x18d1;
+constexpr uint16_t kPid = 0x4ee7;
+
+struct Options {
+  int devices{2000};
+  int adbEvery{20};
+  int timeoutSec{60};
+  double minEventsPerSec{0};
+  double maxP99Ms{0};
+  double maxRssMb{0};
+};
+
+struct SimDevice {
+  int index;
+  int bus;
+  int hub;
+  int port;
+  bool adb;
+  int protocol; // adb interface protocol, 1 adb, 3 fastboot
+
+  static SimDevice at(int index, int adb_every) {
+    int in_bus = index % kDevicesPerBus;
+    return {
+      .index = index,
+      .bus = index / kDevicesPerBus + 1,
+      .hub = in_bus / kPortsPerHub + 1,
+      .port = in_bus % kPortsPerHub + 1,
+      .adb = adb_every > 0 && index % adb_every == 0,
+      .protocol = 1,
+    };
+  }
+
+  // root hub 1, hubs 2..16, devices 17..
+  int devnum() const { return 1 + kHubsPerBus + (hub - 1) * kPortsPerHub + port; }
+  std::string name() const { return std::format("{}-{}.{}", bus, hub, port); }
+  std::string devpath() const { return std::format("/devices/sim/usb{0}/{0}-{1}/{2}", bus, hub, name()); }
+  std::string serial() const { return std::format("SIM{:05d}", index); }
+  // DeviceInterface::hub of the device
+  std::string hubIdentity() const { return std::format("USB{}-{}-{}", bus, hub, port); }
+  std::string interfaceTriple() const { return adb ? std::format("255/66/{}", protocol) : "255/255/255"; }
+};
+
+void write_attr(const fs::path &path, std::string_view value) {
+  std::ofstream(path) << value << '\n';
+}
+
+// <tmp>/sim-sysfs-<pid>/devices/sim/usbB/B-H/B-H.P and the
+// <tmp>/sim-sysfs-<pid>/bus/usb/devices/B-H.P links, as the enumerator expects
+class SysfsTree {
+public:
+  SysfsTree() : root_(fs::temp_directory_path() / std::format("sim-sysfs-{}", getpid())) {
+    fs::remove_all(root_);
+    fs::create_directories(root_ / "bus/usb/devices");
+  }
+
+  ~SysfsTree() {
+    std::error_code ec;
+    fs::remove_all(root_, ec);
+  }
+
+  const fs::path &root() const { return root_; }
+
+  void addHub(int bus, int hub) {
+    auto name = std::format("{}-{}", bus, hub);
+    auto dir = root_ / std::format("devices/sim/usb{}", bus) / name;
+    fs::create_directories(dir);
+    write_attr(dir / "speed", "480");
+    fs::create_directory_symlink(dir, root_ / "bus/usb/devices" / name);
+  }
+
+  void addDevice(const SimDevice &d) {
+    auto dir = deviceDir(d);
+    fs::create_directories(dir);
+    write_attr(dir / "bNumInterfaces", " 1");
+    write_attr(dir / "busnum", std::to_string(d.bus));
+    write_attr(dir / "devnum", std::to_string(d.devnum()));
+    write_attr(dir / "idVendor", std::format("{:04x}", kVid));
+    write_attr(dir / "idProduct", std::format("{:04x}", kPid));
+    write_attr(dir / "serial", d.serial());
+    write_attr(dir / "product", "sim device");
+    write_attr(dir / "speed", "480");
+    setProtocol(d);
+    fs::create_directory_symlink(dir, root_ / "bus/usb/devices" / d.name());
+  }
+
+  void setProtocol(const SimDevice &d) {
+    auto dir = deviceDir(d) / (d.name() + ":1.0");
+    fs::create_directories(dir);
+    write_attr(dir / "bInterfaceClass", "ff");
+    write_attr(dir / "bInterfaceSubClass", d.adb ? "42" : "ff");
+    write_attr(dir / "bInterfaceProtocol", d.adb ? std::format("{:02x}", d.protocol) : "ff");
+  }
+
+private:
+  fs::path deviceDir(const SimDevice &d) const {
+    return root_ / d.devpath().substr(1);
+  }
+
+  fs::path root_;
+};
+
+// the kernel side of the watcher's uevent socket
+class UeventInjector {
+public:
+  UeventInjector() {
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds_) != 0) {
+      throw std::system_error(errno, std::generic_category(), "socketpair");
+    }
+    int size = 4 << 20;
+    setsockopt(fds_[1], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  }
+
+  ~UeventInjector() {
+    close(fds_[0]);
+    close(fds_[1]);
+  }
+
+  int watchFd() const { return fds_[0]; }
+
+  void interfaceAdd(const SimDevice &d) {
+    auto devpath = d.devpath() + "/" + d.name() + ":1.0";
+    send({
+      "add@" + devpath,
+      "ACTION=add",
+      "DEVPATH=" + devpath,
+      "SUBSYSTEM=usb",
+      "DEVTYPE=usb_interface",
+      std::format("PRODUCT={:x}/{:x}/100", kVid, kPid),
+      "TYPE=0/0/0",
+      "INTERFACE=" + d.interfaceTriple(),
+      std::format("SEQNUM={}", ++seqnum_),
+    });
+  }
+
+  void deviceRemove(const SimDevice &d) {
+    send({
+      "remove@" + d.devpath(),
+      "ACTION=remove",
+      "DEVPATH=" + d.devpath(),
+      "SUBSYSTEM=usb",
+      "DEVTYPE=usb_device",
+      std::format("PRODUCT={:x}/{:x}/100", kVid, kPid),
+      std::format("BUSNUM={:03d}", d.bus),
+      std::format("DEVNUM={:03d}", d.devnum()),
+      std::format("SEQNUM={}", ++seqnum_),
+    });
+  }
+
+private:
+  void send(std::initializer_list<std::string> fields) {
+    std::string msg;
+    for (auto &f : fields) {
+      msg += f;
+      msg += '\0';
+    }
+    if (::send(fds_[1], msg.data(), msg.size(), MSG_NOSIGNAL) < 0) {
+      throw std::system_error(errno, std::generic_category(), "send uevent");
+    }
+  }
+
+  int fds_[2];
+  uint64_t seqnum_{0};
+};
+
+// callbacks expected by "<hub identity>+" (on) or "<hub identity>-" (off)
+class Recorder {
+public:
+  static std::string key(const std::string &hub, bool off) {
+    return hub + (off ? '-' : '+');
+  }
+
+  void expect(const SimDevice &d, bool off, steady_clock::time_point sent = steady_clock::now()) {
+    std::lock_guard lk(mutex_);
+    pending_[key(d.hubIdentity(), off)] = sent;
+  }
+
+  void onDevice(const DeviceInterface &node) {
+    auto now = steady_clock::now();
+    std::lock_guard lk(mutex_);
+    auto it = pending_.find(key(node.hub, node.off));
+    if (it == pending_.end()) {
+      return;
+    }
+
+    latencies_.push_back(duration<double, std::milli>(now - it->second).count());
+    last_ = now;
+    pending_.erase(it);
+    if (pending_.empty()) {
+      cond_.notify_all();
+    }
+  }
+
+  struct Result {
+    size_t missing;
+    steady_clock::time_point last;
+    std::vector<double> latencies;
+  };
+
+  // waits for every expected callback, or the timeout
+  Result collect(seconds timeout) {
+    std::unique_lock lk(mutex_);
+    cond_.wait_for(lk, timeout, [this] { return pending_.empty(); });
+
+    Result r{pending_.size(), last_, std::move(latencies_)};
+    pending_.clear();
+    latencies_.clear();
+    return r;
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::unordered_map<std::string, steady_clock::time_point> pending_;
+  std::vector<double> latencies_;
+  steady_clock::time_point last_;
+};
+
+// "serial\tdevice product:.. model:.. device:.. transport_id:N" lines of the adb devices present
+std::string adb_device_list(const std::vector<SimDevice> &devices, size_t present) {
+  std::string list;
+  for (size_t i = 0; i < present; i++) {
+    auto &d = devices[i];
+    if (d.adb && d.protocol == 1) {
+      list += std::format("{}\tdevice usb:{}-{}.{} product:sim model:Sim_Device device:sim transport_id:{}\n",
+                          d.serial(), d.bus, d.hub, d.port, d.index + 1);
+    }
+  }
+  return list;
+}
+
+struct Thresholds {
+  const Options &opt;
+  bool failed{false};
+
+  void check(bool ok, std::string_view what) {
+    if (!ok) {
+      std::cerr << "sim-scale: " << what << std::endl;
+      failed = true;
+    }
+  }
+};
+
+double cpu_seconds() {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  auto tv = [](const timeval &t) { return t.tv_sec + t.tv_usec / 1e6; };
+  return tv(ru.ru_utime) + tv(ru.ru_stime);
+}
+
+struct Window {
+  steady_clock::time_point start{steady_clock::now()};
+  double cpu{cpu_seconds()};
+};
+
+// returns the cpu time of the scenario
+double report(std::string_view scenario, size_t events, const Window &window,
+              Recorder::Result &&r, Thresholds &gate, bool gate_rate = true) {
+  double cpu = cpu_seconds() - window.cpu;
+  auto &lat = r.latencies;
+  std::ranges::sort(lat);
+  auto pct = [&lat](size_t p) { return lat.empty() ? 0.0 : lat[std::min(lat.size() - 1, lat.size() * p / 100)]; };
+
+  double secs = lat.empty() ? 0 : duration<double>(r.last - window.start).count();
+  double rate = secs > 0 ? events / secs : 0;
+
+  std::cout << std::format(R"({{"scenario":"{}","events":{},"missing":{},"seconds":{:.3f},"events_per_sec":{:.0f},"p50_ms":{:.3f},"p99_ms":{:.3f},"max_ms":{:.3f},"cpu_sec":{:.3f}}})",
+                           scenario, events, r.missing, secs, rate, pct(50), pct(99), lat.empty() ? 0.0 : lat.back(), cpu) << std::endl;
+
+  gate.check(r.missing == 0, std::format("{}: {} callbacks missing", scenario, r.missing));
+  if (gate.opt.maxP99Ms > 0) {
+    gate.check(pct(99) <= gate.opt.maxP99Ms, std::format("{}: p99 {:.3f}ms above {}ms", scenario, pct(99), gate.opt.maxP99Ms));
+  }
+  if (gate_rate && gate.opt.minEventsPerSec > 0) {
+    gate.check(rate >= gate.opt.minEventsPerSec, std::format("{}: {:.0f} events/s below {}", scenario, rate, gate.opt.minEventsPerSec));
+  }
+  return cpu;
+}
+
+// peak resident set, VmHWM of /proc/self/status
+double peak_rss_mb() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.starts_with("VmHWM:")) {
+      return std::atof(line.c_str() + 6) / 1024;
+    }
+  }
+  return 0;
+}
+
+Options parse_options(int argc, char **argv) {
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string_view name = argv[i];
+    const char *value = argv[i + 1];
+    if (name == "--devices") {
+      opt.devices = std::clamp(std::atoi(value), 2, 255 * kDevicesPerBus);
+    } else if (name == "--adb-every") {
+      opt.adbEvery = std::atoi(value);
+    } else if (name == "--timeout-sec") {
+      opt.timeoutSec = std::max(1, std::atoi(value));
+    } else if (name == "--min-events-per-sec") {
+      opt.minEventsPerSec = std::atof(value);
+    } else if (name == "--max-p99-ms") {
+      opt.maxP99Ms = std::atof(value);
+    } else if (name == "--max-rss-mb") {
+      opt.maxRssMb = std::atof(value);
+    } else {
+      std::cerr << "sim-scale: unknown option " << name << std::endl;
+      std::exit(2);
+    }
+  }
+  return opt;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  auto opt = parse_options(argc, argv);
+  auto timeout = seconds(opt.timeoutSec);
+  Thresholds gate{opt};
+
+  std::vector<SimDevice> devices;
+  for (int i = 0; i < opt.devices; i++) {
+    devices.push_back(SimDevice::at(i, opt.adbEvery));
+  }
+  size_t initial = devices.size() / 2;
+
+  SysfsTree tree;
+  for (int bus = 1; bus <= devices.back().bus; bus++) {
+    for (int hub = 1; hub <= kHubsPerBus; hub++) {
+      tree.addHub(bus, hub);
+    }
+  }
+  for (size_t i = 0; i < initial; i++) {
+    tree.addDevice(devices[i]);
+  }
+
+  asio::io_context server_ctx;
+  auto work = asio::make_work_guard(server_ctx);
+  adb_bench::FakeAdbServer server(server_ctx.get_executor());
+  std::thread server_thread([&] { server_ctx.run(); });
+
+  auto spec = server.listenTcp();
+  server.setDevices(adb_device_list(devices, initial));
+
+  UeventInjector uevents;
+  Recorder recorder;
+
+  WatchThread::WatchSettings settings;
+  settings.adbServers = {spec.substr(spec.find(':') + 1)};
+  settings.sysfsRoot = tree.root().string();
+  settings.ueventFd = uevents.watchFd();
+
+  // enumerate
+  Window window;
+  for (size_t i = 0; i < initial; i++) {
+    recorder.expect(devices[i], false, window.start);
+  }
+
+  auto watcher = WatchThread::create([&recorder](const DeviceInterface &node) {
+    recorder.onDevice(node);
+  }, settings);
+
+  if (!watcher) {
+    std::cerr << "sim-scale: failed to start the watcher" << std::endl;
+    return 1;
+  }
+  // the enumeration rate is the sysfs walk, gated by latency only
+  double cpu = report("enumerate", initial, window, recorder.collect(timeout), gate, false);
+
+  // mass_attach, adb lists the new devices as they show up on usb
+  for (size_t i = initial; i < devices.size(); i++) {
+    tree.addDevice(devices[i]);
+  }
+  server.setDevices(adb_device_list(devices, devices.size()));
+  std::this_thread::sleep_for(milliseconds(50));
+
+  window = {};
+  for (size_t i = initial; i < devices.size(); i++) {
+    recorder.expect(devices[i], false);
+    uevents.interfaceAdd(devices[i]);
+  }
+  cpu += report("mass_attach", devices.size() - initial, window, recorder.collect(timeout), gate);
+
+  // hub_cycle
+  size_t events = 0;
+  window = {};
+  for (int hub = 1; hub <= kHubsPerBus; hub++) {
+    auto on_hub = devices | std::views::filter([hub](auto &d) { return d.bus == 1 && d.hub == hub; });
+    for (auto &d : on_hub) {
+      recorder.expect(d, true);
+      uevents.deviceRemove(d);
+      events++;
+    }
+    for (auto &d : on_hub) {
+      recorder.expect(d, false);
+      uevents.interfaceAdd(d);
+      events++;
+    }
+  }
+  cpu += report("hub_cycle", events, window, recorder.collect(timeout), gate);
+
+  // fastboot_wave, the adb devices drop off adb and come back as fastboot.
+  // sysfs is rewritten before the window, the remove uevent never reads it
+  for (auto &d : devices) {
+    if (d.adb) {
+      d.protocol = 3;
+      tree.setProtocol(d);
+    }
+  }
+  server.setDevices(adb_device_list(devices, devices.size()));
+
+  events = 0;
+  window = {};
+  for (auto &d : devices) {
+    if (!d.adb) {
+      continue;
+    }
+    recorder.expect(d, true);
+    uevents.deviceRemove(d);
+    recorder.expect(d, false);
+    uevents.interfaceAdd(d);
+    events += 2;
+  }
+  cpu += report("fastboot_wave", events, window, recorder.collect(timeout), gate, false);
+
+  watcher.reset();
+
+  auto rss = peak_rss_mb();
+  std::cout << std::format(R"({{"scenario":"total","devices":{},"rss_mb":{:.1f},"cpu_sec":{:.3f}}})",
+                           devices.size(), rss, cpu) << std::endl;
+  if (opt.maxRssMb > 0) {
+    gate.check(rss <= opt.maxRssMb, std::format("peak rss {:.1f}MB above {}MB", rss, opt.maxRssMb));
+  }
+
+  server.close();
+  work.reset();
+  server_ctx.stop();
+  server_thread.join();
+
+  return gate.failed ? 1 : 0;
+}
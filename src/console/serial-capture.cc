@@ -0,0 +1,571 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#endif
+
+#include "serial-capture.h"
+#include "tracing/logger.h"
+#include <atomic>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+
+namespace serial_console {
+
+using device_enumerator::DeviceInterface;
+using device_enumerator::DeviceType;
+using device_enumerator::portLogName;
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int kMaxEvents = 64;
+// reads per port and wakeup, keeps one chatty port from starving the rest
+constexpr int kReadsPerWakeup = 4;
+// "[2025-01-01 00:00:00.000] "
+constexpr size_t kStampLen = 26;
+
+speed_t baud_to_speed(int baud) {
+  switch (baud) {
+  case 9600: return B9600;
+  case 19200: return B19200;
+  case 38400: return B38400;
+  case 57600: return B57600;
+  case 115200: return B115200;
+  case 230400: return B230400;
+  case 460800: return B460800;
+  case 921600: return B921600;
+  case 1000000: return B1000000;
+  case 1500000: return B1500000;
+  case 2000000: return B2000000;
+  case 3000000: return B3000000;
+  case 4000000: return B4000000;
+  default: return B0;
+  }
+}
+
+// raw 8n1, reads return whatever has arrived
+bool configure_tty(int fd, int baud) {
+  struct termios tio;
+  if (tcgetattr(fd, &tio) != 0) {
+    return false;
+  }
+
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+
+  if (auto speed = baud_to_speed(baud); speed != B0) {
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+  }
+
+  return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+} // namespace
+
+struct Port {
+  std::string devpath;
+  std::string name;
+  fs::path logPath;
+  int fd{-1};
+  int logFd{-1};
+  uint64_t logSize{0};
+  // the log was rotated away but the new one could not be opened yet,
+  // logFd still writes to the rotated file and the open is retried every flush
+  bool reopen{false};
+  bool lineStart{true};
+  RawSink sink;
+
+  // batched output, allocated once at attach
+  std::unique_ptr<char[]> out;
+  size_t outUsed{0};
+
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> lines{0};
+  std::atomic<uint64_t> rotations{0};
+  std::atomic<uint64_t> logErrors{0};
+
+  ~Port() {
+    if (fd >= 0) ::close(fd);
+    if (logFd >= 0) ::close(logFd);
+  }
+};
+
+struct CaptureEngine::Impl {
+  CaptureSettings settings;
+
+  int epfd{-1};
+  int wakeFd{-1};
+  std::thread thread;
+  std::atomic<bool> stopping{false};
+
+  struct Command {
+    bool attach;
+    std::string devpath;
+    std::string name;
+    RawSink sink;
+  };
+
+  std::mutex commandMutex;
+  std::vector<Command> commands;
+
+  // written by the capture thread only, the mutex guards readers in stats()
+  mutable std::mutex portsMutex;
+  std::unordered_map<int, std::unique_ptr<Port>> ports; // by tty fd
+  std::unordered_map<std::string, int> byDevpath;
+
+  std::unique_ptr<char[]> readBuffer;
+
+  // refreshed once per read, every line of one read shares it
+  char stamp[kStampLen + 1]{};
+
+  void post(Command cmd);
+  void run();
+  void applyCommands();
+  void open(const std::string &devpath, const std::string &name, RawSink sink);
+  void close(int fd);
+  void drain(Port &port);
+  void append(Port &port, const char *data, size_t size);
+  void flush(Port &port);
+  void rotate(Port &port);
+  void reopen(Port &port);
+  void updateStamp();
+};
+
+void CaptureEngine::Impl::post(Command cmd) {
+  {
+    std::lock_guard lk(commandMutex);
+    commands.push_back(std::move(cmd));
+  }
+
+  uint64_t one = 1;
+  [[maybe_unused]] auto n = ::write(wakeFd, &one, sizeof(one));
+}
+
+void CaptureEngine::Impl::open(const std::string &devpath, const std::string &name, RawSink sink) {
+  if (byDevpath.contains(devpath)) {
+    return;
+  }
+
+  int fd = ::open(devpath.c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    DEVICE_WATCH_LOG_WARNING("capture: cannot open {}, errno={}", devpath, errno);
+    return;
+  }
+
+  if (!configure_tty(fd, settings.baudRate)) {
+    DEVICE_WATCH_LOG_WARNING("capture: cannot configure {}, errno={}", devpath, errno);
+  }
+
+  auto port = std::make_unique<Port>();
+  port->fd = fd;
+  port->devpath = devpath;
+  port->name = name.empty() ? portLogName(devpath, {}) : name;
+  port->sink = std::move(sink);
+
+  if (!port->sink) {
+    port->logPath = settings.logDir / (port->name + ".log");
+    port->logFd = ::open(port->logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (port->logFd < 0) {
+      DEVICE_WATCH_LOG_ERROR("capture: cannot open {}, errno={}", port->logPath.string(), errno);
+      return;
+    }
+
+    struct stat st;
+    if (fstat(port->logFd, &st) == 0) {
+      port->logSize = st.st_size;
+    }
+
+    port->out.reset(new char[settings.bufferSize]);
+  }
+
+  struct epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+    DEVICE_WATCH_LOG_ERROR("capture: epoll_ctl {} failed, errno={}", devpath, errno);
+    return;
+  }
+
+  DEVICE_WATCH_LOG_INFO("capture: {} -> {}", devpath, port->sink ? "sink" : port->logPath.string());
+
+  std::lock_guard lk(portsMutex);
+  byDevpath[devpath] = fd;
+  ports[fd] = std::move(port);
+}
+
+void CaptureEngine::Impl::close(int fd) {
+  auto it = ports.find(fd);
+  if (it == ports.end()) {
+    return;
+  }
+
+  flush(*it->second);
+  epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+
+  std::lock_guard lk(portsMutex);
+  byDevpath.erase(it->second->devpath);
+  ports.erase(it);
+}
+
+void CaptureEngine::Impl::applyCommands() {
+  std::vector<Command> pending;
+  {
+    std::lock_guard lk(commandMutex);
+    pending.swap(commands);
+  }
+
+  for (auto &cmd : pending) {
+    if (cmd.attach) {
+      open(cmd.devpath, cmd.name, std::move(cmd.sink));
+    } else if (auto it = byDevpath.find(cmd.devpath); it != byDevpath.end()) {
+      close(it->second);
+    }
+  }
+}
+
+void CaptureEngine::Impl::updateStamp() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  std::tm tm{};
+  localtime_r(&ts.tv_sec, &tm);
+  auto len = strftime(stamp, sizeof(stamp), "[%Y-%m-%d %H:%M:%S", &tm);
+  snprintf(stamp + len, sizeof(stamp) - len, ".%03d] ", static_cast<int>(ts.tv_nsec / 1000000));
+}
+
+void CaptureEngine::Impl::rotate(Port &port) {
+  std::error_code ec;
+  auto numbered = [&port](int i) {
+    return fs::path(port.logPath).concat("." + std::to_string(i));
+  };
+
+  // older files missing is fine, they are only shifted when present
+  fs::remove(numbered(settings.keepFiles), ec);
+  for (int i = settings.keepFiles - 1; i >= 1; i--) {
+    fs::rename(numbered(i), numbered(i + 1), ec);
+  }
+
+  ec.clear();
+  if (settings.keepFiles > 0) {
+    fs::rename(port.logPath, numbered(1), ec);
+  } else {
+    fs::remove(port.logPath, ec);
+  }
+
+  if (ec) {
+    // reopening would truncate the current log, keep appending to it
+    // and try again after another rotateBytes
+    DEVICE_WATCH_LOG_ERROR("capture: cannot rotate {}: {}", port.logPath.string(), ec.message());
+    port.logErrors.fetch_add(1, std::memory_order_relaxed);
+    port.logSize = 0;
+    return;
+  }
+
+  port.rotations.fetch_add(1, std::memory_order_relaxed);
+  reopen(port);
+}
+
+void CaptureEngine::Impl::reopen(Port &port) {
+  int fd = ::open(port.logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    // logged once, not on every retry
+    if (!port.reopen) {
+      DEVICE_WATCH_LOG_ERROR("capture: cannot reopen {}, errno={}", port.logPath.string(), errno);
+    }
+    port.logErrors.fetch_add(1, std::memory_order_relaxed);
+    port.reopen = true;
+    return;
+  }
+
+  if (port.reopen) {
+    DEVICE_WATCH_LOG_INFO("capture: reopened {}", port.logPath.string());
+  }
+  ::close(port.logFd);
+  port.logFd = fd;
+  port.logSize = 0;
+  port.reopen = false;
+}
+
+void CaptureEngine::Impl::flush(Port &port) {
+  if (port.outUsed == 0) {
+    return;
+  }
+
+  if (port.reopen) {
+    reopen(port);
+  } else if (port.logSize + port.outUsed > settings.rotateBytes && port.logSize > 0) {
+    rotate(port);
+  }
+
+  const char *p = port.out.get();
+  size_t left = port.outUsed;
+  while (left && port.logFd >= 0) {
+    auto n = ::write(port.logFd, p, left);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      DEVICE_WATCH_LOG_ERROR("capture: write {} failed, errno={}", port.logPath.string(), errno);
+      port.logErrors.fetch_add(1, std::memory_order_relaxed);
+      break;
+    }
+    p += n;
+    left -= n;
+  }
+
+  port.logSize += port.outUsed - left;
+  port.outUsed = 0;
+}
+
+void CaptureEngine::Impl::append(Port &port, const char *data, size_t size) {
+  auto capacity = settings.bufferSize;
+  auto put = [&](const char *p, size_t n) {
+    while (n) {
+      if (port.outUsed == capacity) {
+        flush(port);
+      }
+      auto chunk = std::min(n, capacity - port.outUsed);
+      memcpy(port.out.get() + port.outUsed, p, chunk);
+      port.outUsed += chunk;
+      p += chunk;
+      n -= chunk;
+    }
+  };
+
+  const char *end = data + size;
+  while (data < end) {
+    if (port.lineStart && settings.timestamps) {
+      put(stamp, kStampLen);
+    }
+
+    auto *nl = static_cast<const char *>(memchr(data, '\n', end - data));
+    auto *stop = nl ? nl + 1 : end;
+    put(data, stop - data);
+    port.lineStart = nl != nullptr;
+    if (nl) {
+      port.lines.fetch_add(1, std::memory_order_relaxed);
+    }
+    data = stop;
+  }
+}
+
+void CaptureEngine::Impl::drain(Port &port) {
+  for (int i = 0; i < kReadsPerWakeup; i++) {
+    auto n = ::read(port.fd, readBuffer.get(), settings.readChunk);
+    if (n > 0) {
+      if (port.sink) {
+        port.sink({reinterpret_cast<const uint8_t *>(readBuffer.get()), size_t(n)});
+      } else {
+        updateStamp();
+        append(port, readBuffer.get(), n);
+      }
+      port.bytes.fetch_add(n, std::memory_order_relaxed);
+      if (size_t(n) < settings.readChunk) {
+        return;
+      }
+      continue;
+    }
+
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+      return;
+    }
+
+    // eof or EIO, the device is gone
+    DEVICE_WATCH_LOG_INFO("capture: {} closed", port.devpath);
+    close(port.fd);
+    return;
+  }
+}
+
+void CaptureEngine::Impl::run() {
+  struct epoll_event events[kMaxEvents];
+  auto interval = static_cast<int>(settings.flushInterval.count());
+  auto next_flush = std::chrono::steady_clock::now() + settings.flushInterval;
+
+  while (!stopping.load(std::memory_order_acquire)) {
+    int n = epoll_wait(epfd, events, kMaxEvents, interval);
+    if (n < 0 && errno != EINTR) {
+      DEVICE_WATCH_LOG_ERROR("capture: epoll_wait failed, errno={}", errno);
+      break;
+    }
+
+    for (int i = 0; i < n; i++) {
+      int fd = events[i].data.fd;
+      if (fd == wakeFd) {
+        uint64_t value;
+        [[maybe_unused]] auto r = ::read(wakeFd, &value, sizeof(value));
+        applyCommands();
+        continue;
+      }
+
+      auto it = ports.find(fd);
+      if (it == ports.end()) {
+        continue;
+      }
+
+      if (events[i].events & EPOLLIN) {
+        drain(*it->second);
+      } else if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+        close(fd);
+      }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now >= next_flush) {
+      for (auto &[fd, port] : ports) {
+        flush(*port);
+      }
+      next_flush = now + settings.flushInterval;
+    }
+  }
+
+  applyCommands();
+  while (!ports.empty()) {
+    close(ports.begin()->first);
+  }
+}
+
+CaptureEngine::CaptureEngine(CaptureSettings settings) : impl_(std::make_unique<Impl>()) {
+  impl_->settings = std::move(settings);
+  impl_->settings.readChunk = std::max<size_t>(impl_->settings.readChunk, 4096);
+  impl_->settings.bufferSize = std::max<size_t>(impl_->settings.bufferSize, 4096);
+}
+
+CaptureEngine::~CaptureEngine() {
+  stop();
+}
+
+bool CaptureEngine::start() {
+  auto &impl = *impl_;
+  if (impl.thread.joinable()) {
+    return true;
+  }
+
+  std::error_code ec;
+  fs::create_directories(impl.settings.logDir, ec);
+  if (ec) {
+    DEVICE_WATCH_LOG_ERROR("capture: cannot create {}: {}", impl.settings.logDir.string(), ec.message());
+    return false;
+  }
+
+  impl.epfd = epoll_create1(EPOLL_CLOEXEC);
+  impl.wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (impl.epfd < 0 || impl.wakeFd < 0) {
+    DEVICE_WATCH_LOG_ERROR("capture: epoll setup failed, errno={}", errno);
+    return false;
+  }
+
+  struct epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.fd = impl.wakeFd;
+  epoll_ctl(impl.epfd, EPOLL_CTL_ADD, impl.wakeFd, &ev);
+
+  impl.readBuffer.reset(new char[impl.settings.readChunk]);
+  impl.stopping = false;
+  impl.thread = std::thread([&impl] { impl.run(); });
+  return true;
+}
+
+void CaptureEngine::stop() {
+  auto &impl = *impl_;
+  if (impl.thread.joinable()) {
+    impl.stopping.store(true, std::memory_order_release);
+    uint64_t one = 1;
+    [[maybe_unused]] auto n = ::write(impl.wakeFd, &one, sizeof(one));
+    impl.thread.join();
+  }
+
+  if (impl.epfd >= 0) {
+    ::close(impl.epfd);
+    impl.epfd = -1;
+  }
+  if (impl.wakeFd >= 0) {
+    ::close(impl.wakeFd);
+    impl.wakeFd = -1;
+  }
+}
+
+void CaptureEngine::attach(const std::string &devpath, const std::string &name, RawSink sink) {
+  if (impl_->wakeFd >= 0) {
+    impl_->post({true, devpath, name, std::move(sink)});
+  }
+}
+
+void CaptureEngine::detach(const std::string &devpath) {
+  if (impl_->wakeFd >= 0) {
+    impl_->post({false, devpath, {}, {}});
+  }
+}
+
+void CaptureEngine::onDevice(const DeviceInterface &dev) {
+  if (!(dev.type & (DeviceType::Serial | DeviceType::Diag)) || dev.devpath.empty()) {
+    return;
+  }
+
+  auto &prefixes = impl_->settings.ttyPrefixes;
+  if (std::ranges::none_of(prefixes, [&dev](auto &prefix) { return dev.devpath.starts_with(prefix); })) {
+    return;
+  }
+
+  if (dev.off) {
+    detach(dev.devpath);
+  } else {
+    auto &sinkFor = impl_->settings.rawSinkFor;
+    attach(dev.devpath, portLogName(dev.devpath, dev.hub), sinkFor ? sinkFor(dev) : RawSink{});
+  }
+}
+
+std::vector<PortStats> CaptureEngine::stats() const {
+  std::vector<PortStats> out;
+  std::lock_guard lk(impl_->portsMutex);
+  for (auto &[fd, port] : impl_->ports) {
+    PortStats st;
+    st.devpath = port->devpath;
+    st.name = port->name;
+    st.bytes = port->bytes.load(std::memory_order_relaxed);
+    st.lines = port->lines.load(std::memory_order_relaxed);
+    st.rotations = port->rotations.load(std::memory_order_relaxed);
+    st.logErrors = port->logErrors.load(std::memory_order_relaxed);
+    out.push_back(std::move(st));
+  }
+  return out;
+}
+
+} // namespace serial_console
+
+#ifdef ENABLE_TEST
+#include "serial-capture_tests.cc"
+#endif
@@ -0,0 +1,108 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include "device-enumerator/usb-watch-base.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+// console capture of serial devices (usb2serial, cdc-acm, diag ports).
+//
+// every attached tty is put in raw mode and read by one epoll thread, bytes
+// go to <logDir>/<name>.log with a timestamp in front of every line. output
+// is batched in a preallocated buffer per port and written when the buffer
+// fills or every flushInterval, logs rotate to <name>.log.1 .. .keepFiles.
+//
+// linux only.
+
+namespace serial_console {
+
+// consumer of the raw bytes of a port, runs on the capture thread
+using RawSink = std::function<void(std::span<const uint8_t>)>;
+
+struct CaptureSettings {
+  std::filesystem::path logDir;
+  int baudRate{115200};
+
+  // only devices whose devpath starts with one of these are auto attached
+  std::vector<std::string> ttyPrefixes{"/dev/ttyUSB", "/dev/ttyACM"};
+
+  size_t readChunk{64 << 10};
+  size_t bufferSize{64 << 10};
+  std::chrono::milliseconds flushInterval{200};
+
+  uint64_t rotateBytes{64 << 20};
+  int keepFiles{4};
+
+  bool timestamps{true};
+
+  // asked for every auto attached device, a non empty sink gets the port
+  // bytes instead of the log (e.g. diag::DiagTap::sinkFor)
+  std::function<RawSink(const device_enumerator::DeviceInterface &)> rawSinkFor;
+};
+
+struct PortStats {
+  std::string devpath;
+  std::string name;
+  uint64_t bytes{0};
+  uint64_t lines{0};
+  uint64_t rotations{0};
+  // failed log renames, reopens and writes, each one is logged
+  uint64_t logErrors{0};
+};
+
+class CaptureEngine {
+public:
+  explicit CaptureEngine(CaptureSettings settings);
+  ~CaptureEngine();
+
+  CaptureEngine(const CaptureEngine &) = delete;
+  CaptureEngine& operator=(const CaptureEngine &) = delete;
+
+  // false (and logged) if the log directory or the poll thread can not be set up
+  bool start();
+  // flushes and closes every port
+  void stop();
+
+  // thread safe, the port is opened on the capture thread.
+  // name is the log file stem, derived from devpath if empty.
+  // with a sink the bytes go there and no log is written
+  void attach(const std::string &devpath, const std::string &name = {}, RawSink sink = {});
+  void detach(const std::string &devpath);
+
+  // watcher callback glue, attaches serial devices on arrival
+  // and detaches them when they go off
+  void onDevice(const device_enumerator::DeviceInterface &dev);
+
+  std::vector<PortStats> stats() const;
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+} // namespace serial_console
@@ -0,0 +1,189 @@
+#include <fstream>
+#include <sstream>
+#include <sys/resource.h>
+
+namespace serial_console {
+
+namespace {
+
+// a pty pair stands in for a usb2serial port, the slave is captured
+struct TestPty {
+  int master{-1};
+  std::string slave;
+
+  TestPty() {
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master >= 0 && grantpt(master) == 0 && unlockpt(master) == 0) {
+      slave = ptsname(master);
+    }
+  }
+
+  ~TestPty() {
+    if (master >= 0) ::close(master);
+  }
+
+  void write(std::string_view s) {
+    [[maybe_unused]] auto n = ::write(master, s.data(), s.size());
+  }
+};
+
+std::string read_file(const fs::path &path) {
+  std::ifstream in(path, std::ios::binary);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+template <class Pred>
+bool wait_until(Pred pred) {
+  for (int i = 0; i < 200 && !pred(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return pred();
+}
+
+} // namespace
+
+TEST(SerialCapture, TimestampedLines) {
+  auto dir = fs::temp_directory_path() / "serial-capture-test";
+  fs::remove_all(dir);
+
+  TestPty pty;
+  ASSERT_FALSE(pty.slave.empty());
+
+  CaptureSettings settings;
+  settings.logDir = dir;
+  settings.flushInterval = std::chrono::milliseconds(10);
+  CaptureEngine engine(settings);
+  ASSERT_TRUE(engine.start());
+  engine.attach(pty.slave, "pty");
+  ASSERT_TRUE(wait_until([&] { return engine.stats().size() == 1; }));
+
+  pty.write("boot: one\nboot: tw");
+  pty.write("o\nboot: three\n");
+  ASSERT_TRUE(wait_until([&] { return engine.stats()[0].lines == 3; }));
+  engine.stop();
+
+  auto log = read_file(dir / "pty.log");
+  std::vector<std::string> lines;
+  std::istringstream ss(log);
+  for (std::string line; std::getline(ss, line);) {
+    lines.push_back(line);
+  }
+
+  ASSERT_EQ(lines.size(), 3u);
+  EXPECT_EQ(lines[0].substr(kStampLen), "boot: one");
+  EXPECT_EQ(lines[1].substr(kStampLen), "boot: two");
+  EXPECT_EQ(lines[2].substr(kStampLen), "boot: three");
+  EXPECT_EQ(lines[0][0], '[');
+  EXPECT_EQ(lines[0].substr(kStampLen - 2, 2), "] ");
+}
+
+TEST(SerialCapture, RotatesLogs) {
+  auto dir = fs::temp_directory_path() / "serial-capture-rotate";
+  fs::remove_all(dir);
+
+  TestPty pty;
+  ASSERT_FALSE(pty.slave.empty());
+
+  CaptureSettings settings;
+  settings.logDir = dir;
+  settings.flushInterval = std::chrono::milliseconds(5);
+  settings.rotateBytes = 1000;
+  settings.keepFiles = 2;
+  settings.timestamps = false;
+  CaptureEngine engine(settings);
+  ASSERT_TRUE(engine.start());
+  engine.attach(pty.slave, "pty");
+  ASSERT_TRUE(wait_until([&] { return engine.stats().size() == 1; }));
+
+  std::string line(99, 'x');
+  line += '\n';
+  for (int i = 0; i < 40; i++) {
+    pty.write(line);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  ASSERT_TRUE(wait_until([&] { return engine.stats()[0].lines == 40; }));
+  engine.stop();
+
+  EXPECT_TRUE(fs::exists(dir / "pty.log.1"));
+  EXPECT_TRUE(fs::exists(dir / "pty.log.2"));
+  EXPECT_FALSE(fs::exists(dir / "pty.log.3"));
+  EXPECT_LE(fs::file_size(dir / "pty.log"), 1000u);
+  EXPECT_LE(fs::file_size(dir / "pty.log.1"), 1000u);
+}
+
+TEST(SerialCapture, RecoversFromFailedReopen) {
+  auto dir = fs::temp_directory_path() / "serial-capture-reopen";
+  fs::remove_all(dir);
+
+  TestPty pty;
+  ASSERT_FALSE(pty.slave.empty());
+
+  CaptureSettings settings;
+  settings.logDir = dir;
+  settings.flushInterval = std::chrono::milliseconds(5);
+  settings.rotateBytes = 500;
+  settings.keepFiles = 1;
+  settings.timestamps = false;
+  CaptureEngine engine(settings);
+  ASSERT_TRUE(engine.start());
+  engine.attach(pty.slave, "pty");
+  ASSERT_TRUE(wait_until([&] { return engine.stats().size() == 1; }));
+
+  std::string line(99, 'x');
+  line += '\n';
+  pty.write(line);
+  ASSERT_TRUE(wait_until([&] { return fs::exists(dir / "pty.log") && fs::file_size(dir / "pty.log") == 100; }));
+
+  // no descriptor left, the open after the rotation fails with EMFILE
+  struct rlimit saved;
+  getrlimit(RLIMIT_NOFILE, &saved);
+  int lowest = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+  ::close(lowest);
+  struct rlimit exhausted = saved;
+  exhausted.rlim_cur = lowest;
+  setrlimit(RLIMIT_NOFILE, &exhausted);
+
+  for (int i = 0; i < 9; i++) {
+    pty.write(line);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  // nothing is dropped, it goes on into the rotated file
+  bool kept = wait_until([&] {
+    return fs::exists(dir / "pty.log.1") && fs::file_size(dir / "pty.log.1") == 1000;
+  });
+  bool reported = engine.stats()[0].logErrors > 0;
+  setrlimit(RLIMIT_NOFILE, &saved);
+  ASSERT_TRUE(kept);
+  ASSERT_TRUE(reported);
+  EXPECT_FALSE(fs::exists(dir / "pty.log"));
+
+  pty.write(line);
+  ASSERT_TRUE(wait_until([&] { return fs::exists(dir / "pty.log") && fs::file_size(dir / "pty.log") == 100; }));
+  engine.stop();
+
+  EXPECT_EQ(fs::file_size(dir / "pty.log.1"), 1000u);
+}
+
+TEST(SerialCapture, RawSinkBypassesLog) {
+  auto dir = fs::temp_directory_path() / "serial-capture-sink";
+  fs::remove_all(dir);
+
+  TestPty pty;
+  ASSERT_FALSE(pty.slave.empty());
+
+  std::atomic<size_t> received{0};
+  CaptureEngine engine({.logDir = dir});
+  ASSERT_TRUE(engine.start());
+  engine.attach(pty.slave, "pty", [&received](std::span<const uint8_t> data) { received += data.size(); });
+  ASSERT_TRUE(wait_until([&] { return engine.stats().size() == 1; }));
+
+  pty.write("\x7e\x01\x02\n");
+  ASSERT_TRUE(wait_until([&] { return received == 4; }));
+  engine.stop();
+
+  EXPECT_FALSE(fs::exists(dir / "pty.log"));
+}
+
+} // namespace serial_console
@@ -20,8 +20,19 @@
 
 #include "device-enumerator/device-watcher.h"
 #include "adb-client/adb-client.h"
+#include "adb-client/remote-target-keeper.h"
+#include "tracing/logger.h"
+#include "tracing/trace-writer.h"
+#include "journal/event-journal.h"
+#if __linux__
+#include "console/serial-capture.h"
+#include "diag/diag-tap.h"
+#endif
+#include "device-json.h"
 #include <gflags/gflags.h>
+#include <algorithm>
 #include <mutex>
+#include <optional>
 #include <thread>
 #include <condition_variable>
 #include <iostream>
@@ -35,16 +46,6 @@ using json = nlohmann::json;
 using device_enumerator::DeviceInterface;
 using device_enumerator::WatchThread;
 
-namespace nlohmann {
-  template <>
-  struct adl_serializer<std::wstring> {
-    static void to_json(json& j, const std::wstring& str) {
-      std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
-      j = converter.to_bytes(str);
-    }
-  };
-}
-
 
 DEFINE_bool(pretty, false,
                   "pretty json output.");
@@ -77,37 +78,39 @@ DEFINE_string(drivers, "",
 DEFINE_string(ip_list, "",
                   "watch ip list");
 
-namespace {
+DEFINE_string(adb_servers, "",
+                  "adb servers to track, default server if empty. e.g. 5037,5038,10.0.0.2:5037");
 
-json 
-deviceNodeToJsonObject(const DeviceInterface &dev) {
-  json jdev;
-  
-  jdev["id"] = dev.identity;
-  if (dev.off) jdev["off"] = dev.off;
-  if (!dev.devpath.empty()) jdev["devpath"] = dev.devpath;
-  if (!dev.hub.empty()) jdev["hub"] = dev.hub;
-  if (!dev.serial.empty()) jdev["serial"] = dev.serial;
-  if (!dev.manufacturer.empty()) jdev["manufacturer"] = dev.manufacturer;
-  if (!dev.product.empty()) jdev["product"] = dev.product;
-  if (!dev.model.empty()) jdev["model"] = dev.model;
-  if (!dev.device.empty()) jdev["device"] = dev.device;
-  if (!dev.driver.empty()) jdev["driver"] = dev.driver;
-  if (!dev.ip.empty()) jdev["ip"] = dev.ip;
-  if (dev.port) jdev["port"] = dev.port;
-  if (dev.vid) jdev["vid"] = dev.vid;
-  if (dev.pid) jdev["pid"] = dev.pid;
-  jdev["type"] = device_enumerator::DeviceTypeConverter::stringfiyType(dev.type);
-  if (!dev.description.empty()) jdev["description"] = dev.description;
-  if (dev.type & device_enumerator::DeviceType::Usb) {
-    jdev["usbClass"] = dev.usbClass;
-    jdev["usbSubClass"] = dev.usbSubClass;
-    jdev["usbProto"] = dev.usbProto;
-    jdev["usbIf"] = dev.usbIf;
-  }
+DEFINE_bool(adb_mdns, false,
+                  "connect wireless debugging devices advertised over mdns");
 
-  return jdev;
-}
+DEFINE_string(adb_mdns_instances, "",
+                  "only connect mdns instances starting with one of these. e.g. adb-R5CT,adb-2A1");
+
+DEFINE_int32(identity_scheme, 2,
+                  "device id hash, 2 current, 1 the ids of releases before versioned ids");
+
+DEFINE_string(trace_file, "",
+                  "write a chrome trace-event json of the device pipeline to this file");
+
+DEFINE_string(journal_dir, "",
+                  "append every device event to the journal in this directory, see adb-device-journal");
+
+#if __linux__
+DEFINE_string(capture_dir, "",
+                  "capture the console of every serial device (ttyUSB*, ttyACM*) to <capture_dir>/<hub>.<tty>.log");
+
+DEFINE_int32(capture_baud, 115200,
+                  "baud rate of the captured serial consoles");
+
+DEFINE_bool(capture_diag, false,
+                  "decode captured diag ports into <capture_dir>/<hub>.<tty>.diag instead of logging their raw bytes");
+#endif
+
+DEFINE_int32(log_level, 2,
+                  "stderr log level, 0 debug, 1 info, 2 warning, 3 error, 4 off");
+
+namespace {
 
 template <class T>
 requires std::is_integral_v<T>
@@ -164,7 +167,7 @@ int main(int argc, char *argv[]) {
 
 #if __linux__ 
   if (FLAGS_usbserial_vidpid.size() && !process::runingAsSudoer()) {
-    std::cerr << "require sudo privileges. " << std::endl;
+    DEVICE_WATCH_LOG_ERROR("require sudo privileges.");
     return 1;
   }
 #endif
@@ -177,6 +180,8 @@ int main(int argc, char *argv[]) {
 
   gflags::ParseCommandLineFlags(&argc, &argv, true);
 
+  tracing::set_log_level(static_cast<tracing::LogLevel>(std::clamp(FLAGS_log_level, 0, 4)));
+
   WatchThread::WatchSettings settings;
 
 #if __linux__ 
@@ -192,7 +197,7 @@ int main(int argc, char *argv[]) {
   for (auto vidpid : vidpid_list) {
     auto pos = vidpid.find(':');
     if (pos == std::string_view::npos) {
-      std::cerr << "invalid vid:pid format: " << vidpid << std::endl;
+      DEVICE_WATCH_LOG_ERROR("invalid vid:pid format: {}", vidpid);
       return 1;
     }
     uint16_t vid = 0, pid = 0;
@@ -230,6 +235,33 @@ int main(int argc, char *argv[]) {
     settings.drivers.push_back(std::string(driver));
   }
 
+  auto adb_servers = FLAGS_adb_servers
+            | std::views::split(',')
+            | std::views::transform([](auto&& subrange) -> std::string_view {
+                return std::string_view(subrange.begin(), subrange.end());
+            })
+            | std::views::filter([](std::string_view s) {
+                return !s.empty();
+            });
+
+  for (auto server : adb_servers) {
+    settings.adbServers.push_back(std::string(server));
+  }
+
+  settings.adbMdns = FLAGS_adb_mdns;
+  for (auto instance : FLAGS_adb_mdns_instances | std::views::split(',')) {
+    if (!instance.empty()) {
+      settings.adbMdnsInstances.emplace_back(instance.begin(), instance.end());
+    }
+  }
+
+  if (FLAGS_identity_scheme == 1) {
+    settings.identityScheme = device_enumerator::IdentityScheme::ShortHash;
+  } else if (FLAGS_identity_scheme != 2) {
+    DEVICE_WATCH_LOG_ERROR("unknown identity scheme {}", FLAGS_identity_scheme);
+    return 1;
+  }
+
   auto ip_list = FLAGS_ip_list 
             | std::views::split(',')
             | std::views::transform([](auto&& subrange) -> std::string_view {
@@ -239,24 +271,68 @@ int main(int argc, char *argv[]) {
                 return !s.empty();
             })
             | std::views::transform([](std::string_view str) -> std::string {
-              return std::string("connect:") + std::string(str);
+              return std::string(str);
             });
 
+  // declared first so it is flushed after everything below has stopped
+  tracing::TraceFile trace(FLAGS_trace_file);
+  if (FLAGS_trace_file.size() && !trace.started()) {
+    DEVICE_WATCH_LOG_ERROR("cannot open trace file: {}", FLAGS_trace_file);
+    return 1;
+  }
+
+  std::vector<std::string> targets;
   for (auto ip : ip_list) {
-    try {
-      adb_command_query(ip);
-    } catch (const std::exception& e) {
-      // std::cerr << "connect IP failed: " << e.what() << std::endl;
-    }
+    targets.push_back(std::move(ip));
+  }
+
+  // connects in the background and keeps reconnecting dropped targets
+  RemoteTargetKeeper remote_targets(targets);
+  remote_targets.start();
+
+  if (!FLAGS_watch) {
+    // one shot listing, give the network targets a chance to show up
+    remote_targets.waitSettled(std::chrono::seconds(5));
+  }
+
+  device_journal::JournalWriter journal;
+  if (FLAGS_journal_dir.size() && !journal.open(FLAGS_journal_dir)) {
+    DEVICE_WATCH_LOG_ERROR("cannot open journal: {}", FLAGS_journal_dir);
+    return 1;
+  }
+
+#if __linux__
+  // outlive the capture, which feeds them from its thread
+  diag::DiagTap diag_tap;
+  std::optional<diag::DiagFrameLog> diag_log;
+  serial_console::CaptureSettings capture_settings{.logDir = FLAGS_capture_dir, .baudRate = FLAGS_capture_baud};
+  if (FLAGS_capture_dir.size() && FLAGS_capture_diag) {
+    diag_log.emplace(diag_tap, FLAGS_capture_dir);
+    capture_settings.rawSinkFor = [&diag_tap](const DeviceInterface &dev) {
+      return diag_tap.sinkFor(dev);
+    };
   }
 
-  auto watcher = WatchThread::create([](const DeviceInterface &dev) {
+  serial_console::CaptureEngine capture(std::move(capture_settings));
+  if (FLAGS_capture_dir.size() && !capture.start()) {
+    DEVICE_WATCH_LOG_ERROR("cannot start console capture: {}", FLAGS_capture_dir);
+    return 1;
+  }
+#endif
+
+  auto watcher = WatchThread::create([&](const DeviceInterface &dev) {
+    journal.append(dev);
+#if __linux__
+    if (FLAGS_capture_dir.size()) {
+      capture.onDevice(dev);
+    }
+#endif
     auto jdev = deviceNodeToJsonObject(dev);
     std::cout << jdev.dump(FLAGS_pretty ? 4 : -1) << std::endl;
   }, settings);
 
   if (!watcher) {
-    std::cerr << "create watcher failed." << std::endl;
+    DEVICE_WATCH_LOG_ERROR("create watcher failed.");
     return 1;
   }
 
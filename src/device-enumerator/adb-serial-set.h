@@ -0,0 +1,109 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include "adb-client/adb-client.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace device_enumerator {
+
+// serials of one adb server that were turned into devices, reconciled
+// against every list the server pushes in linear time: one hash lookup
+// per listed device, then a sweep of the entries not seen this round.
+class AdbSerialSet {
+public:
+  struct Entry {
+    // decided once at insert, telling remote serials apart takes a regex
+    bool remote{false};
+    int64_t transportId{0};
+    uint64_t round{0};
+  };
+
+  // for each device `listed` accepts:
+  //   onAdded(dev)         not in the set, insert() it to keep it
+  //   onChanged(dev, e)    known serial on a new transport (re-attached between two lists)
+  // then onRemoved(serial, e) for each entry the list no longer has, the entry is erased after
+  template <class Listed, class Added, class Changed, class Removed>
+  void reconcile(const std::vector<adb_client::DeviceInfo> &devs,
+                 Listed &&listed, Added &&onAdded, Changed &&onChanged, Removed &&onRemoved) {
+    round_++;
+
+    for (auto &dev : devs) {
+      if (!listed(dev)) {
+        continue;
+      }
+
+      auto it = entries_.find(dev.serial);
+      if (it == entries_.end()) {
+        onAdded(dev);
+        continue;
+      }
+
+      auto &entry = it->second;
+      entry.round = round_;
+      if (entry.transportId != dev.transportId) {
+        entry.transportId = dev.transportId;
+        onChanged(dev, entry);
+      }
+    }
+
+    std::erase_if(entries_, [this, &onRemoved](auto &item) {
+      if (item.second.round == round_) {
+        return false;
+      }
+      onRemoved(item.first, item.second);
+      return true;
+    });
+  }
+
+  // counts as seen in the current round
+  void insert(const std::string &serial, int64_t transport_id, bool remote) {
+    entries_[serial] = Entry {.remote = remote, .transportId = transport_id, .round = round_};
+  }
+
+  bool erase(const std::string &serial) {
+    return entries_.erase(serial) > 0;
+  }
+
+  bool contains(const std::string &serial) const {
+    return entries_.contains(serial);
+  }
+
+  size_t size() const {
+    return entries_.size();
+  }
+
+  template <class Fn>
+  void forEach(Fn &&fn) const {
+    for (auto &[serial, entry] : entries_) {
+      fn(serial, entry);
+    }
+  }
+
+private:
+  std::unordered_map<std::string, Entry> entries_;
+  uint64_t round_{0};
+};
+
+} // namespace device_enumerator
@@ -0,0 +1,57 @@
+
+namespace device_enumerator {
+
+TEST(AdbSerialSet, Reconcile) {
+  using adb_client::DeviceInfo;
+
+  AdbSerialSet set;
+  std::vector<std::string> added, changed, removed;
+  auto round = [&](const std::vector<DeviceInfo> &devs) {
+    added.clear();
+    changed.clear();
+    removed.clear();
+    set.reconcile(devs,
+      [](const DeviceInfo &d) { return d.state == "device"; },
+      [&](const DeviceInfo &d) {
+        added.push_back(d.serial);
+        // only remote serials are kept, like the enumerator does
+        if (d.serial.find(':') != std::string::npos) {
+          set.insert(d.serial, d.transportId, true);
+        }
+      },
+      [&](const DeviceInfo &d, auto &) { changed.push_back(d.serial); },
+      [&](const std::string &serial, auto &e) {
+        EXPECT_TRUE(e.remote);
+        removed.push_back(serial);
+      });
+  };
+
+  round({{.serial = "10.0.0.1:5555", .state = "device", .transportId = 1},
+         {.serial = "10.0.0.2:5555", .state = "device", .transportId = 2},
+         {.serial = "USB1", .state = "device", .transportId = 3}});
+  EXPECT_EQ(added, (std::vector<std::string>{"10.0.0.1:5555", "10.0.0.2:5555", "USB1"}));
+  EXPECT_EQ(set.size(), 2u);
+
+  // unchanged list, only the serial never kept shows up again
+  round({{.serial = "10.0.0.1:5555", .state = "device", .transportId = 1},
+         {.serial = "10.0.0.2:5555", .state = "device", .transportId = 2},
+         {.serial = "USB1", .state = "device", .transportId = 3}});
+  EXPECT_EQ(added, std::vector<std::string>{"USB1"});
+  EXPECT_TRUE(changed.empty());
+  EXPECT_TRUE(removed.empty());
+
+  // one went offline, the other re-attached between two lists
+  set.insert("USB1", 3, false);
+  round({{.serial = "10.0.0.1:5555", .state = "offline", .transportId = 1},
+         {.serial = "10.0.0.2:5555", .state = "device", .transportId = 7},
+         {.serial = "USB1", .state = "device", .transportId = 3}});
+  EXPECT_TRUE(added.empty());
+  EXPECT_EQ(changed, std::vector<std::string>{"10.0.0.2:5555"});
+  EXPECT_EQ(removed, std::vector<std::string>{"10.0.0.1:5555"});
+  EXPECT_TRUE(set.contains("USB1"));
+
+  EXPECT_TRUE(set.erase("USB1"));
+  EXPECT_FALSE(set.erase("USB1"));
+}
+
+} // namespace device_enumerator
@@ -0,0 +1,321 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "adb-state-index.h"
+#include "adb-tracker.h"
+#include <asio.hpp>
+#include <algorithm>
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#endif
+
+namespace device_enumerator {
+
+using namespace adb_client;
+using asio::awaitable;
+using asio::use_awaitable;
+
+namespace {
+
+// emulators, adb connect (host:port) and mdns (._adb-tls-connect._tcp) serials
+bool isLocalTransport(std::string_view serial) {
+  return serial.starts_with("emulator-") ||
+         serial.find(':') != std::string_view::npos ||
+         serial.find("._adb") != std::string_view::npos;
+}
+
+} // namespace
+
+struct AdbStateIndex::Waiter {
+  std::string server;
+  std::string serial;
+  std::string state;
+  TransportType transportType{TransportType::Any};
+  std::optional<int64_t> transportId;
+
+  asio::steady_timer timer;
+  bool done{false};
+  std::string error;
+
+  explicit Waiter(const asio::any_io_executor &ex) : timer(ex, asio::steady_timer::time_point::max()) {}
+
+  bool accepts(const DeviceInfo &dev) const {
+    if (transportId && dev.transportId != *transportId) {
+      return false;
+    }
+
+    if (transportType == TransportType::Usb && isLocalTransport(dev.serial)) {
+      return false;
+    }
+    if (transportType == TransportType::Local && !isLocalTransport(dev.serial)) {
+      return false;
+    }
+
+    return state == "any" || state == "disconnect" || dev.state == state;
+  }
+};
+
+struct AdbStateIndex::Pending {
+  std::mutex mutex;
+  // set by the index destructor, the waiters it woke do not touch it again
+  bool closed{false};
+  // <serial, waiter>, waits for one device
+  std::unordered_multimap<std::string, std::shared_ptr<Waiter>> bySerial;
+  // waits for any device (or a transport id)
+  std::vector<std::shared_ptr<Waiter>> unbound;
+
+  void remove(const Waiter *w) {
+    if (w->serial.empty()) {
+      std::erase_if(unbound, [w](auto &p) { return p.get() == w; });
+      return;
+    }
+
+    auto [first, last] = bySerial.equal_range(w->serial);
+    for (auto it = first; it != last; ++it) {
+      if (it->second.get() == w) {
+        bySerial.erase(it);
+        return;
+      }
+    }
+  }
+};
+
+AdbStateIndex::AdbStateIndex() : pending_(std::make_shared<Pending>()) {}
+
+AdbStateIndex::~AdbStateIndex() {
+  std::lock_guard lk(pending_->mutex);
+  pending_->closed = true;
+  for (auto &[serial, w] : pending_->bySerial) {
+    wake(w, "adb state index closed");
+  }
+  for (auto &w : pending_->unbound) {
+    wake(w, "adb state index closed");
+  }
+  pending_->bySerial.clear();
+  pending_->unbound.clear();
+}
+
+std::string AdbStateIndex::serverOf(const TransportOption &option) {
+  return AdbTracker::canonicalServer(server_socket_spec(option));
+}
+
+bool AdbStateIndex::satisfied(const Waiter &w, const Devices &devices) {
+  bool gone = w.state == "disconnect";
+
+  if (!w.serial.empty()) {
+    auto it = devices.find(w.serial);
+    bool present = it != devices.end() && w.accepts(it->second);
+    return gone ? !present : present;
+  }
+
+  bool present = std::ranges::any_of(devices, [&w](auto &d) { return w.accepts(d.second); });
+  return gone ? !present : present;
+}
+
+void AdbStateIndex::wake(const std::shared_ptr<Waiter> &w, std::string error) {
+  if (w->done) {
+    return;
+  }
+
+  w->done = true;
+  w->error = std::move(error);
+  asio::post(w->timer.get_executor(), [w] {
+    // expiring (rather than cancelling) also covers a wait not started yet
+    w->timer.expires_at(asio::steady_timer::time_point::min());
+  });
+}
+
+void AdbStateIndex::update(const std::string &server, std::shared_ptr<const std::vector<DeviceInfo>> devices) {
+  std::lock_guard lk(pending_->mutex);
+  auto &bySerial = pending_->bySerial;
+  auto &unbound = pending_->unbound;
+
+  if (!devices) {
+    servers_.erase(server);
+
+    std::erase_if(bySerial, [&server](auto &entry) {
+      if (entry.second->server != server) {
+        return false;
+      }
+      wake(entry.second, "adb server " + server + " lost");
+      return true;
+    });
+
+    std::erase_if(unbound, [&server](auto &w) {
+      if (w->server != server) {
+        return false;
+      }
+      wake(w, "adb server " + server + " lost");
+      return true;
+    });
+    return;
+  }
+
+  auto &known = servers_[server];
+
+  Devices next;
+  next.reserve(devices->size());
+  for (auto &dev : *devices) {
+    next.emplace(dev.serial, dev);
+  }
+
+  // serials that appeared, went away or changed state
+  std::vector<std::string_view> changed;
+  for (auto &[serial, dev] : next) {
+    auto it = known.find(serial);
+    if (it == known.end() || it->second.state != dev.state || it->second.transportId != dev.transportId) {
+      changed.push_back(serial);
+    }
+  }
+  for (auto &[serial, dev] : known) {
+    if (!next.contains(serial)) {
+      changed.push_back(serial);
+    }
+  }
+
+  // `changed` also views into the old list, it lives until the end
+  known.swap(next);
+
+  for (auto serial : changed) {
+    auto [first, last] = bySerial.equal_range(std::string(serial));
+    for (auto it = first; it != last;) {
+      auto &w = it->second;
+      if (w->server == server && satisfied(*w, known)) {
+        wake(w);
+        it = bySerial.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  if (!changed.empty()) {
+    std::erase_if(unbound, [&server, &known](auto &w) {
+      if (w->server != server || !satisfied(*w, known)) {
+        return false;
+      }
+      wake(w);
+      return true;
+    });
+  }
+}
+
+std::string AdbStateIndex::state(std::string_view server, std::string_view serial) const {
+  std::lock_guard lk(pending_->mutex);
+
+  auto it = servers_.find(std::string(server));
+  if (it == servers_.end()) {
+    return {};
+  }
+
+  auto dev = it->second.find(std::string(serial));
+  return dev != it->second.end() ? dev->second.state : std::string();
+}
+
+size_t AdbStateIndex::waiters() const {
+  std::lock_guard lk(pending_->mutex);
+  return pending_->bySerial.size() + pending_->unbound.size();
+}
+
+bool AdbStateIndex::covers(const TransportOption &option) const {
+  auto server = serverOf(option);
+  if (server.empty()) {
+    return false;
+  }
+
+  std::lock_guard lk(pending_->mutex);
+  return servers_.contains(server);
+}
+
+awaitable<void>
+AdbStateIndex::co_wait(std::string_view state, TransportOption option, std::optional<std::chrono::milliseconds> timeout) {
+  auto w = std::make_shared<Waiter>(co_await asio::this_coro::executor);
+  w->server = serverOf(option);
+  w->serial = option.serial;
+  w->state = state;
+  w->transportType = option.transportType;
+  w->transportId = option.transportId;
+
+  // the index may be gone once the wait resumes, past this point only
+  // the shared part is used
+  auto pending = pending_;
+
+  {
+    std::lock_guard lk(pending->mutex);
+
+    auto it = servers_.find(w->server);
+    if (it == servers_.end()) {
+      throw adb_error("adb server " + w->server + " not tracked");
+    }
+
+    if (satisfied(*w, it->second)) {
+      co_return;
+    }
+
+    if (w->serial.empty()) {
+      pending->unbound.push_back(w);
+    } else {
+      pending->bySerial.emplace(w->serial, w);
+    }
+
+    if (timeout) {
+      w->timer.expires_after(*timeout);
+    }
+  }
+
+  // a wait abandoned with its coroutine leaves the index too
+  struct Registration {
+    Pending *pending;
+    Waiter *w;
+    ~Registration() {
+      std::lock_guard lk(pending->mutex);
+      if (!w->done && !pending->closed) {
+        w->done = true;
+        pending->remove(w);
+      }
+    }
+  };
+
+  std::string error;
+  {
+    Registration reg{pending.get(), w.get()};
+
+    asio::error_code ec;
+    co_await w->timer.async_wait(asio::redirect_error(use_awaitable, ec));
+
+    std::lock_guard lk(pending->mutex);
+    if (!w->done) {
+      error = "command timeout";
+    } else {
+      error = w->error;
+    }
+  }
+
+  if (!error.empty()) {
+    throw adb_error(error);
+  }
+}
+
+} // namespace device_enumerator
+
+#ifdef ENABLE_TEST
+#include "adb-state-index_tests.cc"
+#endif
@@ -0,0 +1,84 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include "adb-client/co-adb-client.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace device_enumerator {
+
+// device states of the tracked adb servers and the coroutines waiting on them.
+//
+// update() takes every list AdbTracker receives and diffs it against the
+// previous one; only the waiters of serials whose state changed (and those
+// not bound to a serial) are looked at. a wait holds no server connection
+// and resumes as soon as the list satisfying it arrives.
+// waiting coroutines must run on a single threaded executor or a strand.
+// the index may be destroyed while waits are pending, they fail with
+// adb_error once resumed.
+class AdbStateIndex : public adb_client::DeviceStateSource {
+public:
+  AdbStateIndex();
+  ~AdbStateIndex() override;
+
+  AdbStateIndex(const AdbStateIndex &) = delete;
+  AdbStateIndex& operator=(const AdbStateIndex &) = delete;
+
+  // latest list of server (canonical "host:port"), null when the server went away.
+  // waiters of a server that went away fail with adb_error.
+  void update(const std::string &server, std::shared_ptr<const std::vector<adb_client::DeviceInfo>> devices);
+
+  // state of serial on server, empty when it is not listed
+  std::string state(std::string_view server, std::string_view serial) const;
+
+  // pending waits
+  size_t waiters() const;
+
+  bool covers(const adb_client::TransportOption &option) const override;
+
+  // state is one of the wait-for states: device, recovery, rescue, sideload,
+  // bootloader, any (listed in any state) or disconnect (not listed)
+  asio::awaitable<void>
+  co_wait(std::string_view state, adb_client::TransportOption option, std::optional<std::chrono::milliseconds> timeout) override;
+
+private:
+  struct Waiter;
+  struct Pending;
+
+  // <serial, device>
+  using Devices = std::unordered_map<std::string, adb_client::DeviceInfo>;
+
+  static std::string serverOf(const adb_client::TransportOption &option);
+  static bool satisfied(const Waiter &w, const Devices &devices);
+  static void wake(const std::shared_ptr<Waiter> &w, std::string error = {});
+
+  // the waiters and the mutex guarding them and servers_,
+  // shared with every pending wait
+  std::shared_ptr<Pending> pending_;
+  // <server, devices>
+  std::unordered_map<std::string, Devices> servers_;
+};
+
+} // namespace device_enumerator
@@ -0,0 +1,102 @@
+#include <thread>
+
+namespace device_enumerator {
+
+namespace {
+
+std::shared_ptr<const std::vector<DeviceInfo>> devices(std::initializer_list<std::pair<const char *, const char *>> list) {
+  auto out = std::make_shared<std::vector<DeviceInfo>>();
+  int64_t id = 1;
+  for (auto &[serial, state] : list) {
+    out->push_back({.serial = serial, .state = state, .transportId = id++});
+  }
+  return out;
+}
+
+// run a wait to completion, returns the adb_error text or "" on success
+std::string wait_for(std::string_view state, TransportOption option, std::chrono::milliseconds timeout) {
+  asio::io_context ctx;
+  std::string error;
+  std::optional<std::chrono::milliseconds> limit = timeout;
+  co_spawn(ctx, [&]() -> awaitable<void> {
+    try {
+      co_await co_wait_device(state, option, limit);
+    } catch (adb_error &e) {
+      error = e.what();
+    }
+  }, asio::detached);
+  ctx.run();
+  return error;
+}
+
+} // namespace
+
+TEST(AdbStateIndex, WaitsWithoutServer) {
+  AdbStateIndex index;
+  auto server = AdbTracker::canonicalServer({});
+
+  // not tracked yet, waits go to the server
+  EXPECT_FALSE(index.covers({.stateSource = &index}));
+
+  index.update(server, devices({{"A", "offline"}, {"192.168.1.7:5555", "device"}}));
+  EXPECT_TRUE(index.covers({}));
+  EXPECT_TRUE(index.covers({.server = "tcp:localhost", .port = "5037"}));
+  EXPECT_FALSE(index.covers({.server = "other-host"}));
+  EXPECT_FALSE(index.covers({.server = "localabstract:adb"}));
+  EXPECT_EQ(index.state(server, "A"), "offline");
+
+  // already satisfied
+  EXPECT_EQ(wait_for("device", {.serial = "192.168.1.7:5555", .stateSource = &index}, std::chrono::milliseconds(10)), "");
+  EXPECT_EQ(wait_for("any", {.serial = "A", .stateSource = &index}, std::chrono::milliseconds(10)), "");
+  EXPECT_EQ(wait_for("device", {.transportType = TransportType::Local, .stateSource = &index}, std::chrono::milliseconds(10)), "");
+
+  EXPECT_EQ(wait_for("device", {.serial = "A", .stateSource = &index}, std::chrono::milliseconds(20)), "command timeout");
+  EXPECT_EQ(wait_for("device", {.transportType = TransportType::Usb, .stateSource = &index}, std::chrono::milliseconds(20)), "command timeout");
+  EXPECT_EQ(index.waiters(), 0u);
+
+  // woken by the list that satisfies it
+  std::thread feeder([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    index.update(server, devices({{"A", "recovery"}}));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    index.update(server, devices({{"A", "device"}}));
+  });
+  EXPECT_EQ(wait_for("device", {.serial = "A", .stateSource = &index}, std::chrono::seconds(5)), "");
+  feeder.join();
+
+  feeder = std::thread([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    index.update(server, devices({}));
+  });
+  EXPECT_EQ(wait_for("disconnect", {.serial = "A", .stateSource = &index}, std::chrono::seconds(5)), "");
+  feeder.join();
+
+  feeder = std::thread([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    index.update(server, nullptr);
+  });
+  auto error = wait_for("device", {.serial = "B", .stateSource = &index}, std::chrono::seconds(5));
+  EXPECT_NE(error.find("lost"), std::string::npos) << error;
+  feeder.join();
+
+  EXPECT_EQ(index.waiters(), 0u);
+  EXPECT_FALSE(index.covers({}));
+}
+
+TEST(AdbStateIndex, DestroyedWhileWaiting) {
+  auto index = std::make_unique<AdbStateIndex>();
+  index->update(AdbTracker::canonicalServer({}), devices({}));
+  auto *source = index.get();
+
+  std::thread closer([&] {
+    while (index->waiters() == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    index.reset();
+  });
+  auto error = wait_for("device", {.serial = "A", .stateSource = source}, std::chrono::seconds(5));
+  closer.join();
+  EXPECT_NE(error.find("closed"), std::string::npos) << error;
+}
+
+} // namespace device_enumerator
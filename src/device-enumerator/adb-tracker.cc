@@ -0,0 +1,469 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "adb-tracker.h"
+#include "adb-client/co-adb-client.h"
+#include "adb-client/co-parallel.h"
+#include <asio.hpp>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <unordered_set>
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#include "bench/fake-adb-server.h"
+#endif
+
+namespace device_enumerator {
+
+using namespace adb_client;
+using asio::awaitable;
+using asio::use_awaitable;
+
+namespace {
+
+constexpr auto kRetryMin = std::chrono::milliseconds(500);
+constexpr auto kRetryMax = std::chrono::milliseconds(30000);
+
+// paired devices, pairing services need a code and are left to the user
+constexpr std::string_view kMdnsConnect = "_adb-tls-connect._tcp";
+
+bool isLocalHost(std::string_view host) {
+  return host == "localhost" || host == "127.0.0.1" || host == "::1";
+}
+
+bool isUnixSocket(std::string_view spec) {
+  return spec.starts_with("localfilesystem:") || spec.starts_with("localabstract:");
+}
+
+struct Server {
+  std::string name;
+  // TransportOption::server, tcp names get their prefix back
+  std::string spec;
+  bool local{false};
+  bool removed{false};
+  // tells a server re-added under the same name from the one it replaced
+  uint64_t generation{0};
+  asio::steady_timer retry;
+  std::optional<AdbSocket> socket;
+
+  // last host:mdns:services reply and the matching services in it
+  asio::steady_timer mdnsPoll;
+  std::string mdnsText;
+  std::vector<AdbTracker::MdnsDevice> mdns;
+
+  Server(const asio::any_io_executor &ex, std::string canonical) : name(std::move(canonical)), retry(ex), mdnsPoll(ex) {
+    if (isUnixSocket(name)) {
+      spec = name;
+      local = true;
+    } else {
+      spec = "tcp:" + name;
+      local = isLocalHost(std::string_view(name).substr(0, name.rfind(':')));
+    }
+  }
+
+  void close() noexcept {
+    removed = true;
+    retry.cancel();
+    mdnsPoll.cancel();
+    if (socket) {
+      asio::error_code ec;
+      socket->close(ec);
+    }
+  }
+};
+
+} // namespace
+
+struct AdbTracker::Impl {
+  ChangeCallback callback;
+  MdnsSettings mdnsSettings;
+
+  asio::io_context ctx;
+  asio::executor_work_guard<asio::io_context::executor_type> work{ctx.get_executor()};
+  std::thread thread;
+
+  // io thread only
+  std::map<std::string, std::shared_ptr<Server>> servers;
+  uint64_t generation{0};
+
+  mutable std::mutex mutex;
+  std::set<std::string> names;
+  std::map<std::string, ServerDevices, std::less<>> lists;
+  std::map<std::string, std::vector<MdnsDevice>, std::less<>> mdns;
+  // <name, generation of the server whose lists are published>
+  std::map<std::string, uint64_t, std::less<>> owners;
+
+  explicit Impl(ChangeCallback &&cb) : callback(std::move(cb)) {}
+
+  // a removed server's coroutines may finish after a server of the
+  // same name was added again, they must not touch its lists
+  bool owns(const Server &server) const {
+    auto it = owners.find(server.name);
+    return it != owners.end() && it->second == server.generation;
+  }
+
+  void publish(const Server &server, std::shared_ptr<const std::vector<DeviceInfo>> devices) {
+    {
+      std::lock_guard lk(mutex);
+      if (!owns(server)) {
+        return;
+      }
+      if (devices) {
+        lists[server.name] = ServerDevices {
+          .server = server.name,
+          .local = server.local,
+          .devices = std::move(devices),
+        };
+      } else if (!lists.erase(server.name)) {
+        return;
+      }
+    }
+
+    if (callback) {
+      callback(server.name);
+    }
+  }
+
+  awaitable<void> track(std::shared_ptr<Server> server) {
+    auto backoff = kRetryMin;
+
+    while (!server->removed) {
+      try {
+        server->socket.emplace(co_await co_track_devices({
+          .server = server->spec,
+          .launchServerIfNeed = isDefaultServer(server->name),
+        }));
+
+        while (!server->removed) {
+          auto devices = co_await co_next_devices(*server->socket, false);
+          publish(*server, std::make_shared<const std::vector<DeviceInfo>>(std::move(devices)));
+          backoff = kRetryMin;
+        }
+      } catch (std::exception &) {
+        // server not running or connection lost
+      }
+
+      server->socket.reset();
+      publish(*server, nullptr);
+
+      if (server->removed) {
+        break;
+      }
+
+      asio::error_code ec;
+      server->retry.expires_after(backoff);
+      co_await server->retry.async_wait(asio::redirect_error(use_awaitable, ec));
+      backoff = std::min<std::chrono::milliseconds>(backoff * 2, kRetryMax);
+    }
+  }
+
+  TransportOption option(const Server &server) const {
+    return {
+      .server = server.spec,
+      .launchServerIfNeed = false,
+    };
+  }
+
+  bool matchesInstance(std::string_view instance) const {
+    return mdnsSettings.instances.empty() ||
+           std::ranges::any_of(mdnsSettings.instances, [instance](auto &prefix) {
+             return instance.starts_with(prefix);
+           });
+  }
+
+  void publishMdns(const Server &server) {
+    std::lock_guard lk(mutex);
+    if (!owns(server)) {
+      return;
+    }
+    if (server.mdns.empty()) {
+      mdns.erase(server.name);
+    } else {
+      mdns[server.name] = server.mdns;
+    }
+  }
+
+  awaitable<bool> connect(const Server &server, const std::string &address) {
+    try {
+      // co_query keeps launchServerIfNeed, a remote server being down must not start a local one
+      auto service = "host:connect:" + address;
+      auto reply = co_await co_query(service, option(server));
+      co_return is_connect_success(reply);
+    } catch (std::exception &) {
+      co_return false;
+    }
+  }
+
+  // a connected service the server no longer lists has dropped, connect it again
+  void markDropped(Server &server) {
+    std::shared_ptr<const std::vector<DeviceInfo>> devices;
+    {
+      std::lock_guard lk(mutex);
+      if (auto it = lists.find(server.name); it != lists.end()) {
+        devices = it->second.devices;
+      }
+    }
+
+    std::unordered_set<std::string_view> serials;
+    if (devices) {
+      for (auto &dev : *devices) {
+        serials.insert(dev.serial);
+      }
+    }
+
+    for (auto &d : server.mdns) {
+      if (d.connected && !serials.contains(d.service.address) &&
+          !serials.contains(d.service.instance + "." + std::string(kMdnsConnect))) {
+        d.connected = false;
+      }
+    }
+  }
+
+  awaitable<void> discover(std::shared_ptr<Server> server) {
+    while (!server->removed) {
+      std::string text;
+      try {
+        text = co_await co_query("host:mdns:services", option(*server));
+      } catch (std::exception &) {
+        // server down, its services go with it
+      }
+
+      if (server->removed) {
+        break;
+      }
+
+      if (text != server->mdnsText) {
+        std::vector<MdnsDevice> found;
+        for (auto &service : parse_mdns_services(text)) {
+          if (service.type != kMdnsConnect || !matchesInstance(service.instance)) {
+            continue;
+          }
+
+          auto known = std::ranges::find_if(server->mdns, [&service](auto &d) {
+            return d.service.address == service.address;
+          });
+          bool connected = known != server->mdns.end() && known->connected;
+          found.push_back({.server = server->name, .service = std::move(service), .connected = connected});
+        }
+
+        server->mdnsText = std::move(text);
+        server->mdns = std::move(found);
+        publishMdns(*server);
+      }
+
+      if (std::ranges::any_of(server->mdns, [](auto &d) { return d.connected; })) {
+        markDropped(*server);
+      }
+
+      std::vector<size_t> pending;
+      for (size_t i = 0; i < server->mdns.size(); i++) {
+        if (!server->mdns[i].connected) {
+          pending.push_back(i);
+        }
+      }
+
+      // failures stay pending and are tried again next round
+      if (!pending.empty()) {
+        co_await co_for_each_bounded(pending.size(), mdnsSettings.connectConcurrency,
+          [this, &server, &pending](size_t i) -> awaitable<void> {
+            auto &d = server->mdns[pending[i]];
+            d.connected = co_await connect(*server, d.service.address);
+          });
+        publishMdns(*server);
+      }
+
+      asio::error_code ec;
+      server->mdnsPoll.expires_after(mdnsSettings.pollInterval);
+      co_await server->mdnsPoll.async_wait(asio::redirect_error(use_awaitable, ec));
+    }
+
+    server->mdns.clear();
+    publishMdns(*server);
+  }
+
+  void add(const std::string &name) {
+    auto server = std::make_shared<Server>(ctx.get_executor(), name);
+    server->generation = ++generation;
+    servers[name] = server;
+
+    // whatever the replaced server left behind goes now
+    bool dropped;
+    {
+      std::lock_guard lk(mutex);
+      owners[name] = server->generation;
+      dropped = lists.erase(name) > 0;
+      mdns.erase(name);
+    }
+    if (dropped && callback) {
+      callback(name);
+    }
+
+    co_spawn(ctx, track(server), asio::detached);
+    if (mdnsSettings.enabled) {
+      co_spawn(ctx, discover(std::move(server)), asio::detached);
+    }
+  }
+
+  void remove(const std::string &name) {
+    auto it = servers.find(name);
+    if (it != servers.end()) {
+      it->second->close();
+      servers.erase(it);
+    }
+  }
+};
+
+AdbTracker::AdbTracker(ChangeCallback callback) : impl_(std::make_unique<Impl>(std::move(callback))) {}
+
+AdbTracker::~AdbTracker() {
+  stop();
+}
+
+void AdbTracker::setMdns(MdnsSettings settings) {
+  impl_->mdnsSettings = std::move(settings);
+}
+
+bool AdbTracker::isMdnsSerial(std::string_view serial) {
+  return serial.ends_with(kMdnsConnect) && serial.size() > kMdnsConnect.size() &&
+         serial[serial.size() - kMdnsConnect.size() - 1] == '.';
+}
+
+std::string AdbTracker::canonicalServer(std::string_view spec) {
+  // parsed the way the client connects, tcp servers keep their host:port name
+  auto canonical = server_socket_spec({.server = spec});
+  if (canonical.starts_with("tcp:")) {
+    canonical.erase(0, 4);
+  }
+  return canonical;
+}
+
+bool AdbTracker::isDefaultServer(std::string_view canonical) {
+  return canonical == canonicalServer({});
+}
+
+void AdbTracker::start(const std::vector<std::string> &servers) {
+  if (impl_->thread.joinable()) {
+    return;
+  }
+
+  if (servers.empty()) {
+    addServer({});
+  } else {
+    for (auto &server : servers) {
+      addServer(server);
+    }
+  }
+
+  impl_->thread = std::thread([this] {
+    impl_->ctx.run();
+  });
+}
+
+void AdbTracker::stop() noexcept {
+  impl_->ctx.stop();
+  if (impl_->thread.joinable()) {
+    impl_->thread.join();
+  }
+}
+
+bool AdbTracker::addServer(std::string_view spec) {
+  auto name = canonicalServer(spec);
+  {
+    std::lock_guard lk(impl_->mutex);
+    if (!impl_->names.insert(name).second) {
+      return false;
+    }
+  }
+
+  asio::post(impl_->ctx, [impl = impl_.get(), name] {
+    impl->add(name);
+  });
+  return true;
+}
+
+bool AdbTracker::removeServer(std::string_view spec) {
+  auto name = canonicalServer(spec);
+  {
+    std::lock_guard lk(impl_->mutex);
+    if (!impl_->names.erase(name)) {
+      return false;
+    }
+  }
+
+  asio::post(impl_->ctx, [impl = impl_.get(), name] {
+    impl->remove(name);
+  });
+  return true;
+}
+
+std::vector<AdbTracker::ServerDevices> AdbTracker::snapshot() const {
+  std::vector<ServerDevices> out;
+
+  std::lock_guard lk(impl_->mutex);
+  out.reserve(impl_->lists.size());
+  for (auto &[name, list] : impl_->lists) {
+    out.push_back(list);
+  }
+  return out;
+}
+
+std::shared_ptr<const std::vector<DeviceInfo>> AdbTracker::devices(std::string_view server) const {
+  std::lock_guard lk(impl_->mutex);
+  auto it = impl_->lists.find(server);
+  return it != impl_->lists.end() ? it->second.devices : nullptr;
+}
+
+std::vector<AdbTracker::MdnsDevice> AdbTracker::mdnsDevices() const {
+  std::vector<MdnsDevice> out;
+
+  std::lock_guard lk(impl_->mutex);
+  for (auto &[name, list] : impl_->mdns) {
+    out.insert(out.end(), list.begin(), list.end());
+  }
+  return out;
+}
+
+std::string AdbTracker::mdnsAddress(std::string_view server, std::string_view serial) const {
+  if (!isMdnsSerial(serial)) {
+    return {};
+  }
+  auto instance = serial.substr(0, serial.size() - kMdnsConnect.size() - 1);
+
+  std::lock_guard lk(impl_->mutex);
+  auto it = impl_->mdns.find(server);
+  if (it == impl_->mdns.end()) {
+    return {};
+  }
+
+  for (auto &d : it->second) {
+    if (d.service.instance == instance) {
+      return d.service.address;
+    }
+  }
+  return {};
+}
+
+} // namespace device_enumerator
+
+#ifdef ENABLE_TEST
+#include "adb-tracker_tests.cc"
+#endif
@@ -0,0 +1,113 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include "adb-client/adb-client.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace device_enumerator {
+
+// follows the device lists of any number of adb servers.
+//
+// every server is tracked over its own host:track-devices-l push stream,
+// all of them on one io thread. a server that goes away drops its
+// devices and is reconnected with backoff.
+// lists carry devices in every state (offline, unauthorized, recovery ...).
+//
+// with mdns enabled every server is also polled for the wireless debugging
+// services it discovered (host:mdns:services); matching services are
+// connected concurrently and then show up in the server's list like any
+// other network device. an unchanged service list is not parsed again.
+class AdbTracker {
+public:
+  struct ServerDevices {
+    std::string server; // canonical "host:port"
+    bool local{false};  // runs on this machine, may own our usb devices
+    std::shared_ptr<const std::vector<adb_client::DeviceInfo>> devices;
+  };
+
+  struct MdnsSettings {
+    bool enabled{false};
+    std::chrono::milliseconds pollInterval{3000};
+    // connect services whose instance name starts with one of these, empty means all
+    std::vector<std::string> instances;
+    size_t connectConcurrency{8};
+  };
+
+  // an advertised _adb-tls-connect service
+  struct MdnsDevice {
+    std::string server;
+    adb_client::MdnsService service;
+    bool connected{false};
+  };
+
+  // invoked on the tracker thread whenever a server's device list
+  // changed, appeared or went away
+  using ChangeCallback = std::function<void(const std::string &server)>;
+
+  explicit AdbTracker(ChangeCallback callback);
+  ~AdbTracker();
+
+  AdbTracker(const AdbTracker &) = delete;
+  AdbTracker& operator=(const AdbTracker &) = delete;
+
+  // "host:port", "port", "host" or a socket spec (tcp:, localfilesystem:,
+  // localabstract:), empty means ADB_SERVER_SOCKET or the default server.
+  // tcp servers are named "host:port", the others keep their spec.
+  static std::string canonicalServer(std::string_view spec);
+  static bool isDefaultServer(std::string_view canonical);
+
+  // before start
+  void setMdns(MdnsSettings settings);
+
+  void start(const std::vector<std::string> &servers);
+  void stop() noexcept;
+
+  bool addServer(std::string_view spec);
+  bool removeServer(std::string_view spec);
+
+  // latest list of every server currently connected, ordered by server
+  std::vector<ServerDevices> snapshot() const;
+
+  // latest list of one server, null while it is not connected
+  std::shared_ptr<const std::vector<adb_client::DeviceInfo>> devices(std::string_view server) const;
+
+  // matching services of every server, in server order
+  std::vector<MdnsDevice> mdnsDevices() const;
+
+  // "ip:port" of a device the server lists by its mdns name
+  // (<instance>._adb-tls-connect._tcp), empty when not advertised
+  std::string mdnsAddress(std::string_view server, std::string_view serial) const;
+
+  static bool isMdnsSerial(std::string_view serial);
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+} // namespace device_enumerator
@@ -0,0 +1,122 @@
+#include <condition_variable>
+#include <thread>
+#include <unistd.h>
+
+namespace device_enumerator {
+
+TEST(AdbTracker, MdnsServices) {
+  auto services = parse_mdns_services(
+    "adb-R5CT1234-aBcDeF\t_adb-tls-connect._tcp.\t192.168.1.7:37915\n"
+    "adb-R5CT1234-aBcDeF\t_adb-tls-pairing._tcp\t192.168.1.7:41023\n"
+    "broken line\n"
+    "adb-2A1\t_adb-tls-connect._tcp\t10.0.0.3:5555\r\n");
+
+  ASSERT_EQ(services.size(), 3u);
+  EXPECT_EQ(services[0].instance, "adb-R5CT1234-aBcDeF");
+  EXPECT_EQ(services[0].type, "_adb-tls-connect._tcp");
+  EXPECT_EQ(services[0].address, "192.168.1.7:37915");
+  EXPECT_EQ(services[1].type, "_adb-tls-pairing._tcp");
+  EXPECT_EQ(services[2].address, "10.0.0.3:5555");
+
+  EXPECT_TRUE(AdbTracker::isMdnsSerial("adb-R5CT1234-aBcDeF._adb-tls-connect._tcp"));
+  EXPECT_FALSE(AdbTracker::isMdnsSerial("_adb-tls-connect._tcp"));
+  EXPECT_FALSE(AdbTracker::isMdnsSerial("192.168.1.7:37915"));
+}
+
+TEST(AdbTracker, ServerSpec) {
+  EXPECT_EQ(AdbTracker::canonicalServer("5038"), "localhost:5038");
+  EXPECT_EQ(AdbTracker::canonicalServer("10.0.0.2"), "10.0.0.2:5037");
+  EXPECT_EQ(AdbTracker::canonicalServer("10.0.0.2:5038"), "10.0.0.2:5038");
+  EXPECT_EQ(AdbTracker::canonicalServer("tcp:5038"), "localhost:5038");
+  EXPECT_EQ(AdbTracker::canonicalServer("tcp:10.0.0.2:5038"), "10.0.0.2:5038");
+  EXPECT_EQ(AdbTracker::canonicalServer("tcp:::1:5038"), "::1:5038");
+  EXPECT_EQ(AdbTracker::canonicalServer("localfilesystem:/tmp/adb:1.sock"), "localfilesystem:/tmp/adb:1.sock");
+  EXPECT_EQ(AdbTracker::canonicalServer("localabstract:adb"), "localabstract:adb");
+
+  // canonical names parse back to themselves
+  for (auto name : {"localhost:5038", "10.0.0.2:5037", "localfilesystem:/tmp/adb.sock"}) {
+    EXPECT_EQ(AdbTracker::canonicalServer(name), name);
+  }
+
+  EXPECT_EQ(server_socket_spec({.server = "10.0.0.2", .port = "5038"}), "tcp:10.0.0.2:5038");
+  EXPECT_EQ(server_socket_spec({.server = "::1"}), "tcp:::1:5037");
+  EXPECT_EQ(server_socket_spec({.port = "5038"}), "tcp:localhost:5038");
+  EXPECT_EQ(server_socket_spec({.server = "tcp:10.0.0.2", .port = "5038"}), "tcp:10.0.0.2:5038");
+}
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+TEST(AdbTracker, TracksUnixSocketServer) {
+  asio::io_context ctx;
+  auto guard = asio::make_work_guard(ctx);
+  adb_bench::FakeAdbServer fake(ctx.get_executor());
+  auto path = (std::filesystem::temp_directory_path() / std::format("adb-tracker-{}.sock", getpid())).string();
+  auto spec = fake.listenUnix(path);
+  fake.setDevices("emulator-5554\tdevice product:p model:m device:d transport_id:1\n");
+  std::thread io([&ctx] { ctx.run(); });
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  AdbTracker tracker([&](const std::string &) { changed.notify_all(); });
+  tracker.start({spec});
+
+  {
+    std::unique_lock lk(mutex);
+    changed.wait_for(lk, std::chrono::seconds(5), [&] { return tracker.devices(spec) != nullptr; });
+  }
+  auto devices = tracker.devices(spec);
+  ASSERT_TRUE(devices);
+  ASSERT_EQ(devices->size(), 1u);
+  EXPECT_EQ(devices->front().serial, "emulator-5554");
+
+  auto snapshot = tracker.snapshot();
+  ASSERT_EQ(snapshot.size(), 1u);
+  EXPECT_EQ(snapshot[0].server, spec);
+  EXPECT_TRUE(snapshot[0].local);
+
+  tracker.stop();
+  fake.close();
+  guard.reset();
+  io.join();
+  std::filesystem::remove(path);
+}
+
+TEST(AdbTracker, ReaddedServerKeepsItsList) {
+  asio::io_context ctx;
+  auto guard = asio::make_work_guard(ctx);
+  adb_bench::FakeAdbServer fake(ctx.get_executor());
+  auto path = (std::filesystem::temp_directory_path() / std::format("adb-tracker-readd-{}.sock", getpid())).string();
+  auto spec = fake.listenUnix(path);
+  fake.setDevices("emulator-5554\tdevice product:p model:m device:d transport_id:1\n");
+  std::thread io([&ctx] { ctx.run(); });
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  AdbTracker tracker([&](const std::string &) { changed.notify_all(); });
+  tracker.start({spec});
+
+  auto listed = [&] {
+    std::unique_lock lk(mutex);
+    return changed.wait_for(lk, std::chrono::seconds(5), [&] { return tracker.devices(spec) != nullptr; });
+  };
+  ASSERT_TRUE(listed());
+
+  // the removed servers finish while their successor already tracks
+  for (int i = 0; i < 20; i++) {
+    EXPECT_TRUE(tracker.removeServer(spec));
+    EXPECT_TRUE(tracker.addServer(spec));
+  }
+  ASSERT_TRUE(listed());
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  EXPECT_TRUE(tracker.devices(spec));
+  EXPECT_EQ(tracker.snapshot().size(), 1u);
+
+  tracker.stop();
+  fake.close();
+  guard.reset();
+  io.join();
+  std::filesystem::remove(path);
+}
+#endif
+
+} // namespace device_enumerator
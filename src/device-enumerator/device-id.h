@@ -0,0 +1,236 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include "shorthash.h"
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#if defined(_MSC_VER) && defined(_M_X64) && !defined(__SIZEOF_INT128__)
+#include <intrin.h>
+#endif
+
+namespace device_enumerator {
+
+// which hash turned an interface key into its identity. ids outlive the
+// process (scripts, journals), so a released scheme never changes.
+enum class IdentityScheme : uint8_t {
+  // shorthash.h, the ids of releases before schemes were versioned
+  ShortHash = 1,
+  // multiply fold hash, ids carry the version in their top 4 bits
+  Fold = 2,
+};
+
+// identity of one device interface: an integer inside, 16 hex digits
+// only where it leaves the process (json, journal, traces)
+class DeviceId {
+public:
+  constexpr DeviceId() = default;
+  constexpr explicit DeviceId(uint64_t value) : value_(value) {}
+
+  constexpr uint64_t value() const { return value_; }
+  constexpr bool empty() const { return value_ == 0; }
+
+  // the scheme of a Fold id, 0 for a ShortHash one (any top digit)
+  constexpr unsigned version() const {
+    return unsigned(value_ >> 60) == unsigned(IdentityScheme::Fold) ? unsigned(IdentityScheme::Fold) : 0;
+  }
+
+  // the 16 digits into out, no allocation
+  std::string_view to_chars(char (&out)[16]) const {
+    constexpr char kHex[] = "0123456789abcdef";
+    for (int i = 15, shift = 0; i >= 0; i--, shift += 4) {
+      out[i] = kHex[(value_ >> shift) & 0xf];
+    }
+    return {out, 16};
+  }
+
+  std::string to_string() const {
+    char out[16];
+    return std::string(to_chars(out));
+  }
+
+  // up to 16 hex digits, either case
+  static constexpr std::optional<DeviceId> parse(std::string_view s) {
+    if (s.empty() || s.size() > 16) {
+      return std::nullopt;
+    }
+
+    uint64_t value = 0;
+    for (char c : s) {
+      int digit = c >= '0' && c <= '9' ? c - '0'
+                : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                : -1;
+      if (digit < 0) {
+        return std::nullopt;
+      }
+      value = value << 4 | uint64_t(digit);
+    }
+    return DeviceId(value);
+  }
+
+  friend constexpr bool operator==(DeviceId, DeviceId) = default;
+  friend constexpr auto operator<=>(DeviceId, DeviceId) = default;
+
+private:
+  uint64_t value_{0};
+};
+
+namespace idhash {
+
+constexpr uint64_t kSecret[4] = {
+  0x2d358dccaa6c78a5, 0x8bb84b93962eacc9, 0x4b33a62ed433d4a3, 0x4d5a2da51de1aa47,
+};
+
+// 64x64 -> 128 multiply, low half in a, high half in b
+constexpr void mum(uint64_t &a, uint64_t &b) {
+#if defined(__SIZEOF_INT128__)
+  __extension__ unsigned __int128 r = a;
+  r *= b;
+  a = uint64_t(r);
+  b = uint64_t(r >> 64);
+#else
+#if defined(_MSC_VER) && defined(_M_X64)
+  if (!std::is_constant_evaluated()) {
+    a = _umul128(a, b, &b);
+    return;
+  }
+#endif
+  uint64_t ha = a >> 32, hb = b >> 32, la = uint32_t(a), lb = uint32_t(b);
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32);
+  uint64_t carry = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  carry += lo < t;
+  a = lo;
+  b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
+
+constexpr uint64_t mix(uint64_t a, uint64_t b) {
+  mum(a, b);
+  return a ^ b;
+}
+
+// little endian loads with no alignment needs, plain memcpy at run time
+constexpr uint64_t read64(const char *p) {
+  if (std::is_constant_evaluated() || std::endian::native != std::endian::little) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+      v |= uint64_t(uint8_t(p[i])) << (i * 8);
+    }
+    return v;
+  }
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+constexpr uint64_t read32(const char *p) {
+  if (std::is_constant_evaluated() || std::endian::native != std::endian::little) {
+    uint64_t v = 0;
+    for (int i = 0; i < 4; i++) {
+      v |= uint64_t(uint8_t(p[i])) << (i * 8);
+    }
+    return v;
+  }
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// 1..3 bytes
+constexpr uint64_t read_small(const char *p, size_t n) {
+  return uint64_t(uint8_t(p[0])) << 16 | uint64_t(uint8_t(p[n >> 1])) << 8 | uint8_t(p[n - 1]);
+}
+
+// one multiply fold per 16 bytes (three independent lanes past 48 bytes,
+// so the multipliers overlap), two more to finish. interface keys are
+// 10..150 bytes, too short for vector loads to pay for their setup.
+constexpr uint64_t fold64(std::string_view key, uint64_t seed = 0) {
+  const char *p = key.data();
+  size_t len = key.size();
+  seed ^= mix(seed ^ kSecret[0], kSecret[1]);
+
+  uint64_t a = 0;
+  uint64_t b = 0;
+  if (len <= 16) {
+    if (len >= 4) {
+      a = read32(p) << 32 | read32(p + ((len >> 3) << 2));
+      b = read32(p + len - 4) << 32 | read32(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = read_small(p, len);
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      uint64_t see1 = seed;
+      uint64_t see2 = seed;
+      do {
+        seed = mix(read64(p) ^ kSecret[1], read64(p + 8) ^ seed);
+        see1 = mix(read64(p + 16) ^ kSecret[2], read64(p + 24) ^ see1);
+        see2 = mix(read64(p + 32) ^ kSecret[3], read64(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = mix(read64(p) ^ kSecret[1], read64(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = read64(p + i - 16);
+    b = read64(p + i - 8);
+  }
+
+  a ^= kSecret[1];
+  b ^= seed;
+  mum(a, b);
+  return mix(a ^ kSecret[0] ^ len, b ^ kSecret[1]);
+}
+
+} // namespace idhash
+
+// the identity of an interface key (sysfs device name, windows instance id,
+// "server/serial" of a remote adb device)
+constexpr DeviceId make_device_id(std::string_view key, IdentityScheme scheme = IdentityScheme::Fold) {
+  if (scheme == IdentityScheme::ShortHash) {
+    return DeviceId(shorthash::hash(key.begin(), key.end()));
+  }
+  return DeviceId((idhash::fold64(key) >> 4) | uint64_t(IdentityScheme::Fold) << 60);
+}
+
+} // namespace device_enumerator
+
+template <>
+struct std::hash<device_enumerator::DeviceId> {
+  size_t operator()(device_enumerator::DeviceId id) const noexcept {
+    // already well mixed
+    return size_t(id.value());
+  }
+};
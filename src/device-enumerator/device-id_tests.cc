@@ -0,0 +1,58 @@
+#include <array>
+#include <memory>
+
+namespace device_enumerator {
+
+namespace {
+
+constexpr char kText[] =
+  "USB\\VID_18D1&PID_4EE7&MI_01\\6&2A3B4C5D&0&0001/sys/devices/pci0000:00/0000:00:14.0/usb1/1-9/1-9:1.0";
+constexpr size_t kTextSize = sizeof(kText) - 1;
+
+// every prefix of kText, hashed at compile time
+constexpr auto kPrefixIds = [] {
+  std::array<uint64_t, kTextSize + 1> ids{};
+  for (size_t n = 0; n <= kTextSize; n++) {
+    ids[n] = make_device_id(std::string_view(kText, n)).value();
+  }
+  return ids;
+}();
+
+} // namespace
+
+// released schemes never change, these pin them
+static_assert(make_device_id("USB1-9-1:1.0", IdentityScheme::ShortHash).value() == 0x8cf3e87564ba7c84);
+static_assert(make_device_id("USB1-9-1:1.0").value() == 0x2cca14887cf600e3);
+
+TEST(DeviceId, RuntimeMatchesCompileTime) {
+  // odd offsets, loads are unaligned
+  auto buffer = std::make_unique<char[]>(kTextSize + 3);
+  for (size_t offset : {1, 3}) {
+    std::memcpy(buffer.get() + offset, kText, kTextSize);
+    for (size_t n = 0; n <= kTextSize; n++) {
+      std::string_view key(buffer.get() + offset, n);
+      ASSERT_EQ(make_device_id(key).value(), kPrefixIds[n]) << n;
+    }
+  }
+
+  std::string key = "USB1-9-1:1.0";
+  EXPECT_EQ(make_device_id(key, IdentityScheme::ShortHash).to_string(),
+            shorthash::hash_to_string(key.begin(), key.end()));
+}
+
+TEST(DeviceId, TextForm) {
+  auto id = make_device_id("USB1-9-1:1.0");
+  EXPECT_EQ(id.to_string(), "2cca14887cf600e3");
+  EXPECT_EQ(id.version(), 2u);
+  EXPECT_EQ(DeviceId::parse("2CCA14887CF600E3"), id);
+  EXPECT_EQ(DeviceId::parse("000000000000000001"), std::nullopt);
+  EXPECT_EQ(DeviceId::parse("xyz"), std::nullopt);
+
+  // no two prefixes collide, every id is versioned
+  std::vector<uint64_t> ids(kPrefixIds.begin(), kPrefixIds.end());
+  std::ranges::sort(ids);
+  EXPECT_EQ(std::ranges::adjacent_find(ids), ids.end());
+  EXPECT_TRUE(std::ranges::all_of(ids, [](uint64_t v) { return DeviceId(v).version() == 2; }));
+}
+
+} // namespace device_enumerator
@@ -104,7 +104,8 @@ public:
   template <class FN>
   requires std::invocable<FN, const DeviceInterface &>
   [[nodiscard]] static std::unique_ptr<WatchThread, WatchStopper> create(FN &&callback, const WatchSettings &settings = {}) {
-    class Impl : public WatchThread {
+    // the one type erased hop of an event, callback_ itself is called directly
+    class Impl final : public WatchThread {
       FN callback_;
     public:
       Impl(FN&& callback) : callback_(std::forward<FN>(callback)) {}
@@ -131,8 +132,24 @@ class WatchWaiter {
   std::unique_ptr<WatchThread, WatchThread::WatchStopper> watcher_;
   std::mutex mutex_;
   DeviceInterface *wait_if_{nullptr};
+  std::string_view wait_key_;
   std::condition_variable cond_;
-  std::unordered_map<std::string, DeviceInterface> ifs_;
+  std::unordered_map<DeviceId, DeviceInterface> ifs_;
+
+  // key matches any of the id (16 hex digits), devpath, hub, serial, ip
+  // and driver, as target.identity did while it was a string
+  static bool test_key(std::string_view key, const DeviceInterface &iface) {
+    if (key.empty()) {
+      return true;
+    }
+    char id_text[16];
+    return key == iface.identity.to_chars(id_text) ||
+           key == iface.devpath ||
+           key == iface.hub ||
+           key == iface.serial ||
+           key == iface.ip ||
+           key == iface.driver;
+  }
 
   constexpr bool test_match(const DeviceInterface &target, const DeviceInterface &iface) const {
     return (target.off == iface.off) &&
@@ -142,6 +159,7 @@ class WatchWaiter {
             (target.serial.empty() || target.serial == iface.serial) &&
             (target.ip.empty() || target.ip == iface.ip) &&
             (target.driver.empty() || target.driver == iface.driver) &&
+            (target.adbServer.empty() || target.adbServer == iface.adbServer) &&
             (target.port == 0 || target.port == iface.port) &&
             (target.vid == 0 || target.vid == iface.vid) &&
             (target.pid == 0 || target.pid == iface.pid) &&
@@ -149,17 +167,12 @@ class WatchWaiter {
             (target.usbSubClass == 0 || target.usbSubClass == iface.usbSubClass) &&
             (target.usbProto == 0 || target.usbProto == iface.usbProto) &&
             (target.usbIf < 0 || target.usbIf == iface.usbIf) &&
-            (target.identity.empty() || (target.identity == iface.identity || 
-                                          target.identity == iface.devpath  || 
-                                          target.identity == iface.hub ||
-                                          target.identity == iface.serial ||
-                                          target.identity == iface.ip ||
-                                          target.identity == iface.driver));
+            (target.identity.empty() || target.identity == iface.identity);
   }
 
-  bool match_target(DeviceInterface &target) const {
+  bool match_target(DeviceInterface &target, std::string_view key) const {
     for (auto &[id, iface] : ifs_) {
-      if (test_match(target, iface)) {
+      if (test_match(target, iface) && test_key(key, iface)) {
         target = iface;
         return true;
       }
@@ -175,7 +188,7 @@ public:
       ifs_[node.identity] = std::move(node);
 
       if (wait_if_ != nullptr) {
-        if (match_target(*wait_if_)) {
+        if (match_target(*wait_if_, wait_key_)) {
           wait_if_ = nullptr;
           lock.unlock();
           cond_.notify_all();
@@ -187,14 +200,17 @@ public:
     return watcher_ != nullptr;
   }
 
-  bool wait_for(DeviceInterface &node, int64_t milliseconds_timeout = -1) noexcept {
+  // the set fields of node must match, target.identity the id only.
+  // key, if not empty, is matched against the id and the string fields
+  bool wait_for(DeviceInterface &node, int64_t milliseconds_timeout = -1, std::string_view key = {}) noexcept {
     std::unique_lock lock(mutex_);
 
-    if (match_target(node)) {
+    if (match_target(node, key)) {
       return true;
     }
 
     wait_if_ = &node;
+    wait_key_ = key;
 
     if (milliseconds_timeout < 0) {
       cond_.wait(lock, [this] {
@@ -212,25 +228,26 @@ public:
     return true;
   }
 
-  DeviceInterface wait(DeviceInterface target) noexcept {
-    wait_for(target);
+  DeviceInterface wait(DeviceInterface target, std::string_view key = {}) noexcept {
+    wait_for(target, -1, key);
     return target;
   }
 
-  bool wait(DeviceInterface target, int64_t milliseconds_timeout, DeviceInterface *out = nullptr) noexcept {
-    auto ret = wait_for(target, milliseconds_timeout);
+  bool wait(DeviceInterface target, int64_t milliseconds_timeout, DeviceInterface *out = nullptr,
+            std::string_view key = {}) noexcept {
+    auto ret = wait_for(target, milliseconds_timeout, key);
     if (ret && out) {
       *out = std::move(target);
     }
     return ret;
   }
 
-  std::vector<DeviceInterface> get_all(const DeviceInterface *filter) {
+  std::vector<DeviceInterface> get_all(const DeviceInterface *filter, std::string_view key = {}) {
     std::vector<DeviceInterface> devices;
 
     std::lock_guard lock(mutex_);
     for (auto &[id, iface] : ifs_) {
-      if (filter == nullptr || test_match(*filter, iface)) {
+      if ((filter == nullptr || test_match(*filter, iface)) && test_key(key, iface)) {
         devices.push_back(iface);
       }
     }
@@ -2,8 +2,12 @@
 
 #include <cstdint>
 #include <algorithm>
+#include <bit>
 #include <string>
 
+// the identity hash before identities were versioned, kept bit for bit as
+// device_enumerator::IdentityScheme::ShortHash. new code uses device-id.h.
+
 namespace shorthash {
 
 namespace detail {
@@ -28,12 +32,24 @@ struct hash_state {
   uint64_t counter = 0;
 };
 
+// counts of 0 and past 63 occur, they wrap like the x86 rotate the
+// original shift pair compiled to
 constexpr uint64_t rotate_left(uint64_t x, uint32_t n) {
-  return (x << n) | (x >> (64 - n));
+  return std::rotl(x, int(n % 64));
 }
 
 constexpr uint64_t rotate_right(uint64_t x, uint32_t n) {
-  return (x >> n) | (x << (64 - n));
+  return std::rotr(x, int(n % 64));
+}
+
+// little endian load of 8 bytes, no alignment needed
+template <typename Iter>
+constexpr uint64_t load_word(Iter p, size_t n = 8) {
+  uint64_t word = 0;
+  for (size_t i = 0; i < n; ++i) {
+    word |= uint64_t(static_cast<uint8_t>(p[i])) << (i * 8);
+  }
+  return word;
 }
 
 constexpr uint64_t mix(uint64_t x, uint64_t key, uint32_t round) {
@@ -69,14 +85,12 @@ constexpr void process_block(hash_state& state, Iter first, Iter last) {
   }
 
   for (size_t i = 0; i < word_count; ++i) {
-    words[i] = *reinterpret_cast<const uint64_t*>(&*(first + i * 8));
+    words[i] = load_word(first + i * 8);
   }
 
   if (block_size % 8 != 0) {
     size_t remaining = block_size % 8;
-    uint64_t last_word = 0;
-    std::copy(last - remaining, last, &last_word);
-    words[word_count] = last_word;
+    words[word_count] = load_word(last - remaining, remaining);
     word_count++;
   }
 
@@ -0,0 +1,185 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include "tracing/usdt.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <memory_resource>
+#include <string>
+
+// uevent and sysfs attribute helpers of the netlink enumerator,
+// header only so that benchmarks can drive them on synthetic input.
+
+#define MAX_PATH_LEN 512
+
+namespace device_enumerator {
+
+// value of key in a uevent message (nul separated KEY=value strings)
+inline const char *netlink_message_parse(const char *buffer, size_t len, const char *key)
+{
+  const char *end = buffer + len;
+  size_t keylen = strlen(key);
+
+  while (buffer < end && *buffer) {
+    if (strncmp(buffer, key, keylen) == 0 && buffer[keylen] == '=')
+      return buffer + keylen + 1;
+    buffer += strlen(buffer) + 1;
+  }
+
+  return nullptr;
+}
+
+// sysfs_read_start / sysfs_read_end around one attribute read,
+// result is the read(2) return value (-1 if the open failed)
+struct SysfsReadProbe {
+  const char *path;
+  ssize_t result{-1};
+  [[maybe_unused]] uint64_t start;
+
+  explicit SysfsReadProbe(const char *p) : path(p), start(DEVICE_WATCH_PROBE_NOW(sysfs_read_end)) {
+    DEVICE_WATCH_PROBE(sysfs_read_start, path);
+  }
+
+  ~SysfsReadProbe() {
+    DEVICE_WATCH_PROBE(sysfs_read_end, path, result, DEVICE_WATCH_PROBE_SINCE(start));
+  }
+};
+
+// <sysfs_dir>/<attr>, false if it does not fit
+inline bool sysfs_attr_path(char (&path)[MAX_PATH_LEN], const char *sysfs_dir, const char *attr)
+{
+  int n = snprintf(path, sizeof(path), "%s/%s", sysfs_dir, attr);
+  return n >= 0 && size_t(n) < sizeof(path);
+}
+
+inline int _sysfs_read_attr(const char *sysfs_dir, const char *attr, int *value_p, bool hex)
+{
+  char buf[20], *endptr;
+  long value;
+  ssize_t r;
+
+  char attr_path[MAX_PATH_LEN];
+  if (!sysfs_attr_path(attr_path, sysfs_dir, attr))
+    return -1;
+  SysfsReadProbe probe(attr_path);
+  int fd = open(attr_path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return fd;
+
+  r = read(fd, buf, sizeof(buf));
+  close(fd);
+  probe.result = r;
+  if (r < 0) {
+    return r;
+  }
+
+  if (r == 0) {
+    /* Certain attributes (e.g. bConfigurationValue) are not
+     * populated if the device is not configured. */
+    return -1;
+  }
+
+  buf[r - 1] = '\0';
+  errno = 0;
+
+  if (hex) {
+    value = strtol(buf, &endptr, 16);
+    if (value < 0 || errno) {
+      return -2;
+    }
+  } else {
+    value = strtol(buf, &endptr, 10);
+    if (value < 0|| errno) {
+      return -2;
+    } else if (*endptr != '\0') {
+      /* Consider the value to be valid if the remainder is a '.'
+      * character followed by numbers.  This occurs, for example,
+      * when reading the "speed" attribute for a low-speed device
+      * (e.g. "1.5") */
+      if (*endptr == '.' && isdigit(*(endptr + 1))) {
+        endptr++;
+        while (isdigit(*endptr))
+          endptr++;
+      }
+      if (*endptr != '\0') {
+        return -2;
+      }
+    }
+  }
+
+  *value_p = (int)value;
+  return 0;
+}
+
+template <typename T>
+int sysfs_read_attr(const char *sysfs_dir, const char *attr, T &value, bool hex) {
+  int sysfs_val = 0;
+  int r = _sysfs_read_attr(sysfs_dir, attr, &sysfs_val, hex);
+  if (r == 0) {
+    value = static_cast<T>(sysfs_val);
+  }
+
+  return r;
+}
+
+// value without the trailing newline, the string keeps its allocator
+template <class String>
+inline int _sysfs_read_attr_string(const char *sysfs_dir, const char *attr, String &value) {
+  char attr_path[MAX_PATH_LEN];
+  if (!sysfs_attr_path(attr_path, sysfs_dir, attr)) {
+    return -1;
+  }
+  SysfsReadProbe probe(attr_path);
+  int fd = open(attr_path, O_RDONLY | O_CLOEXEC);
+  if (fd > 0) {
+    char buf[MAX_PATH_LEN];
+    int r = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    probe.result = r;
+    if (r > 0) {
+      buf[r--] = 0;
+      if (r > 0 && buf[r] == '\n') {
+        buf[r] = 0;
+      }
+      value = buf;
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+template <>
+inline int sysfs_read_attr<std::string>(const char *sysfs_dir, const char *attr, std::string &value, bool) {
+  return _sysfs_read_attr_string(sysfs_dir, attr, value);
+}
+
+template <>
+inline int sysfs_read_attr<std::pmr::string>(const char *sysfs_dir, const char *attr, std::pmr::string &value, bool) {
+  return _sysfs_read_attr_string(sysfs_dir, attr, value);
+}
+
+} // namespace device_enumerator
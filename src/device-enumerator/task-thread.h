@@ -64,7 +64,7 @@ class task_thread {
 
 public:
   template<typename Function, typename... Args>
-  requires std::invocable<Function, REQ&&, Args...> and !std::is_void_v<REQ>
+  requires (std::invocable<Function, REQ&&, Args...> and !std::is_void_v<REQ>)
   void start(Function&& f, Args&&... args) {
     if (thread_.joinable()) {
       std::terminate();
@@ -100,7 +100,7 @@ public:
   }
 
   template<class Rep, class Period, typename Function, typename... Args>
-  requires std::invocable<Function, std::optional<REQ>&&, Args...> and !std::is_void_v<REQ>
+  requires (std::invocable<Function, std::optional<REQ>&&, Args...> and !std::is_void_v<REQ>)
   void start(const std::chrono::duration<Rep, Period>& rel_time, Function&& f, Args&&... args) {
     if (thread_.joinable()) {
       std::terminate();
@@ -143,7 +143,7 @@ public:
   }
 
   template<class Rep, class Period, typename Function, typename... Args>
-  requires std::invocable<Function, Args...> and std::is_void_v<REQ>
+  requires (std::invocable<Function, Args...> and std::is_void_v<REQ>)
   void start(const std::chrono::duration<Rep, Period>& rel_time, Function&& f, Args&&... args) {
     if (thread_.joinable()) {
       std::terminate();
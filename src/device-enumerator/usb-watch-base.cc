@@ -18,10 +18,17 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#endif
+
 #include "usb-watch-base.h"
+#include "adb-state-index.h"
+#include "watch-pipeline.h"
 #include "adb-client/adb-client.h"
 #include <algorithm>
-#include "shorthash.h"
+#include "tracing/trace-writer.h"
+#include "tracing/usdt.h"
 #include <regex>
 
 namespace device_enumerator {
@@ -30,24 +37,11 @@ using namespace adb_client;
 
 namespace {
 
-constexpr uint8_t ADB_CLASS = 0xff;
-constexpr uint8_t ADB_SUBCLASS = 0x42;
-constexpr uint8_t ADB_PROTOCOL = 0x01;
-constexpr uint8_t FASTBOOT_PROTOCOL = 0x03;
-constexpr uint8_t HDC_SUBCLASS = 0x50;
-constexpr uint8_t HDC_PROTOCOL = 0x01;
-
-constexpr uint16_t QUALCOMM_VID = 0x05C6;
-constexpr uint16_t QDL_PID = 0x9008;
 constexpr int MAX_ADB_RETRY_COUNT = 60;
 constexpr auto ADB_POLL_INTERVAL = std::chrono::milliseconds(3000);
 
 const std::regex re_remote(R"((\d{1,3}\.\d{1,3}\.\d{1,3}\.\d{1,3}):(\d{1,5}))");
 
-std::string createUuid(std::string_view interface_id) {
-  return shorthash::hash_to_string(interface_id.begin(), interface_id.end());
-}
-
 bool isRemoteDevice(const std::string &serial, std::string *ip = nullptr, uint16_t *port = nullptr) noexcept {
   try {
     std::smatch matches;
@@ -110,14 +104,22 @@ constexpr bool checkDriverFilter(const DeviceInterface& node, const UsbEnumerato
      std::ranges::find(settings.drivers, node.driver) != settings.drivers.end();
 }
 
-constexpr bool shouldIncludeDevice(const DeviceInterface& node, const UsbEnumerator::WatchSettings& settings) {
+} // namespace
+
+bool shouldIncludeDevice(const DeviceInterface& node, const UsbEnumerator::WatchSettings& settings) {
   return checkTypeFilter(node, settings) &&
          checkVidFilter(node, settings) &&
          checkPidFilter(node, settings) &&
          checkDriverFilter(node, settings);
 }
 
-} // namespace
+std::string parentHubOf(std::string_view hub) {
+  auto dash = hub.rfind('-');
+  if (dash == hub.npos) {
+    return {};
+  }
+  return std::string(hub.substr(0, dash));
+}
 
 void UsbEnumerator::initSettings(const WatchSettings &settings) {
   settings_ = settings;
@@ -128,7 +130,10 @@ void UsbEnumerator::initialEnumerateDevices() {
     createAdbTask();
   }
 
-  enumerateDevices();
+  {
+    tracing::TraceSpan span("enumerator", "enumerate");
+    enumerateDevices();
+  }
 
   if (initCallback_) {
     std::move(initCallback_)(true);
@@ -136,81 +141,100 @@ void UsbEnumerator::initialEnumerateDevices() {
 }
 
 void UsbEnumerator::onUsbInterfaceEnumerated(const std::string &interface_id, DeviceInterface&& newdev) {
-  if (newdev.type & DeviceType::Usb) {
-    if (newdev.usbClass == ADB_CLASS) {
-      if (newdev.usbSubClass == HDC_SUBCLASS && newdev.usbProto == HDC_PROTOCOL) {
-        newdev.type |= DeviceType::HDC;
-      } else if (newdev.usbSubClass == ADB_SUBCLASS && newdev.usbProto == ADB_PROTOCOL) {
-        newdev.type |= DeviceType::Adb;
-      } else if (newdev.usbSubClass == ADB_SUBCLASS && newdev.usbProto == FASTBOOT_PROTOCOL) {
-        newdev.type |= DeviceType::Fastboot;
-      }
-    }
-  }
-
-  if (newdev.vid == QUALCOMM_VID && newdev.pid == QDL_PID) {
-    newdev.type |= DeviceType::QDL;
-  }
-
-  if (!shouldIncludeDevice(newdev, settings_)) {
-    return;
-  }
-
-  newdev.identity = createUuid(interface_id);
+  auto pipeline = WatchPipeline(
+    SettingsFilter{settings_},
+    [this, &interface_id](DeviceInterface &dev) {
+      dev.identity = make_device_id(interface_id, settings_.identityScheme);
+
+      if (settings_.enableAdbClient &&
+          (dev.type & DeviceType::usbConnectedAdb) == static_cast<uint32_t>(DeviceType::usbConnectedAdb)) {
+        // cache the adb device for later use
+        {
+          std::lock_guard lock(mutex_);
+          cacheInterface(dev);
+          DEVICE_WATCH_PROBE(cache_insert, dev.identity.value(), cached_interfaces_.size());
+        }
 
-  if ((newdev.type & DeviceType::usbConnectedAdb) == static_cast<uint32_t>(DeviceType::usbConnectedAdb)) {
-    if (settings_.enableAdbClient) {
-      // cache the adb device for later use
-      {
-        std::lock_guard lock(mutex_);
-        cached_interfaces_[newdev.identity] = newdev;
+        adb_task_.push_request(Trigger { .node = std::move(dev) });
+        return;
       }
 
-      adb_task_.push_request(Trigger { .node = std::move(newdev) });
-      return;
-    }
-  }
+      onDeviceInterfaceChangedToOn(dev);
+    },
+    ClassifyUsbInterface{},
+    ClassifyQdl{});
 
-  onDeviceInterfaceChangedToOn(newdev);
+  if (!pipeline(newdev)) {
+    DEVICE_WATCH_PROBE(filter_reject, interface_id.c_str(), newdev.vid, newdev.pid, newdev.type);
+  }
 }
 
 void UsbEnumerator::onUsbInterfaceOff(const std::string &interface_id) {
-  auto uuid = createUuid(interface_id);
-  
-  DeviceInterface node;
+  auto id = make_device_id(interface_id, settings_.identityScheme);
+
+  decltype(cached_interfaces_)::node_type cached;
   {
     std::lock_guard lock(mutex_);
-    auto it = cached_interfaces_.find(uuid);
-    if (it == cached_interfaces_.end()) {
+    cached = cached_interfaces_.extract(id);
+    if (!cached) {
       return;
     }
-
-    node = std::move(it->second);
-    cached_interfaces_.erase(it);
+    DEVICE_WATCH_PROBE(cache_remove, id.value(), cached_interfaces_.size());
   }
 
+  auto &node = cached.mapped();
   node.off = true;
 
+  // not merged with adb devices means nobody was told it is on
+  bool notify = true;
   if ((node.type & DeviceType::usbConnectedAdb) == static_cast<uint32_t>(DeviceType::usbConnectedAdb)) {
     if (settings_.enableAdbClient) {
       adb_task_.push_request(Trigger { .node = node });
-      if (node.device.empty() && node.model.empty()) {
-        // means not merged with adb devices, no need notify
-        return;
-      }
+      notify = !node.device.empty() || !node.model.empty();
     }
   }
 
-  onDeviceInterfaceChanged(node);
+  if (notify) {
+    char id_text[16];
+    tracing::TraceSpan span("enumerator", "callback");
+    span.arg("identity", node.identity.to_chars(id_text)).arg("off", 1);
+
+    [[maybe_unused]] auto start = DEVICE_WATCH_PROBE_NOW(callback_dispatch);
+    onDeviceInterfaceChanged(node);
+    DEVICE_WATCH_PROBE(callback_dispatch, node.identity.value(), 1, DEVICE_WATCH_PROBE_SINCE(start));
+  }
+
+  std::lock_guard lock(mutex_);
+  spare_interface_ = std::move(cached);
+}
+
+void UsbEnumerator::cacheInterface(const DeviceInterface &node) {
+  if (auto it = cached_interfaces_.find(node.identity); it != cached_interfaces_.end()) {
+    it->second = node;
+  } else if (spare_interface_) {
+    // assigning keeps the capacity of the spare's strings
+    spare_interface_.key() = node.identity;
+    spare_interface_.mapped() = node;
+    cached_interfaces_.insert(std::move(spare_interface_));
+  } else {
+    cached_interfaces_.emplace(node.identity, node);
+  }
 }
 
 void UsbEnumerator::onDeviceInterfaceChangedToOn(const DeviceInterface &node) {
   {
     std::lock_guard lock(mutex_);
-    cached_interfaces_[node.identity] = node;
+    cacheInterface(node);
+    DEVICE_WATCH_PROBE(cache_insert, node.identity.value(), cached_interfaces_.size());
   }
 
+  char id_text[16];
+  tracing::TraceSpan span("enumerator", "callback");
+  span.arg("identity", node.identity.to_chars(id_text)).arg("off", 0);
+
+  [[maybe_unused]] auto start = DEVICE_WATCH_PROBE_NOW(callback_dispatch);
   onDeviceInterfaceChanged(node);
+  DEVICE_WATCH_PROBE(callback_dispatch, node.identity.value(), 0, DEVICE_WATCH_PROBE_SINCE(start));
 }
 
 namespace {
@@ -222,84 +246,155 @@ constexpr void merge_adb_info(DeviceInterface &dst, DeviceInfo &&src) {
   dst.device = std::move(src.device);
 }
 
+// remote devices of the default server keep their serial based identity
+std::string remoteDeviceKey(const std::string &server, const std::string &serial) {
+  if (AdbTracker::isDefaultServer(server)) {
+    return serial;
+  }
+  return server + "/" + serial;
+}
+
+// the tracker reports every state, only usable devices are watched
+bool isOnline(const DeviceInfo &dev) {
+  return dev.state == "device";
+}
+
+// devices of a server on another host are remote regardless of their serial,
+// so are wireless debugging devices connected by their mdns name.
+// addressed tells the serial is an ip[:port]
+bool isRemoteAdb(bool local_server, const std::string &serial, bool addressed) {
+  return !local_server || addressed || AdbTracker::isMdnsSerial(serial);
+}
+
 } // namespace
 
+UsbEnumerator::UsbEnumerator() : adb_states_(std::make_unique<AdbStateIndex>()) {}
+
+UsbEnumerator::~UsbEnumerator() = default;
+
+adb_client::DeviceStateSource *UsbEnumerator::adbStates() {
+  return adb_states_.get();
+}
+
 void UsbEnumerator::createAdbTask() {
+  adb_tracker_ = std::make_unique<AdbTracker>([this](const std::string &server) {
+    adb_states_->update(server, adb_tracker_->devices(server));
+    adb_task_.push_request(Trigger { .refresh = true });
+  });
+
   adb_task_.set_consume_all_requests(true);
 
   adb_task_.start(ADB_POLL_INTERVAL, [this](std::optional<Trigger> &&req) {
     if (req.has_value()) {
       if (req->node.off) {
-        adb_serials_.remove(req->node.serial);
+        if (auto it = adb_serials_.find(req->node.adbServer); it != adb_serials_.end()) {
+          it->second.serials.erase(req->node.serial);
+          it->second.list.reset();
+        }
+        req.reset();
+      } else if (req->refresh) {
         req.reset();
       }
     }
 
-    std::vector<DeviceInfo> devs;
-    try {
-      devs = adb_list_devices({}, true);
-    } catch (std::exception &e) {
-      std::cerr << "adb_list_devices failed: " << e.what() << std::endl;
-      adb_task_.notify_stop();
-      return;
-    }
+    tracing::TraceSpan span("adb", "adb_poll");
+    [[maybe_unused]] auto start = DEVICE_WATCH_PROBE_NOW(adb_poll_end);
+    auto servers = adb_tracker_->snapshot();
+    DEVICE_WATCH_PROBE(adb_poll_start, servers.size());
 
-    // check removed devices
-    std::erase_if(adb_serials_, [this, &devs](const auto& serial) {
-      bool not_found = std::ranges::none_of(devs, [&serial](const auto& d) { 
-        return d.serial == serial; 
-      });
-      
-      if (not_found && isRemoteDevice(serial)) {
-        onUsbInterfaceOff(serial);
+    // servers gone, their devices go with them (the snapshot is ordered by server)
+    std::erase_if(adb_serials_, [this, &servers](auto &entry) {
+      auto &[server, known] = entry;
+      if (std::ranges::binary_search(servers, server, {}, &AdbTracker::ServerDevices::server)) {
+        return false;
       }
-      
-      return not_found;
+
+      known.serials.forEach([this, &server](auto &serial, auto &e) {
+        if (e.remote) {
+          onUsbInterfaceOff(remoteDeviceKey(server, serial));
+        }
+      });
+      return true;
     });
 
-    // check added devices
-    std::vector<DeviceInfo> newly_added;
+    // <server, device>
+    std::vector<std::pair<std::string, DeviceInfo>> newly_added;
 
-    for (auto &dev : devs) {
-      if (std::ranges::none_of(adb_serials_, [&](auto &serial) { return serial == dev.serial; })) {
-        DeviceInterface rmote;
-        if (isRemoteDevice(dev.serial, &rmote.ip, &rmote.port)) {
-          rmote.identity = createUuid(dev.serial);
-          rmote.type = DeviceType::remoteAdb;
-          merge_adb_info(rmote, std::move(dev));
-          adb_serials_.push_back(rmote.serial);
+    for (auto &list : servers) {
+      auto &known = adb_serials_[list.server];
+      known.local = list.local;
 
-          if (shouldIncludeDevice(rmote, settings_)) {
-            onDeviceInterfaceChangedToOn(rmote);
-          }
+      // nothing changed since the last round and no usb node waits for a match
+      if (known.list == list.devices && !req.has_value()) {
+        continue;
+      }
+      known.list = list.devices;
+
+      // rmote carries the address parsed from the serial when addressed
+      auto announce = [this, &list](const DeviceInfo &dev, DeviceInterface &rmote, bool addressed) {
+        if (!addressed &&
+            !isRemoteDevice(adb_tracker_->mdnsAddress(list.server, dev.serial), &rmote.ip, &rmote.port)) {
+          rmote.ip = list.server.substr(0, list.server.rfind(':'));
+        }
+        rmote.identity = make_device_id(remoteDeviceKey(list.server, dev.serial), settings_.identityScheme);
+        rmote.type = DeviceType::remoteAdb;
+        rmote.adbServer = list.server;
+        merge_adb_info(rmote, DeviceInfo(dev));
+
+        if (shouldIncludeDevice(rmote, settings_)) {
+          onDeviceInterfaceChangedToOn(rmote);
         } else {
-          if (req.has_value()) {
+          DEVICE_WATCH_PROBE(filter_reject, rmote.serial.c_str(), rmote.vid, rmote.pid, rmote.type);
+        }
+      };
+
+      known.serials.reconcile(*list.devices, isOnline,
+        [&](const DeviceInfo &dev) {
+          DeviceInterface rmote;
+          bool addressed = isRemoteDevice(dev.serial, &rmote.ip, &rmote.port);
+          if (isRemoteAdb(list.local, dev.serial, addressed)) {
+            known.serials.insert(dev.serial, dev.transportId, true);
+            announce(dev, rmote, addressed);
+          } else if (req.has_value()) {
             if (req->node.serial == dev.serial || req->node.serial.empty()) {
-              if (req->node.serial == dev.serial) {
-                // matched by serial exactlly
-                // make this dev sort at head
-                dev.transportId = -1;
-              }
-
-              newly_added.push_back(std::move(dev));
+              newly_added.emplace_back(list.server, dev);
             }
           }
-        }
-      }
+        },
+        [&](const DeviceInfo &dev, auto &e) {
+          // a usb device re-attaching comes through its own usb events
+          if (e.remote) {
+            DeviceInterface rmote;
+            bool addressed = isRemoteDevice(dev.serial, &rmote.ip, &rmote.port);
+            announce(dev, rmote, addressed);
+          }
+        },
+        [&](const std::string &serial, auto &e) {
+          if (e.remote) {
+            onUsbInterfaceOff(remoteDeviceKey(list.server, serial));
+          }
+        });
     }
 
     if (newly_added.size()) {
-      std::ranges::sort(newly_added, [](const auto& a, const auto& b) {
-        return a.transportId < b.transportId;
+      // all candidates match the serial (or any serial was asked), the oldest transport wins
+      std::ranges::sort(newly_added, {}, [](const auto &a) {
+        return a.second.transportId;
       });
 
-      merge_adb_info(req->node, std::move(newly_added[0]));
-      adb_serials_.push_back(req->node.serial);
+      auto &[server, dev] = newly_added[0];
+      auto transport_id = dev.transportId;
+      merge_adb_info(req->node, std::move(dev));
+      req->node.adbServer = server;
+      adb_serials_[server].serials.insert(req->node.serial, transport_id, false);
 
       onDeviceInterfaceChangedToOn(req->node);
       req.reset();
     }
 
+    span.arg("servers", servers.size()).arg("matched", newly_added.size());
+    DEVICE_WATCH_PROBE(adb_poll_end, servers.size(), newly_added.size(), DEVICE_WATCH_PROBE_SINCE(start));
+
     if (req.has_value() && req->round < MAX_ADB_RETRY_COUNT) {
       auto identity = req->node.identity;
       req->round++;
@@ -312,10 +407,33 @@ void UsbEnumerator::createAdbTask() {
       }
     }
   });
+
+  adb_tracker_->setMdns({
+    .enabled = settings_.adbMdns,
+    .instances = settings_.adbMdnsInstances,
+  });
+  adb_tracker_->start(settings_.adbServers);
 }
 
 void UsbEnumerator::deleteAdbTask() {
+  if (adb_tracker_) {
+    adb_tracker_->stop();
+  }
   adb_task_.stop();
 }
 
+bool UsbEnumerator::addAdbServer(std::string_view server) {
+  return adb_tracker_ && adb_tracker_->addServer(server);
+}
+
+bool UsbEnumerator::removeAdbServer(std::string_view server) {
+  return adb_tracker_ && adb_tracker_->removeServer(server);
+}
+
 } // namespace device_enumerator
+
+#ifdef ENABLE_TEST
+#include "device-id_tests.cc"
+#include "adb-serial-set_tests.cc"
+#include "usb-watch-base_tests.cc"
+#endif
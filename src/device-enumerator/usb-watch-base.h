@@ -20,6 +20,9 @@
 
 #pragma once 
 #include "task-thread.h"
+#include "adb-tracker.h"
+#include "adb-serial-set.h"
+#include "device-id.h"
 #include <string>
 #include <vector>
 #include <tuple>
@@ -28,11 +31,15 @@
 #include <unordered_map>
 #include <iostream>
 #include <ranges>
-#include <list>
+#include <map>
 #include <array>
+#include <algorithm>
+#include <filesystem>
 
 namespace device_enumerator {
 
+class AdbStateIndex;
+
 enum class DeviceType : uint32_t {
   None = 0,
 
@@ -127,8 +134,41 @@ public:
   }
 };
 
+enum class UsbSpeed : uint8_t {
+  Unknown = 0,
+  Low,          // 1.5 Mbps
+  Full,         // 12 Mbps
+  High,         // 480 Mbps
+  Super,        // 5 Gbps
+  SuperPlus,    // 10 Gbps
+  SuperPlus2x2, // 20 Gbps
+};
+
+constexpr uint32_t usbSpeedMbps(UsbSpeed speed) {
+  switch (speed) {
+    case UsbSpeed::Low: return 1;
+    case UsbSpeed::Full: return 12;
+    case UsbSpeed::High: return 480;
+    case UsbSpeed::Super: return 5000;
+    case UsbSpeed::SuperPlus: return 10000;
+    case UsbSpeed::SuperPlus2x2: return 20000;
+    default: return 0;
+  }
+}
+
+// sysfs reports "1.5" for low speed, which reads back as 1
+constexpr UsbSpeed usbSpeedFromMbps(uint32_t mbps) {
+  if (mbps >= 20000) return UsbSpeed::SuperPlus2x2;
+  if (mbps >= 10000) return UsbSpeed::SuperPlus;
+  if (mbps >= 5000) return UsbSpeed::Super;
+  if (mbps >= 480) return UsbSpeed::High;
+  if (mbps >= 12) return UsbSpeed::Full;
+  if (mbps >= 1) return UsbSpeed::Low;
+  return UsbSpeed::Unknown;
+}
+
 struct DeviceInterface {
-  std::string identity;
+  DeviceId identity;
 
   std::string devpath;
   std::string hub;
@@ -141,6 +181,10 @@ struct DeviceInterface {
   uint16_t port{0};
   std::string driver;
 
+  // "host:port" of the adb server that reported the device,
+  // or its socket spec when it listens on a unix socket
+  std::string adbServer;
+
 #ifdef _WIN32
   std::wstring
 #else
@@ -149,7 +193,12 @@ struct DeviceInterface {
             description;
   uint16_t vid{0};
   uint16_t pid{0};
-  // UsbSpeed speed;
+  UsbSpeed speed{UsbSpeed::Unknown};
+
+  // the hub this device is plugged into, devices sharing it
+  // share that hub's upstream link (of parentHubSpeed)
+  std::string parentHub;
+  UsbSpeed parentHubSpeed{UsbSpeed::Unknown};
 
   uint8_t usbClass{0};
   uint8_t usbSubClass{0};
@@ -160,27 +209,59 @@ struct DeviceInterface {
   bool off{false};
 };
 
+// file name the per port logs (console capture, diag frames) are kept
+// under: "hub.tty", with the separators paths and drives use replaced
+inline std::string portLogName(const std::string &devpath, const std::string &hub) {
+  auto tty = std::filesystem::path(devpath).filename().string();
+  auto name = hub.empty() ? tty : hub + "." + tty;
+  std::ranges::replace_if(name, [](char c) { return c == '/' || c == ':' || c == '\\'; }, '_');
+  return name;
+}
+
 class UsbEnumerator {
 public:
   struct WatchSettings {
     bool enableAdbClient{true};
+    // adb servers to track ("host:port"), empty means the default server only
+    std::vector<std::string> adbServers;
+    // discover wireless debugging devices over mdns and connect them,
+    // optionally only the instance names starting with one of adbMdnsInstances
+    bool adbMdns{false};
+    std::vector<std::string> adbMdnsInstances;
     std::vector<DeviceType> typeFilters;
     std::vector<uint16_t> includeVids;
     std::vector<uint16_t> excludeVids;
     std::vector<uint16_t> includePids;
     std::vector<uint16_t> excludePids;
     std::vector<std::string> drivers;
+    // the default Fold ids differ from those of earlier releases,
+    // ShortHash keeps them
+    IdentityScheme identityScheme{IdentityScheme::Fold};
 #if __linux__ 
     std::vector<std::pair<uint16_t, uint16_t>> usb2serialVidPid;
+    // sysfs mount point, a synthetic tree for simulation
+    std::string sysfsRoot{"/sys"};
+    // read uevents from this datagram / seqpacket socket (one message per
+    // datagram, not owned) instead of the kernel netlink socket
+    int ueventFd{-1};
 #endif
   };
 
   void initSettings(const WatchSettings &settings);
 
-  virtual ~UsbEnumerator() = default;
+  // track another adb server / stop tracking one while watching,
+  // devices of a removed server are reported off
+  bool addAdbServer(std::string_view server);
+  bool removeAdbServer(std::string_view server);
+
+  // states of the devices on the tracked adb servers, pass it as
+  // TransportOption::stateSource to wait without a server connection
+  adb_client::DeviceStateSource *adbStates();
+
+  virtual ~UsbEnumerator();
 
 protected:
-  UsbEnumerator() = default;
+  UsbEnumerator();
 
   void deleteAdbTask();
   void initialEnumerateDevices();
@@ -194,21 +275,44 @@ protected:
 
   void createAdbTask();
   void onDeviceInterfaceChangedToOn(const DeviceInterface &);
+  // mutex_ held
+  void cacheInterface(const DeviceInterface &node);
 
 protected:
   WatchSettings settings_;
   std::function<void(bool)> initCallback_;
 
 private:
-  // serial
-  std::list<std::string> adb_serials_;
+  struct AdbSerials {
+    bool local{false};
+    AdbSerialSet serials;
+    // the list reconciled last, the tracker publishes a new one on every change
+    std::shared_ptr<const std::vector<adb_client::DeviceInfo>> list;
+  };
+
+  // <server, serials>
+  std::map<std::string, AdbSerials> adb_serials_;
 
-  struct Trigger { DeviceInterface node; int round{0}; };
+  // refresh: some server's device list changed
+  struct Trigger { DeviceInterface node; int round{0}; bool refresh{false}; };
   task_thread<Trigger> adb_task_;
+  std::unique_ptr<AdbStateIndex> adb_states_;
+  std::unique_ptr<AdbTracker> adb_tracker_;
 
   std::mutex mutex_;
   // <identity, device>
-  std::unordered_map<std::string, DeviceInterface> cached_interfaces_;
+  std::unordered_map<DeviceId, DeviceInterface> cached_interfaces_;
+  // the entry of the last device gone off, refilled by the next one cached,
+  // so a device plugging in and out does not allocate
+  std::unordered_map<DeviceId, DeviceInterface>::node_type spare_interface_;
 };
 
+// type, vid, pid and driver filters of the settings
+bool shouldIncludeDevice(const DeviceInterface& node, const UsbEnumerator::WatchSettings& settings);
+
+// DeviceInterface::parentHub of a device on the given hub path:
+// USB1-9-1 hangs off USB1-9, USB1-9 off root hub USB1.
+// linux names hubs this way in sysfs, windows derives them from the same path.
+std::string parentHubOf(std::string_view hub);
+
 } // namespace device_enumerator
@@ -0,0 +1,11 @@
+namespace device_enumerator {
+
+TEST(UsbWatch, ParentHubOf) {
+  EXPECT_EQ(parentHubOf("USB1-9-1"), "USB1-9");
+  EXPECT_EQ(parentHubOf("USB1-9"), "USB1");
+  EXPECT_EQ(parentHubOf("USB2-1-4-3"), "USB2-1-4");
+  EXPECT_EQ(parentHubOf("USB1"), "");
+  EXPECT_EQ(parentHubOf(""), "");
+}
+
+} // namespace device_enumerator
@@ -18,8 +18,16 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#endif
+
 #include "usb-watch-netlink.h"
+#include "sysfs-attr.h"
 #include "process/process.h"
+#include "tracing/logger.h"
+#include "tracing/trace-writer.h"
+#include "tracing/usdt.h"
 #include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
@@ -27,6 +35,7 @@
 #include <unistd.h>
 #include <poll.h>
 #include <charconv>
+#include <cstring>
 
 #include <linux/netlink.h>
 #include <sys/socket.h>
@@ -34,28 +43,6 @@
 #include <sys/types.h>
 #include <sys/eventfd.h>
 
-#define _DEBUG 0
-
-#if defined(UNREFERENCED_PARAMETER)
-#define UNUSED(var) UNREFERENCED_PARAMETER(var)
-#else
-#define UNUSED(var) do { (void)(var); } while(0)
-#endif
-
-#define usbi_warn(ctx, ...) UNUSED(ctx)
-#define usbi_info(ctx, ...) UNUSED(ctx)
-// 
-
-#if _DEBUG
-#define usbi_dbg(format, ...) fprintf(stderr, format "\n", ##__VA_ARGS__)
-#define usbi_err(format, ...) fprintf(stderr, format "\n", ##__VA_ARGS__)
-#else
-#define usbi_dbg(...) do {} while (0)
-#define usbi_err(...) do {} while (0)
-#endif
-
-#define MAX_PATH_LEN 512
-
 
 namespace device_enumerator {
 
@@ -70,18 +57,46 @@ constexpr bool isUsb2SerialDevice(const std::vector<std::pair<uint16_t, uint16_t
   return false;
 }
 
+// a default DeviceInterface, except that the strings keep their buffers
+void reset_interface(DeviceInterface &dev) {
+  for (auto *s : {&dev.devpath, &dev.hub, &dev.serial, &dev.manufacturer, &dev.product,
+                  &dev.model, &dev.device, &dev.ip, &dev.driver, &dev.adbServer,
+                  &dev.description, &dev.parentHub}) {
+    s->clear();
+  }
+  dev.identity = {};
+  dev.port = 0;
+  dev.vid = 0;
+  dev.pid = 0;
+  dev.speed = UsbSpeed::Unknown;
+  dev.parentHubSpeed = UsbSpeed::Unknown;
+  dev.usbClass = 0;
+  dev.usbSubClass = 0;
+  dev.usbProto = 0;
+  dev.usbIf = -1;
+  dev.type = DeviceType::None;
+  dev.off = false;
+}
+
 } // namespace
 
+// lives in UsbSerialContext::arena for the duration of one uevent
 struct UsbEnumeratorNetlink::UsbInterfaceAttr {
+  explicit UsbInterfaceAttr(std::pmr::memory_resource *mr)
+    : identity(mr), tty(mr), serial(mr), productDesc(mr), parentHub(mr) {}
+
   uint8_t numinterfaces;
   uint8_t busnum;
   uint8_t devaddr;
   uint16_t vendor{0};
   uint16_t product{0};
-  std::string identity;
-  std::string tty;
-  std::string serial;
-  std::string productDesc;
+  std::pmr::string identity;
+  std::pmr::string tty;
+  std::pmr::string serial;
+  std::pmr::string productDesc;
+  std::pmr::string parentHub;
+  UsbSpeed speed{UsbSpeed::Unknown};
+  UsbSpeed parentSpeed{UsbSpeed::Unknown};
   int ifnum{-1};
   uint8_t usbClass{0};
   uint8_t usbSubClass{0};
@@ -93,8 +108,6 @@ namespace {
 using UsbInterfaceAttrs = UsbEnumeratorNetlink::UsbInterfaceAttr;
 using UsbSerialContext = UsbEnumeratorNetlink::UsbSerialContext;
 
-#define SYSFS_DEVICE_PATH "/sys/bus/usb/devices"
-
 #define NL_GROUP_KERNEL 1
 
 #ifndef SOCK_CLOEXEC
@@ -114,12 +127,12 @@ int set_fd_cloexec_nb(int fd, int socktype)
   if (!(socktype & SOCK_CLOEXEC)) {
     flags = fcntl(fd, F_GETFD);
     if (flags == -1) {
-      usbi_err("failed to get netlink fd flags, errno=%d", errno);
+      DEVICE_WATCH_LOG_ERROR("failed to get netlink fd flags, errno={}", errno);
       return -1;
     }
 
     if (fcntl(fd, F_SETFD, flags | FD_CLOEXEC) == -1) {
-      usbi_err("failed to set netlink fd flags, errno=%d", errno);
+      DEVICE_WATCH_LOG_ERROR("failed to set netlink fd flags, errno={}", errno);
       return -1;
     }
   }
@@ -129,12 +142,12 @@ int set_fd_cloexec_nb(int fd, int socktype)
   if (!(socktype & SOCK_NONBLOCK)) {
     flags = fcntl(fd, F_GETFL);
     if (flags == -1) {
-      usbi_err("failed to get netlink fd status flags, errno=%d", errno);
+      DEVICE_WATCH_LOG_ERROR("failed to get netlink fd status flags, errno={}", errno);
       return -1;
     }
 
     if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
-      usbi_err("failed to set netlink fd status flags, errno=%d", errno);
+      DEVICE_WATCH_LOG_ERROR("failed to set netlink fd status flags, errno={}", errno);
       return -1;
     }
   }
@@ -142,14 +155,14 @@ int set_fd_cloexec_nb(int fd, int socktype)
   return 0;
 }
 
-#if _DEBUG
+#if DEVICE_WATCH_LOG_LEVEL == 0
 
 void netlink_message_dump(const char *buffer, size_t len)
 {
-  usbi_dbg("-----------------------------------------");
+  DEVICE_WATCH_LOG_DEBUG("-----------------------------------------");
   const char *end = buffer + len;
   while (buffer < end && *buffer) {
-    usbi_dbg(">> %s", buffer);
+    DEVICE_WATCH_LOG_DEBUG(">> {}", buffer);
     buffer += strlen(buffer) + 1;
   }
 }
@@ -160,107 +173,45 @@ inline void netlink_message_dump(const char *buffer, size_t len) {}
 
 #endif
 
-const char *netlink_message_parse(const char *buffer, size_t len, const char *key)
-{
-  const char *end = buffer + len;
-  size_t keylen = strlen(key);
-
-  while (buffer < end && *buffer) {
-    if (strncmp(buffer, key, keylen) == 0 && buffer[keylen] == '=')
-      return buffer + keylen + 1;
-    buffer += strlen(buffer) + 1;
-  }
-
-  return nullptr;
-}
-
-int _sysfs_read_attr(const char *sysfs_dir, const char *attr, int *value_p, bool hex)
-{
-  char buf[20], *endptr;
-  long value;
-  ssize_t r;
-
-  char attr_path[MAX_PATH_LEN];
-  snprintf(attr_path, sizeof(attr_path), "%s/%s", sysfs_dir, attr);
-  int fd = open(attr_path, O_RDONLY | O_CLOEXEC);
-  if (fd < 0)
-    return fd;
-
-  r = read(fd, buf, sizeof(buf));
-  close(fd);
-  if (r < 0) {
-    return r;
-  }
-
-  if (r == 0) {
-    /* Certain attributes (e.g. bConfigurationValue) are not
-     * populated if the device is not configured. */
-    return -1;
-  }
-
-  buf[r - 1] = '\0';
-  errno = 0;
-
-  if (hex) {
-    value = strtol(buf, &endptr, 16);
-    if (value < 0 || errno) {
-      return -2;
-    }
+// 1-9.1 hangs off hub 1-9, 1-9 off root hub usb1.
+// device_dir is either <sysfs>/bus/usb/devices/1-9.1, with the hub as a sibling,
+// or the real <sysfs>/devices/.../usb1/1-9/1-9.1, with the hub as the parent.
+void sysfs_get_usb_parent_hub(const char *device_dir, UsbInterfaceAttrs &attr) {
+  const char *device_name = strrchr(device_dir, '/') + 1;
+  char parent[64];
+  const char *dot = strrchr(device_name, '.');
+  if (dot) {
+    snprintf(parent, sizeof(parent), "%.*s", (int)(dot - device_name), device_name);
   } else {
-    value = strtol(buf, &endptr, 10);
-    if (value < 0|| errno) {
-      return -2;
-    } else if (*endptr != '\0') {
-      /* Consider the value to be valid if the remainder is a '.'
-      * character followed by numbers.  This occurs, for example,
-      * when reading the "speed" attribute for a low-speed device
-      * (e.g. "1.5") */
-      if (*endptr == '.' && isdigit(*(endptr + 1))) {
-        endptr++;
-        while (isdigit(*endptr))
-          endptr++;
-      }
-      if (*endptr != '\0') {
-        return -2;
-      }
+    const char *dash = strchr(device_name, '-');
+    if (!dash) {
+      return;
     }
+    snprintf(parent, sizeof(parent), "usb%.*s", (int)(dash - device_name), device_name);
   }
 
-  *value_p = (int)value;
-  return 0;
-}
-
-template <typename T>
-int sysfs_read_attr(const char *sysfs_dir, const char *attr, T &value, bool hex) {
-  int sysfs_val;
-  int r = _sysfs_read_attr(sysfs_dir, attr, &sysfs_val, hex);
-  if (r == 0) {
-    value = static_cast<T>(sysfs_val);
+  char parent_dir[MAX_PATH_LEN];
+  int dir_len = (int)(device_name - 1 - device_dir);
+  const char *up = static_cast<const char *>(memrchr(device_dir, '/', dir_len));
+  size_t parent_len = strlen(parent);
+  if (up && (size_t)(device_name - 2 - up) == parent_len && memcmp(up + 1, parent, parent_len) == 0) {
+    snprintf(parent_dir, sizeof(parent_dir), "%.*s", dir_len, device_dir);
+  } else {
+    snprintf(parent_dir, sizeof(parent_dir), "%.*s/%s", dir_len, device_dir, parent);
   }
 
-  return r;
-}
-
-template <>
-int sysfs_read_attr<std::string>(const char *sysfs_dir, const char *attr, std::string &value, bool) {
-  char attr_path[MAX_PATH_LEN];
-  snprintf(attr_path, sizeof(attr_path), "%s/%s", sysfs_dir, attr);
-  int fd = open(attr_path, O_RDONLY | O_CLOEXEC);
-  if (fd > 0) {
-    char buf[MAX_PATH_LEN];
-    int r = read(fd, buf, sizeof(buf) - 1);
-    close(fd);
-    if (r > 0) {
-      buf[r--] = 0;
-      if (r > 0 && buf[r] == '\n') {
-        buf[r] = 0;
-      }
-      value = buf;
-      return 0;
-    }
+  int speed = 0;
+  if (sysfs_read_attr(parent_dir, "speed", speed, false) == 0) {
+    attr.parentSpeed = usbSpeedFromMbps(speed);
   }
 
-  return -1;
+  // same naming as identity: USB1-9
+  char identity[80] = "USB";
+  strcat(identity, parent[0] == 'u' ? parent + 3 : parent);
+  for (char *i = &identity[3]; *i; i++) {
+    if (*i == '.') *i = '-';
+  }
+  attr.parentHub = identity;
 }
 
 int sysfs_get_usb_attributes(const char *device_dir, UsbInterfaceAttrs &attr) {
@@ -303,13 +254,21 @@ int sysfs_get_usb_attributes(const char *device_dir, UsbInterfaceAttrs &attr) {
   }
   attr.identity = identity;
 
+  int speed = 0;
+  if (sysfs_read_attr(device_dir, "speed", speed, false) == 0) {
+    attr.speed = usbSpeedFromMbps(speed);
+  }
+
+  sysfs_get_usb_parent_hub(device_dir, attr);
+
   return 0;
 }
 
+template <class OnInterface>
 int sysfs_get_usb_interface_adb(
     const char *device_dir,
     UsbInterfaceAttrs &attr,
-    const std::function<void(const UsbInterfaceAttrs*)> &onInterfaceEnumerated) {
+    const OnInterface &onInterfaceEnumerated) {
 
   if (sysfs_get_usb_attributes(device_dir, attr) != 0) {
     return -1;
@@ -319,12 +278,13 @@ int sysfs_get_usb_interface_adb(
   return 0;
 }
 
+template <class OnInterface>
 int sysfs_get_usb_interface_adb(
     const char *interface_dir,
     const char *device_dir,
     UsbInterfaceAttrs &attr,
-    const std::function<void(const UsbInterfaceAttrs*)> &onInterfaceEnumerated) {
-  int usb_class, usb_subclass, usb_protocol;
+    const OnInterface &onInterfaceEnumerated) {
+  int usb_class = 0, usb_subclass = 0, usb_protocol = 0;
   int r = sysfs_read_attr(interface_dir, "bInterfaceClass", usb_class, true);
   if (r < 0) 
     return r;
@@ -347,10 +307,11 @@ int sysfs_get_usb_interface_adb(
     onInterfaceEnumerated);
 }
 
+template <class OnInterface>
 int sysfs_get_usb_interface_tty_devname(
     const char *interface_dir,
     UsbInterfaceAttrs &attr,
-    const std::function<void(const UsbInterfaceAttrs*)> &onInterfaceEnumerated) {
+    const OnInterface &onInterfaceEnumerated) {
   DIR *dir = opendir(interface_dir); 
   if (!dir) {
     return -1;
@@ -372,11 +333,12 @@ int sysfs_get_usb_interface_tty_devname(
   return -1;
 }
 
+template <class OnInterface>
 int sysfs_get_usb_interface_tty(
     const char *device_dir,
     UsbInterfaceAttrs &attr,
     int ifnum,
-    const std::function<void(const UsbInterfaceAttrs*)> &onInterfaceEnumerated) {
+    const OnInterface &onInterfaceEnumerated) {
   if (sysfs_get_usb_attributes(device_dir, attr) != 0) {
     return -1;
   }
@@ -389,15 +351,9 @@ void set_expect_tty_usbserial(
     UsbSerialContext &ttyCtx,
     uint16_t vid,
     uint16_t pid,
-    const std::string &devpath,
-    const std::vector<int> ifnums,
+    std::string_view devpath,
+    int ifnum,
     int timeout) {
-  int ifnum = 0;
-
-  if (ifnums.size()) {
-    ifnum = ifnums[0];
-  }
-
     // a tty subssystem device should emerge
     // if not, we dynamiclly do mobprobe usbserial
   ttyCtx.timeout = timeout;
@@ -408,19 +364,21 @@ void set_expect_tty_usbserial(
   ttyCtx.time = std::chrono::steady_clock::now();
 }
 
+template <class OnInterface>
 int sysfs_get_usb_device(
     const char *device_dir,
     UsbSerialContext &ttyCtx,
-    const std::function<void(const UsbInterfaceAttrs*)> &onInterfaceEnumerated) {
+    const OnInterface &onInterfaceEnumerated) {
   DIR *interfaces = opendir(device_dir);
   if (!interfaces) {
     return -1;
   }
 
   bool ttyFound = false;
-  std::vector<int> unknownIfs;
-  UsbInterfaceAttrs attr;
+  int unknownIf = -1;
+  UsbInterfaceAttrs attr(&ttyCtx.arena);
   if (sysfs_get_usb_attributes(device_dir, attr) != 0) {
+    closedir(interfaces);
     return -1;
   }
 
@@ -430,7 +388,8 @@ int sysfs_get_usb_device(
       continue;
 
     char interface_dir[MAX_PATH_LEN];
-    snprintf(interface_dir, sizeof(interface_dir), "%s/%s", device_dir, entry->d_name);
+    if (!sysfs_attr_path(interface_dir, device_dir, entry->d_name))
+      continue;
 
     // parse interface number ...1:1.[0]
     int ifnum = -1;
@@ -452,19 +411,19 @@ int sysfs_get_usb_device(
     }
 
     // parse interface number ...1:1.[0]
-    if (ifnum >= 0) {
-      unknownIfs.push_back(ifnum);
+    if (ifnum >= 0 && unknownIf < 0) {
+      unknownIf = ifnum;
     }
   }
 
-  if (!ttyFound && unknownIfs.size()) {
-    if (isUsb2SerialDevice(settings_.usb2serialVidPid, attr.vendor, attr.product)) {
+  if (!ttyFound && unknownIf >= 0) {
+    if (isUsb2SerialDevice(ttyCtx.usb2serialVidPid, attr.vendor, attr.product)) {
       set_expect_tty_usbserial(
         ttyCtx,
         attr.vendor,
         attr.product,
         "",
-        {unknownIfs},
+        unknownIf,
         1); // expire immerately
     }
   }
@@ -472,10 +431,11 @@ int sysfs_get_usb_device(
   return 0;
 }
 
-int sysfs_get_device_list(UsbSerialContext &ttyCtx, const std::function<void(const UsbInterfaceAttrs*)> &onInterfaceEnumerated) {
-  constexpr const char *sysfs_device_path = SYSFS_DEVICE_PATH;
+template <class OnInterface>
+int sysfs_get_device_list(UsbSerialContext &ttyCtx, const OnInterface &onInterfaceEnumerated) {
+  std::string sysfs_device_path = ttyCtx.sysfsRoot + "/bus/usb/devices";
 
-  DIR *devices = opendir(sysfs_device_path);
+  DIR *devices = opendir(sysfs_device_path.c_str());
   if (!devices) {
     return -1;
   }
@@ -487,9 +447,10 @@ int sysfs_get_device_list(UsbSerialContext &ttyCtx, const std::function<void(con
       continue;
 
     char device_dir[MAX_PATH_LEN];
-    snprintf(device_dir, sizeof(device_dir), "%s/%s", sysfs_device_path, entry->d_name);
+    snprintf(device_dir, sizeof(device_dir), "%s/%s", sysfs_device_path.c_str(), entry->d_name);
 
     sysfs_get_usb_device(device_dir, ttyCtx, onInterfaceEnumerated);
+    ttyCtx.arena.release();
   }
 
   closedir(devices);
@@ -504,7 +465,7 @@ unpack_value(const char *str, int type) {
   for (int i = 0; i < 3; i++) {
     const char *p1 = (i == 2) ? (p0 + strlen(p0)) : strchr(p0, '/');
     if (!p1) {
-      usbi_err("bad value format, %s", str);
+      DEVICE_WATCH_LOG_ERROR("bad value format, {}", str);
       break;
     }
     std::from_chars(p0, p1, v[i], type);
@@ -514,11 +475,12 @@ unpack_value(const char *str, int type) {
   return { v[0], v[1], v[2] };
 }
 
+template <class OnInterface>
 int linux_netlink_parse_usb_interface_add(
     const char *buffer,
     size_t len,
     UsbSerialContext &ttyCtx,
-    const std::function<void(const UsbInterfaceAttrs*)> &onInterfaceEnumerated)
+    const OnInterface &onInterfaceEnumerated)
 {
   // PRODUCT=31ef/3001/0
   // INTERFACE=255/255/255
@@ -527,7 +489,7 @@ int linux_netlink_parse_usb_interface_add(
   const char *interface = netlink_message_parse(buffer, len, "INTERFACE");
   const char *devpath = netlink_message_parse(buffer, len, "DEVPATH");
   if (!product || !interface || !devpath) {
-    usbi_err("usb_interface without PRODUCT | INTERFACE | DEVPATH value");
+    DEVICE_WATCH_LOG_ERROR("usb_interface without PRODUCT | INTERFACE | DEVPATH value");
     return -1;
   }
 
@@ -542,26 +504,30 @@ int linux_netlink_parse_usb_interface_add(
   auto [vid, pid, _] = unpack_value(product, 16);
   auto [cls, subclass, proto] = unpack_value(interface, 10);
 
-  if (isUsb2SerialDevice(settings_.usb2serialVidPid, vid, pid)) {
+  if (isUsb2SerialDevice(ttyCtx.usb2serialVidPid, vid, pid)) {
     set_expect_tty_usbserial(
         ttyCtx,
         vid,
         pid,
         devpath,
-        {ifnum},
+        ifnum,
         1000);
   } else {
     // construct device_path from devpath
     // strip off last interface entry
-    char device_dir[MAX_PATH_LEN] = "/sys";
-    strcat(device_dir, devpath);
+    char device_dir[MAX_PATH_LEN];
+    snprintf(device_dir, sizeof(device_dir), "%s%s", ttyCtx.sysfsRoot.c_str(), devpath);
     // strip off "/1-9.1:1.0"
     char *slash = strrchr(device_dir, '/');
     *slash = 0;
 
-    UsbInterfaceAttrs attr;
+    UsbInterfaceAttrs attr(&ttyCtx.arena);
     attr.vendor = vid;
     attr.product = pid;
+    attr.usbClass = cls;
+    attr.usbSubClass = subclass;
+    attr.usbProto = proto;
+    attr.ifnum = ifnum;
 
     return sysfs_get_usb_interface_adb(
       device_dir,
@@ -572,11 +538,12 @@ int linux_netlink_parse_usb_interface_add(
   return -1;
 }
 
+template <class OnInterface>
 int linux_netlink_parse_usb_add(
     const char *buffer,
     size_t len,
     UsbSerialContext &ttyCtx,
-    const std::function<void(const UsbInterfaceAttrs*)> &onInterfaceEnumerated)
+    const OnInterface &onInterfaceEnumerated)
 {
   // DEVTYPE=usb_interface
   const char *devtype = netlink_message_parse(buffer, len, "DEVTYPE");
@@ -587,18 +554,19 @@ int linux_netlink_parse_usb_add(
   return -1;
 }
 
+template <class OnInterface>
 int linux_netlink_parse_tty_add(
     const char *buffer,
     size_t len,
     UsbSerialContext &ttyCtx,
-    const std::function<void(const UsbInterfaceAttrs*)> &onInterfaceEnumerated)
+    const OnInterface &onInterfaceEnumerated)
 {
   // DEVPATH=/devices/pci0000:00/0000:00:14.0/usb1/1-9/1-9.1/1-9.1:1.0/ttyUSB0/tty/ttyUSB0
   // DEVNAME=ttyUSB0
   const char *devname = netlink_message_parse(buffer, len, "DEVNAME");
   const char *devpath = netlink_message_parse(buffer, len, "DEVPATH");
   if (!devname || !devpath) {
-    usbi_err("tty without DEVNAME | DEVPATH value");
+    DEVICE_WATCH_LOG_ERROR("tty without DEVNAME | DEVPATH value");
     return -1;
   }
 
@@ -612,8 +580,8 @@ int linux_netlink_parse_tty_add(
 
   // construct device_path from devpath
   // strip off last interface entry
-  char device_dir[MAX_PATH_LEN] = "/sys";
-  strcat(device_dir, devpath);
+  char device_dir[MAX_PATH_LEN];
+  snprintf(device_dir, sizeof(device_dir), "%s%s", ttyCtx.sysfsRoot.c_str(), devpath);
   // strip off "/1-9.1:1.0/ttyUSB0/tty/ttyUSB0"
   char *slash = strrchr(device_dir, ':');
   if (!slash) {
@@ -632,7 +600,7 @@ int linux_netlink_parse_tty_add(
   slash = strrchr(device_dir, '/');
   *slash = 0;
 
-  UsbInterfaceAttrs attr;
+  UsbInterfaceAttrs attr(&ttyCtx.arena);
   attr.tty = devname;
   attr.ifnum = ifnum;
 
@@ -643,11 +611,12 @@ int linux_netlink_parse_tty_add(
     onInterfaceEnumerated);
 }
 
+template <class OnInterface>
 int linux_netlink_parse_action_add(
     const char *buffer,
     size_t len,
     UsbSerialContext &ttyCtx,
-    const std::function<void(const UsbInterfaceAttrs*)> &onInterfaceEnumerated)
+    const OnInterface &onInterfaceEnumerated)
 {
   const char *subsystem = netlink_message_parse(buffer, len, "SUBSYSTEM");
   if (subsystem && strcmp(subsystem, "usb") == 0) {
@@ -661,11 +630,12 @@ int linux_netlink_parse_action_add(
   return -1;
 }
 
+template <class OnUsbOff>
 int linux_netlink_parse_action_remove(
     const char *buffer,
     size_t len,
     UsbSerialContext &ttyCtx,
-    const std::function<void(uint8_t busnum, uint8_t devaddr)> &onUsbOff)
+    const OnUsbOff &onUsbOff)
 {
 
   // DEVPATH=/devices/pci0000:00/0000:00:14.0/usb1/1-9/1-9.1
@@ -717,30 +687,40 @@ int linux_netlink_parse_action_remove(
 }
 
 // parse parts of netlink message common to both libudev and the kernel
+template <class OnInterface, class OnUsbOff>
 int linux_netlink_parse(
     const char *buffer,
     size_t len,
     UsbSerialContext &ttyCtx,
-    const std::function<void(const UsbInterfaceAttrs*)> &onInterfaceEnumerated,
-    const std::function<void(uint8_t busnum, uint8_t devaddr)> &onUsbOff)
+    const OnInterface &onInterfaceEnumerated,
+    const OnUsbOff &onUsbOff)
 {
   netlink_message_dump(buffer, len);
 
+  tracing::TraceSpan span("enumerator", "uevent");
+  [[maybe_unused]] auto start = DEVICE_WATCH_PROBE_NOW(uevent_parse);
+  int r = -1;
+
   const char *action = netlink_message_parse(buffer, len, "ACTION");
   if (action && strcmp(action, "add") == 0) {
-    return linux_netlink_parse_action_add(buffer, len, ttyCtx, onInterfaceEnumerated);
+    r = linux_netlink_parse_action_add(buffer, len, ttyCtx, onInterfaceEnumerated);
   } else if (action && strcmp(action, "remove") == 0) {
-    return linux_netlink_parse_action_remove(buffer, len, ttyCtx, onUsbOff);
+    r = linux_netlink_parse_action_remove(buffer, len, ttyCtx, onUsbOff);
   }
 
-  return -1;
+  span.arg("action", action ? action : "").arg("bytes", len);
+  DEVICE_WATCH_PROBE(uevent_parse, action ? action : "", len, DEVICE_WATCH_PROBE_SINCE(start));
+  return r;
 }
 
+// trusted: fd is an injected uevent socket, not bound to the kernel group
+template <class OnInterface, class OnUsbOff>
 int linux_netlink_read_message(
     int fd,
+    bool trusted,
     UsbSerialContext &ttyCtx,
-    const std::function<void(const UsbInterfaceAttrs*)> &onInterfaceEnumerated,
-    const std::function<void(uint8_t busnum, uint8_t devaddr)> &onUsbOff)
+    const OnInterface &onInterfaceEnumerated,
+    const OnUsbOff &onUsbOff)
 {
   char cred_buffer[CMSG_SPACE(sizeof(struct ucred))];
   char msg_buffer[2048];
@@ -760,30 +740,36 @@ int linux_netlink_read_message(
   len = recvmsg(fd, &msg, 0);
   if (len == -1) {
     if (errno != EAGAIN && errno != EINTR)
-      usbi_err("error receiving message from netlink, errno=%d", errno);
+      DEVICE_WATCH_LOG_ERROR("error receiving message from netlink, errno={}", errno);
     return -1;
   }
 
   if (len < 32 || (msg.msg_flags & MSG_TRUNC)) {
-    usbi_err("invalid netlink message length");
+    DEVICE_WATCH_LOG_ERROR("invalid netlink message length");
     return -1;
   }
 
+  DEVICE_WATCH_PROBE(netlink_recv, len);
+
+  if (trusted) {
+    return linux_netlink_parse(msg_buffer, (size_t)len, ttyCtx, onInterfaceEnumerated, onUsbOff);
+  }
+
   if (sa_nl.nl_groups != NL_GROUP_KERNEL || sa_nl.nl_pid != 0) {
-    usbi_dbg("ignoring netlink message from unknown group/PID (%u/%u)",
-      (unsigned int)sa_nl.nl_groups, (unsigned int)sa_nl.nl_pid);
+    DEVICE_WATCH_LOG_DEBUG("ignoring netlink message from unknown group/PID ({}/{})",
+      sa_nl.nl_groups, sa_nl.nl_pid);
     return -1;
   }
 
   cmsg = CMSG_FIRSTHDR(&msg);
   if (!cmsg || cmsg->cmsg_type != SCM_CREDENTIALS) {
-    usbi_dbg("ignoring netlink message with no sender credentials");
+    DEVICE_WATCH_LOG_DEBUG("ignoring netlink message with no sender credentials");
     return -1;
   }
 
   cred = (struct ucred *)CMSG_DATA(cmsg);
   if (cred->uid != 0) {
-    usbi_dbg("ignoring netlink message with non-zero sender UID %u", (unsigned int)cred->uid);
+    DEVICE_WATCH_LOG_DEBUG("ignoring netlink message with non-zero sender UID {}", cred->uid);
     return -1;
   }
 
@@ -822,13 +808,29 @@ int UsbEnumeratorNetlink::createNetlink() {
   netlinkfd_ = -1;
   eventfd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
   if (eventfd_ == -1) {
-    usbi_err("failed to create eventfd, errno=%d", errno);
+    DEVICE_WATCH_LOG_ERROR("failed to create eventfd, errno={}", errno);
     return -1;
   }
 
+  expect_tty_.timeout = 0;
+  expect_tty_.sysfsRoot = settings_.sysfsRoot;
+  expect_tty_.usb2serialVidPid = settings_.usb2serialVidPid;
+
+  if (settings_.ueventFd >= 0) {
+    int fd = fcntl(settings_.ueventFd, F_DUPFD_CLOEXEC, 0);
+    if (fd == -1 || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1) {
+      DEVICE_WATCH_LOG_ERROR("failed to take the injected uevent socket, errno={}", errno);
+      if (fd >= 0) close(fd);
+      return -1;
+    }
+    injected_ = true;
+    netlinkfd_ = fd;
+    return fd;
+  }
+
   int fd = socket(PF_NETLINK, socktype, NETLINK_KOBJECT_UEVENT);
   if (fd == -1 && errno == EINVAL) {
-    usbi_dbg("failed to create netlink socket of type %d, attempting SOCK_RAW", socktype);
+    DEVICE_WATCH_LOG_DEBUG("failed to create netlink socket of type {}, attempting SOCK_RAW", socktype);
     socktype = SOCK_RAW;
     fd = socket(PF_NETLINK, socktype, NETLINK_KOBJECT_UEVENT);
   }
@@ -854,8 +856,6 @@ int UsbEnumeratorNetlink::createNetlink() {
     return r;
   }
 
-  expect_tty_.timeout = 0;
-
   netlinkfd_ = fd;
   return fd;
 }
@@ -907,7 +907,7 @@ bool UsbEnumeratorNetlink::poll(bool blocking) {
     // check for temporary failure
     if (errno == EINTR)
       return true;
-    usbi_err("poll() failed, errno=%d", errno);
+    DEVICE_WATCH_LOG_ERROR("poll() failed, errno={}", errno);
     return false;
   }
 
@@ -923,50 +923,63 @@ bool UsbEnumeratorNetlink::poll(bool blocking) {
   if (fds[1].revents) {
     linux_netlink_read_message(
       netlinkfd_,
+      injected_,
       expect_tty_,
       [this](const UsbInterfaceAttrs *attr) {
         sysfs_usb_interface_enumerated(attr);
       },
       [this](uint8_t busnum, uint8_t devaddr) {
-        uint16_t session_id = ((uint16_t)busnum << 8) | devaddr;
-        onUsbInterfaceOff(std::to_string(session_id));
+        onUsbInterfaceOff(session_interface_id(busnum, devaddr));
         unload_driver();
       });
+    expect_tty_.arena.release();
   }
 
   return true;
 }
 
 void UsbEnumeratorNetlink::enumerateDevices() {
+  expect_tty_.sysfsRoot = settings_.sysfsRoot;
+  expect_tty_.usb2serialVidPid = settings_.usb2serialVidPid;
   sysfs_get_device_list(expect_tty_, [this](const UsbInterfaceAttrs *attr) {
     sysfs_usb_interface_enumerated(attr);
   });
 }
 
+// the decimal (busnum << 8) | devaddr
+const std::string &UsbEnumeratorNetlink::session_interface_id(uint8_t busnum, uint8_t devaddr) {
+  uint16_t session_id = ((uint16_t)busnum << 8) | devaddr;
+  char text[8];
+  auto end = std::to_chars(text, text + sizeof(text), session_id).ptr;
+  interface_id_.assign(text, end);
+  return interface_id_;
+}
+
 void UsbEnumeratorNetlink::sysfs_usb_interface_enumerated(const UsbInterfaceAttr* attr) {
   //printf("device %s\n", attr->tty.c_str());
-  DeviceInterface newnode;
+  auto &newnode = node_;
+  reset_interface(newnode);
   newnode.hub = attr->identity;
   newnode.vid = attr->vendor;
   newnode.pid = attr->product;
   newnode.serial = attr->serial;
   newnode.usbIf = attr->ifnum;
+  newnode.speed = attr->speed;
+  newnode.parentHub = attr->parentHub;
+  newnode.parentHubSpeed = attr->parentSpeed;
 
   if (attr->numinterfaces == 1) {
     newnode.usbIf = -1;
   }
 
-  uint16_t session_id = ((uint16_t)attr->busnum << 8) | attr->devaddr;
-  auto interface_id = std::to_string(session_id);
-
   if (attr->tty.size()) {
-    newnode.devpath = "/dev/" + attr->tty;
+    newnode.devpath.assign("/dev/").append(attr->tty);
     newnode.description = attr->tty;
     // usb2serial
     newnode.type = DeviceType::Usb | DeviceType::Serial;
   } else {
     newnode.type = DeviceType::Usb;
-    newnode.description = "USB - " + attr->identity;
+    newnode.description.assign("USB - ").append(attr->identity);
     newnode.usbClass = attr->usbClass;
     newnode.usbSubClass = attr->usbSubClass;
     newnode.usbProto = attr->usbProto;
@@ -976,7 +989,7 @@ void UsbEnumeratorNetlink::sysfs_usb_interface_enumerated(const UsbInterfaceAttr
     newnode.description = attr->productDesc;
   }
 
-  this->onUsbInterfaceEnumerated(interface_id, std::move(newnode));
+  this->onUsbInterfaceEnumerated(session_interface_id(attr->busnum, attr->devaddr), std::move(newnode));
   // printf("busnum %x devaddr %x vendor %x product %x [%s %s %s]\n", busnum, devaddr, vendor, product, newnode.description.c_str(), tty.c_str(), serial.c_str());
 }
 
@@ -1002,3 +1015,7 @@ void UsbWatcherNetLink::createWatch(std::function<void(bool)> &&cb) noexcept {
 }
 
 } // namespace device_enumerator
+
+#ifdef ENABLE_TEST
+#include "usb-watch-netlink_tests.cc"
+#endif
@@ -20,7 +20,9 @@
 
 #pragma once 
 #include "usb-watch-base.h"
+#include <array>
 #include <chrono>
+#include <memory_resource>
 
 namespace device_enumerator {
 
@@ -34,6 +36,15 @@ public:
     uint16_t pid{0};
     int ifnum;
     std::chrono::steady_clock::time_point time;
+
+    // from the watch settings, for the enumeration helpers
+    std::string sysfsRoot{"/sys"};
+    std::vector<std::pair<uint16_t, uint16_t>> usb2serialVidPid;
+
+    // scratch memory of the uevent (or enumerated device) being handled,
+    // released once it is done. what survives is copied into a DeviceInterface.
+    std::array<std::byte, 4096> arenaBuffer;
+    std::pmr::monotonic_buffer_resource arena{arenaBuffer.data(), arenaBuffer.size()};
   };
 
   ~UsbEnumeratorNetlink();
@@ -47,14 +58,22 @@ protected:
 
 private:
   void sysfs_usb_interface_enumerated(const UsbInterfaceAttr*);
+  const std::string &session_interface_id(uint8_t busnum, uint8_t devaddr);
 
   void load_driver();
   void unload_driver();
 
   int eventfd_{-1};
   int netlinkfd_{-1};
+  // netlinkfd_ is a dup of WatchSettings::ueventFd
+  bool injected_{false};
   UsbSerialContext expect_tty_;
   bool driver_manually_loaded_{false};
+
+  // rebuilt for every interface enumerated, their strings keep their
+  // capacity so that steady uevent traffic does not allocate
+  DeviceInterface node_;
+  std::string interface_id_;
 };
 
 class UsbWatcherNetLink : public UsbEnumeratorNetlink {
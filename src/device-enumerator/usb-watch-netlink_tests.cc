@@ -0,0 +1,280 @@
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <new>
+
+// counts the operator new calls of a thread while it has an AllocationCounter,
+// the other threads and tests of the binary only go through malloc / free.
+// every replaceable form is defined, so that no pair mixes this allocator
+// with the library one.
+namespace {
+
+thread_local size_t *counted_allocations = nullptr;
+
+void *allocate(size_t size, size_t align) {
+  if (counted_allocations) {
+    (*counted_allocations)++;
+  }
+  size = size ? size : 1;
+  for (;;) {
+    void *p = align <= alignof(std::max_align_t)
+        ? std::malloc(size)
+        : std::aligned_alloc(align, (size + align - 1) / align * align);
+    if (p) {
+      return p;
+    }
+    auto handler = std::get_new_handler();
+    if (!handler) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+// out of line: inlined into a delete, gcc pairs the free with the
+// operator new of the caller (-Wmismatched-new-delete)
+[[gnu::noinline]] void release(void *p) noexcept {
+  std::free(p);
+}
+
+} // namespace
+
+void *operator new(size_t size) {
+  return allocate(size, 0);
+}
+
+void *operator new[](size_t size) {
+  return allocate(size, 0);
+}
+
+void *operator new(size_t size, std::align_val_t align) {
+  return allocate(size, size_t(align));
+}
+
+void *operator new[](size_t size, std::align_val_t align) {
+  return allocate(size, size_t(align));
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return allocate(size, 0);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return ::operator new(size, std::nothrow);
+}
+
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+  try {
+    return allocate(size, size_t(align));
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+  return ::operator new(size, align, std::nothrow);
+}
+
+void operator delete(void *p) noexcept {
+  release(p);
+}
+
+void operator delete[](void *p) noexcept {
+  release(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  release(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  release(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+  release(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept {
+  release(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+  release(p);
+}
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept {
+  release(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+  release(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+  release(p);
+}
+
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept {
+  release(p);
+}
+
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept {
+  release(p);
+}
+
+namespace device_enumerator {
+
+namespace {
+
+class AllocationCounter {
+public:
+  AllocationCounter() { counted_allocations = &count_; }
+  ~AllocationCounter() { counted_allocations = nullptr; }
+
+  size_t count() const { return count_; }
+
+private:
+  size_t count_{0};
+};
+
+// the real uevent -> sysfs -> watch pipeline -> callback path,
+// fed through an injected uevent socket
+class TestEnumerator : public UsbEnumeratorNetlink {
+public:
+  using UsbEnumeratorNetlink::createNetlink;
+  using UsbEnumeratorNetlink::poll;
+
+  int on{0};
+  int off{0};
+
+private:
+  void onDeviceInterfaceChanged(const DeviceInterface &dev) override {
+    if (dev.off) {
+      off++;
+      return;
+    }
+    on += dev.type == (DeviceType::Usb | DeviceType::Adb) && dev.serial == "0123456789ABCDEF0123" &&
+        dev.hub == "USB1-9-1" && dev.parentHub == "USB1-9" &&
+        dev.description == "Pixel 7 Pro development board";
+  }
+};
+
+// <tmp>/uevent-alloc-test-<pid>/devices/usb1/1-9/1-9.1 with an adb interface,
+// serial and product long enough to leave the small string buffer
+std::filesystem::path make_test_device() {
+  auto root = std::filesystem::temp_directory_path() /
+      ("uevent-alloc-test-" + std::to_string(getpid()));
+  auto hub = root / "devices/usb1/1-9";
+  auto dev = hub / "1-9.1";
+  auto intf = dev / "1-9.1:1.0";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(intf);
+
+  auto attr = [](const std::filesystem::path &dir, const char *name, const char *value) {
+    std::ofstream(dir / name) << value << '\n';
+  };
+
+  attr(hub, "speed", "480");
+  attr(dev, "bNumInterfaces", " 1");
+  attr(dev, "busnum", "1");
+  attr(dev, "devnum", "16");
+  attr(dev, "idVendor", "18d1");
+  attr(dev, "idProduct", "4ee7");
+  attr(dev, "serial", "0123456789ABCDEF0123");
+  attr(dev, "product", "Pixel 7 Pro development board");
+  attr(dev, "speed", "480");
+  attr(intf, "bInterfaceClass", "ff");
+  attr(intf, "bInterfaceSubClass", "42");
+  attr(intf, "bInterfaceProtocol", "01");
+  return root;
+}
+
+std::string make_uevent(std::initializer_list<const char *> fields) {
+  std::string msg;
+  for (auto f : fields) {
+    msg += f;
+    msg += '\0';
+  }
+  return msg;
+}
+
+} // namespace
+
+TEST(UsbWatchNetlink, SteadyStateUeventAllocations) {
+  auto root = make_test_device();
+
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds), 0);
+
+  // adb devices would be handed to the adb thread, which has no server here
+  UsbEnumerator::WatchSettings settings;
+  settings.enableAdbClient = false;
+  settings.sysfsRoot = root.string();
+  settings.ueventFd = fds[0];
+
+  TestEnumerator watcher;
+  watcher.initSettings(settings);
+  ASSERT_GE(watcher.createNetlink(), 0);
+
+  auto add = make_uevent({
+    "add@/devices/usb1/1-9/1-9.1/1-9.1:1.0",
+    "ACTION=add",
+    "DEVPATH=/devices/usb1/1-9/1-9.1/1-9.1:1.0",
+    "SUBSYSTEM=usb",
+    "DEVTYPE=usb_interface",
+    "PRODUCT=18d1/4ee7/440",
+    "TYPE=0/0/0",
+    "INTERFACE=255/66/1",
+    "SEQNUM=5123",
+  });
+
+  auto remove = make_uevent({
+    "remove@/devices/usb1/1-9/1-9.1",
+    "ACTION=remove",
+    "DEVPATH=/devices/usb1/1-9/1-9.1",
+    "SUBSYSTEM=usb",
+    "DEVTYPE=usb_device",
+    "BUSNUM=001",
+    "DEVNUM=016",
+    "SEQNUM=5124",
+  });
+
+  auto deliver = [&](const std::string &msg) {
+    return send(fds[1], msg.data(), msg.size(), MSG_NOSIGNAL) == (ssize_t)msg.size() &&
+        watcher.poll(false);
+  };
+
+  // the first pair sizes the reused node and the cache entry
+  ASSERT_TRUE(deliver(add));
+  ASSERT_TRUE(deliver(remove));
+
+  constexpr int kEvents = 100;
+  bool delivered = true;
+  size_t allocations;
+  {
+    AllocationCounter heap;
+    for (int i = 0; i < kEvents; i++) {
+      delivered &= deliver(add);
+      delivered &= deliver(remove);
+    }
+    allocations = heap.count();
+  }
+
+  close(fds[0]);
+  close(fds[1]);
+  std::filesystem::remove_all(root);
+
+  ASSERT_TRUE(delivered);
+  ASSERT_EQ(watcher.on, kEvents + 1);
+  ASSERT_EQ(watcher.off, kEvents + 1);
+  // at most one per uevent handled
+  ASSERT_LE(allocations, size_t(2 * kEvents));
+}
+
+} // namespace device_enumerator
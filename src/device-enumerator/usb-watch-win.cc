@@ -561,6 +561,13 @@ void queryUsbProperties(const char *interface_name, const char *hub_device_id, U
       newdev.vid = conn_info.DeviceDescriptor.idVendor;
       newdev.pid = conn_info.DeviceDescriptor.idProduct;
 
+      switch (conn_info.Speed) {
+        case UsbLowSpeed: newdev.speed = UsbSpeed::Low; break;
+        case UsbFullSpeed: newdev.speed = UsbSpeed::Full; break;
+        case UsbHighSpeed: newdev.speed = UsbSpeed::High; break;
+        case UsbSuperSpeed: newdev.speed = UsbSpeed::Super; break;
+      }
+
       for (UCHAR i = 0; i < conn_info.DeviceDescriptor.bNumConfigurations; i++) {
 
         memset(&cd_buf_short, 0, sizeof(cd_buf_short));
@@ -797,6 +804,8 @@ void UsbEnumeratorWindows::handleUsbInterfaceEnumated(
   }
 
   newdev.usbIf = interfaceNumber;
+  // the hub link speed is not queried on windows, parentHubSpeed stays unknown
+  newdev.parentHub = parentHubOf(newdev.hub);
 
   if (newdev.hub.size()) {
     newdev.type |= DeviceType::Usb;
@@ -0,0 +1,103 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include "usb-watch-base.h"
+#include <tuple>
+#include <utility>
+
+namespace device_enumerator {
+
+// the way of an enumerated interface to the watcher callback:
+// enrichment stages derive what they can from the interface, the filter
+// drops what the settings exclude and the sink takes the rest.
+//
+// every stage is a template parameter, so the chain inlines end to end.
+// type erasure is left to the public boundary, the watcher's virtual
+// onDeviceInterfaceChanged.
+template <class Filter, class Sink, class... Stages>
+class WatchPipeline {
+public:
+  constexpr WatchPipeline(Filter filter, Sink sink, Stages... stages)
+    : filter_(std::move(filter)), sink_(std::move(sink)), stages_(std::move(stages)...) {}
+
+  // false when the filter dropped dev
+  constexpr bool operator()(DeviceInterface &dev) {
+    std::apply([&dev](auto &...stage) { (stage(dev), ...); }, stages_);
+    if (!filter_(std::as_const(dev))) {
+      return false;
+    }
+    sink_(dev);
+    return true;
+  }
+
+private:
+  [[no_unique_address]] Filter filter_;
+  [[no_unique_address]] Sink sink_;
+  [[no_unique_address]] std::tuple<Stages...> stages_;
+};
+
+// adb, fastboot and hdc interfaces by class / subclass / protocol
+struct ClassifyUsbInterface {
+  static constexpr uint8_t ADB_CLASS = 0xff;
+  static constexpr uint8_t ADB_SUBCLASS = 0x42;
+  static constexpr uint8_t ADB_PROTOCOL = 0x01;
+  static constexpr uint8_t FASTBOOT_PROTOCOL = 0x03;
+  static constexpr uint8_t HDC_SUBCLASS = 0x50;
+  static constexpr uint8_t HDC_PROTOCOL = 0x01;
+
+  constexpr void operator()(DeviceInterface &dev) const {
+    if (!(dev.type & DeviceType::Usb) || dev.usbClass != ADB_CLASS) {
+      return;
+    }
+
+    if (dev.usbSubClass == HDC_SUBCLASS && dev.usbProto == HDC_PROTOCOL) {
+      dev.type |= DeviceType::HDC;
+    } else if (dev.usbSubClass == ADB_SUBCLASS && dev.usbProto == ADB_PROTOCOL) {
+      dev.type |= DeviceType::Adb;
+    } else if (dev.usbSubClass == ADB_SUBCLASS && dev.usbProto == FASTBOOT_PROTOCOL) {
+      dev.type |= DeviceType::Fastboot;
+    }
+  }
+};
+
+// qualcomm emergency download mode
+struct ClassifyQdl {
+  static constexpr uint16_t QUALCOMM_VID = 0x05C6;
+  static constexpr uint16_t QDL_PID = 0x9008;
+
+  constexpr void operator()(DeviceInterface &dev) const {
+    if (dev.vid == QUALCOMM_VID && dev.pid == QDL_PID) {
+      dev.type |= DeviceType::QDL;
+    }
+  }
+};
+
+// type, vid, pid and driver filters of the settings
+struct SettingsFilter {
+  const UsbEnumerator::WatchSettings &settings;
+
+  bool operator()(const DeviceInterface &dev) const {
+    return shouldIncludeDevice(dev, settings);
+  }
+};
+
+} // namespace device_enumerator
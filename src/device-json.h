@@ -0,0 +1,73 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include "device-enumerator/usb-watch-base.h"
+#include <codecvt>
+#include <locale>
+#include <nlohmann/json.hpp>
+
+namespace nlohmann {
+  template <>
+  struct adl_serializer<std::wstring> {
+    static void to_json(nlohmann::json& j, const std::wstring& str) {
+      std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
+      j = converter.to_bytes(str);
+    }
+  };
+}
+
+namespace device_enumerator {
+
+// one device as printed by adb-device-watch, empty fields are left out
+inline nlohmann::json
+deviceNodeToJsonObject(const DeviceInterface &dev) {
+  nlohmann::json jdev;
+  
+  jdev["id"] = dev.identity.to_string();
+  if (dev.off) jdev["off"] = dev.off;
+  if (!dev.devpath.empty()) jdev["devpath"] = dev.devpath;
+  if (!dev.hub.empty()) jdev["hub"] = dev.hub;
+  if (!dev.serial.empty()) jdev["serial"] = dev.serial;
+  if (!dev.manufacturer.empty()) jdev["manufacturer"] = dev.manufacturer;
+  if (!dev.product.empty()) jdev["product"] = dev.product;
+  if (!dev.model.empty()) jdev["model"] = dev.model;
+  if (!dev.device.empty()) jdev["device"] = dev.device;
+  if (!dev.driver.empty()) jdev["driver"] = dev.driver;
+  if (!dev.ip.empty()) jdev["ip"] = dev.ip;
+  if (dev.port) jdev["port"] = dev.port;
+  if (dev.vid) jdev["vid"] = dev.vid;
+  if (dev.pid) jdev["pid"] = dev.pid;
+  if (dev.speed != UsbSpeed::Unknown) jdev["speed"] = usbSpeedMbps(dev.speed);
+  if (!dev.parentHub.empty()) jdev["parentHub"] = dev.parentHub;
+  if (!dev.adbServer.empty()) jdev["adbServer"] = dev.adbServer;
+  jdev["type"] = DeviceTypeConverter::stringfiyType(dev.type);
+  if (!dev.description.empty()) jdev["description"] = dev.description;
+  if (dev.type & DeviceType::Usb) {
+    jdev["usbClass"] = dev.usbClass;
+    jdev["usbSubClass"] = dev.usbSubClass;
+    jdev["usbProto"] = dev.usbProto;
+    jdev["usbIf"] = dev.usbIf;
+  }
+
+  return jdev;
+}
+
+} // namespace device_enumerator
@@ -0,0 +1,131 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "diag-tap.h"
+#include "tracing/logger.h"
+
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#endif
+
+namespace diag {
+
+using device_enumerator::DeviceInterface;
+using device_enumerator::DeviceType;
+using device_enumerator::portLogName;
+
+int DiagTap::subscribe(FrameHandler handler) {
+  std::lock_guard lk(mutex_);
+  auto next = std::make_shared<Subscribers>(*subscribers_);
+  next->emplace_back(nextId_, std::move(handler));
+  subscribers_ = std::move(next);
+  return nextId_++;
+}
+
+void DiagTap::unsubscribe(int id) {
+  std::lock_guard lk(mutex_);
+  auto next = std::make_shared<Subscribers>(*subscribers_);
+  std::erase_if(*next, [id](auto &s) { return s.first == id; });
+  subscribers_ = std::move(next);
+}
+
+std::shared_ptr<const DiagTap::Subscribers> DiagTap::subscribers() const {
+  std::lock_guard lk(mutex_);
+  return subscribers_;
+}
+
+std::function<void(std::span<const uint8_t>)> DiagTap::sinkFor(const DeviceInterface &dev) {
+  if (!(dev.type & DeviceType::Diag)) {
+    return {};
+  }
+
+  struct Port {
+    DeviceInterface dev;
+    std::shared_ptr<const Subscribers> subscribers;
+    HdlcDecoder decoder;
+
+    explicit Port(const DeviceInterface &d)
+      : dev(d),
+        decoder([this](std::span<const uint8_t> payload) {
+          for (auto &[id, handler] : *subscribers) {
+            handler(dev, payload);
+          }
+        }) {}
+  };
+
+  auto port = std::make_shared<Port>(dev);
+
+  return [this, port](std::span<const uint8_t> data) {
+    // one lock per chunk, not per frame, and none while handlers run
+    port->subscribers = subscribers();
+    port->decoder.feed(data);
+    port->subscribers.reset();
+  };
+}
+
+DiagFrameLog::DiagFrameLog(DiagTap &tap, std::filesystem::path dir)
+  : tap_(tap), dir_(std::move(dir)) {
+  std::error_code ec;
+  std::filesystem::create_directories(dir_, ec);
+  id_ = tap_.subscribe([this](const DeviceInterface &port, std::span<const uint8_t> payload) {
+    write(port, payload);
+  });
+}
+
+DiagFrameLog::~DiagFrameLog() {
+  tap_.unsubscribe(id_);
+  std::lock_guard lk(mutex_);
+  for (auto &[devpath, file] : files_) {
+    if (file) fclose(file);
+  }
+}
+
+uint64_t DiagFrameLog::frames() const {
+  std::lock_guard lk(mutex_);
+  return frames_;
+}
+
+void DiagFrameLog::write(const DeviceInterface &port, std::span<const uint8_t> payload) {
+  std::lock_guard lk(mutex_);
+  auto [it, inserted] = files_.try_emplace(port.devpath, nullptr);
+  if (inserted) {
+    auto path = dir_ / (portLogName(port.devpath, port.hub) + ".diag");
+    it->second = fopen(path.string().c_str(), "ab");
+    if (!it->second) {
+      DEVICE_WATCH_LOG_ERROR("diag: cannot open {}, errno={}", path.string(), errno);
+    }
+  }
+
+  // a port whose file failed to open stays dropped
+  if (FILE *file = it->second) {
+    uint32_t n = uint32_t(payload.size());
+    uint8_t size[4] = {uint8_t(n), uint8_t(n >> 8), uint8_t(n >> 16), uint8_t(n >> 24)};
+    fwrite(size, 1, sizeof(size), file);
+    fwrite(payload.data(), 1, payload.size(), file);
+    frames_++;
+  }
+}
+
+} // namespace diag
+
+#ifdef ENABLE_TEST
+#include "diag-tap_tests.cc"
+#endif
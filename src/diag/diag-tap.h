@@ -0,0 +1,92 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include "hdlc.h"
+#include "device-enumerator/usb-watch-base.h"
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace diag {
+
+// fans decoded frames of every diag port out to the subscribers.
+// sinkFor() plugs into the console capture (CaptureSettings::rawSinkFor),
+// which then feeds the raw port bytes here instead of logging them.
+class DiagTap {
+public:
+  using FrameHandler = std::function<void(const device_enumerator::DeviceInterface &port,
+                                          std::span<const uint8_t> payload)>;
+
+  DiagTap() = default;
+
+  DiagTap(const DiagTap &) = delete;
+  DiagTap& operator=(const DiagTap &) = delete;
+
+  // handlers run on the thread feeding the port with no lock of the tap
+  // held, the payload is only valid during the call. a chunk being fed
+  // while unsubscribe() returns may still reach the handler.
+  int subscribe(FrameHandler handler);
+  void unsubscribe(int id);
+
+  // a byte sink with its own decoder for a diag device, empty otherwise.
+  // the sink refers to this tap, which must outlive it
+  std::function<void(std::span<const uint8_t>)> sinkFor(const device_enumerator::DeviceInterface &dev);
+
+private:
+  using Subscribers = std::vector<std::pair<int, FrameHandler>>;
+
+  std::shared_ptr<const Subscribers> subscribers() const;
+
+  mutable std::mutex mutex_;
+  int nextId_{1};
+  // replaced on every change, a sink takes the current one per chunk
+  std::shared_ptr<const Subscribers> subscribers_{std::make_shared<Subscribers>()};
+};
+
+// subscriber writing the frames of every port to <dir>/<hub>.<tty>.diag,
+// a frame is its payload size (u32 little endian) followed by the payload
+class DiagFrameLog {
+public:
+  DiagFrameLog(DiagTap &tap, std::filesystem::path dir);
+  ~DiagFrameLog();
+
+  DiagFrameLog(const DiagFrameLog &) = delete;
+  DiagFrameLog& operator=(const DiagFrameLog &) = delete;
+
+  uint64_t frames() const;
+
+private:
+  void write(const device_enumerator::DeviceInterface &port, std::span<const uint8_t> payload);
+
+  DiagTap &tap_;
+  std::filesystem::path dir_;
+  int id_{0};
+
+  mutable std::mutex mutex_;
+  // by devpath, opened on the first frame and kept across reattaches
+  std::unordered_map<std::string, FILE *> files_;
+  uint64_t frames_{0};
+};
+
+} // namespace diag
@@ -0,0 +1,80 @@
+#include <fstream>
+#include <sstream>
+
+namespace diag {
+
+namespace {
+
+DeviceInterface diag_port(std::string devpath) {
+  DeviceInterface dev;
+  dev.type = DeviceType::Diag;
+  dev.devpath = std::move(devpath);
+  dev.hub = "USB1-9";
+  return dev;
+}
+
+std::vector<uint8_t> frames(std::initializer_list<std::string_view> payloads) {
+  std::vector<uint8_t> stream{kHdlcFlag};
+  for (auto p : payloads) {
+    hdlc_encode({reinterpret_cast<const uint8_t *>(p.data()), p.size()}, stream);
+  }
+  return stream;
+}
+
+} // namespace
+
+TEST(DiagTap, SinkOnlyForDiagPorts) {
+  DiagTap tap;
+  DeviceInterface serial;
+  serial.type = DeviceType::Serial;
+  serial.devpath = "/dev/ttyUSB0";
+  EXPECT_FALSE(tap.sinkFor(serial));
+  EXPECT_TRUE(tap.sinkFor(diag_port("/dev/ttyUSB1")));
+}
+
+TEST(DiagTap, HandlersRunOutsideTheLock) {
+  DiagTap tap;
+  std::vector<std::string> seen;
+  int id = 0;
+  id = tap.subscribe([&](const DeviceInterface &port, std::span<const uint8_t> payload) {
+    seen.push_back(port.devpath + " " + std::string(payload.begin(), payload.end()));
+    // would deadlock if the tap held its mutex here
+    tap.unsubscribe(id);
+  });
+
+  int others = 0;
+  tap.subscribe([&others](const DeviceInterface &, std::span<const uint8_t>) { others++; });
+
+  auto sink = tap.sinkFor(diag_port("/dev/ttyUSB2"));
+  // the list is taken per chunk, both frames of this one reach the handler
+  sink(frames({"one", "two"}));
+  sink(frames({"three"}));
+
+  EXPECT_EQ(seen, (std::vector<std::string>{"/dev/ttyUSB2 one", "/dev/ttyUSB2 two"}));
+  EXPECT_EQ(others, 3);
+}
+
+TEST(DiagTap, FrameLog) {
+  auto dir = std::filesystem::temp_directory_path() / ("diag-tap-test-" + std::to_string(getpid()));
+  std::filesystem::remove_all(dir);
+
+  DiagTap tap;
+  {
+    DiagFrameLog log(tap, dir);
+    auto sink = tap.sinkFor(diag_port("/dev/ttyUSB3"));
+    auto stream = frames({"\x4b\x12", "with \x7e flag"});
+    // split inside the second frame
+    sink({stream.data(), 6});
+    sink({stream.data() + 6, stream.size() - 6});
+    EXPECT_EQ(log.frames(), 2u);
+  }
+
+  std::ifstream in(dir / "USB1-9.ttyUSB3.diag", std::ios::binary);
+  std::stringstream text;
+  text << in.rdbuf();
+  EXPECT_EQ(text.str(), std::string("\x02\x00\x00\x00\x4b\x12" "\x0b\x00\x00\x00with \x7e flag", 6 + 15));
+
+  std::filesystem::remove_all(dir);
+}
+
+} // namespace diag
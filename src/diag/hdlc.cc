@@ -0,0 +1,320 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#endif
+
+#include "hdlc.h"
+#include <array>
+#include <bit>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define DIAG_HDLC_SSE2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#define DIAG_TARGET_PCLMUL
+#else
+#define DIAG_TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DIAG_HDLC_NEON 1
+#endif
+
+namespace diag {
+
+namespace {
+
+using CrcTables = std::array<std::array<uint16_t, 256>, 8>;
+
+constexpr CrcTables make_crc_tables() {
+  CrcTables t{};
+  for (uint32_t i = 0; i < 256; i++) {
+    uint16_t crc = uint16_t(i);
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+    }
+    t[0][i] = crc;
+  }
+
+  for (size_t k = 1; k < 8; k++) {
+    for (size_t i = 0; i < 256; i++) {
+      t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+    }
+  }
+  return t;
+}
+
+constexpr CrcTables kCrcTables = make_crc_tables();
+
+uint16_t crc16_slice8(const uint8_t *data, size_t size, uint16_t crc) {
+  auto &t = kCrcTables;
+
+  if constexpr (std::endian::native == std::endian::little) {
+    while (size >= 8) {
+      uint64_t x;
+      memcpy(&x, data, sizeof(x));
+      x ^= crc;
+      crc = t[7][x & 0xff] ^ t[6][(x >> 8) & 0xff] ^
+            t[5][(x >> 16) & 0xff] ^ t[4][(x >> 24) & 0xff] ^
+            t[3][(x >> 32) & 0xff] ^ t[2][(x >> 40) & 0xff] ^
+            t[1][(x >> 48) & 0xff] ^ t[0][x >> 56];
+      data += 8;
+      size -= 8;
+    }
+  }
+
+  while (size--) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xff];
+  }
+  return crc;
+}
+
+#ifdef DIAG_HDLC_SSE2
+
+bool cpu_has_pclmul() {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 1)) && (info[2] & (1 << 19));
+#else
+  return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+const bool kHasPclmul = cpu_has_pclmul();
+
+// folds 16 byte blocks with carry-less multiplies, the crc of the folded
+// block is the crc of everything folded into it. bit reflected, so a
+// product is one bit off and the constants are x^(n-1) mod P:
+//   lo: x^191 mod P = 0xba95, hi: x^127 mod P = 0x577e, reflected to 64 bits
+DIAG_TARGET_PCLMUL
+uint16_t crc16_clmul(const uint8_t *data, size_t size, uint16_t crc) {
+  const __m128i k = _mm_set_epi64x(0x7eea000000000000ll, int64_t(0xa95d000000000000ull));
+
+  __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+  x = _mm_xor_si128(x, _mm_cvtsi32_si128(crc));
+  data += 16;
+  size -= 16;
+
+  while (size >= 16) {
+    __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    x = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11)), next);
+    data += 16;
+    size -= 16;
+  }
+
+  alignas(16) uint8_t folded[16];
+  _mm_store_si128(reinterpret_cast<__m128i *>(folded), x);
+  crc = crc16_slice8(folded, sizeof(folded), 0);
+  return crc16_slice8(data, size, crc);
+}
+
+#endif
+
+} // namespace
+
+uint16_t crc16(const uint8_t *data, size_t size, uint16_t crc) {
+#ifdef DIAG_HDLC_SSE2
+  if (size >= 64 && kHasPclmul) {
+    return crc16_clmul(data, size, crc);
+  }
+#endif
+  return crc16_slice8(data, size, crc);
+}
+
+void hdlc_encode(std::span<const uint8_t> payload, std::vector<uint8_t> &out) {
+  uint16_t crc = ~crc16(payload.data(), payload.size());
+  uint8_t tail[2] = {uint8_t(crc), uint8_t(crc >> 8)};
+
+  auto put = [&out](uint8_t b) {
+    if (b == kHdlcFlag || b == kHdlcEscape) {
+      out.push_back(kHdlcEscape);
+      out.push_back(b ^ kHdlcEscapeMask);
+    } else {
+      out.push_back(b);
+    }
+  };
+
+  out.reserve(out.size() + payload.size() + 4);
+  for (auto b : payload) {
+    put(b);
+  }
+  put(tail[0]);
+  put(tail[1]);
+  out.push_back(kHdlcFlag);
+}
+
+const uint8_t *hdlc_find_special(const uint8_t *p, const uint8_t *end) {
+#if defined(__AVX2__)
+  const __m256i flag32 = _mm256_set1_epi8(char(kHdlcFlag));
+  const __m256i esc32 = _mm256_set1_epi8(char(kHdlcEscape));
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    auto mask = uint32_t(_mm256_movemask_epi8(
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, flag32), _mm256_cmpeq_epi8(v, esc32))));
+    if (mask) {
+      return p + std::countr_zero(mask);
+    }
+    p += 32;
+  }
+#endif
+
+#if defined(DIAG_HDLC_SSE2)
+  const __m128i flag = _mm_set1_epi8(char(kHdlcFlag));
+  const __m128i esc = _mm_set1_epi8(char(kHdlcEscape));
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    auto mask = uint32_t(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, flag), _mm_cmpeq_epi8(v, esc))));
+    if (mask) {
+      return p + std::countr_zero(mask);
+    }
+    p += 16;
+  }
+#elif defined(DIAG_HDLC_NEON)
+  const uint8x16_t flag = vdupq_n_u8(kHdlcFlag);
+  const uint8x16_t esc = vdupq_n_u8(kHdlcEscape);
+  while (end - p >= 16) {
+    uint8x16_t v = vld1q_u8(p);
+    uint8x16_t m = vorrq_u8(vceqq_u8(v, flag), vceqq_u8(v, esc));
+    // 4 bits per byte
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+    if (mask) {
+      return p + std::countr_zero(mask) / 4;
+    }
+    p += 16;
+  }
+#endif
+
+  for (; p < end; p++) {
+    if (*p == kHdlcFlag || *p == kHdlcEscape) {
+      break;
+    }
+  }
+  return p;
+}
+
+HdlcDecoder::HdlcDecoder(FrameHandler handler, size_t maxFrame)
+  : handler_(std::move(handler)),
+    maxFrame_(maxFrame),
+    frame_(new uint8_t[maxFrame]) {}
+
+void HdlcDecoder::reset() {
+  used_ = 0;
+  escape_ = false;
+  overflow_ = false;
+}
+
+void HdlcDecoder::append(const uint8_t *p, size_t n) {
+  if (overflow_ || n == 0) {
+    return;
+  }
+
+  if (used_ + n > maxFrame_) {
+    overflow_ = true;
+    used_ = 0;
+    stats_.oversize++;
+    return;
+  }
+
+  memcpy(frame_.get() + used_, p, n);
+  used_ += n;
+}
+
+void HdlcDecoder::finish(const uint8_t *p, size_t n) {
+  if (n == 0) {
+    // back to back flags
+    return;
+  }
+
+  if (n < 3) {
+    stats_.runts++;
+    return;
+  }
+
+  // same limit for frames handed out in place
+  if (n > maxFrame_) {
+    stats_.oversize++;
+    return;
+  }
+
+  uint16_t crc = ~crc16(p, n - 2);
+  if ((p[n - 2] | (p[n - 1] << 8)) != crc) {
+    stats_.crcErrors++;
+    return;
+  }
+
+  stats_.frames++;
+  if (handler_) {
+    handler_({p, n - 2});
+  }
+}
+
+void HdlcDecoder::feed(std::span<const uint8_t> data) {
+  const uint8_t *p = data.data();
+  const uint8_t *end = p + data.size();
+  stats_.bytes += data.size();
+
+  while (p < end) {
+    if (escape_) {
+      escape_ = false;
+      if (*p == kHdlcFlag) {
+        stats_.aborted++;
+        reset();
+      } else {
+        uint8_t b = *p ^ kHdlcEscapeMask;
+        append(&b, 1);
+      }
+      p++;
+      continue;
+    }
+
+    auto *s = hdlc_find_special(p, end);
+    if (s != end && *s == kHdlcFlag && used_ == 0 && !overflow_) {
+      // whole frame in this chunk, nothing to unescape
+      finish(p, s - p);
+    } else {
+      append(p, s - p);
+      if (s == end) {
+        break;
+      }
+
+      if (*s == kHdlcFlag) {
+        if (!overflow_) {
+          finish(frame_.get(), used_);
+        }
+        used_ = 0;
+        overflow_ = false;
+      } else {
+        escape_ = true;
+      }
+    }
+    p = s + 1;
+  }
+}
+
+} // namespace diag
+
+#ifdef ENABLE_TEST
+#include "hdlc_tests.cc"
+#endif
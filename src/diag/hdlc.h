@@ -0,0 +1,88 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+// qualcomm diag hdlc framing:
+//   escape(payload + crc16 little endian) 0x7e
+// 0x7e and 0x7d inside a frame are sent as 0x7d, byte ^ 0x20.
+// the crc is crc-16/x-25 (reflected 0x1021, init and final xor 0xffff).
+
+namespace diag {
+
+constexpr uint8_t kHdlcFlag = 0x7e;
+constexpr uint8_t kHdlcEscape = 0x7d;
+constexpr uint8_t kHdlcEscapeMask = 0x20;
+
+// pclmul folding on x86 cpus that have it, slice-by-8 otherwise
+uint16_t crc16(const uint8_t *data, size_t size, uint16_t crc = 0xffff);
+
+// appends the framed payload to out
+void hdlc_encode(std::span<const uint8_t> payload, std::vector<uint8_t> &out);
+
+// first 0x7e or 0x7d in [p, end), end if none. sse2/avx2/neon when available
+const uint8_t *hdlc_find_special(const uint8_t *p, const uint8_t *end);
+
+// streaming decoder, bytes may be fed in chunks of any size.
+// a frame that ends inside the fed chunk and holds no escape is handed out
+// in place, the others are unescaped into a buffer allocated once.
+class HdlcDecoder {
+public:
+  // payload without the crc, valid during the call only
+  using FrameHandler = std::function<void(std::span<const uint8_t> payload)>;
+
+  struct Stats {
+    uint64_t bytes{0};
+    uint64_t frames{0};
+    uint64_t crcErrors{0};
+    uint64_t runts{0};     // shorter than the crc
+    uint64_t oversize{0};  // longer than maxFrame, dropped
+    uint64_t aborted{0};   // escape followed by a flag
+  };
+
+  explicit HdlcDecoder(FrameHandler handler, size_t maxFrame = 64 << 10);
+
+  void feed(std::span<const uint8_t> data);
+  // drops a partial frame, e.g. after the port was reopened
+  void reset();
+
+  const Stats &stats() const { return stats_; }
+
+private:
+  void append(const uint8_t *p, size_t n);
+  void finish(const uint8_t *p, size_t n);
+
+  FrameHandler handler_;
+  size_t maxFrame_;
+  std::unique_ptr<uint8_t[]> frame_;
+  size_t used_{0};
+  bool escape_{false};
+  bool overflow_{false};
+  Stats stats_;
+};
+
+} // namespace diag
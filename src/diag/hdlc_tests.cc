@@ -0,0 +1,89 @@
+#include <random>
+#include <string_view>
+
+namespace diag {
+
+namespace {
+
+std::vector<uint8_t> bytes(std::string_view s) {
+  return {s.begin(), s.end()};
+}
+
+} // namespace
+
+TEST(Hdlc, Crc16X25) {
+  auto check = bytes("123456789");
+  EXPECT_EQ(uint16_t(~crc16(check.data(), check.size())), 0x906e);
+
+  // the wide kernels agree with the bytewise tail at every length
+  std::vector<uint8_t> data(300);
+  for (size_t i = 0; i < data.size(); i++) data[i] = uint8_t(i * 37 + 11);
+  for (size_t n = 0; n < data.size(); n++) {
+    uint16_t bytewise = 0xffff;
+    for (size_t i = 0; i < n; i++) bytewise = crc16(&data[i], 1, bytewise);
+    ASSERT_EQ(crc16(data.data(), n), bytewise) << n;
+  }
+}
+
+TEST(Hdlc, FindSpecial) {
+  std::vector<uint8_t> data(100, 0x11);
+  for (size_t at = 0; at < data.size(); at++) {
+    data[at] = kHdlcEscape;
+    ASSERT_EQ(hdlc_find_special(data.data(), data.data() + data.size()) - data.data(), ptrdiff_t(at));
+    data[at] = 0x11;
+  }
+  EXPECT_EQ(hdlc_find_special(data.data(), data.data() + data.size()), data.data() + data.size());
+}
+
+TEST(Hdlc, SplitAtEveryOffset) {
+  std::vector<std::vector<uint8_t>> payloads = {
+    bytes("\x4b\x12\x00\x00"),
+    bytes("with \x7e flag and \x7d escape"),
+    std::vector<uint8_t>(300, 0x7e),
+    bytes("x"),
+  };
+
+  std::vector<uint8_t> stream;
+  stream.push_back(kHdlcFlag);
+  for (auto &p : payloads) hdlc_encode(p, stream);
+
+  for (size_t split = 0; split <= stream.size(); split++) {
+    std::vector<std::vector<uint8_t>> got;
+    HdlcDecoder decoder([&got](std::span<const uint8_t> payload) {
+      got.emplace_back(payload.begin(), payload.end());
+    });
+    decoder.feed({stream.data(), split});
+    decoder.feed({stream.data() + split, stream.size() - split});
+
+    ASSERT_EQ(got, payloads) << split;
+    EXPECT_EQ(decoder.stats().crcErrors, 0u);
+  }
+}
+
+TEST(Hdlc, BadFramesAreCounted) {
+  std::vector<uint8_t> stream;
+  hdlc_encode(bytes("good"), stream);
+  auto corrupt = stream.size();
+  hdlc_encode(bytes("bad"), stream);
+  stream[corrupt] ^= 1;
+  stream.insert(stream.end(), {0x01, kHdlcFlag});                // runt
+  stream.insert(stream.end(), {0x01, kHdlcEscape, kHdlcFlag});   // aborted
+  hdlc_encode(bytes("good"), stream);
+
+  int frames = 0;
+  HdlcDecoder decoder([&frames](std::span<const uint8_t>) { frames++; }, 64);
+  decoder.feed(stream);
+
+  std::vector<uint8_t> big;
+  hdlc_encode(std::vector<uint8_t>(100, 0x55), big);
+  hdlc_encode(bytes("good"), big);
+  decoder.feed(big);
+
+  EXPECT_EQ(frames, 3);
+  EXPECT_EQ(decoder.stats().crcErrors, 1u);
+  EXPECT_EQ(decoder.stats().runts, 1u);
+  EXPECT_EQ(decoder.stats().aborted, 1u);
+  EXPECT_EQ(decoder.stats().oversize, 1u);
+}
+
+} // namespace diag
@@ -74,7 +74,7 @@ private:
     } else if (node.type & DeviceType::Serial) {
       id = node.devpath;
     } else {
-      id = node.identity;
+      id = node.identity.to_string();
     }
 
     Device dev;
@@ -226,7 +226,7 @@ int main() {
   WatchThread::WatchSettings settings;
   waiter.start(settings);
   waiter.wait_for(dev);
-  std::cout << "device: " << dev.identity << std::endl;
+  std::cout << "device: " << dev.identity.to_string() << std::endl;
 
   getchar();
   return 0;
@@ -0,0 +1,205 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#endif
+
+#include "fastboot-client.h"
+#include <charconv>
+#include <format>
+
+namespace fastboot {
+
+namespace {
+
+constexpr size_t kMaxCommand = 4096;
+constexpr size_t kMaxResponse = 256;
+
+} // namespace
+
+FastbootClient::FastbootClient(Transport &transport) : transport_(transport) {}
+
+asio::awaitable<std::string>
+FastbootClient::co_response(std::optional<uint32_t> *data_size) {
+  uint8_t buffer[kMaxResponse];
+
+  for (;;) {
+    auto n = co_await transport_.co_read(buffer);
+    if (n < 4) {
+      throw fastboot_error(std::format("short response of {} bytes", n));
+    }
+
+    std::string_view tag(reinterpret_cast<const char *>(buffer), 4);
+    std::string_view text(reinterpret_cast<const char *>(buffer) + 4, n - 4);
+
+    if (tag == "OKAY") {
+      co_return std::string(text);
+    }
+
+    if (tag == "FAIL") {
+      throw fastboot_error(std::format("remote failure: {}", text));
+    }
+
+    if (tag == "INFO" || tag == "TEXT") {
+      if (onInfo) {
+        onInfo(text);
+      }
+      continue;
+    }
+
+    if (tag == "DATA" && data_size) {
+      uint32_t size = 0;
+      auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), size, 16);
+      if (ec != std::errc()) {
+        throw fastboot_error(std::format("bad DATA response: {}", text));
+      }
+      *data_size = size;
+      co_return std::string();
+    }
+
+    throw fastboot_error(std::format("unexpected response: {}", tag));
+  }
+}
+
+asio::awaitable<std::string> FastbootClient::co_command(std::string_view cmd) {
+  if (cmd.size() > kMaxCommand) {
+    throw fastboot_error("command too long");
+  }
+
+  // anything but getvar may change what getvar reports (slots, partitions...)
+  if (!cmd.starts_with("getvar:")) {
+    vars_.clear();
+  }
+
+  co_await transport_.co_write({reinterpret_cast<const uint8_t *>(cmd.data()), cmd.size()});
+  co_return co_await co_response();
+}
+
+asio::awaitable<std::string> FastbootClient::co_getvar(std::string_view name) {
+  std::string key(name);
+  if (auto it = vars_.find(key); it != vars_.end()) {
+    co_return it->second;
+  }
+
+  auto cmd = "getvar:" + key;
+  auto value = co_await co_command(cmd);
+  vars_.emplace(std::move(key), value);
+  co_return value;
+}
+
+asio::awaitable<size_t> FastbootClient::co_max_download_size() {
+  auto value = co_await co_getvar("max-download-size");
+
+  std::string_view s = value;
+  int base = 10;
+  if (s.starts_with("0x") || s.starts_with("0X")) {
+    s.remove_prefix(2);
+    base = 16;
+  }
+
+  size_t size = 0;
+  auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), size, base);
+  if (ec != std::errc() || size == 0) {
+    throw fastboot_error(std::format("bad max-download-size: {}", value));
+  }
+  co_return size;
+}
+
+asio::awaitable<void> FastbootClient::co_download(std::span<const uint8_t> data) {
+  std::span<const std::span<const uint8_t>> buffers(&data, 1);
+  co_await co_download(buffers);
+}
+
+asio::awaitable<void> FastbootClient::co_download(std::span<const std::span<const uint8_t>> buffers) {
+  size_t size = 0;
+  for (auto &b : buffers) {
+    size += b.size();
+  }
+
+  auto max = co_await co_max_download_size();
+  if (size > max) {
+    throw fastboot_error(std::format("{} bytes exceed max-download-size {}", size, max));
+  }
+
+  co_await co_send_download(buffers, size);
+}
+
+asio::awaitable<void>
+FastbootClient::co_send_download(std::span<const std::span<const uint8_t>> buffers, size_t size) {
+  vars_.clear();
+  auto cmd = std::format("download:{:08x}", size);
+  co_await transport_.co_write({reinterpret_cast<const uint8_t *>(cmd.data()), cmd.size()});
+
+  std::optional<uint32_t> accepted;
+  co_await co_response(&accepted);
+  if (!accepted || *accepted != size) {
+    throw fastboot_error(std::format("device accepted {} of {} bytes", accepted.value_or(0), size));
+  }
+
+  co_await transport_.co_write_gather(buffers);
+  co_await co_response();
+}
+
+asio::awaitable<void> FastbootClient::co_flash(std::string_view partition) {
+  auto cmd = std::format("flash:{}", partition);
+  co_await co_command(cmd);
+}
+
+asio::awaitable<void> FastbootClient::co_flash(std::string_view partition, std::span<const uint8_t> data) {
+  co_await co_download(data);
+  co_await co_flash(partition);
+}
+
+asio::awaitable<void>
+FastbootClient::co_flash(std::string_view partition, const sparse_image::SparseImage &image) {
+  auto max = co_await co_max_download_size();
+  auto source = image.source();
+  if (source.size() <= max) {
+    co_await co_flash(partition, source);
+    co_return;
+  }
+
+  std::vector<sparse_image::SparsePiece> pieces;
+  try {
+    pieces = image.split(max);
+  } catch (sparse_image::sparse_error &e) {
+    throw fastboot_error(e.what());
+  }
+
+  // max is not asked again, every flash command drops the getvar cache
+  for (auto &piece : pieces) {
+    auto buffers = piece.buffers();
+    co_await co_send_download(buffers, piece.size());
+    co_await co_flash(partition);
+  }
+}
+
+asio::awaitable<void> FastbootClient::co_reboot(std::string_view target) {
+  auto cmd = target.empty() ? std::string("reboot") : std::format("reboot-{}", target);
+  co_await co_command(cmd);
+}
+
+} // namespace fastboot
+
+#ifdef ENABLE_TEST
+#include "fastboot-client_tests.cc"
+#endif
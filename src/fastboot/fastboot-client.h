@@ -0,0 +1,77 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include "fastboot-transport.h"
+#include "sparse/sparse-image.h"
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+namespace fastboot {
+
+// one device in fastboot mode. a client must only be used from one
+// coroutine at a time, run one client per device to flash in parallel
+// (e.g. adb_client::co_for_each_bounded).
+class FastbootClient {
+public:
+  explicit FastbootClient(Transport &transport);
+
+  // INFO and TEXT lines of the device, dropped when empty
+  std::function<void(std::string_view)> onInfo;
+
+  // sends cmd, returns the OKAY text, throws fastboot_error on FAIL
+  asio::awaitable<std::string> co_command(std::string_view cmd);
+
+  // cached until the next command that may change device state
+  asio::awaitable<std::string> co_getvar(std::string_view name);
+
+  // getvar max-download-size
+  asio::awaitable<size_t> co_max_download_size();
+
+  // data is sent as one message straight from the caller's memory
+  // (a MappedFile can feed every device at once), throws if it is
+  // larger than max-download-size
+  asio::awaitable<void> co_download(std::span<const uint8_t> data);
+  // the concatenation of buffers, sent as one message
+  asio::awaitable<void> co_download(std::span<const std::span<const uint8_t>> buffers);
+
+  asio::awaitable<void> co_flash(std::string_view partition);
+  asio::awaitable<void> co_flash(std::string_view partition, std::span<const uint8_t> data);
+
+  // the image as is if it fits max-download-size, otherwise split into
+  // sparse pieces (headers built per piece, payloads straight from the
+  // image) that are downloaded and flashed one after the other
+  asio::awaitable<void> co_flash(std::string_view partition, const sparse_image::SparseImage &image);
+
+  // target: empty, "bootloader", "fastboot", "recovery"
+  asio::awaitable<void> co_reboot(std::string_view target = {});
+
+private:
+  asio::awaitable<std::string> co_response(std::optional<uint32_t> *data_size = nullptr);
+  asio::awaitable<void> co_send_download(std::span<const std::span<const uint8_t>> buffers, size_t size);
+
+  Transport &transport_;
+  std::unordered_map<std::string, std::string> vars_;
+};
+
+} // namespace fastboot
@@ -0,0 +1,191 @@
+#include "adb-client/co-parallel.h"
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/io_context.hpp>
+#include <asio/read.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/write.hpp>
+#include <map>
+
+namespace fastboot {
+
+namespace {
+
+using asio::ip::tcp;
+using asio::use_awaitable;
+
+// fastboot tcp device: getvar, download, flash and reboot, recording
+// what got flashed
+struct FakeDevice {
+  tcp::acceptor acceptor;
+  size_t maxDownload{1 << 20};
+  std::map<std::string, std::vector<uint8_t>, std::less<>> flashed;
+  int getvars{0};
+  int sparsePieces{0};
+  bool rebooted{false};
+
+  explicit FakeDevice(asio::io_context &io) : acceptor(io, tcp::endpoint(asio::ip::address_v4::loopback(), 0)) {}
+
+  uint16_t port() const { return acceptor.local_endpoint().port(); }
+
+  static asio::awaitable<std::vector<uint8_t>> co_message(tcp::socket &s) {
+    uint8_t header[8];
+    co_await asio::async_read(s, asio::buffer(header), use_awaitable);
+    uint64_t size = 0;
+    for (auto b : header) size = (size << 8) | b;
+    std::vector<uint8_t> data(size);
+    co_await asio::async_read(s, asio::buffer(data), use_awaitable);
+    co_return data;
+  }
+
+  static asio::awaitable<void> co_reply(tcp::socket &s, std::string text) {
+    uint8_t header[8]{};
+    for (int i = 7, n = int(text.size()); i >= 0; i--, n >>= 8) header[i] = uint8_t(n);
+    co_await asio::async_write(s, asio::buffer(header), use_awaitable);
+    co_await asio::async_write(s, asio::buffer(text), use_awaitable);
+  }
+
+  asio::awaitable<void> co_serve() {
+    auto s = co_await acceptor.async_accept(use_awaitable);
+    char hello[4];
+    co_await asio::async_read(s, asio::buffer(hello), use_awaitable);
+    co_await asio::async_write(s, asio::buffer("FB01", 4), use_awaitable);
+
+    std::vector<uint8_t> downloaded;
+    while (!rebooted) {
+      auto msg = co_await co_message(s);
+      std::string cmd(msg.begin(), msg.end());
+
+      if (cmd == "getvar:max-download-size") {
+        getvars++;
+        co_await co_reply(s, std::format("OKAY0x{:x}", maxDownload));
+      } else if (cmd == "getvar:product") {
+        getvars++;
+        co_await co_reply(s, "OKAYfake");
+      } else if (cmd.starts_with("download:")) {
+        auto size = std::stoul(cmd.substr(9), nullptr, 16);
+        co_await co_reply(s, std::format("DATA{:08x}", size));
+        downloaded.clear();
+        while (downloaded.size() < size) {
+          auto part = co_await co_message(s);
+          downloaded.insert(downloaded.end(), part.begin(), part.end());
+        }
+        co_await co_reply(s, "OKAY");
+      } else if (cmd.starts_with("flash:")) {
+        co_await co_reply(s, "INFOwriting " + cmd.substr(6));
+        auto &partition = flashed[cmd.substr(6)];
+        if (sparse_image::SparseImage::is_sparse(downloaded)) {
+          // pieces of a split land on top of each other
+          auto image = sparse_image::SparseImage::parse(downloaded);
+          partition.resize(image.expandedSize());
+          for (auto &c : image.chunks()) {
+            auto *dst = partition.data() + size_t(c.startBlock) * image.blockSize();
+            if (c.type == sparse_image::ChunkType::Raw) {
+              std::memcpy(dst, c.data.data(), c.data.size());
+            } else {
+              for (size_t i = 0; i < size_t(c.blocks) * image.blockSize(); i += 4) std::memcpy(dst + i, &c.fill, 4);
+            }
+          }
+          sparsePieces++;
+        } else {
+          partition = downloaded;
+        }
+        co_await co_reply(s, "OKAY");
+      } else if (cmd == "reboot") {
+        rebooted = true;
+        co_await co_reply(s, "OKAY");
+      } else {
+        co_await co_reply(s, "FAILunknown command");
+      }
+    }
+  }
+};
+
+} // namespace
+
+TEST(Fastboot, ParallelFlashFromOneImage) {
+  constexpr size_t kDevices = 6;
+
+  std::vector<uint8_t> image(300000);
+  for (size_t i = 0; i < image.size(); i++) image[i] = uint8_t(i * 7);
+
+  asio::io_context io;
+  std::vector<std::unique_ptr<FakeDevice>> devices;
+  for (size_t i = 0; i < kDevices; i++) {
+    devices.push_back(std::make_unique<FakeDevice>(io));
+    co_spawn(io, devices.back()->co_serve(), asio::detached);
+  }
+
+  size_t done = 0;
+  std::vector<std::string> infos;
+  std::string error;
+  co_spawn(io, adb_client::co_for_each_bounded(kDevices, kDevices, [&](size_t i) -> asio::awaitable<void> {
+    try {
+      auto transport = co_await TcpTransport::co_connect("127.0.0.1", devices[i]->port());
+      FastbootClient client(*transport);
+      client.onInfo = [&infos](std::string_view line) { infos.emplace_back(line); };
+
+      EXPECT_EQ(co_await client.co_getvar("product"), "fake");
+      EXPECT_EQ(co_await client.co_getvar("product"), "fake");
+      co_await client.co_flash("boot", image);
+
+      // too large for the device, rejected before anything is sent
+      std::vector<uint8_t> huge(devices[i]->maxDownload + 1);
+      try {
+        co_await client.co_download(huge);
+        ADD_FAILURE() << "oversized download accepted";
+      } catch (fastboot_error &) {
+      }
+
+      co_await client.co_reboot();
+      done++;
+    } catch (std::exception &e) {
+      error = e.what();
+    }
+  }), asio::detached);
+  io.run();
+
+  EXPECT_EQ(error, "");
+  EXPECT_EQ(done, kDevices);
+  EXPECT_EQ(infos.size(), kDevices);
+  for (auto &dev : devices) {
+    EXPECT_EQ(dev->flashed["boot"], image);
+    EXPECT_TRUE(dev->rebooted);
+    // product once, max-download-size once (cache dropped after the flash)
+    EXPECT_EQ(dev->getvars, 3);
+  }
+}
+
+TEST(Fastboot, SparseSplitPastMaxDownload) {
+  asio::io_context io;
+  FakeDevice device(io);
+  device.maxDownload = 64 << 10;
+  co_spawn(io, device.co_serve(), asio::detached);
+
+  // 80 blocks, a zero run in the middle
+  std::vector<uint8_t> raw(80 * 4096);
+  for (size_t i = 0; i < raw.size(); i++) raw[i] = uint8_t(i * 13 + i / 4096);
+  std::fill(raw.begin() + 20 * 4096, raw.begin() + 50 * 4096, 0);
+  auto image = sparse_image::SparseImage::from_raw(raw);
+
+  std::string error;
+  co_spawn(io, [&]() -> asio::awaitable<void> {
+    try {
+      auto transport = co_await TcpTransport::co_connect("127.0.0.1", device.port());
+      FastbootClient client(*transport);
+      co_await client.co_flash("super", image);
+      co_await client.co_reboot();
+    } catch (std::exception &e) {
+      error = e.what();
+    }
+  }, asio::detached);
+  io.run();
+
+  EXPECT_EQ(error, "");
+  EXPECT_EQ(device.flashed["super"], raw);
+  // 50 raw blocks in 64k pieces
+  EXPECT_EQ(device.sparsePieces, 4);
+  EXPECT_EQ(device.getvars, 1);
+}
+
+} // namespace fastboot
@@ -0,0 +1,166 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "fastboot-transport.h"
+#include <asio/connect.hpp>
+#include <asio/read.hpp>
+#include <asio/redirect_error.hpp>
+#include <asio/this_coro.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/write.hpp>
+#include <cstring>
+#include <format>
+#include <vector>
+
+namespace fastboot {
+
+using asio::ip::tcp;
+using asio::use_awaitable;
+
+namespace {
+
+constexpr char kHandshake[4] = {'F', 'B', '0', '1'};
+
+void put_be64(uint8_t *p, uint64_t v) {
+  for (int i = 7; i >= 0; i--) {
+    p[i] = uint8_t(v);
+    v >>= 8;
+  }
+}
+
+uint64_t be64_at(const uint8_t *p) {
+  uint64_t v = 0;
+  for (int i = 0; i < 8; i++) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+} // namespace
+
+TcpTransport::TcpTransport(tcp::socket socket, std::chrono::milliseconds readTimeout)
+  : socket_(std::move(socket)), timer_(socket_.get_executor()), timeout_(readTimeout) {}
+
+asio::awaitable<std::unique_ptr<TcpTransport>>
+TcpTransport::co_connect(std::string host, uint16_t port, std::chrono::milliseconds readTimeout) {
+  auto ex = co_await asio::this_coro::executor;
+  tcp::resolver resolver(ex);
+  tcp::socket socket(ex);
+
+  asio::error_code ec;
+  auto endpoints = co_await resolver.async_resolve(host, std::to_string(port),
+                                                   asio::redirect_error(use_awaitable, ec));
+  if (!ec) {
+    co_await asio::async_connect(socket, endpoints, asio::redirect_error(use_awaitable, ec));
+  }
+  if (ec) {
+    throw fastboot_error(std::format("cannot connect {}:{}: {}", host, port, ec.message()));
+  }
+
+  socket.set_option(tcp::no_delay(true), ec);
+  auto transport = std::make_unique<TcpTransport>(std::move(socket), readTimeout);
+
+  co_await asio::async_write(transport->socket_, asio::buffer(kHandshake), asio::redirect_error(use_awaitable, ec));
+  if (ec) {
+    throw fastboot_error("handshake failed: " + ec.message());
+  }
+
+  uint8_t reply[4];
+  co_await transport->co_read_exact(reply);
+  if (memcmp(reply, kHandshake, 2) != 0) {
+    throw fastboot_error("not a fastboot tcp server");
+  }
+
+  co_return transport;
+}
+
+asio::awaitable<void> TcpTransport::co_read_exact(std::span<uint8_t> buffer) {
+  timer_.expires_after(timeout_);
+  timer_.async_wait([this](const asio::error_code &ec) {
+    if (!ec) {
+      asio::error_code ignored;
+      socket_.cancel(ignored);
+    }
+  });
+
+  asio::error_code ec;
+  co_await asio::async_read(socket_, asio::buffer(buffer.data(), buffer.size()),
+                            asio::redirect_error(use_awaitable, ec));
+  timer_.cancel();
+
+  if (ec == asio::error::operation_aborted) {
+    throw fastboot_error("read timeout");
+  }
+  if (ec) {
+    throw fastboot_error("read failed: " + ec.message());
+  }
+}
+
+asio::awaitable<size_t> TcpTransport::co_read(std::span<uint8_t> buffer) {
+  uint8_t header[8];
+  co_await co_read_exact(header);
+
+  auto size = be64_at(header);
+  if (size > buffer.size()) {
+    throw fastboot_error(std::format("{} byte message does not fit {} bytes", size, buffer.size()));
+  }
+
+  co_await co_read_exact(buffer.first(size));
+  co_return size;
+}
+
+asio::awaitable<void> TcpTransport::co_write(std::span<const uint8_t> data) {
+  std::span<const std::span<const uint8_t>> buffers(&data, 1);
+  co_await co_write_gather(buffers);
+}
+
+asio::awaitable<void> TcpTransport::co_write_gather(std::span<const std::span<const uint8_t>> buffers) {
+  uint64_t size = 0;
+  for (auto &b : buffers) {
+    size += b.size();
+  }
+
+  uint8_t header[8];
+  put_be64(header, size);
+
+  // header and payload in one gather write, the payload is not copied
+  std::vector<asio::const_buffer> gather;
+  gather.reserve(buffers.size() + 1);
+  gather.push_back(asio::buffer(header));
+  for (auto &b : buffers) {
+    gather.push_back(asio::buffer(b.data(), b.size()));
+  }
+
+  asio::error_code ec;
+  co_await asio::async_write(socket_, gather, asio::redirect_error(use_awaitable, ec));
+  if (ec) {
+    throw fastboot_error("write failed: " + ec.message());
+  }
+}
+
+void TcpTransport::close() noexcept {
+  asio::error_code ec;
+  timer_.cancel();
+  socket_.shutdown(tcp::socket::shutdown_both, ec);
+  socket_.close(ec);
+}
+
+} // namespace fastboot
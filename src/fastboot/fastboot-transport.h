@@ -0,0 +1,82 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include <asio/awaitable.hpp>
+#include <asio/any_io_executor.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/steady_timer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+namespace fastboot {
+
+class fastboot_error : public std::runtime_error {
+public:
+  fastboot_error(const std::string& arg): std::runtime_error(arg) {}
+};
+
+// message transport of the fastboot protocol: usb bulk packets, or
+// length prefixed messages over tcp. all operations throw fastboot_error.
+class Transport {
+public:
+  virtual ~Transport() = default;
+
+  // one message, at most buffer.size() bytes
+  virtual asio::awaitable<size_t> co_read(std::span<uint8_t> buffer) = 0;
+  // one message
+  virtual asio::awaitable<void> co_write(std::span<const uint8_t> data) = 0;
+  // one message gathered from several buffers, none of them copied
+  virtual asio::awaitable<void> co_write_gather(std::span<const std::span<const uint8_t>> buffers) = 0;
+  virtual void close() noexcept = 0;
+};
+
+// fastboot over tcp (`fastboot -s tcp:host:port`): a "FB01" handshake,
+// then every message goes with a big endian 64 bit length in front.
+// a read that gets nothing for readTimeout fails.
+class TcpTransport : public Transport {
+public:
+  static constexpr uint16_t kDefaultPort = 5554;
+
+  TcpTransport(asio::ip::tcp::socket socket, std::chrono::milliseconds readTimeout);
+
+  static asio::awaitable<std::unique_ptr<TcpTransport>>
+  co_connect(std::string host, uint16_t port = kDefaultPort,
+             std::chrono::milliseconds readTimeout = std::chrono::seconds(30));
+
+  asio::awaitable<size_t> co_read(std::span<uint8_t> buffer) override;
+  asio::awaitable<void> co_write(std::span<const uint8_t> data) override;
+  asio::awaitable<void> co_write_gather(std::span<const std::span<const uint8_t>> buffers) override;
+  void close() noexcept override;
+
+private:
+  asio::awaitable<void> co_read_exact(std::span<uint8_t> buffer);
+
+  asio::ip::tcp::socket socket_;
+  asio::steady_timer timer_;
+  std::chrono::milliseconds timeout_;
+};
+
+} // namespace fastboot
@@ -0,0 +1,44 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "edl-transport.h"
+#include <asio/serial_port.hpp>
+
+namespace edl_flash {
+
+std::unique_ptr<Transport> open_serial_transport(const asio::any_io_executor &ex, const std::string &path) {
+  asio::serial_port port(ex);
+  asio::error_code ec;
+  port.open(path, ec);
+  if (ec) {
+    throw flash_error("cannot open " + path + ": " + ec.message());
+  }
+
+  // the baud rate means nothing to usb bulk, 8n1 raw is what matters
+  port.set_option(asio::serial_port::character_size(8), ec);
+  port.set_option(asio::serial_port::parity(asio::serial_port::parity::none), ec);
+  port.set_option(asio::serial_port::stop_bits(asio::serial_port::stop_bits::one), ec);
+  port.set_option(asio::serial_port::flow_control(asio::serial_port::flow_control::none), ec);
+
+  return std::make_unique<StreamTransport<asio::serial_port>>(std::move(port));
+}
+
+} // namespace edl_flash
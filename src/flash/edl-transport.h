@@ -0,0 +1,121 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include <asio/awaitable.hpp>
+#include <asio/any_io_executor.hpp>
+#include <asio/read.hpp>
+#include <asio/redirect_error.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/write.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+namespace edl_flash {
+
+class flash_error : public std::runtime_error {
+public:
+  flash_error(const std::string& arg): std::runtime_error(arg) {}
+};
+
+// byte stream to a device in emergency download mode: the qdloader com port
+// on windows, the qcserial tty on linux, a socket in tests.
+// all operations throw flash_error.
+class Transport {
+public:
+  virtual ~Transport() = default;
+
+  // resumes with at least one byte
+  virtual asio::awaitable<size_t> co_read_some(std::span<uint8_t> buffer) = 0;
+  virtual asio::awaitable<void> co_write(std::span<const uint8_t> data) = 0;
+  virtual void close() noexcept = 0;
+
+  asio::awaitable<void> co_read_exact(std::span<uint8_t> buffer) {
+    while (buffer.size()) {
+      auto n = co_await co_read_some(buffer);
+      buffer = buffer.subspan(n);
+    }
+  }
+};
+
+// Transport over any asio stream (serial_port, stream_descriptor, socket),
+// a read that gets nothing for readTimeout cancels the stream.
+template <class Stream>
+class StreamTransport : public Transport {
+public:
+  StreamTransport(Stream stream, std::chrono::milliseconds readTimeout = std::chrono::seconds(10))
+    : stream_(std::move(stream)), timer_(stream_.get_executor()), timeout_(readTimeout) {}
+
+  asio::awaitable<size_t> co_read_some(std::span<uint8_t> buffer) override {
+    timer_.expires_after(timeout_);
+    timer_.async_wait([this](const asio::error_code &ec) {
+      if (!ec) {
+        asio::error_code ignored;
+        stream_.cancel(ignored);
+      }
+    });
+
+    asio::error_code ec;
+    auto n = co_await stream_.async_read_some(asio::buffer(buffer.data(), buffer.size()),
+                                              asio::redirect_error(asio::use_awaitable, ec));
+    timer_.cancel();
+
+    if (ec == asio::error::operation_aborted) {
+      throw flash_error("read timeout");
+    }
+    if (ec) {
+      throw flash_error("read failed: " + ec.message());
+    }
+    co_return n;
+  }
+
+  asio::awaitable<void> co_write(std::span<const uint8_t> data) override {
+    asio::error_code ec;
+    co_await asio::async_write(stream_, asio::buffer(data.data(), data.size()),
+                               asio::redirect_error(asio::use_awaitable, ec));
+    if (ec) {
+      throw flash_error("write failed: " + ec.message());
+    }
+  }
+
+  void close() noexcept override {
+    asio::error_code ec;
+    timer_.cancel();
+    stream_.close(ec);
+  }
+
+  Stream &stream() { return stream_; }
+
+private:
+  Stream stream_;
+  asio::steady_timer timer_;
+  std::chrono::milliseconds timeout_;
+};
+
+// the com port (windows) or tty (linux) of a 05c6:9008 device, in raw mode
+std::unique_ptr<Transport> open_serial_transport(const asio::any_io_executor &ex, const std::string &path);
+
+} // namespace edl_flash
@@ -0,0 +1,298 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#endif
+
+#include "firehose.h"
+#include "sahara.h"
+#include "tracing/logger.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <format>
+
+namespace edl_flash {
+
+namespace {
+
+constexpr std::string_view kXmlHeader = R"(<?xml version="1.0" encoding="UTF-8" ?><data>)";
+constexpr std::string_view kXmlTrailer = "</data>";
+// a device that sends more than this without closing a document is broken
+constexpr size_t kMaxResponse = 64 << 10;
+
+// the next "<name ... />" element in doc starting at pos
+std::string_view next_element(std::string_view doc, std::string_view name, size_t &pos) {
+  for (;;) {
+    pos = doc.find('<', pos);
+    if (pos == std::string_view::npos) {
+      return {};
+    }
+
+    auto end = doc.find('>', pos);
+    if (end == std::string_view::npos) {
+      pos = end;
+      return {};
+    }
+
+    auto element = doc.substr(pos, end - pos + 1);
+    pos = end + 1;
+    if (element.substr(1).starts_with(name) && element.size() > name.size() + 1 &&
+        (element[name.size() + 1] == ' ' || element[name.size() + 1] == '/')) {
+      return element;
+    }
+  }
+}
+
+size_t to_size(std::string_view s) {
+  size_t value = 0;
+  std::from_chars(s.data(), s.data() + s.size(), value);
+  return value;
+}
+
+} // namespace
+
+std::string_view xml_attribute(std::string_view element, std::string_view name) {
+  size_t pos = 0;
+  while ((pos = element.find(name, pos)) != std::string_view::npos) {
+    auto after = pos + name.size();
+    bool starts = pos > 0 && (element[pos - 1] == ' ' || element[pos - 1] == '\t');
+    if (starts && element.substr(after).starts_with("=\"")) {
+      auto begin = after + 2;
+      auto end = element.find('"', begin);
+      if (end == std::string_view::npos) {
+        return {};
+      }
+      return element.substr(begin, end - begin);
+    }
+    pos = after;
+  }
+  return {};
+}
+
+FirehoseClient::FirehoseClient(Transport &transport, FirehoseOptions options)
+  : transport_(transport), options_(std::move(options)), maxPayload_(options_.maxPayload) {}
+
+asio::awaitable<void> FirehoseClient::co_send(std::string_view xml) {
+  std::string doc;
+  doc.reserve(kXmlHeader.size() + xml.size() + kXmlTrailer.size());
+  doc.append(kXmlHeader).append(xml).append(kXmlTrailer);
+  co_await transport_.co_write({reinterpret_cast<const uint8_t *>(doc.data()), doc.size()});
+}
+
+asio::awaitable<FirehoseClient::Response> FirehoseClient::co_response() {
+  uint8_t buffer[4096];
+
+  for (;;) {
+    // every complete document, logs first, until a response shows up
+    size_t end;
+    while ((end = pending_.find(kXmlTrailer)) != std::string::npos) {
+      end += kXmlTrailer.size();
+      std::string_view doc(pending_.data(), end);
+
+      size_t pos = 0;
+      for (auto log = next_element(doc, "log", pos); !log.empty(); log = next_element(doc, "log", pos)) {
+        auto value = xml_attribute(log, "value");
+        if (options_.log) {
+          options_.log(value);
+        } else {
+          DEVICE_WATCH_LOG_DEBUG("firehose: {}", value);
+        }
+      }
+
+      pos = 0;
+      auto element = next_element(doc, "response", pos);
+      Response response{xml_attribute(element, "value") == "ACK", std::string(element)};
+      pending_.erase(0, end);
+      if (!element.empty()) {
+        co_return response;
+      }
+    }
+
+    if (pending_.size() > kMaxResponse) {
+      throw flash_error("firehose: oversized response");
+    }
+
+    auto n = co_await transport_.co_read_some(buffer);
+    pending_.append(reinterpret_cast<const char *>(buffer), n);
+  }
+}
+
+asio::awaitable<void> FirehoseClient::co_configure() {
+  for (int attempt = 0; attempt < 2; attempt++) {
+    co_await co_send(std::format(
+      R"(<configure MemoryName="{}" MaxPayloadSizeToTargetInBytes="{}" ZLPAwareHost="1" SkipStorageInit="{}" SkipWrite="0" Verbose="0" />)",
+      options_.memoryName, maxPayload_, options_.skipStorageInit ? 1 : 0));
+
+    auto response = co_await co_response();
+    if (response.ack) {
+      if (auto size = to_size(xml_attribute(response.element, "MaxPayloadSizeToTargetInBytes"))) {
+        maxPayload_ = std::min(maxPayload_, size);
+      }
+      DEVICE_WATCH_LOG_DEBUG("firehose: configured, payload {}", maxPayload_);
+      co_return;
+    }
+
+    auto supported = to_size(xml_attribute(response.element, "MaxPayloadSizeToTargetInBytesSupported"));
+    if (supported == 0 || supported >= maxPayload_) {
+      break;
+    }
+    maxPayload_ = supported;
+  }
+
+  throw flash_error("firehose: configure rejected");
+}
+
+asio::awaitable<void>
+FirehoseClient::co_program_start(const ProgramCommand &command, uint64_t sectors) {
+  co_await co_send(std::format(
+    R"(<program SECTOR_SIZE_IN_BYTES="{}" num_partition_sectors="{}" physical_partition_number="{}" start_sector="{}" label="{}" filename="{}" />)",
+    command.sectorSize, sectors, command.physicalPartition, command.startSector, command.label, command.filename));
+
+  auto response = co_await co_response();
+  if (!response.ack || xml_attribute(response.element, "rawmode") != "true") {
+    throw flash_error(std::format("firehose: program {} rejected", command.label));
+  }
+}
+
+asio::awaitable<void> FirehoseClient::co_program_finish(const ProgramCommand &command) {
+  auto response = co_await co_response();
+  if (!response.ack) {
+    throw flash_error(std::format("firehose: program {} failed", command.label));
+  }
+}
+
+asio::awaitable<void>
+FirehoseClient::co_program(const ProgramCommand &command, std::span<const uint8_t> data) {
+  if (command.sectorSize == 0) {
+    throw flash_error("firehose: zero sector size");
+  }
+
+  uint64_t sectors = (data.size() + command.sectorSize - 1) / command.sectorSize;
+  co_await co_program_start(command, sectors);
+
+  // whole payloads, only the last one is short, padded to a sector
+  auto payload = std::max<size_t>(maxPayload_ / command.sectorSize, 1) * command.sectorSize;
+  while (data.size() >= payload) {
+    co_await transport_.co_write(data.first(payload));
+    data = data.subspan(payload);
+  }
+
+  // whole sectors straight from data, the partial one padded in a copy
+  if (auto whole = data.size() - data.size() % command.sectorSize) {
+    co_await transport_.co_write(data.first(whole));
+    data = data.subspan(whole);
+  }
+
+  if (data.size()) {
+    std::vector<uint8_t> sector(command.sectorSize);
+    std::ranges::copy(data, sector.begin());
+    co_await transport_.co_write(sector);
+  }
+
+  co_await co_program_finish(command);
+}
+
+asio::awaitable<void>
+FirehoseClient::co_program(const ProgramCommand &command, const sparse_image::SparseImage &image) {
+  auto blockSize = image.blockSize();
+  if (command.sectorSize == 0 || blockSize % command.sectorSize) {
+    throw flash_error(std::format("firehose: {} byte blocks are not whole {} byte sectors",
+                                  blockSize, command.sectorSize));
+  }
+
+  uint64_t sectorsPerBlock = blockSize / command.sectorSize;
+  std::vector<uint8_t> pattern;
+
+  for (auto &chunk : image.chunks()) {
+    auto at = command;
+    at.startSector += chunk.startBlock * sectorsPerBlock;
+
+    if (chunk.type == sparse_image::ChunkType::Raw) {
+      co_await co_program(at, chunk.data);
+      continue;
+    }
+
+    // the same whole blocks of the pattern, written until the chunk is done
+    uint64_t left = uint64_t(chunk.blocks) * blockSize;
+    pattern.resize(std::min<uint64_t>(std::max<size_t>(maxPayload_ / blockSize, 1) * blockSize, left));
+    for (size_t i = 0; i < pattern.size(); i += 4) {
+      std::memcpy(pattern.data() + i, &chunk.fill, 4);
+    }
+
+    co_await co_program_start(at, chunk.blocks * sectorsPerBlock);
+    while (left) {
+      auto n = std::min<uint64_t>(left, pattern.size());
+      co_await transport_.co_write(std::span(pattern).first(n));
+      left -= n;
+    }
+    co_await co_program_finish(at);
+  }
+}
+
+asio::awaitable<void> FirehoseClient::co_reset() {
+  co_await co_send(R"(<power value="reset" />)");
+  auto response = co_await co_response();
+  if (!response.ack) {
+    throw flash_error("firehose: reset rejected");
+  }
+}
+
+namespace {
+
+// parsing only walks the chunk headers, cheap enough to do per device
+sparse_image::SparseImage parse_sparse(const FlashImage &image) {
+  try {
+    return sparse_image::SparseImage::parse(image.data);
+  } catch (sparse_image::sparse_error &e) {
+    throw flash_error(std::format("firehose: {}: {}", image.command.label, e.what()));
+  }
+}
+
+} // namespace
+
+asio::awaitable<void>
+co_flash_edl(Transport &transport, const FlashPlan &plan) {
+  co_await co_sahara_upload(transport, plan.programmer);
+
+  FirehoseClient firehose(transport, plan.firehose);
+  co_await firehose.co_configure();
+
+  for (auto &image : plan.images) {
+    if (sparse_image::SparseImage::is_sparse(image.data)) {
+      auto sparse = parse_sparse(image);
+      co_await firehose.co_program(image.command, sparse);
+    } else {
+      co_await firehose.co_program(image.command, image.data);
+    }
+  }
+
+  if (plan.reset) {
+    co_await firehose.co_reset();
+  }
+}
+
+} // namespace edl_flash
+
+#ifdef ENABLE_TEST
+#include "firehose_tests.cc"
+#endif
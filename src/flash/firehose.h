@@ -0,0 +1,111 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include "edl-transport.h"
+#include "sparse/sparse-image.h"
+#include <functional>
+#include <string_view>
+#include <vector>
+
+// firehose, the xml protocol of the programmer uploaded by sahara.
+// program commands are followed by the raw sectors, streamed in writes of
+// the largest payload the device accepts with no round trip in between.
+
+namespace edl_flash {
+
+struct FirehoseOptions {
+  std::string memoryName{"ufs"};
+  // asked for in configure, the device may settle on less
+  size_t maxPayload{1 << 20};
+  bool skipStorageInit{false};
+  // <log> lines of the device, logged at debug level when empty
+  std::function<void(std::string_view)> log;
+};
+
+struct ProgramCommand {
+  uint32_t sectorSize{4096};
+  uint64_t startSector{0};
+  uint32_t physicalPartition{0};
+  std::string label;
+  std::string filename;
+};
+
+class FirehoseClient {
+public:
+  explicit FirehoseClient(Transport &transport, FirehoseOptions options = {});
+
+  // negotiates the payload size, retrying once with what the device supports
+  asio::awaitable<void> co_configure();
+
+  // data is padded with zeros to whole sectors
+  asio::awaitable<void> co_program(const ProgramCommand &command, std::span<const uint8_t> data);
+
+  // one program per chunk at its block offset: raw chunks straight from
+  // the image, fills streamed from one payload of the pattern, don't care
+  // blocks skipped. the block size must be a multiple of the sector size.
+  asio::awaitable<void> co_program(const ProgramCommand &command, const sparse_image::SparseImage &image);
+
+  asio::awaitable<void> co_reset();
+
+  size_t maxPayload() const { return maxPayload_; }
+
+private:
+  struct Response {
+    bool ack{false};
+    std::string element; // the whole <response .../>
+  };
+
+  asio::awaitable<void> co_send(std::string_view xml);
+  asio::awaitable<Response> co_response();
+  asio::awaitable<void> co_program_start(const ProgramCommand &command, uint64_t sectors);
+  asio::awaitable<void> co_program_finish(const ProgramCommand &command);
+
+  Transport &transport_;
+  FirehoseOptions options_;
+  size_t maxPayload_;
+  std::string pending_;
+};
+
+// one image of a flash plan, data usually points into a MappedFile.
+// android sparse images are recognized and expanded on the fly.
+struct FlashImage {
+  ProgramCommand command;
+  std::span<const uint8_t> data;
+};
+
+struct FlashPlan {
+  std::span<const uint8_t> programmer;
+  std::vector<FlashImage> images;
+  FirehoseOptions firehose;
+  bool reset{true};
+};
+
+// sahara upload, configure, program every image, reset.
+// a plan is read only, any number of devices can be flashed from it at once
+// (e.g. adb_client::co_for_each_bounded over their transports).
+asio::awaitable<void>
+co_flash_edl(Transport &transport, const FlashPlan &plan);
+
+// value of attribute name in one xml element, empty if missing
+std::string_view xml_attribute(std::string_view element, std::string_view name);
+
+} // namespace edl_flash
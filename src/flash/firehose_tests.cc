@@ -0,0 +1,232 @@
+#include "adb-client/co-parallel.h"
+#include <asio/co_spawn.hpp>
+#include <asio/io_context.hpp>
+#include <asio/local/stream_protocol.hpp>
+#include <thread>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace edl_flash {
+
+TEST(EdlFlash, XmlAttribute) {
+  std::string_view e = R"(<response value="ACK" rawmode="true" MaxPayloadSizeToTargetInBytes="1048576"/>)";
+  EXPECT_EQ(xml_attribute(e, "value"), "ACK");
+  EXPECT_EQ(xml_attribute(e, "rawmode"), "true");
+  EXPECT_EQ(xml_attribute(e, "MaxPayloadSizeToTargetInBytes"), "1048576");
+  EXPECT_EQ(xml_attribute(e, "MaxPayload"), "");
+}
+
+#ifndef _WIN32
+
+namespace {
+
+// scripted device on the other end of a socketpair: sahara pulls the
+// programmer, firehose rejects the first configure and takes any program
+struct FakeTarget {
+  int fd;
+  size_t payload{16384};
+  std::vector<uint8_t> programmer;
+  std::vector<uint8_t> flashed;
+  uint64_t startSector{0};
+  // every program at its sector
+  std::vector<uint8_t> disk;
+  bool reset{false};
+  std::string error;
+
+  void readExact(void *p, size_t n) {
+    auto *b = static_cast<uint8_t *>(p);
+    while (n) {
+      auto r = ::read(fd, b, n);
+      if (r <= 0) throw std::runtime_error("eof");
+      b += r;
+      n -= r;
+    }
+  }
+
+  void write(const void *p, size_t n) {
+    if (::write(fd, p, n) != ssize_t(n)) throw std::runtime_error("short write");
+  }
+
+  void packet(std::initializer_list<uint32_t> words) {
+    std::vector<uint32_t> p(words);
+    p[1] = uint32_t(p.size() * 4);
+    write(p.data(), p.size() * 4);
+  }
+
+  void packet64(uint32_t cmd, uint64_t id, uint64_t offset, uint64_t length) {
+    uint32_t h[2] = {cmd, 0x20};
+    uint64_t b[3] = {id, offset, length};
+    write(h, sizeof(h));
+    write(b, sizeof(b));
+  }
+
+  std::string readDoc() {
+    std::string doc;
+    while (doc.find("</data>") == std::string::npos) {
+      char c;
+      readExact(&c, 1);
+      doc += c;
+    }
+    return doc;
+  }
+
+  void respond(std::string_view attrs) {
+    auto doc = std::format(R"(<?xml version="1.0" ?><data><response value={} /></data>)", attrs);
+    write(doc.data(), doc.size());
+  }
+
+  void run(size_t programmer_size) {
+    try {
+      packet({0x01, 0, 2, 1, 0x400, 0, 0, 0, 0, 0, 0, 0});
+      uint32_t hello_resp[12];
+      readExact(hello_resp, sizeof(hello_resp));
+      if (hello_resp[0] != 0x02) throw std::runtime_error("no hello response");
+
+      programmer.resize(programmer_size);
+      for (size_t off = 0; off < programmer_size; off += 1000) {
+        auto n = std::min<size_t>(1000, programmer_size - off);
+        if (off == 0) packet({0x03, 0, 13, uint32_t(off), uint32_t(n)});
+        else packet64(0x12, 13, off, n);
+        readExact(programmer.data() + off, n);
+      }
+
+      packet({0x04, 0, 13, 0});
+      uint32_t done[2];
+      readExact(done, sizeof(done));
+      if (done[0] != 0x05) throw std::runtime_error("no done");
+      packet({0x06, 0, 1});
+
+      auto doc = readDoc();
+      if (doc.find("<configure") == std::string::npos) throw std::runtime_error("no configure");
+      respond(R"("NAK" MaxPayloadSizeToTargetInBytesSupported="16384")");
+      doc = readDoc();
+      if (xml_attribute(doc, "MaxPayloadSizeToTargetInBytes") != "16384") throw std::runtime_error("payload not lowered");
+      const char *log = R"(<?xml version="1.0" ?><data><log value="storage ready" /></data>)";
+      write(log, strlen(log));
+      respond(R"("ACK" MaxPayloadSizeToTargetInBytes="16384")");
+
+      for (;;) {
+        doc = readDoc();
+        if (doc.find("<power") != std::string::npos) {
+          reset = true;
+          respond(R"("ACK")");
+          return;
+        }
+
+        auto size = std::stoul(std::string(xml_attribute(doc, "SECTOR_SIZE_IN_BYTES")));
+        auto sectors = std::stoul(std::string(xml_attribute(doc, "num_partition_sectors")));
+        startSector = std::stoul(std::string(xml_attribute(doc, "start_sector")));
+        respond(R"("ACK" rawmode="true")");
+        flashed.resize(size * sectors);
+        readExact(flashed.data(), flashed.size());
+        disk.resize(std::max(disk.size(), size * (startSector + sectors)));
+        std::ranges::copy(flashed, disk.begin() + size * startSector);
+        respond(R"("ACK" rawmode="false")");
+      }
+    } catch (std::exception &e) {
+      error = e.what();
+    }
+  }
+};
+
+using LocalTransport = StreamTransport<asio::local::stream_protocol::socket>;
+
+std::vector<uint8_t> pattern(size_t size, uint8_t seed) {
+  std::vector<uint8_t> v(size);
+  for (size_t i = 0; i < size; i++) v[i] = uint8_t(i * 31 + seed);
+  return v;
+}
+
+} // namespace
+
+TEST(EdlFlash, ConcurrentDevicesFromOnePlan) {
+  constexpr int kDevices = 4;
+  auto programmer = pattern(12345, 1);
+  auto image = pattern(100000, 2); // not a whole number of sectors
+
+  // 512 byte sectors under 4k blocks: raw, a 0x5a fill, raw
+  auto super = pattern(4096 * 20, 3);
+  std::fill(super.begin() + 4096 * 5, super.begin() + 4096 * 15, 0x5a);
+  auto superSparse = sparse_image::SparseImage::from_raw(super).split(SIZE_MAX)[0];
+  std::vector<uint8_t> superFile;
+  for (auto b : superSparse.buffers()) superFile.insert(superFile.end(), b.begin(), b.end());
+
+  FlashPlan plan;
+  plan.programmer = programmer;
+  plan.images.push_back({{.sectorSize = 512, .startSector = 800, .label = "super"}, superFile});
+  plan.images.push_back({{.sectorSize = 4096, .startSector = 64, .label = "boot"}, image});
+  std::vector<std::string> logs;
+  plan.firehose.log = [&logs](std::string_view line) { logs.emplace_back(line); };
+
+  asio::io_context io;
+  std::vector<std::unique_ptr<FakeTarget>> targets;
+  std::vector<std::thread> threads;
+  std::vector<std::unique_ptr<Transport>> transports;
+
+  for (int i = 0; i < kDevices; i++) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds), 0);
+    auto target = std::make_unique<FakeTarget>();
+    target->fd = fds[1];
+    threads.emplace_back([t = target.get(), size = programmer.size()] {
+      t->run(size);
+      ::close(t->fd);
+    });
+    targets.push_back(std::move(target));
+    transports.push_back(std::make_unique<LocalTransport>(
+      asio::local::stream_protocol::socket(io, asio::local::stream_protocol(), fds[0])));
+  }
+
+  int flashed = 0;
+  co_spawn(io, adb_client::co_for_each_bounded(kDevices, kDevices, [&](size_t i) -> asio::awaitable<void> {
+    co_await co_flash_edl(*transports[i], plan);
+    flashed++;
+  }), asio::detached);
+  io.run();
+
+  for (auto &t : threads) t.join();
+
+  EXPECT_EQ(flashed, kDevices);
+  EXPECT_EQ(logs.size(), size_t(kDevices));
+  for (auto &t : targets) {
+    EXPECT_EQ(t->error, "");
+    EXPECT_EQ(t->programmer, programmer);
+    EXPECT_EQ(t->startSector, 64u);
+    ASSERT_EQ(t->flashed.size(), 25u * 4096);
+    EXPECT_TRUE(std::equal(image.begin(), image.end(), t->flashed.begin()));
+    EXPECT_TRUE(std::all_of(t->flashed.begin() + image.size(), t->flashed.end(), [](uint8_t b) { return b == 0; }));
+    ASSERT_GE(t->disk.size(), 512 * 800 + super.size());
+    EXPECT_TRUE(std::equal(super.begin(), super.end(), t->disk.begin() + 512 * 800));
+    EXPECT_TRUE(t->reset);
+  }
+}
+
+TEST(EdlFlash, SaharaRejectsReadPastProgrammer) {
+  asio::io_context io;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds), 0);
+  LocalTransport transport(asio::local::stream_protocol::socket(io, asio::local::stream_protocol(), fds[0]));
+
+  uint32_t request[5] = {0x03, 0x14, 13, 0, 4096};
+  ASSERT_EQ(::write(fds[1], request, sizeof(request)), ssize_t(sizeof(request)));
+
+  std::string error;
+  std::vector<uint8_t> programmer(100);
+  co_spawn(io, [&]() -> asio::awaitable<void> {
+    try {
+      co_await co_sahara_upload(transport, programmer);
+    } catch (flash_error &e) {
+      error = e.what();
+    }
+  }, asio::detached);
+  io.run();
+  ::close(fds[1]);
+
+  EXPECT_NE(error.find("past the 100 byte programmer"), std::string::npos);
+}
+
+#endif
+
+} // namespace edl_flash
@@ -0,0 +1,165 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "sahara.h"
+#include "tracing/logger.h"
+#include <array>
+#include <cstring>
+#include <format>
+
+namespace edl_flash {
+
+namespace {
+
+constexpr uint32_t kSaharaVersion = 2;
+constexpr uint32_t kSaharaVersionSupported = 1;
+constexpr uint32_t kModeImageTxPending = 0;
+constexpr uint32_t kDoneComplete = 1;
+
+// packets are little endian u32 (u64 for ReadData64) words, the first
+// two being command and total length
+struct PacketHeader {
+  uint32_t command;
+  uint32_t length;
+};
+
+constexpr size_t kMaxPacket = 0x100;
+using Packet = std::array<uint8_t, kMaxPacket>;
+
+uint32_t u32_at(const uint8_t *p) {
+  return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+uint64_t u64_at(const uint8_t *p) {
+  return u32_at(p) | (uint64_t(u32_at(p + 4)) << 32);
+}
+
+void put_u32(uint8_t *p, uint32_t v) {
+  p[0] = uint8_t(v);
+  p[1] = uint8_t(v >> 8);
+  p[2] = uint8_t(v >> 16);
+  p[3] = uint8_t(v >> 24);
+}
+
+// command and body, length checked against the command
+asio::awaitable<PacketHeader>
+co_read_packet(Transport &transport, Packet &packet) {
+  co_await transport.co_read_exact({packet.data(), sizeof(PacketHeader)});
+  PacketHeader header{u32_at(packet.data()), u32_at(packet.data() + 4)};
+  if (header.length < sizeof(PacketHeader) || header.length > kMaxPacket) {
+    throw flash_error(std::format("sahara: bad packet length {} (command {})", header.length, header.command));
+  }
+
+  co_await transport.co_read_exact({packet.data() + sizeof(PacketHeader), header.length - sizeof(PacketHeader)});
+  co_return header;
+}
+
+// returns the packet length
+uint32_t make_packet(Packet &packet, SaharaCommand command, std::initializer_list<uint32_t> words) {
+  auto length = uint32_t(sizeof(PacketHeader) + words.size() * 4);
+  put_u32(packet.data(), static_cast<uint32_t>(command));
+  put_u32(packet.data() + 4, length);
+
+  auto *p = packet.data() + sizeof(PacketHeader);
+  for (auto w : words) {
+    put_u32(p, w);
+    p += 4;
+  }
+  return length;
+}
+
+} // namespace
+
+asio::awaitable<void>
+co_sahara_upload(Transport &transport, std::span<const uint8_t> programmer) {
+  Packet packet;
+  Packet reply{};
+  uint64_t served = 0;
+
+  for (;;) {
+    auto header = co_await co_read_packet(transport, packet);
+    const uint8_t *body = packet.data() + sizeof(PacketHeader);
+    auto body_size = header.length - sizeof(PacketHeader);
+
+    switch (static_cast<SaharaCommand>(header.command)) {
+    case SaharaCommand::Hello: {
+      if (body_size < 16) {
+        throw flash_error("sahara: short hello");
+      }
+      DEVICE_WATCH_LOG_DEBUG("sahara: hello version {} mode {}", u32_at(body), u32_at(body + 12));
+      auto length = make_packet(reply, SaharaCommand::HelloResponse,
+                                {kSaharaVersion, kSaharaVersionSupported, 0, kModeImageTxPending, 0, 0, 0, 0, 0, 0});
+      co_await transport.co_write({reply.data(), length});
+      break;
+    }
+
+    case SaharaCommand::ReadData:
+    case SaharaCommand::ReadData64: {
+      uint64_t offset, length;
+      if (header.command == static_cast<uint32_t>(SaharaCommand::ReadData)) {
+        if (body_size < 12) {
+          throw flash_error("sahara: short read request");
+        }
+        offset = u32_at(body + 4);
+        length = u32_at(body + 8);
+      } else {
+        if (body_size < 24) {
+          throw flash_error("sahara: short read request");
+        }
+        offset = u64_at(body + 8);
+        length = u64_at(body + 16);
+      }
+
+      if (offset > programmer.size() || length > programmer.size() - offset) {
+        throw flash_error(std::format("sahara: read {}+{} past the {} byte programmer", offset, length, programmer.size()));
+      }
+
+      co_await transport.co_write(programmer.subspan(offset, length));
+      served += length;
+      break;
+    }
+
+    case SaharaCommand::EndOfImage: {
+      auto status = body_size >= 8 ? u32_at(body + 4) : 0;
+      if (status != 0) {
+        throw flash_error(std::format("sahara: image transfer failed, status {:#x}", status));
+      }
+      DEVICE_WATCH_LOG_DEBUG("sahara: programmer sent, {} bytes served", served);
+      auto length = make_packet(reply, SaharaCommand::Done, {});
+      co_await transport.co_write({reply.data(), length});
+      break;
+    }
+
+    case SaharaCommand::DoneResponse: {
+      auto status = body_size >= 4 ? u32_at(body) : 0;
+      if (status != kDoneComplete) {
+        throw flash_error(std::format("sahara: done with status {}", status));
+      }
+      co_return;
+    }
+
+    default:
+      throw flash_error(std::format("sahara: unexpected command {:#x}", header.command));
+    }
+  }
+}
+
+} // namespace edl_flash
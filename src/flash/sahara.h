@@ -0,0 +1,50 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include "edl-transport.h"
+
+// sahara, the boot rom side of emergency download mode: the device says
+// hello and then pulls the programmer (a firehose elf) in pieces of its
+// choosing. once the transfer is done the programmer runs and the same
+// transport speaks firehose.
+
+namespace edl_flash {
+
+enum class SaharaCommand : uint32_t {
+  Hello = 0x01,
+  HelloResponse = 0x02,
+  ReadData = 0x03,
+  EndOfImage = 0x04,
+  Done = 0x05,
+  DoneResponse = 0x06,
+  Reset = 0x07,
+  ResetResponse = 0x08,
+  ReadData64 = 0x12,
+};
+
+// serves programmer until the device reports the image transfer complete.
+// the data requested is written straight from programmer, which may be a
+// mapping shared by any number of concurrent uploads.
+asio::awaitable<void>
+co_sahara_upload(Transport &transport, std::span<const uint8_t> programmer);
+
+} // namespace edl_flash
@@ -0,0 +1,198 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "journal/event-journal.h"
+#include "tracing/logger.h"
+#include "device-json.h"
+#include <gflags/gflags.h>
+#include <charconv>
+#include <ctime>
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+using device_journal::Clock;
+using device_journal::JournalEvent;
+using device_journal::JournalReader;
+
+DEFINE_string(journal_dir, "",
+                  "journal directory written by adb-device-watch --journal_dir");
+
+DEFINE_string(from, "",
+                  "oldest event time, 'now', relative (-90m, -12h, -7d), epoch seconds or local 'YYYY-MM-DD[ HH:MM[:SS]]'");
+
+DEFINE_string(to, "now",
+                  "newest event time (exclusive), same formats as --from");
+
+DEFINE_string(identity, "",
+                  "list the history of one device identity, newest first");
+
+DEFINE_string(hub, "",
+                  "only events of devices on this hub (hub or parentHub)");
+
+DEFINE_string(serial, "",
+                  "only events of this serial");
+
+DEFINE_int32(limit, 0,
+                  "stop after this many events, 0 for all");
+
+DEFINE_bool(pretty, false,
+                  "pretty json output.");
+
+namespace {
+
+bool parse_time(std::string_view str, Clock::time_point &tp) {
+  auto now = Clock::now();
+  if (str.empty()) {
+    tp = Clock::time_point{};
+    return true;
+  }
+
+  if (str == "now") {
+    tp = now;
+    return true;
+  }
+
+  if (str[0] == '-') {
+    int64_t value = 0;
+    auto [ptr, ec] = std::from_chars(str.data() + 1, str.data() + str.size(), value);
+    if (ec != std::errc() || ptr + 1 != str.data() + str.size()) {
+      return false;
+    }
+
+    switch (*ptr) {
+    case 's': tp = now - std::chrono::seconds(value); return true;
+    case 'm': tp = now - std::chrono::minutes(value); return true;
+    case 'h': tp = now - std::chrono::hours(value); return true;
+    case 'd': tp = now - std::chrono::hours(value * 24); return true;
+    default: return false;
+    }
+  }
+
+  int64_t epoch = 0;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), epoch);
+  if (ec == std::errc() && ptr == str.data() + str.size()) {
+    tp = Clock::from_time_t(static_cast<time_t>(epoch));
+    return true;
+  }
+
+  std::tm tm{};
+  std::string s(str);
+  int n = sscanf(s.c_str(), "%d-%d-%d %d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                 &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+  if (n != 3 && n != 5 && n != 6) {
+    return false;
+  }
+
+  tm.tm_year -= 1900;
+  tm.tm_mon -= 1;
+  tm.tm_isdst = -1;
+  auto secs = mktime(&tm);
+  if (secs == -1) {
+    return false;
+  }
+
+  tp = Clock::from_time_t(secs);
+  return true;
+}
+
+std::string format_time(Clock::time_point tp) {
+  auto secs = Clock::to_time_t(tp);
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count() % 1000;
+
+  std::tm tm{};
+#ifdef _WIN32
+  localtime_s(&tm, &secs);
+#else
+  localtime_r(&secs, &tm);
+#endif
+
+  char buf[32];
+  auto len = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+  snprintf(buf + len, sizeof(buf) - len, ".%03d", static_cast<int>(ms));
+  return buf;
+}
+
+bool matches(const JournalEvent &ev) {
+  auto &dev = ev.device;
+  if (FLAGS_hub.size() && dev.hub != FLAGS_hub && dev.parentHub != FLAGS_hub) {
+    return false;
+  }
+  if (FLAGS_serial.size() && dev.serial != FLAGS_serial) {
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  gflags::SetUsageMessage("query the device event journal of adb-device-watch");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_journal_dir.empty()) {
+    DEVICE_WATCH_LOG_ERROR("--journal_dir is required");
+    return 1;
+  }
+
+  Clock::time_point from, to;
+  if (!parse_time(FLAGS_from, from)) {
+    DEVICE_WATCH_LOG_ERROR("bad --from: {}", FLAGS_from);
+    return 1;
+  }
+
+  if (!parse_time(FLAGS_to, to)) {
+    DEVICE_WATCH_LOG_ERROR("bad --to: {}", FLAGS_to);
+    return 1;
+  }
+
+  JournalReader reader;
+  if (!reader.open(FLAGS_journal_dir)) {
+    DEVICE_WATCH_LOG_ERROR("no journal in {}", FLAGS_journal_dir);
+    return 1;
+  }
+
+  int count = 0;
+  auto print = [&count](const JournalEvent &ev) {
+    if (!matches(ev)) {
+      return true;
+    }
+
+    auto jdev = device_enumerator::deviceNodeToJsonObject(ev.device);
+    jdev["seq"] = ev.seq;
+    jdev["time"] = format_time(ev.time);
+    std::cout << jdev.dump(FLAGS_pretty ? 4 : -1) << '\n';
+    return FLAGS_limit <= 0 || ++count < FLAGS_limit;
+  };
+
+  if (FLAGS_identity.size()) {
+    reader.history(FLAGS_identity, [&](const JournalEvent &ev) {
+      if (ev.time >= to) {
+        return true;
+      }
+      return ev.time >= from && print(ev);
+    });
+  } else {
+    reader.range(from, to, print);
+  }
+
+  std::cout.flush();
+  return 0;
+}
@@ -0,0 +1,806 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "event-journal.h"
+#include "tracing/logger.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <codecvt>
+#include <locale>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#endif
+
+namespace device_journal {
+
+using device_enumerator::DeviceId;
+using device_enumerator::DeviceInterface;
+using device_enumerator::DeviceType;
+using device_enumerator::UsbSpeed;
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kSegmentMagic[8] = {'D', 'W', 'J', 'S', 'E', 'G', '0', '1'};
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kIndexEvery = 64;
+
+struct SegmentHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t number;
+  int64_t created;
+  uint8_t reserved[40];
+};
+static_assert(sizeof(SegmentHeader) == 64);
+
+// string fields of a record: the identity as 16 hex digits first,
+// these members, description last
+constexpr std::string DeviceInterface::* kStringMembers[] = {
+  &DeviceInterface::devpath,
+  &DeviceInterface::hub,
+  &DeviceInterface::serial,
+  &DeviceInterface::manufacturer,
+  &DeviceInterface::product,
+  &DeviceInterface::model,
+  &DeviceInterface::device,
+  &DeviceInterface::ip,
+  &DeviceInterface::driver,
+  &DeviceInterface::adbServer,
+  &DeviceInterface::parentHub,
+};
+constexpr size_t kStringFields = std::size(kStringMembers) + 2;
+
+// followed by the strings back to back, padded to 8 bytes
+struct RecordHeader {
+  uint32_t size;     // whole record, 0 past the last one
+  uint32_t checksum; // fnv-1a of the record after this field
+  uint64_t seq;
+  int64_t time;      // ns since the epoch
+  uint64_t prev;     // position of the previous record of the identity, 0 if none
+  uint32_t type;
+  uint16_t vid;
+  uint16_t pid;
+  uint16_t port;
+  int16_t usbIf;
+  uint8_t off;
+  uint8_t speed;
+  uint8_t parentHubSpeed;
+  uint8_t usbClass;
+  uint8_t usbSubClass;
+  uint8_t usbProto;
+  uint8_t reserved[4];
+  uint16_t lengths[kStringFields];
+};
+static_assert(sizeof(RecordHeader) == 80);
+
+struct IndexEntry {
+  int64_t time;
+  uint64_t seq;
+  uint64_t offset;
+};
+
+// <segment number, offset in the segment>
+constexpr uint64_t position(uint32_t segment, uint64_t offset) {
+  return (uint64_t(segment) << 32) | offset;
+}
+
+constexpr uint32_t segmentOf(uint64_t pos) {
+  return uint32_t(pos >> 32);
+}
+
+constexpr uint32_t offsetOf(uint64_t pos) {
+  return uint32_t(pos);
+}
+
+uint32_t fnv1a(const char *p, size_t n) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++) {
+    h = (h ^ uint8_t(p[i])) * 16777619u;
+  }
+  return h;
+}
+
+std::string description_bytes(const DeviceInterface &dev) {
+#ifdef _WIN32
+  std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
+  return converter.to_bytes(dev.description);
+#else
+  return dev.description;
+#endif
+}
+
+void set_description(DeviceInterface &dev, std::string_view bytes) {
+#ifdef _WIN32
+  std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
+  dev.description = converter.from_bytes(bytes.data(), bytes.data() + bytes.size());
+#else
+  dev.description = bytes;
+#endif
+}
+
+fs::path segment_path(const fs::path &dir, uint32_t number, const char *ext) {
+  char name[24];
+  snprintf(name, sizeof(name), "%08u%s", number, ext);
+  return dir / name;
+}
+
+// segment numbers in dir, ascending
+std::vector<uint32_t> list_segments(const fs::path &dir) {
+  std::vector<uint32_t> numbers;
+  std::error_code ec;
+  for (auto &entry : fs::directory_iterator(dir, ec)) {
+    if (entry.path().extension() != ".seg") {
+      continue;
+    }
+    auto stem = entry.path().stem().string();
+    uint32_t n = 0;
+    auto [ptr, err] = std::from_chars(stem.data(), stem.data() + stem.size(), n);
+    if (err == std::errc() && ptr == stem.data() + stem.size() && n > 0) {
+      numbers.push_back(n);
+    }
+  }
+  std::ranges::sort(numbers);
+  return numbers;
+}
+
+// one segment file mapped whole
+class SegmentMap {
+public:
+  SegmentMap() = default;
+  ~SegmentMap() { unmap(); }
+
+  SegmentMap(const SegmentMap &) = delete;
+  SegmentMap& operator=(const SegmentMap &) = delete;
+
+  // writable maps at least size bytes, extending the file with zeros
+  bool map(const fs::path &path, size_t size, bool writable) {
+    unmap();
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(),
+                              writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                              writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+
+    LARGE_INTEGER st;
+    if (!GetFileSizeEx(file, &st)) {
+      CloseHandle(file);
+      return false;
+    }
+
+    size = writable ? std::max<size_t>(size, st.QuadPart) : static_cast<size_t>(st.QuadPart);
+    if (size == 0) {
+      CloseHandle(file);
+      return false;
+    }
+
+    // a writable mapping larger than the file grows it
+    HANDLE mapping = CreateFileMappingW(file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                        DWORD(uint64_t(size) >> 32), DWORD(size), NULL);
+    if (!mapping) {
+      CloseHandle(file);
+      return false;
+    }
+
+    void *p = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+    CloseHandle(mapping);
+    if (!p) {
+      CloseHandle(file);
+      return false;
+    }
+
+    file_ = file;
+#else
+    int fd = ::open(path.c_str(), writable ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      ::close(fd);
+      return false;
+    }
+
+    if (writable && size_t(st.st_size) < size) {
+      if (ftruncate(fd, size) != 0) {
+        ::close(fd);
+        return false;
+      }
+    } else {
+      size = st.st_size;
+    }
+
+    if (size == 0) {
+      ::close(fd);
+      return false;
+    }
+
+    void *p = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+      return false;
+    }
+#endif
+    data_ = static_cast<char *>(p);
+    size_ = size;
+    return true;
+  }
+
+  // the file keeps its size, a reader may still map all of it
+  void unmap() noexcept {
+    if (!data_) {
+      return;
+    }
+#ifdef _WIN32
+    FlushViewOfFile(data_, 0);
+    UnmapViewOfFile(data_);
+    CloseHandle(file_);
+    file_ = nullptr;
+#else
+    munmap(data_, size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  void flush() noexcept {
+#ifdef _WIN32
+    if (data_) FlushViewOfFile(data_, 0);
+#else
+    if (data_) msync(data_, size_, MS_ASYNC);
+#endif
+  }
+
+  char *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool mapped() const { return data_ != nullptr; }
+
+private:
+  char *data_{nullptr};
+  size_t size_{0};
+#ifdef _WIN32
+  HANDLE file_{nullptr};
+#endif
+};
+
+bool valid_segment(const SegmentMap &seg) {
+  return seg.size() >= sizeof(SegmentHeader) &&
+         memcmp(seg.data(), kSegmentMagic, sizeof(kSegmentMagic)) == 0;
+}
+
+// the record at offset, nullptr past the last valid one
+const RecordHeader *record_at(const SegmentMap &seg, size_t offset) {
+  if (offset < sizeof(SegmentHeader) || offset + sizeof(RecordHeader) > seg.size() || offset % 8) {
+    return nullptr;
+  }
+
+  auto *rec = reinterpret_cast<const RecordHeader *>(seg.data() + offset);
+  // the writer stores size last
+  uint32_t size = std::atomic_ref(const_cast<uint32_t &>(rec->size)).load(std::memory_order_acquire);
+  if (size < sizeof(RecordHeader) || size % 8 || offset + size > seg.size()) {
+    return nullptr;
+  }
+
+  const char *p = seg.data() + offset;
+  if (fnv1a(p + 8, size - 8) != rec->checksum) {
+    return nullptr;
+  }
+  return rec;
+}
+
+std::string_view record_string(const RecordHeader *rec, size_t field) {
+  const char *p = reinterpret_cast<const char *>(rec) + sizeof(RecordHeader);
+  for (size_t i = 0; i < field; i++) {
+    p += rec->lengths[i];
+  }
+  return {p, rec->lengths[field]};
+}
+
+JournalEvent decode(const RecordHeader *rec) {
+  JournalEvent ev;
+  ev.seq = rec->seq;
+  ev.time = Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(rec->time)));
+
+  auto &dev = ev.device;
+  const char *p = reinterpret_cast<const char *>(rec) + sizeof(RecordHeader);
+  dev.identity = DeviceId::parse(std::string_view(p, rec->lengths[0])).value_or(DeviceId());
+  p += rec->lengths[0];
+  for (size_t i = 0; i < std::size(kStringMembers); i++) {
+    dev.*kStringMembers[i] = std::string_view(p, rec->lengths[i + 1]);
+    p += rec->lengths[i + 1];
+  }
+  set_description(dev, std::string_view(p, rec->lengths[kStringFields - 1]));
+
+  dev.type = static_cast<DeviceType>(rec->type);
+  dev.vid = rec->vid;
+  dev.pid = rec->pid;
+  dev.port = rec->port;
+  dev.usbIf = rec->usbIf;
+  dev.off = rec->off != 0;
+  dev.speed = static_cast<UsbSpeed>(rec->speed);
+  dev.parentHubSpeed = static_cast<UsbSpeed>(rec->parentHubSpeed);
+  dev.usbClass = rec->usbClass;
+  dev.usbSubClass = rec->usbSubClass;
+  dev.usbProto = rec->usbProto;
+  return ev;
+}
+
+using Heads = std::unordered_map<std::string, uint64_t>;
+
+// <pos u64><length u16><identity> repeated
+Heads read_heads(const fs::path &path) {
+  Heads heads;
+  std::ifstream in(path, std::ios::binary);
+  uint64_t pos;
+  uint16_t len;
+  while (in.read(reinterpret_cast<char *>(&pos), sizeof(pos)) &&
+         in.read(reinterpret_cast<char *>(&len), sizeof(len))) {
+    std::string identity(len, '\0');
+    if (!in.read(identity.data(), len)) {
+      break;
+    }
+    heads[std::move(identity)] = pos;
+  }
+  return heads;
+}
+
+bool write_heads(const fs::path &path, const Heads &heads) {
+  auto tmp = fs::path(path).concat(".tmp");
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    for (auto &[identity, pos] : heads) {
+      uint16_t len = uint16_t(std::min<size_t>(identity.size(), UINT16_MAX));
+      out.write(reinterpret_cast<const char *>(&pos), sizeof(pos));
+      out.write(reinterpret_cast<const char *>(&len), sizeof(len));
+      out.write(identity.data(), len);
+    }
+    if (!out) {
+      return false;
+    }
+  }
+  std::error_code ec;
+  fs::rename(tmp, path, ec);
+  return !ec;
+}
+
+std::vector<IndexEntry> read_index(const fs::path &path) {
+  std::vector<IndexEntry> index;
+  std::ifstream in(path, std::ios::binary);
+  IndexEntry e;
+  while (in.read(reinterpret_cast<char *>(&e), sizeof(e))) {
+    index.push_back(e);
+  }
+  return index;
+}
+
+int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+struct JournalWriter::Impl {
+  std::mutex mutex;
+  fs::path dir;
+  Options options;
+
+  SegmentMap seg;
+  uint32_t number{0};
+  size_t used{0};
+  std::ofstream index;
+
+  uint64_t seq{0};
+  int64_t lastTime{0};
+  uint32_t sinceIndex{0};
+  Heads heads;
+
+  bool openSegment(uint32_t n, bool resume);
+  void seal();
+  bool append(const DeviceInterface &dev);
+};
+
+bool JournalWriter::Impl::openSegment(uint32_t n, bool resume) {
+  auto path = segment_path(dir, n, ".seg");
+  if (!seg.map(path, options.segmentSize, true)) {
+    DEVICE_WATCH_LOG_ERROR("journal: cannot map {}", path.string());
+    return false;
+  }
+
+  number = n;
+  used = sizeof(SegmentHeader);
+  sinceIndex = 0;
+
+  if (resume && valid_segment(seg)) {
+    // pick up after the last intact record
+    while (auto *rec = record_at(seg, used)) {
+      heads[std::string(record_string(rec, 0))] = position(number, used);
+      seq = rec->seq;
+      lastTime = std::max(lastTime, rec->time);
+      used += rec->size;
+      sinceIndex = (sinceIndex + 1) % kIndexEvery;
+    }
+
+    // a torn write may have left bytes past the end, clear them so that
+    // nothing stale lines up behind the next records
+    auto *words = reinterpret_cast<uint64_t *>(seg.data() + used);
+    for (size_t i = 0, count = (seg.size() - used) / 8; i < count; i++) {
+      if (words[i]) words[i] = 0;
+    }
+
+    // drop index entries of records that did not survive
+    auto entries = read_index(segment_path(dir, number, ".idx"));
+    std::erase_if(entries, [this](auto &e) { return e.offset >= used; });
+    index.open(segment_path(dir, number, ".idx"), std::ios::binary | std::ios::trunc);
+    index.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(IndexEntry));
+  } else {
+    SegmentHeader header{};
+    memcpy(header.magic, kSegmentMagic, sizeof(kSegmentMagic));
+    header.version = kVersion;
+    header.number = number;
+    header.created = now_ns();
+    memcpy(seg.data(), &header, sizeof(header));
+    index.open(segment_path(dir, number, ".idx"), std::ios::binary | std::ios::trunc);
+  }
+
+  index.flush();
+  return index.good();
+}
+
+void JournalWriter::Impl::seal() {
+  if (!write_heads(segment_path(dir, number, ".heads"), heads)) {
+    DEVICE_WATCH_LOG_ERROR("journal: cannot write heads of segment {}", number);
+  }
+  index.close();
+  seg.unmap();
+}
+
+bool JournalWriter::Impl::append(const DeviceInterface &dev) {
+  char id_text[16];
+  auto identity = dev.identity.to_chars(id_text);
+  auto description = description_bytes(dev);
+
+  auto field = [&](size_t i) -> std::string_view {
+    if (i == 0) {
+      return identity;
+    }
+    return i <= std::size(kStringMembers) ? dev.*kStringMembers[i - 1] : description;
+  };
+
+  RecordHeader hdr{};
+  size_t strings = 0;
+  for (size_t i = 0; i < kStringFields; i++) {
+    size_t len = field(i).size();
+    hdr.lengths[i] = uint16_t(std::min<size_t>(len, UINT16_MAX));
+    strings += hdr.lengths[i];
+  }
+  size_t size = (sizeof(RecordHeader) + strings + 7) & ~size_t(7);
+
+  if (size + sizeof(SegmentHeader) > options.segmentSize) {
+    DEVICE_WATCH_LOG_ERROR("journal: {} byte record does not fit a segment", size);
+    return false;
+  }
+
+  if (used + size > seg.size()) {
+    seal();
+    if (!openSegment(number + 1, false)) {
+      return false;
+    }
+  }
+
+  // clamped, the index relies on time order
+  lastTime = std::max(lastTime, now_ns());
+  auto &head = heads[std::string(identity)];
+
+  hdr.seq = ++seq;
+  hdr.time = lastTime;
+  hdr.prev = head;
+  hdr.type = static_cast<uint32_t>(dev.type);
+  hdr.vid = dev.vid;
+  hdr.pid = dev.pid;
+  hdr.port = dev.port;
+  hdr.usbIf = int16_t(dev.usbIf);
+  hdr.off = dev.off;
+  hdr.speed = static_cast<uint8_t>(dev.speed);
+  hdr.parentHubSpeed = static_cast<uint8_t>(dev.parentHubSpeed);
+  hdr.usbClass = dev.usbClass;
+  hdr.usbSubClass = dev.usbSubClass;
+  hdr.usbProto = dev.usbProto;
+
+  char *out = seg.data() + used;
+  char *p = out + sizeof(RecordHeader);
+  for (size_t i = 0; i < kStringFields; i++) {
+    memcpy(p, field(i).data(), hdr.lengths[i]);
+    p += hdr.lengths[i];
+  }
+  memset(p, 0, out + size - p);
+
+  // size stays 0 until the checksum is in, a concurrent reader
+  // sees either no record or a whole one
+  hdr.size = 0;
+  memcpy(out, &hdr, sizeof(hdr));
+  uint32_t checksum = fnv1a(out + 8, size - 8);
+  memcpy(out + 4, &checksum, sizeof(checksum));
+  std::atomic_ref(*reinterpret_cast<uint32_t *>(out)).store(uint32_t(size), std::memory_order_release);
+
+  head = position(number, used);
+
+  if (sinceIndex == 0) {
+    IndexEntry e{hdr.time, hdr.seq, used};
+    index.write(reinterpret_cast<const char *>(&e), sizeof(e));
+    index.flush();
+  }
+  sinceIndex = (sinceIndex + 1) % kIndexEvery;
+
+  used += size;
+  return true;
+}
+
+JournalWriter::JournalWriter() = default;
+
+JournalWriter::~JournalWriter() {
+  close();
+}
+
+bool JournalWriter::open(const fs::path &dir, Options options) {
+  close();
+
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+  if (ec) {
+    DEVICE_WATCH_LOG_ERROR("journal: cannot create {}: {}", dir.string(), ec.message());
+    return false;
+  }
+
+  auto impl = std::make_unique<Impl>();
+  impl->dir = dir;
+  impl->options = options;
+  impl->options.segmentSize = std::max<size_t>(options.segmentSize, 64 << 10);
+
+  auto segments = list_segments(dir);
+  bool opened = false;
+  if (segments.empty()) {
+    opened = impl->openSegment(1, false);
+  } else {
+    auto last = segments.back();
+    if (last > 1) {
+      impl->heads = read_heads(segment_path(dir, last - 1, ".heads"));
+    }
+    opened = impl->openSegment(last, true);
+  }
+
+  if (!opened) {
+    return false;
+  }
+
+  impl_ = std::move(impl);
+  return true;
+}
+
+bool JournalWriter::opened() const {
+  return impl_ != nullptr;
+}
+
+void JournalWriter::append(const DeviceInterface &dev) {
+  if (!impl_) {
+    return;
+  }
+
+  std::lock_guard lk(impl_->mutex);
+  if (impl_->seg.mapped()) {
+    impl_->append(dev);
+  }
+}
+
+void JournalWriter::flush() {
+  if (impl_) {
+    std::lock_guard lk(impl_->mutex);
+    impl_->seg.flush();
+  }
+}
+
+void JournalWriter::close() {
+  if (!impl_) {
+    return;
+  }
+
+  {
+    std::lock_guard lk(impl_->mutex);
+    impl_->index.close();
+    impl_->seg.unmap();
+  }
+  impl_.reset();
+}
+
+struct JournalReader::Impl {
+  struct Segment {
+    uint32_t number{0};
+    SegmentMap map;
+    std::vector<IndexEntry> index;
+    bool loaded{false};
+
+    // latest record of every identity before offset scanned, extended
+    // by each history() query as the writer appends
+    Heads latest;
+    size_t scanned{sizeof(SegmentHeader)};
+  };
+
+  fs::path dir;
+  // by number, mapped and indexed on first use
+  mutable std::vector<std::unique_ptr<Segment>> segments;
+  // heads written when the segment before the last one was sealed
+  mutable std::optional<Heads> sealedHeads;
+
+  Segment *load(size_t i) const {
+    auto &seg = *segments[i];
+    if (!seg.loaded) {
+      seg.loaded = true;
+      if (seg.map.map(segment_path(dir, seg.number, ".seg"), 0, false) && !valid_segment(seg.map)) {
+        seg.map.unmap();
+      }
+      seg.index = read_index(segment_path(dir, seg.number, ".idx"));
+    }
+    return seg.map.mapped() ? &seg : nullptr;
+  }
+
+  Segment *find(uint32_t number) const {
+    auto it = std::ranges::lower_bound(segments, number, {}, [](auto &s) { return s->number; });
+    if (it == segments.end() || (*it)->number != number) {
+      return nullptr;
+    }
+    return load(it - segments.begin());
+  }
+
+  // time of the first record, from the index
+  int64_t firstTime(size_t i) const {
+    auto *seg = load(i);
+    return seg && seg->index.size() ? seg->index.front().time : INT64_MAX;
+  }
+};
+
+JournalReader::JournalReader() = default;
+JournalReader::~JournalReader() = default;
+
+bool JournalReader::open(const fs::path &dir) {
+  auto impl = std::make_unique<Impl>();
+  impl->dir = dir;
+  for (auto n : list_segments(dir)) {
+    auto seg = std::make_unique<Impl::Segment>();
+    seg->number = n;
+    impl->segments.push_back(std::move(seg));
+  }
+
+  if (impl->segments.empty()) {
+    return false;
+  }
+
+  impl_ = std::move(impl);
+  return true;
+}
+
+void JournalReader::range(Clock::time_point from, Clock::time_point to, const EventVisitor &visit) const {
+  if (!impl_) {
+    return;
+  }
+
+  using std::chrono::nanoseconds;
+  int64_t from_ns = std::chrono::duration_cast<nanoseconds>(from.time_since_epoch()).count();
+  int64_t to_ns = std::chrono::duration_cast<nanoseconds>(to.time_since_epoch()).count();
+
+  // last segment starting at or before from
+  auto &segments = impl_->segments;
+  size_t lo = 0, hi = segments.size();
+  while (hi - lo > 1) {
+    size_t mid = (lo + hi) / 2;
+    if (impl_->firstTime(mid) <= from_ns) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  for (size_t i = lo; i < segments.size(); i++) {
+    auto *seg = impl_->load(i);
+    if (!seg) {
+      continue;
+    }
+
+    // the index entry before the first one at or after from
+    size_t offset = sizeof(SegmentHeader);
+    auto it = std::ranges::lower_bound(seg->index, from_ns, {}, &IndexEntry::time);
+    if (it != seg->index.begin()) {
+      offset = std::prev(it)->offset;
+    }
+
+    while (auto *rec = record_at(seg->map, offset)) {
+      if (rec->time >= to_ns) {
+        return;
+      }
+      if (rec->time >= from_ns && !visit(decode(rec))) {
+        return;
+      }
+      offset += rec->size;
+    }
+  }
+}
+
+void JournalReader::history(std::string_view identity, const EventVisitor &visit) const {
+  if (!impl_) {
+    return;
+  }
+
+  // the newest record is in the open segment or in the heads of the one before it
+  uint64_t pos = 0;
+  auto &segments = impl_->segments;
+  std::string key(identity);
+  if (auto *seg = impl_->load(segments.size() - 1)) {
+    while (auto *rec = record_at(seg->map, seg->scanned)) {
+      seg->latest[std::string(record_string(rec, 0))] = position(seg->number, seg->scanned);
+      seg->scanned += rec->size;
+    }
+    if (auto it = seg->latest.find(key); it != seg->latest.end()) {
+      pos = it->second;
+    }
+  }
+
+  if (pos == 0 && segments.size() > 1) {
+    if (!impl_->sealedHeads) {
+      impl_->sealedHeads = read_heads(segment_path(impl_->dir, segments[segments.size() - 2]->number, ".heads"));
+    }
+    if (auto it = impl_->sealedHeads->find(key); it != impl_->sealedHeads->end()) {
+      pos = it->second;
+    }
+  }
+
+  while (pos) {
+    auto *seg = impl_->find(segmentOf(pos));
+    auto *rec = seg ? record_at(seg->map, offsetOf(pos)) : nullptr;
+    if (!rec || record_string(rec, 0) != identity || !visit(decode(rec))) {
+      return;
+    }
+    pos = rec->prev;
+  }
+}
+
+} // namespace device_journal
+
+#ifdef ENABLE_TEST
+#include "event-journal_tests.cc"
+#endif
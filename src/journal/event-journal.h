@@ -0,0 +1,118 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include "device-enumerator/usb-watch-base.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string_view>
+
+// append-only journal of device events, for post-mortem queries
+// ("when did hub USB1-9-1 drop off last night?").
+//
+// a journal is a directory of segments:
+//   00000001.seg    mmap'd file of compact binary records, preallocated
+//                   (sparse) to the segment size. a sealed segment keeps
+//                   its size so that readers mapping it stay valid, they
+//                   stop at the first zero length record
+//   00000001.idx    sparse index, (time, seq, offset) of every 64th record
+//   00000001.heads  written at seal, latest record of every identity so far
+//
+// every record points at the previous record of the same identity, so the
+// history of one device is a walk back along its chain. record times never
+// go backwards (a clock step back is clamped), which keeps the index sorted.
+//
+// a crash leaves the tail of the open segment zero or half written, records
+// are checksummed and the writer resumes after the last valid one.
+
+namespace device_journal {
+
+using Clock = std::chrono::system_clock;
+
+struct JournalEvent {
+  uint64_t seq{0};
+  Clock::time_point time;
+  device_enumerator::DeviceInterface device;
+};
+
+// return false to stop the walk
+using EventVisitor = std::function<bool(const JournalEvent &)>;
+
+class JournalWriter {
+public:
+  struct Options {
+    size_t segmentSize{64 << 20};
+  };
+
+  JournalWriter();
+  ~JournalWriter();
+
+  JournalWriter(const JournalWriter &) = delete;
+  JournalWriter& operator=(const JournalWriter &) = delete;
+
+  // creates dir if needed and resumes after its last record,
+  // false (and logged) if the directory or segment can not be opened
+  bool open(const std::filesystem::path &dir, Options options);
+  bool open(const std::filesystem::path &dir) { return open(dir, Options{}); }
+  bool opened() const;
+
+  // thread safe, a no-op when not opened
+  void append(const device_enumerator::DeviceInterface &dev);
+
+  // schedule write back of the mapped pages
+  void flush();
+  // unmaps the open segment, the next open() resumes in it
+  void close();
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+// read side, safe to use while a writer appends to the same directory
+// (records appended after a query started may or may not be seen).
+class JournalReader {
+public:
+  JournalReader();
+  ~JournalReader();
+
+  JournalReader(const JournalReader &) = delete;
+  JournalReader& operator=(const JournalReader &) = delete;
+
+  // false if dir holds no segment
+  bool open(const std::filesystem::path &dir);
+
+  // events with from <= time < to, oldest first
+  void range(Clock::time_point from, Clock::time_point to, const EventVisitor &visit) const;
+
+  // events of one identity, newest first. the open segment's latest
+  // record per identity is indexed once and extended on later queries
+  void history(std::string_view identity, const EventVisitor &visit) const;
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+} // namespace device_journal
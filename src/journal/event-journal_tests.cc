@@ -0,0 +1,202 @@
+#include <thread>
+
+namespace device_journal {
+
+struct JournalTest : testing::Test {
+  fs::path dir;
+
+  void SetUp() override {
+    auto *info = testing::UnitTest::GetInstance()->current_test_info();
+    dir = fs::temp_directory_path() /
+        (std::string("event-journal-") + info->name() + "-" + std::to_string(getpid()));
+    fs::remove_all(dir);
+  }
+
+  void TearDown() override {
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+  }
+
+  static DeviceInterface device(uint64_t id, std::string_view serial) {
+    DeviceInterface dev;
+    dev.identity = DeviceId(id);
+    dev.type = DeviceType::Adb;
+    dev.vid = 0x18d1;
+    dev.pid = 0x4ee7;
+    dev.hub = "USB1-9-1";
+    dev.parentHub = "USB1-9";
+    dev.serial = serial;
+    dev.devpath = "/devices/usb1/1-9/1-9.1";
+    return dev;
+  }
+
+  std::vector<JournalEvent> all(const JournalReader &reader) {
+    std::vector<JournalEvent> events;
+    reader.range(Clock::time_point(), Clock::time_point::max(), [&events](const JournalEvent &ev) {
+      events.push_back(ev);
+      return true;
+    });
+    return events;
+  }
+
+  std::vector<uint64_t> history(const JournalReader &reader, uint64_t id) {
+    char text[16];
+    std::vector<uint64_t> seqs;
+    reader.history(DeviceId(id).to_chars(text), [&seqs](const JournalEvent &ev) {
+      seqs.push_back(ev.seq);
+      return true;
+    });
+    return seqs;
+  }
+};
+
+TEST_F(JournalTest, AppendReadBack) {
+  JournalWriter writer;
+  ASSERT_TRUE(writer.open(dir));
+  writer.append(device(1, "serial-a"));
+  auto off = device(2, "serial-b");
+  off.off = true;
+  off.speed = UsbSpeed::High;
+  writer.append(off);
+  writer.append(device(1, "serial-a"));
+  writer.close();
+
+  JournalReader reader;
+  ASSERT_TRUE(reader.open(dir));
+  auto events = all(reader);
+  ASSERT_EQ(events.size(), 3u);
+  EXPECT_EQ(events[0].seq, 1u);
+  EXPECT_EQ(events[1].device.identity, DeviceId(2));
+  EXPECT_EQ(events[1].device.serial, "serial-b");
+  EXPECT_EQ(events[1].device.hub, "USB1-9-1");
+  EXPECT_EQ(events[1].device.parentHub, "USB1-9");
+  EXPECT_EQ(events[1].device.type, DeviceType::Adb);
+  EXPECT_EQ(events[1].device.speed, UsbSpeed::High);
+  EXPECT_TRUE(events[1].device.off);
+  EXPECT_LE(events[0].time, events[2].time);
+
+  EXPECT_EQ(history(reader, 1), (std::vector<uint64_t>{3, 1}));
+  EXPECT_EQ(history(reader, 2), (std::vector<uint64_t>{2}));
+  EXPECT_TRUE(history(reader, 3).empty());
+}
+
+TEST_F(JournalTest, ReopenAfterTornTail) {
+  JournalWriter writer;
+  ASSERT_TRUE(writer.open(dir));
+  for (int i = 0; i < 5; i++) {
+    writer.append(device(1, "serial-a"));
+  }
+  writer.close();
+
+  // a record cut short by a crash: size set, body not matching the checksum
+  {
+    SegmentMap seg;
+    ASSERT_TRUE(seg.map(segment_path(dir, 1, ".seg"), 0, true));
+    size_t used = sizeof(SegmentHeader);
+    while (auto *rec = record_at(seg, used)) {
+      used += rec->size;
+    }
+    RecordHeader torn{};
+    torn.size = 256;
+    torn.checksum = 1;
+    torn.seq = 99;
+    memcpy(seg.data() + used, &torn, sizeof(torn));
+  }
+
+  ASSERT_TRUE(writer.open(dir));
+  writer.append(device(2, "serial-b"));
+  writer.close();
+
+  JournalReader reader;
+  ASSERT_TRUE(reader.open(dir));
+  auto events = all(reader);
+  ASSERT_EQ(events.size(), 6u);
+  EXPECT_EQ(events.back().seq, 6u);
+  EXPECT_EQ(events.back().device.identity, DeviceId(2));
+  EXPECT_EQ(history(reader, 1).size(), 5u);
+}
+
+TEST_F(JournalTest, Range) {
+  JournalWriter writer;
+  ASSERT_TRUE(writer.open(dir));
+  writer.append(device(1, "serial-a"));
+  writer.append(device(2, "serial-b"));
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  auto mid = Clock::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  writer.append(device(3, "serial-c"));
+  writer.append(device(4, "serial-d"));
+
+  // a reader works on the open segment too
+  JournalReader reader;
+  ASSERT_TRUE(reader.open(dir));
+
+  std::vector<uint64_t> before, after;
+  reader.range(Clock::time_point(), mid, [&before](const JournalEvent &ev) {
+    before.push_back(ev.seq);
+    return true;
+  });
+  reader.range(mid, Clock::time_point::max(), [&after](const JournalEvent &ev) {
+    after.push_back(ev.seq);
+    return true;
+  });
+  EXPECT_EQ(before, (std::vector<uint64_t>{1, 2}));
+  EXPECT_EQ(after, (std::vector<uint64_t>{3, 4}));
+
+  // the visitor stops the walk
+  size_t visited = 0;
+  reader.range(Clock::time_point(), Clock::time_point::max(), [&visited](const JournalEvent &) {
+    return ++visited < 3;
+  });
+  EXPECT_EQ(visited, 3u);
+}
+
+TEST_F(JournalTest, HistoryAcrossSegmentRoll) {
+  JournalWriter writer;
+  ASSERT_TRUE(writer.open(dir, {.segmentSize = 64 << 10}));
+  writer.append(device(1, "serial-a"));
+
+  // opened on the first segment while it is still being written
+  JournalReader early;
+  ASSERT_TRUE(early.open(dir));
+  EXPECT_EQ(history(early, 1), (std::vector<uint64_t>{1}));
+
+  // ~200 byte records, a few segments worth
+  constexpr uint64_t kRecords = 1200;
+  std::string serial(64, 's');
+  for (uint64_t i = 2; i <= kRecords; i++) {
+    writer.append(device(i % 3 + 1, serial));
+  }
+  ASSERT_GE(list_segments(dir).size(), 3u);
+
+  // the sealed segment keeps its size, the early reader mapped all of it
+  EXPECT_EQ(fs::file_size(segment_path(dir, 1, ".seg")), size_t(64 << 10));
+  auto early_events = all(early);
+  ASSERT_FALSE(early_events.empty());
+  EXPECT_EQ(early_events.front().seq, 1u);
+
+  JournalReader reader;
+  ASSERT_TRUE(reader.open(dir));
+  EXPECT_EQ(all(reader).size(), kRecords);
+
+  for (uint64_t id = 1; id <= 3; id++) {
+    auto seqs = history(reader, id);
+    std::vector<uint64_t> expected;
+    for (uint64_t seq = kRecords; seq >= 2; seq--) {
+      if (seq % 3 + 1 == id) {
+        expected.push_back(seq);
+      }
+    }
+    if (id == 1) {
+      expected.push_back(1);
+    }
+    EXPECT_EQ(seqs, expected) << "id " << id;
+  }
+
+  // later appends show up in the next query of the same reader
+  writer.append(device(2, serial));
+  EXPECT_EQ(history(reader, 2).front(), kRecords + 1);
+  writer.close();
+}
+
+} // namespace device_journal
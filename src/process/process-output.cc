@@ -19,6 +19,7 @@
 // SOFTWARE.
 
 #include "process-output.h"
+#include <cstring>
 
 namespace process_lib {
 
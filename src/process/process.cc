@@ -24,6 +24,7 @@
 #include "process.h"
 #include "string-replace-all.h"
 #include <charconv>
+#include <cstring>
 #include <ranges>
 #include <filesystem>
 #ifdef _WIN32
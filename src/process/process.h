@@ -20,6 +20,7 @@
 
 #pragma  once
 
+#include <algorithm>
 #include <string>
 #include <functional>
 #include <vector>
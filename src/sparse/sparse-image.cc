@@ -0,0 +1,343 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#endif
+
+#include "sparse-image.h"
+#include <algorithm>
+#include <cstring>
+#include <format>
+
+namespace sparse_image {
+
+namespace {
+
+// longest raw chunk from_raw makes, keeps chunk sizes far from 32 bits
+constexpr size_t kMaxRawChunk = 64 << 20;
+
+uint16_t le16_at(const uint8_t *p) {
+  return uint16_t(p[0] | p[1] << 8);
+}
+
+uint32_t le32_at(const uint8_t *p) {
+  return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+void put_le16(std::vector<uint8_t> &out, uint16_t v) {
+  out.push_back(uint8_t(v));
+  out.push_back(uint8_t(v >> 8));
+}
+
+void put_le32(std::vector<uint8_t> &out, uint32_t v) {
+  for (int i = 0; i < 4; i++, v >>= 8) {
+    out.push_back(uint8_t(v));
+  }
+}
+
+void put_chunk_header(std::vector<uint8_t> &out, ChunkType type, uint32_t blocks, uint32_t total) {
+  put_le16(out, uint16_t(type));
+  put_le16(out, 0);
+  put_le32(out, blocks);
+  put_le32(out, total);
+}
+
+} // namespace
+
+std::vector<std::span<const uint8_t>> SparsePiece::buffers() const {
+  std::vector<std::span<const uint8_t>> out;
+  out.reserve(segments_.size() * 2);
+
+  size_t pos = 0;
+  for (auto &seg : segments_) {
+    if (seg.headerEnd > pos) {
+      out.push_back(std::span(headers_).subspan(pos, seg.headerEnd - pos));
+      pos = seg.headerEnd;
+    }
+    if (!seg.payload.empty()) {
+      out.push_back(seg.payload);
+    }
+  }
+  return out;
+}
+
+bool SparseImage::is_sparse(std::span<const uint8_t> file) {
+  return file.size() >= kFileHeaderSize && le32_at(file.data()) == kMagic;
+}
+
+SparseImage SparseImage::parse(std::span<const uint8_t> file) {
+  if (!is_sparse(file)) {
+    throw sparse_error("not a sparse image");
+  }
+
+  auto *p = file.data();
+  size_t fileHeader = le16_at(p + 8);
+  size_t chunkHeader = le16_at(p + 10);
+  auto count = le32_at(p + 20);
+
+  if (le16_at(p + 4) != 1) {
+    throw sparse_error(std::format("unsupported sparse version {}", le16_at(p + 4)));
+  }
+  if (fileHeader < kFileHeaderSize || chunkHeader < kChunkHeaderSize || fileHeader > file.size()) {
+    throw sparse_error("bad sparse header size");
+  }
+
+  SparseImage image;
+  image.sparse_ = true;
+  image.source_ = file;
+  image.blockSize_ = le32_at(p + 12);
+  image.totalBlocks_ = le32_at(p + 16);
+
+  if (image.blockSize_ == 0 || image.blockSize_ % 4) {
+    throw sparse_error(std::format("bad block size {}", image.blockSize_));
+  }
+
+  size_t off = fileHeader;
+  uint64_t block = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (file.size() - off < chunkHeader) {
+      throw sparse_error(std::format("chunk {} truncated", i));
+    }
+
+    auto *c = p + off;
+    auto blocks = le32_at(c + 4);
+    size_t total = le32_at(c + 8);
+    if (total < chunkHeader || total > file.size() - off) {
+      throw sparse_error(std::format("chunk {} has a bad size", i));
+    }
+
+    auto body = file.subspan(off + chunkHeader, total - chunkHeader);
+    Chunk chunk{.startBlock = uint32_t(block), .blocks = blocks};
+
+    switch (ChunkType(le16_at(c))) {
+    case ChunkType::Raw:
+      if (body.size() != uint64_t(blocks) * image.blockSize_) {
+        throw sparse_error(std::format("raw chunk {} does not hold {} blocks", i, blocks));
+      }
+      chunk.type = ChunkType::Raw;
+      chunk.data = body;
+      break;
+    case ChunkType::Fill:
+      if (body.size() != 4) {
+        throw sparse_error(std::format("fill chunk {} has a bad size", i));
+      }
+      chunk.type = ChunkType::Fill;
+      chunk.fill = le32_at(body.data());
+      break;
+    case ChunkType::DontCare:
+    case ChunkType::Crc32:
+      // checksums would not survive a split, they are dropped
+      chunk.blocks = 0;
+      break;
+    default:
+      throw sparse_error(std::format("chunk {} has unknown type {:#x}", i, le16_at(c)));
+    }
+
+    if (chunk.blocks) {
+      image.chunks_.push_back(chunk);
+    }
+
+    block += blocks;
+    if (block > image.totalBlocks_) {
+      throw sparse_error(std::format("chunks exceed {} blocks", image.totalBlocks_));
+    }
+    off += total;
+  }
+
+  if (block != image.totalBlocks_) {
+    throw sparse_error(std::format("chunks cover {} of {} blocks", block, image.totalBlocks_));
+  }
+
+  return image;
+}
+
+SparseImage SparseImage::from_raw(std::span<const uint8_t> data, uint32_t blockSize) {
+  if (blockSize == 0 || blockSize % 4) {
+    throw sparse_error(std::format("bad block size {}", blockSize));
+  }
+
+  uint64_t blocks = (data.size() + blockSize - 1) / blockSize;
+  if (blocks > UINT32_MAX) {
+    throw sparse_error("image too large");
+  }
+
+  SparseImage image;
+  image.source_ = data;
+  image.blockSize_ = blockSize;
+  image.totalBlocks_ = uint32_t(blocks);
+
+  size_t whole = data.size() / blockSize;
+  if (whole != blocks) {
+    image.tail_.assign(blockSize, 0);
+    std::memcpy(image.tail_.data(), data.data() + whole * blockSize, data.size() - whole * blockSize);
+  }
+
+  auto &chunks = image.chunks_;
+  auto maxRawBlocks = uint32_t(std::max<size_t>(kMaxRawChunk / blockSize, 1));
+
+  for (uint32_t b = 0; b < blocks; b++) {
+    auto *block = b < whole ? data.data() + size_t(b) * blockSize : image.tail_.data();
+    auto *last = chunks.empty() ? nullptr : &chunks.back();
+
+    // a block equal to itself shifted by 4 bytes repeats its first word
+    if (std::memcmp(block, block + 4, blockSize - 4) == 0) {
+      auto value = le32_at(block);
+      if (last && last->type == ChunkType::Fill && last->fill == value) {
+        last->blocks++;
+      } else {
+        chunks.push_back({.type = ChunkType::Fill, .startBlock = b, .blocks = 1, .fill = value});
+      }
+      continue;
+    }
+
+    if (last && last->type == ChunkType::Raw && last->blocks < maxRawBlocks &&
+        last->data.data() + last->data.size() == block) {
+      last->blocks++;
+      last->data = {last->data.data(), last->data.size() + blockSize};
+    } else {
+      chunks.push_back({.type = ChunkType::Raw, .startBlock = b, .blocks = 1, .data = {block, blockSize}});
+    }
+  }
+
+  return image;
+}
+
+SparseImage SparseImage::open(std::span<const uint8_t> file, uint32_t blockSize) {
+  return is_sparse(file) ? parse(file) : from_raw(file, blockSize);
+}
+
+SparsePiece SparseImage::piece(std::span<const Chunk> chunks) const {
+  SparsePiece piece;
+  auto &h = piece.headers_;
+  h.resize(kFileHeaderSize);
+
+  uint32_t cursor = 0;
+  uint32_t count = 0;
+  size_t payload = 0;
+
+  for (auto &c : chunks) {
+    if (c.startBlock > cursor) {
+      put_chunk_header(h, ChunkType::DontCare, c.startBlock - cursor, kChunkHeaderSize);
+      count++;
+    }
+
+    if (c.type == ChunkType::Raw) {
+      put_chunk_header(h, ChunkType::Raw, c.blocks, uint32_t(kChunkHeaderSize + c.data.size()));
+      piece.segments_.push_back({h.size(), c.data});
+      payload += c.data.size();
+    } else {
+      put_chunk_header(h, ChunkType::Fill, c.blocks, kChunkHeaderSize + 4);
+      put_le32(h, c.fill);
+    }
+
+    cursor = c.startBlock + c.blocks;
+    count++;
+  }
+
+  if (cursor < totalBlocks_) {
+    put_chunk_header(h, ChunkType::DontCare, totalBlocks_ - cursor, kChunkHeaderSize);
+    count++;
+  }
+
+  if (piece.segments_.empty() || piece.segments_.back().headerEnd < h.size()) {
+    piece.segments_.push_back({h.size(), {}});
+  }
+
+  std::vector<uint8_t> header;
+  header.reserve(kFileHeaderSize);
+  put_le32(header, kMagic);
+  put_le16(header, 1);
+  put_le16(header, 0);
+  put_le16(header, kFileHeaderSize);
+  put_le16(header, kChunkHeaderSize);
+  put_le32(header, blockSize_);
+  put_le32(header, totalBlocks_);
+  put_le32(header, count);
+  put_le32(header, 0);
+  std::ranges::copy(header, h.begin());
+
+  piece.size_ = h.size() + payload;
+  return piece;
+}
+
+std::vector<SparsePiece> SparseImage::split(size_t maxBytes) const {
+  // every piece has the file header and may end in a don't care chunk
+  constexpr size_t kOverhead = kFileHeaderSize + kChunkHeaderSize;
+  if (maxBytes < kOverhead + 2 * kChunkHeaderSize + blockSize_) {
+    throw sparse_error(std::format("{} bytes can not hold a {} byte block", maxBytes, blockSize_));
+  }
+
+  std::vector<SparsePiece> pieces;
+  std::vector<Chunk> current;
+  size_t used = kOverhead;
+  uint32_t cursor = 0;
+
+  auto finish = [&] {
+    pieces.push_back(piece(current));
+    current.clear();
+    used = kOverhead;
+    cursor = 0;
+  };
+
+  for (auto chunk : chunks_) {
+    for (;;) {
+      size_t gap = chunk.startBlock > cursor ? kChunkHeaderSize : 0;
+      size_t cost = gap + kChunkHeaderSize + (chunk.type == ChunkType::Raw ? chunk.data.size() : 4);
+
+      if (used + cost <= maxBytes) {
+        current.push_back(chunk);
+        used += cost;
+        cursor = chunk.startBlock + chunk.blocks;
+        break;
+      }
+
+      // as many whole blocks as still fit, the rest starts the next piece
+      if (chunk.type == ChunkType::Raw && used + gap + kChunkHeaderSize < maxBytes) {
+        auto n = uint32_t((maxBytes - used - gap - kChunkHeaderSize) / blockSize_);
+        if (n > 0) {
+          auto head = chunk;
+          head.blocks = n;
+          head.data = chunk.data.first(size_t(n) * blockSize_);
+          current.push_back(head);
+
+          chunk.startBlock += n;
+          chunk.blocks -= n;
+          chunk.data = chunk.data.subspan(size_t(n) * blockSize_);
+        }
+      }
+
+      finish();
+    }
+  }
+
+  if (!current.empty() || pieces.empty()) {
+    finish();
+  }
+
+  return pieces;
+}
+
+} // namespace sparse_image
+
+#ifdef ENABLE_TEST
+#include "sparse-image_tests.cc"
+#endif
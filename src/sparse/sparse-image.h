@@ -0,0 +1,139 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// android sparse images (the format of super.img, userdata.img, ...).
+// images are described, never copied: raw chunks are spans into the file
+// (usually a MappedFile) and a split only builds the small chunk headers,
+// so one image can be streamed to any number of devices with no temp files.
+
+namespace sparse_image {
+
+class sparse_error : public std::runtime_error {
+public:
+  sparse_error(const std::string& arg): std::runtime_error(arg) {}
+};
+
+enum class ChunkType : uint16_t {
+  Raw = 0xcac1,
+  Fill = 0xcac2,
+  DontCare = 0xcac3,
+  Crc32 = 0xcac4,
+};
+
+// a run of blocks with content, blocks not covered by any chunk are don't care
+struct Chunk {
+  ChunkType type{ChunkType::Raw};
+  uint32_t startBlock{0};
+  uint32_t blocks{0};
+  // Raw: blocks * blockSize bytes
+  std::span<const uint8_t> data;
+  // Fill: the 32 bit pattern repeated over the blocks
+  uint32_t fill{0};
+};
+
+// one sparse file of a split. its headers are owned, raw payloads point
+// into the source image.
+class SparsePiece {
+public:
+  // bytes of the sparse file
+  size_t size() const { return size_; }
+
+  // the sparse file in order, valid while the piece and the source are
+  std::vector<std::span<const uint8_t>> buffers() const;
+
+private:
+  friend class SparseImage;
+
+  struct Segment {
+    size_t headerEnd; // headers_ up to here come first
+    std::span<const uint8_t> payload;
+  };
+
+  std::vector<uint8_t> headers_;
+  std::vector<Segment> segments_;
+  size_t size_{0};
+};
+
+class SparseImage {
+public:
+  static constexpr uint32_t kMagic = 0xed26ff3a;
+  static constexpr size_t kFileHeaderSize = 28;
+  static constexpr size_t kChunkHeaderSize = 12;
+
+  static bool is_sparse(std::span<const uint8_t> file);
+
+  // throws sparse_error on a malformed image.
+  // file is referenced, not copied, keep it alive while the image is used.
+  static SparseImage parse(std::span<const uint8_t> file);
+
+  // blocks repeating one 32 bit value (zeros included) become fill chunks,
+  // the rest raw chunks pointing into data. a partial last block is padded
+  // with zeros in the only copy made.
+  static SparseImage from_raw(std::span<const uint8_t> data, uint32_t blockSize = 4096);
+
+  // parse or from_raw
+  static SparseImage open(std::span<const uint8_t> file, uint32_t blockSize = 4096);
+
+  SparseImage(SparseImage &&) = default;
+  SparseImage& operator=(SparseImage &&) = default;
+  SparseImage(const SparseImage &) = delete;
+  SparseImage& operator=(const SparseImage &) = delete;
+
+  // whether the source already is a sparse file
+  bool sparse() const { return sparse_; }
+  std::span<const uint8_t> source() const { return source_; }
+
+  uint32_t blockSize() const { return blockSize_; }
+  uint32_t totalBlocks() const { return totalBlocks_; }
+  uint64_t expandedSize() const { return uint64_t(totalBlocks_) * blockSize_; }
+
+  // Raw and Fill chunks by ascending block
+  const std::vector<Chunk> &chunks() const { return chunks_; }
+
+  // sparse files of at most maxBytes each that, flashed one after the
+  // other, write the whole image (what fastboot does past max-download-size).
+  // raw chunks are cut at block boundaries, throws sparse_error if maxBytes
+  // can not hold a single block.
+  std::vector<SparsePiece> split(size_t maxBytes) const;
+
+private:
+  SparseImage() = default;
+
+  // chunks with don't care filling the gaps up to totalBlocks_
+  SparsePiece piece(std::span<const Chunk> chunks) const;
+
+  bool sparse_{false};
+  std::span<const uint8_t> source_;
+  uint32_t blockSize_{0};
+  uint32_t totalBlocks_{0};
+  std::vector<Chunk> chunks_;
+  std::vector<uint8_t> tail_;
+};
+
+} // namespace sparse_image
@@ -0,0 +1,111 @@
+#include <numeric>
+
+namespace sparse_image {
+
+namespace {
+
+// what a device does with a sparse file: writes raw and fill chunks
+// over the image, leaving don't care blocks alone
+void flash(std::span<const uint8_t> file, std::vector<uint8_t> &out) {
+  auto image = SparseImage::parse(file);
+  ASSERT_EQ(out.size(), image.expandedSize());
+  for (auto &c : image.chunks()) {
+    auto *dst = out.data() + size_t(c.startBlock) * image.blockSize();
+    if (c.type == ChunkType::Raw) {
+      std::memcpy(dst, c.data.data(), c.data.size());
+    } else {
+      for (size_t i = 0; i < size_t(c.blocks) * image.blockSize(); i += 4) std::memcpy(dst + i, &c.fill, 4);
+    }
+  }
+}
+
+std::vector<uint8_t> join(const SparsePiece &piece) {
+  std::vector<uint8_t> out;
+  for (auto b : piece.buffers()) out.insert(out.end(), b.begin(), b.end());
+  EXPECT_EQ(out.size(), piece.size());
+  return out;
+}
+
+// random blocks, zero and 0xff runs, and a partial last block
+std::vector<uint8_t> raw_image() {
+  std::vector<uint8_t> data(4096 * 300 + 1000);
+  uint32_t x = 1;
+  for (auto &b : data) b = uint8_t((x = x * 1103515245 + 12345) >> 16);
+  std::fill(data.begin() + 4096 * 10, data.begin() + 4096 * 50, 0);
+  std::fill(data.begin() + 4096 * 120, data.begin() + 4096 * 121, 0xff);
+  std::fill(data.begin() + 4096 * 200, data.begin() + 4096 * 260, 0);
+  return data;
+}
+
+} // namespace
+
+TEST(SparseImage, FromRawFindsFills) {
+  auto data = raw_image();
+  auto image = SparseImage::from_raw(data);
+
+  EXPECT_FALSE(image.sparse());
+  EXPECT_EQ(image.totalBlocks(), 301u);
+
+  std::vector<std::pair<ChunkType, uint32_t>> runs;
+  for (auto &c : image.chunks()) runs.emplace_back(c.type, c.blocks);
+  std::vector<std::pair<ChunkType, uint32_t>> expected = {
+    {ChunkType::Raw, 10}, {ChunkType::Fill, 40}, {ChunkType::Raw, 70}, {ChunkType::Fill, 1},
+    {ChunkType::Raw, 79}, {ChunkType::Fill, 60}, {ChunkType::Raw, 40}, {ChunkType::Raw, 1},
+  };
+  EXPECT_EQ(runs, expected);
+
+  // raw chunks point into the data, only the padded tail is a copy
+  EXPECT_EQ(image.chunks()[0].data.data(), data.data());
+  EXPECT_EQ(image.chunks()[3].fill, 0xffffffffu);
+}
+
+TEST(SparseImage, SplitRoundTrip) {
+  auto data = raw_image();
+  auto image = SparseImage::from_raw(data);
+
+  auto whole = image.split(SIZE_MAX);
+  ASSERT_EQ(whole.size(), 1u);
+  auto file = join(whole[0]);
+  auto reparsed = SparseImage::parse(file);
+  EXPECT_TRUE(reparsed.sparse());
+  EXPECT_EQ(reparsed.chunks().size(), image.chunks().size());
+
+  auto expected = data;
+  expected.resize(image.expandedSize(), 0);
+
+  // every piece fits, and flashing them in turn rebuilds the image
+  for (size_t max : {size_t(64 << 10), size_t(100000), size_t(4096 + 64)}) {
+    auto pieces = reparsed.split(max);
+    EXPECT_GT(pieces.size(), 1u);
+
+    std::vector<uint8_t> device(expected.size(), 0xaa);
+    for (auto &p : pieces) {
+      EXPECT_LE(p.size(), max);
+      flash(join(p), device);
+    }
+    EXPECT_EQ(device, expected) << max;
+  }
+
+  EXPECT_THROW(image.split(4096), sparse_error);
+}
+
+TEST(SparseImage, RejectsMalformed) {
+  auto data = raw_image();
+  auto file = join(SparseImage::from_raw(data).split(SIZE_MAX)[0]);
+
+  auto truncated = std::span(file).first(file.size() - 1);
+  EXPECT_THROW(SparseImage::parse(truncated), sparse_error);
+
+  auto bad = file;
+  bad[16]++; // total blocks
+  EXPECT_THROW(SparseImage::parse(bad), sparse_error);
+
+  bad = file;
+  bad[28] = 0x55; // first chunk type
+  EXPECT_THROW(SparseImage::parse(bad), sparse_error);
+
+  EXPECT_FALSE(SparseImage::is_sparse(data));
+  EXPECT_TRUE(SparseImage::open(file).sparse());
+}
+
+} // namespace sparse_image
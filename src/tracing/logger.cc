@@ -0,0 +1,285 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "logger.h"
+#include "spsc-ring.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#endif
+
+namespace tracing {
+
+namespace detail {
+
+namespace {
+
+constexpr size_t kRingCapacity = 1024;
+constexpr auto kDrainInterval = std::chrono::milliseconds(20);
+
+struct ThreadLog {
+  SpscRing<LogRecord, kRingCapacity> ring;
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<bool> retired{false};
+  uint32_t tid{0};
+};
+
+class Logger {
+public:
+  Logger() : thread_([this] { run(); }) {}
+
+  ~Logger() {
+    {
+      std::lock_guard lk(wake_mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+    drain();
+  }
+
+  std::shared_ptr<ThreadLog> attach() {
+    auto log = std::make_shared<ThreadLog>();
+    std::lock_guard lk(mutex_);
+    log->tid = next_tid_++;
+    logs_.push_back(log);
+    return log;
+  }
+
+  // serialized, called by the writer thread and flush_log()
+  void drain() {
+    std::lock_guard drain_lk(drain_mutex_);
+
+    std::vector<std::shared_ptr<ThreadLog>> logs;
+    {
+      std::lock_guard lk(mutex_);
+      logs = logs_;
+    }
+
+    for (auto &log : logs) {
+      log->ring.drain([this, tid = log->tid](const LogRecord &r) {
+        write(r, tid);
+      });
+
+      if (auto n = log->dropped.exchange(0, std::memory_order_relaxed)) {
+        fprintf(stderr, "W [%u] logger] %llu records dropped, ring full\n", log->tid, (unsigned long long)n);
+      }
+    }
+    fflush(stderr);
+
+    std::lock_guard lk(mutex_);
+    std::erase_if(logs_, [](auto &log) {
+      return log->retired.load(std::memory_order_acquire) && log->ring.empty();
+    });
+  }
+
+private:
+  void write(const LogRecord &r, uint32_t tid) {
+    static constexpr char kLevels[] = "DIWE";
+
+    auto secs = static_cast<time_t>(r.time / 1000000000);
+    auto micros = static_cast<unsigned>(r.time / 1000 % 1000000);
+    struct tm tm{};
+#ifdef _WIN32
+    localtime_s(&tm, &secs);
+#else
+    localtime_r(&secs, &tm);
+#endif
+
+    const char *file = r.file;
+    for (const char *p = r.file; *p; p++) {
+      if (*p == '/' || *p == '\\') {
+        file = p + 1;
+      }
+    }
+
+    line_.clear();
+    log_format(r, line_);
+
+    fprintf(stderr, "%c %02d:%02d:%02d.%06u [%u] %s:%u] %s",
+            kLevels[static_cast<int>(r.level) & 3], tm.tm_hour, tm.tm_min, tm.tm_sec, micros,
+            tid, file, r.line, line_.c_str());
+    if (r.suppressed) {
+      fprintf(stderr, " (%u similar suppressed)", r.suppressed);
+    }
+    fputc('\n', stderr);
+  }
+
+  void run() {
+    std::unique_lock lk(wake_mutex_);
+    while (!stopping_) {
+      wake_.wait_for(lk, kDrainInterval);
+      drain();
+    }
+  }
+
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<ThreadLog>> logs_;
+  uint32_t next_tid_{1};
+
+  std::mutex drain_mutex_;
+  std::string line_;
+
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  bool stopping_{false};
+  std::thread thread_;
+};
+
+Logger& logger() {
+  static Logger instance;
+  return instance;
+}
+
+// marks the ring retired on thread exit, the writer frees it once drained
+struct ThreadLogHolder {
+  std::shared_ptr<ThreadLog> log;
+
+  ~ThreadLogHolder() {
+    if (log) {
+      log->retired.store(true, std::memory_order_release);
+    }
+  }
+};
+
+ThreadLog& thread_log() {
+  thread_local ThreadLogHolder holder;
+  if (!holder.log) {
+    holder.log = logger().attach();
+  }
+  return *holder.log;
+}
+
+template <class T>
+T load_arg(const unsigned char *p) {
+  T v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+} // namespace
+
+uint64_t log_now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void log_submit(const LogRecord &record) {
+  auto &log = thread_log();
+  if (!log.ring.push(record)) {
+    log.dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void log_format(const LogRecord &r, std::string &out) {
+  size_t pos = 0;
+  bool truncated = false;
+  char num[32];
+
+  // appends the next argument, false once they are used up
+  auto next_arg = [&](bool hex) {
+    if (pos >= r.used || truncated) {
+      return false;
+    }
+
+    auto tag = static_cast<ArgTag>(r.args[pos++]);
+    switch (tag) {
+    case ArgTag::Int: {
+      auto v = load_arg<int64_t>(&r.args[pos]);
+      pos += sizeof(v);
+      snprintf(num, sizeof(num), hex ? "%llx" : "%lld", (long long)v);
+      out += num;
+      break;
+    }
+    case ArgTag::Uint: {
+      auto v = load_arg<uint64_t>(&r.args[pos]);
+      pos += sizeof(v);
+      snprintf(num, sizeof(num), hex ? "%llx" : "%llu", (unsigned long long)v);
+      out += num;
+      break;
+    }
+    case ArgTag::Double: {
+      auto v = load_arg<double>(&r.args[pos]);
+      pos += sizeof(v);
+      snprintf(num, sizeof(num), "%g", v);
+      out += num;
+      break;
+    }
+    case ArgTag::String: {
+      size_t n = r.args[pos++];
+      out.append(reinterpret_cast<const char *>(&r.args[pos]), n);
+      pos += n;
+      break;
+    }
+    default:
+      truncated = true;
+      out += "...";
+      break;
+    }
+    return true;
+  };
+
+  for (const char *p = r.format; *p; p++) {
+    if (p[0] == '{' && p[1] == '{') {
+      out += '{';
+      p++;
+    } else if (p[0] == '}' && p[1] == '}') {
+      out += '}';
+      p++;
+    } else if (p[0] == '{') {
+      auto close = strchr(p, '}');
+      if (!close) {
+        out += p;
+        break;
+      }
+      bool hex = close[-1] == 'x' || close[-1] == 'X';
+      if (!next_arg(hex)) {
+        out.append(p, close + 1);
+      }
+      p = close;
+    } else {
+      out += *p;
+    }
+  }
+}
+
+} // namespace detail
+
+void set_log_level(LogLevel level) {
+  detail::log_level.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+void flush_log() {
+  detail::logger().drain();
+}
+
+} // namespace tracing
+
+#ifdef ENABLE_TEST
+#include "logger_tests.cc"
+#endif
@@ -0,0 +1,219 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// structured diagnostics, written to stderr by a background thread.
+//
+//   DEVICE_WATCH_LOG_ERROR("recvmsg failed, errno={}", errno);
+//
+// - levels below DEVICE_WATCH_LOG_LEVEL are compiled out, arguments included.
+// - the calling thread only copies the arguments into a binary record in
+//   its own ring, formatting ("{}" and "{:x}" placeholders) happens later.
+// - every call site is limited to kLogBurst records per second, the number
+//   of suppressed records is appended to the next one that gets through.
+// - a full ring drops records, the writer reports how many.
+
+// 0 debug, 1 info, 2 warning, 3 error, 4 off
+#ifndef DEVICE_WATCH_LOG_LEVEL
+#define DEVICE_WATCH_LOG_LEVEL 1
+#endif
+
+namespace tracing {
+
+enum class LogLevel : uint8_t {
+  Debug = 0,
+  Info = 1,
+  Warning = 2,
+  Error = 3,
+  Off = 4,
+};
+
+// runtime threshold on top of the compile time one, default Warning
+void set_log_level(LogLevel level);
+
+// block until everything logged so far by any thread is written
+void flush_log();
+
+namespace detail {
+
+inline std::atomic<uint8_t> log_level{static_cast<uint8_t>(LogLevel::Warning)};
+
+constexpr uint32_t kLogBurst = 10;
+constexpr size_t kLogArgBytes = 200;
+
+enum class ArgTag : uint8_t {
+  Int,
+  Uint,
+  Double,
+  String,
+  Truncated,
+};
+
+struct LogRecord {
+  const char *format;
+  const char *file;
+  uint64_t time;
+  uint32_t line;
+  uint32_t suppressed;
+  LogLevel level;
+  uint8_t used;
+  unsigned char args[kLogArgBytes];
+};
+
+// per call site token bucket, refilled every second
+struct LogRateLimit {
+  std::atomic<uint64_t> window{0};
+  std::atomic<uint32_t> count{0};
+  std::atomic<uint32_t> suppressed{0};
+
+  // false when over budget, otherwise *dropped is what was suppressed since
+  bool admit(uint64_t now, uint32_t *dropped) {
+    auto w = now / 1000000000;
+    if (window.load(std::memory_order_relaxed) != w) {
+      window.store(w, std::memory_order_relaxed);
+      count.store(0, std::memory_order_relaxed);
+    }
+
+    if (count.fetch_add(1, std::memory_order_relaxed) >= kLogBurst) {
+      suppressed.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    *dropped = suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
+  }
+};
+
+uint64_t log_now();
+void log_submit(const LogRecord &record);
+
+inline bool log_put(LogRecord &r, ArgTag tag, const void *data, size_t size) {
+  if (size_t(r.used) + 1 + size > kLogArgBytes) {
+    if (r.used < kLogArgBytes) {
+      r.args[r.used++] = static_cast<unsigned char>(ArgTag::Truncated);
+    }
+    return false;
+  }
+  r.args[r.used++] = static_cast<unsigned char>(tag);
+  memcpy(&r.args[r.used], data, size);
+  r.used += static_cast<uint8_t>(size);
+  return true;
+}
+
+inline bool log_put_string(LogRecord &r, std::string_view s) {
+  // one byte length, the tail of an oversized string is cut
+  if (size_t(r.used) + 2 > kLogArgBytes) {
+    if (r.used < kLogArgBytes) {
+      r.args[r.used++] = static_cast<unsigned char>(ArgTag::Truncated);
+    }
+    return false;
+  }
+  auto n = std::min<size_t>({s.size(), 255, kLogArgBytes - r.used - 2});
+  r.args[r.used++] = static_cast<unsigned char>(ArgTag::String);
+  r.args[r.used++] = static_cast<unsigned char>(n);
+  memcpy(&r.args[r.used], s.data(), n);
+  r.used += static_cast<uint8_t>(n);
+  return true;
+}
+
+template <class T>
+bool log_encode(LogRecord &r, const T &value) {
+  if constexpr (std::is_same_v<T, bool>) {
+    return log_put_string(r, value ? "true" : "false");
+  } else if constexpr (std::is_enum_v<T>) {
+    return log_encode(r, static_cast<std::underlying_type_t<T>>(value));
+  } else if constexpr (std::signed_integral<T>) {
+    int64_t v = value;
+    return log_put(r, ArgTag::Int, &v, sizeof(v));
+  } else if constexpr (std::unsigned_integral<T>) {
+    uint64_t v = value;
+    return log_put(r, ArgTag::Uint, &v, sizeof(v));
+  } else if constexpr (std::floating_point<T>) {
+    double v = value;
+    return log_put(r, ArgTag::Double, &v, sizeof(v));
+  } else if constexpr (std::is_convertible_v<const T &, const char *>) {
+    const char *s = value;
+    return log_put_string(r, s ? s : "(null)");
+  } else {
+    static_assert(std::is_convertible_v<const T &, std::string_view>, "unsupported log argument");
+    return log_put_string(r, std::string_view(value));
+  }
+}
+
+template <class... Args>
+void log_write(LogRateLimit &limit, LogLevel level, const char *file, uint32_t line,
+               const char *format, const Args &... args) {
+  if (static_cast<uint8_t>(level) < log_level.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  auto now = log_now();
+  uint32_t suppressed = 0;
+  if (!limit.admit(now, &suppressed)) {
+    return;
+  }
+
+  LogRecord r;
+  r.format = format;
+  r.file = file;
+  r.time = now;
+  r.line = line;
+  r.suppressed = suppressed;
+  r.level = level;
+  r.used = 0;
+  // stops at the first argument that does not fit
+  (void)(log_encode(r, args) && ...);
+
+  log_submit(r);
+}
+
+// the formatting half, used by the writer thread
+void log_format(const LogRecord &record, std::string &out);
+
+} // namespace detail
+
+} // namespace tracing
+
+#define DEVICE_WATCH_LOG(level, format, ...) \
+  do { \
+    if constexpr (static_cast<int>(level) >= DEVICE_WATCH_LOG_LEVEL) { \
+      static ::tracing::detail::LogRateLimit device_watch_log_limit_; \
+      ::tracing::detail::log_write(device_watch_log_limit_, level, __FILE__, __LINE__, \
+                                   format __VA_OPT__(,) __VA_ARGS__); \
+    } \
+  } while (0)
+
+#define DEVICE_WATCH_LOG_DEBUG(format, ...) \
+  DEVICE_WATCH_LOG(::tracing::LogLevel::Debug, format __VA_OPT__(,) __VA_ARGS__)
+#define DEVICE_WATCH_LOG_INFO(format, ...) \
+  DEVICE_WATCH_LOG(::tracing::LogLevel::Info, format __VA_OPT__(,) __VA_ARGS__)
+#define DEVICE_WATCH_LOG_WARNING(format, ...) \
+  DEVICE_WATCH_LOG(::tracing::LogLevel::Warning, format __VA_OPT__(,) __VA_ARGS__)
+#define DEVICE_WATCH_LOG_ERROR(format, ...) \
+  DEVICE_WATCH_LOG(::tracing::LogLevel::Error, format __VA_OPT__(,) __VA_ARGS__)
@@ -0,0 +1,82 @@
+namespace tracing {
+
+namespace detail {
+
+template <class... Args>
+std::string format_record(const char *format, const Args &... args) {
+  LogRecord r{};
+  r.format = format;
+  (void)(log_encode(r, args) && ...);
+  std::string out;
+  log_format(r, out);
+  return out;
+}
+
+TEST(Logger, FormatsArguments) {
+  EXPECT_EQ(format_record("plain"), "plain");
+  EXPECT_EQ(format_record("{} {} {}", -3, 7u, 1.5), "-3 7 1.5");
+  EXPECT_EQ(format_record("errno={:x}", 255), "errno=ff");
+  EXPECT_EQ(format_record("{:X}", uint64_t(0xab)), "ab");
+  EXPECT_EQ(format_record("[{}] [{}]", "serial", std::string("hub")), "[serial] [hub]");
+  EXPECT_EQ(format_record("{} {}", true, static_cast<const char *>(nullptr)), "true (null)");
+  EXPECT_EQ(format_record("{{}} {}", 1), "{} 1");
+}
+
+TEST(Logger, KeepsUnusedPlaceholders) {
+  EXPECT_EQ(format_record("{} {}", 1), "1 {}");
+  EXPECT_EQ(format_record("open {", 1), "open {");
+}
+
+TEST(Logger, TruncatesOversizedArguments) {
+  // the tail of a long string is cut to what fits
+  EXPECT_EQ(format_record("{} {}", std::string(300, 'a'), 1),
+            std::string(kLogArgBytes - 2, 'a') + " {}");
+
+  // an argument that does not fit is elided, along with the rest
+  EXPECT_EQ(format_record("{} {} {}", std::string(190, 'a'), 1, 2),
+            std::string(190, 'a') + " ... {}");
+}
+
+TEST(Logger, LimitsBurstPerWindow) {
+  LogRateLimit limit;
+  uint64_t second = 1000000000;
+  uint32_t dropped = ~0u;
+
+  for (uint32_t i = 0; i < kLogBurst; i++) {
+    ASSERT_TRUE(limit.admit(5 * second + i, &dropped));
+    EXPECT_EQ(dropped, 0u);
+  }
+  for (int i = 0; i < 7; i++) {
+    EXPECT_FALSE(limit.admit(5 * second + 100, &dropped));
+  }
+
+  // the next window reports what the previous one suppressed, once
+  ASSERT_TRUE(limit.admit(6 * second, &dropped));
+  EXPECT_EQ(dropped, 7u);
+  ASSERT_TRUE(limit.admit(6 * second + 1, &dropped));
+  EXPECT_EQ(dropped, 0u);
+}
+
+TEST(Logger, WritesSuppressedSummary) {
+  set_log_level(LogLevel::Error);
+  flush_log();
+
+  LogRateLimit limit;
+  limit.window = log_now() / 1000000000;
+  limit.suppressed = 4;
+
+  testing::internal::CaptureStderr();
+  log_write(limit, LogLevel::Error, "src/x/summary.cc", 42, "value={}", 9);
+  log_write(limit, LogLevel::Warning, "src/x/summary.cc", 43, "filtered");
+  flush_log();
+  auto text = testing::internal::GetCapturedStderr();
+  set_log_level(LogLevel::Warning);
+
+  EXPECT_NE(text.find("summary.cc:42] value=9 (4 similar suppressed)\n"), std::string::npos) << text;
+  EXPECT_EQ(text.find("filtered"), std::string::npos) << text;
+  EXPECT_EQ(limit.suppressed.load(), 0u);
+}
+
+} // namespace detail
+
+} // namespace tracing
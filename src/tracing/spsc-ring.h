@@ -0,0 +1,74 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace tracing {
+
+// bounded ring with one producer thread and one consumer thread.
+// push never blocks, a full ring rejects the element.
+template <class T, size_t Capacity>
+class SpscRing {
+  static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+  // producer side
+  bool push(const T &value) {
+    auto h = head_.load(std::memory_order_relaxed);
+    if (h - tail_.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    items_[h & (Capacity - 1)] = value;
+    head_.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side, fn(const T &) for everything pushed so far
+  template <class Fn>
+  size_t drain(Fn &&fn) {
+    auto t = tail_.load(std::memory_order_relaxed);
+    auto h = head_.load(std::memory_order_acquire);
+    size_t n = h - t;
+    for (; t != h; t++) {
+      fn(items_[t & (Capacity - 1)]);
+    }
+    tail_.store(t, std::memory_order_release);
+    return n;
+  }
+
+  // consumer side, drop everything pushed so far
+  void discard() {
+    tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+  bool empty() const {
+    return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+  }
+
+private:
+  std::unique_ptr<T[]> items_{new T[Capacity]};
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+} // namespace tracing
@@ -0,0 +1,381 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "trace-writer.h"
+#include "spsc-ring.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#ifdef ENABLE_TEST
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#endif
+
+namespace tracing {
+
+namespace {
+
+constexpr size_t kRingCapacity = 4096;
+constexpr auto kDrainInterval = std::chrono::milliseconds(100);
+
+struct Event {
+  const char *category;
+  const char *name;
+  uint64_t start;
+  uint64_t duration;
+  const char *int_keys[2];
+  int64_t int_values[2];
+  const char *str_key;
+  char str_value[48];
+};
+
+// filled by the owning thread, drained by the writer
+struct ThreadBuffer {
+  SpscRing<Event, kRingCapacity> ring;
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<bool> retired{false};
+  uint32_t tid{0};
+
+  void push(const Event &e) {
+    if (!ring.push(e)) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  uint32_t next_tid{1};
+};
+
+Registry& registry() {
+  static Registry r;
+  return r;
+}
+
+// marks the buffer retired on thread exit, the writer frees it once drained
+struct BufferHolder {
+  std::shared_ptr<ThreadBuffer> buffer;
+
+  ~BufferHolder() {
+    if (buffer) {
+      buffer->retired.store(true, std::memory_order_release);
+    }
+  }
+};
+
+ThreadBuffer& thread_buffer() {
+  thread_local BufferHolder holder;
+  if (!holder.buffer) {
+    holder.buffer = std::make_shared<ThreadBuffer>();
+    auto &r = registry();
+    std::lock_guard lk(r.mutex);
+    holder.buffer->tid = r.next_tid++;
+    r.buffers.push_back(holder.buffer);
+  }
+  return *holder.buffer;
+}
+
+uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int current_pid() {
+#ifdef _WIN32
+  return _getpid();
+#else
+  return getpid();
+#endif
+}
+
+// length of the well formed utf-8 sequence at s, 0 when it is not one
+// (stray continuation, overlong form, surrogate or past U+10FFFF)
+size_t utf8_length(const unsigned char *s) {
+  size_t n;
+  uint32_t cp;
+  if (s[0] < 0xc2) {
+    return 0;
+  } else if (s[0] < 0xe0) {
+    n = 2;
+    cp = s[0] & 0x1f;
+  } else if (s[0] < 0xf0) {
+    n = 3;
+    cp = s[0] & 0x0f;
+  } else if (s[0] < 0xf5) {
+    n = 4;
+    cp = s[0] & 0x07;
+  } else {
+    return 0;
+  }
+
+  for (size_t i = 1; i < n; i++) {
+    if ((s[i] & 0xc0) != 0x80) {
+      return 0;
+    }
+    cp = (cp << 6) | (s[i] & 0x3f);
+  }
+
+  if ((n == 3 && cp < 0x800) || (n == 4 && cp < 0x10000) ||
+      (cp >= 0xd800 && cp <= 0xdfff) || cp > 0x10ffff) {
+    return 0;
+  }
+  return n;
+}
+
+// invalid utf-8 becomes U+FFFD, one per bad byte, so the json stays parseable
+void write_escaped(FILE *f, const char *s) {
+  while (*s) {
+    auto c = static_cast<unsigned char>(*s);
+    if (c == '"' || c == '\\') {
+      fputc('\\', f);
+      fputc(c, f);
+    } else if (c < 0x20) {
+      fprintf(f, "\\u%04x", c);
+    } else if (c >= 0x80) {
+      auto n = utf8_length(reinterpret_cast<const unsigned char *>(s));
+      if (n == 0) {
+        fputs("\\ufffd", f);
+      } else {
+        fwrite(s, 1, n, f);
+        s += n;
+        continue;
+      }
+    } else {
+      fputc(c, f);
+    }
+    s++;
+  }
+}
+
+struct Writer {
+  FILE *file{nullptr};
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool stopping{false};
+  bool first{true};
+  uint64_t origin{0};
+  int pid{0};
+
+  void writeEvent(const Event &e, uint32_t tid) {
+    fputs(first ? "\n" : ",\n", file);
+    first = false;
+
+    // chrome wants microseconds, keep the nanoseconds as decimals
+    auto ts = e.start > origin ? e.start - origin : 0;
+    fprintf(file,
+            R"({"ph":"X","cat":"%s","name":"%s","pid":%d,"tid":%u,"ts":%llu.%03u,"dur":%llu.%03u,"args":{)",
+            e.category, e.name, pid, tid,
+            (unsigned long long)(ts / 1000), unsigned(ts % 1000),
+            (unsigned long long)(e.duration / 1000), unsigned(e.duration % 1000));
+
+    bool comma = false;
+    for (int i = 0; i < 2 && e.int_keys[i]; i++) {
+      fprintf(file, R"(%s"%s":%lld)", comma ? "," : "", e.int_keys[i], (long long)e.int_values[i]);
+      comma = true;
+    }
+    if (e.str_key) {
+      fprintf(file, R"(%s"%s":")", comma ? "," : "", e.str_key);
+      write_escaped(file, e.str_value);
+      fputc('"', file);
+    }
+    fputs("}}", file);
+  }
+
+  void drain() {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+      auto &r = registry();
+      std::lock_guard lk(r.mutex);
+      buffers = r.buffers;
+    }
+
+    for (auto &b : buffers) {
+      b->ring.drain([this, tid = b->tid](const Event &e) {
+        writeEvent(e, tid);
+      });
+    }
+
+    // buffers of exited threads are gone once drained
+    auto &r = registry();
+    std::lock_guard lk(r.mutex);
+    std::erase_if(r.buffers, [](auto &b) {
+      return b->retired.load(std::memory_order_acquire) && b->ring.empty();
+    });
+  }
+
+  void run() {
+    std::unique_lock lk(mutex);
+    while (!stopping) {
+      cv.wait_for(lk, kDrainInterval);
+      drain();
+    }
+  }
+};
+
+std::mutex writer_mutex;
+std::unique_ptr<Writer> writer;
+
+} // namespace
+
+bool start_trace(const std::filesystem::path &path) {
+  std::lock_guard lk(writer_mutex);
+  if (writer) {
+    return false;
+  }
+
+  auto w = std::make_unique<Writer>();
+#ifdef _WIN32
+  w->file = _wfopen(path.c_str(), L"wb");
+#else
+  w->file = fopen(path.c_str(), "wb");
+#endif
+  if (!w->file) {
+    return false;
+  }
+
+  // events left over from a previous session are discarded
+  {
+    auto &r = registry();
+    std::lock_guard rlk(r.mutex);
+    for (auto &b : r.buffers) {
+      b->ring.discard();
+      b->dropped.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  w->origin = now_ns();
+  w->pid = current_pid();
+  fputs(R"({"displayTimeUnit":"ns","traceEvents":[)", w->file);
+
+  w->thread = std::thread([w = w.get()] { w->run(); });
+  writer = std::move(w);
+  detail::trace_on.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+void stop_trace() {
+  std::unique_ptr<Writer> w;
+  {
+    std::lock_guard lk(writer_mutex);
+    w = std::move(writer);
+  }
+  if (!w) {
+    return;
+  }
+
+  detail::trace_on.store(false, std::memory_order_relaxed);
+
+  {
+    std::lock_guard lk(w->mutex);
+    w->stopping = true;
+  }
+  w->cv.notify_one();
+  w->thread.join();
+
+  w->drain();
+
+  uint64_t dropped = 0;
+  {
+    auto &r = registry();
+    std::lock_guard lk(r.mutex);
+    for (auto &b : r.buffers) {
+      dropped += b->dropped.load(std::memory_order_relaxed);
+    }
+  }
+
+  fprintf(w->file, R"(],"otherData":{"droppedEvents":%llu}})" "\n", (unsigned long long)dropped);
+  fclose(w->file);
+}
+
+TraceSpan::TraceSpan(const char *category, const char *name) {
+  if (trace_enabled()) {
+    category_ = category;
+    name_ = name;
+    start_ = now_ns();
+    active_ = true;
+  }
+}
+
+TraceSpan::~TraceSpan() {
+  if (!active_) {
+    return;
+  }
+
+  Event e;
+  e.category = category_;
+  e.name = name_;
+  e.start = start_;
+  e.duration = now_ns() - start_;
+  e.int_keys[0] = int_keys_[0];
+  e.int_keys[1] = int_keys_[1];
+  e.int_values[0] = int_values_[0];
+  e.int_values[1] = int_values_[1];
+  e.str_key = str_key_;
+  memcpy(e.str_value, str_value_, sizeof(e.str_value));
+
+  thread_buffer().push(e);
+}
+
+TraceSpan& TraceSpan::arg(const char *key, int64_t value) {
+  if (active_) {
+    for (int i = 0; i < 2; i++) {
+      if (!int_keys_[i] || int_keys_[i] == key) {
+        int_keys_[i] = key;
+        int_values_[i] = value;
+        break;
+      }
+    }
+  }
+  return *this;
+}
+
+TraceSpan& TraceSpan::arg(const char *key, std::string_view value) {
+  if (active_) {
+    auto n = std::min(value.size(), sizeof(str_value_) - 1);
+    // cut before a utf-8 sequence rather than through it, the json must stay valid
+    while (n < value.size() && n > 0 && (static_cast<unsigned char>(value[n]) & 0xc0) == 0x80) {
+      n--;
+    }
+    memcpy(str_value_, value.data(), n);
+    str_value_[n] = '\0';
+    str_key_ = key;
+  }
+  return *this;
+}
+
+} // namespace tracing
+
+#ifdef ENABLE_TEST
+#include "trace-writer_tests.cc"
+#endif
@@ -0,0 +1,105 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+// chrome trace-event json export (chrome://tracing, ui.perfetto.dev).
+//
+// spans are recorded into a lock-free per-thread ring and drained by a
+// writer thread, so the recording thread never blocks on the file.
+// when no trace is running a span costs one relaxed atomic load.
+// a full ring drops events, the dropped count is written at the end.
+
+namespace tracing {
+
+namespace detail {
+
+inline std::atomic<bool> trace_on{false};
+
+} // namespace detail
+
+inline bool trace_enabled() {
+  return detail::trace_on.load(std::memory_order_relaxed);
+}
+
+// start writing to path, false if the file can not be created
+// or a trace is already running.
+bool start_trace(const std::filesystem::path &path);
+
+// flush everything recorded so far and close the file.
+void stop_trace();
+
+// timed span, emitted as one complete ("X") event when it goes out of scope.
+// name and category must be string literals (only the pointer is kept),
+// string arguments are copied and truncated to at most 47 bytes,
+// on a utf-8 code point boundary.
+class TraceSpan {
+public:
+  TraceSpan(const char *category, const char *name);
+  ~TraceSpan();
+
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan& operator=(const TraceSpan &) = delete;
+
+  // up to two integer arguments, later ones are ignored
+  TraceSpan& arg(const char *key, int64_t value);
+  // one string argument (device identity, serial, service ...)
+  TraceSpan& arg(const char *key, std::string_view value);
+
+private:
+  const char *category_{nullptr};
+  const char *name_{nullptr};
+  uint64_t start_{0};
+  const char *int_keys_[2]{};
+  int64_t int_values_[2]{};
+  const char *str_key_{nullptr};
+  char str_value_[48]{};
+  bool active_{false};
+};
+
+// RAII wrapper, stops the trace it started
+class TraceFile {
+public:
+  explicit TraceFile(const std::filesystem::path &path) {
+    if (!path.empty()) {
+      started_ = start_trace(path);
+    }
+  }
+
+  ~TraceFile() {
+    if (started_) {
+      stop_trace();
+    }
+  }
+
+  TraceFile(const TraceFile &) = delete;
+  TraceFile& operator=(const TraceFile &) = delete;
+
+  bool started() const { return started_; }
+
+private:
+  bool started_{false};
+};
+
+} // namespace tracing
@@ -0,0 +1,98 @@
+#include <format>
+#include <fstream>
+#include <sstream>
+
+namespace tracing {
+
+namespace {
+
+nlohmann::json read_trace(const std::filesystem::path &path) {
+  std::ifstream in(path, std::ios::binary);
+  std::stringstream text;
+  text << in.rdbuf();
+  // throws on malformed json and on ill-formed utf-8
+  return nlohmann::json::parse(text.str());
+}
+
+const nlohmann::json *find_event(const nlohmann::json &trace, std::string_view name) {
+  for (auto &e : trace["traceEvents"]) {
+    if (e["name"] == name) {
+      return &e;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace
+
+TEST(TraceWriter, EmitsValidJson) {
+  auto path = std::filesystem::temp_directory_path() /
+      std::format("trace-writer-{}.json", current_pid());
+
+  { TraceSpan ignored("test", "before"); }
+
+  ASSERT_TRUE(start_trace(path));
+  EXPECT_FALSE(start_trace(path));
+
+  // 16 three byte characters, the 47 byte limit falls after the first
+  // two bytes of the sixteenth which must not be kept
+  std::string cjk;
+  for (int i = 0; i < 16; i++) {
+    cjk += "\xe8\xae\xbe";
+  }
+
+  {
+    TraceSpan span("test", "escaped");
+    span.arg("bytes", 512).arg("off", 1).arg("ignored", 3);
+    span.arg("service", std::string_view("shell:\"echo\"\\\n\t"));
+  }
+  {
+    TraceSpan span("test", "utf8");
+    span.arg("serial", cjk);
+  }
+  {
+    // stray continuation, truncated sequence, overlong '/', surrogate, byte ff
+    TraceSpan span("test", "invalid");
+    span.arg("serial", std::string_view("a\x80" "b\xe8\xae" "c\xc0\xaf"
+                                        "d\xed\xa0\x80" "e\xff"));
+  }
+  std::thread([] {
+    TraceSpan span("test", "other-thread");
+    span.arg("serial", "0123456789abcdef0123456789abcdef0123456789abcdef0123");
+  }).join();
+
+  stop_trace();
+
+  nlohmann::json trace;
+  ASSERT_NO_THROW(trace = read_trace(path));
+  std::filesystem::remove(path);
+
+  EXPECT_EQ(trace["otherData"]["droppedEvents"], 0);
+  EXPECT_EQ(find_event(trace, "before"), nullptr);
+
+  auto *escaped = find_event(trace, "escaped");
+  ASSERT_NE(escaped, nullptr);
+  EXPECT_EQ((*escaped)["ph"], "X");
+  EXPECT_EQ((*escaped)["cat"], "test");
+  EXPECT_EQ((*escaped)["args"]["bytes"], 512);
+  EXPECT_EQ((*escaped)["args"]["off"], 1);
+  EXPECT_FALSE((*escaped)["args"].contains("ignored"));
+  EXPECT_EQ((*escaped)["args"]["service"], "shell:\"echo\"\\\n\t");
+  EXPECT_GE((*escaped)["dur"].get<double>(), 0.0);
+
+  auto *utf8 = find_event(trace, "utf8");
+  ASSERT_NE(utf8, nullptr);
+  EXPECT_EQ((*utf8)["args"]["serial"], cjk.substr(0, 45));
+
+  auto *invalid = find_event(trace, "invalid");
+  ASSERT_NE(invalid, nullptr);
+  EXPECT_EQ((*invalid)["args"]["serial"],
+            "a\uFFFDb\uFFFD\uFFFDc\uFFFD\uFFFDd\uFFFD\uFFFD\uFFFDe\uFFFD");
+
+  auto *other = find_event(trace, "other-thread");
+  ASSERT_NE(other, nullptr);
+  EXPECT_EQ((*other)["args"]["serial"].get<std::string>().size(), 47u);
+  EXPECT_NE((*other)["tid"], (*utf8)["tid"]);
+}
+
+} // namespace tracing
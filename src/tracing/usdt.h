@@ -0,0 +1,121 @@
+// Copyright (c) 2025 R.J. (kencube@hotmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+// USDT probes (provider adb_device_watch) for bpftrace / systemtap / perf.
+//
+// compiled in with DEVICE_WATCH_ENABLE_USDT (needs sys/sdt.h). every probe
+// has a semaphore the tracer raises while attached: an unattached probe is a
+// test of that counter, its arguments and timestamps are not evaluated.
+// otherwise everything here compiles to nothing.
+//
+//   bpftrace -e 'usdt:./adb-device-watch:adb_device_watch:adb_poll_end { @ = hist(arg2); }'
+//
+// probe                       arguments
+// netlink_recv                bytes
+// uevent_parse                action, bytes, duration ns
+// sysfs_read_start            path
+// sysfs_read_end              path, result, duration ns
+// filter_reject               id, vid, pid, type
+// cache_insert                identity (u64), cache size
+// cache_remove                identity (u64), cache size
+// adb_poll_start              servers
+// adb_poll_end                servers, devices, duration ns
+// adb_connect                 service, service length, duration ns
+// sync_chunk_sent             bytes
+// sync_chunk_received         bytes
+// callback_dispatch           identity (u64), off, duration ns
+//
+// durations are taken as
+//   auto start = DEVICE_WATCH_PROBE_NOW(uevent_parse);
+//   ...
+//   DEVICE_WATCH_PROBE(uevent_parse, ..., DEVICE_WATCH_PROBE_SINCE(start));
+// the clock is only read while the probe is attached, a probe attached
+// in between reports 0.
+
+#define DEVICE_WATCH_PROBES(X) \
+  X(netlink_recv) \
+  X(uevent_parse) \
+  X(sysfs_read_start) \
+  X(sysfs_read_end) \
+  X(filter_reject) \
+  X(cache_insert) \
+  X(cache_remove) \
+  X(adb_poll_start) \
+  X(adb_poll_end) \
+  X(adb_connect) \
+  X(sync_chunk_sent) \
+  X(sync_chunk_received) \
+  X(callback_dispatch)
+
+#if defined(DEVICE_WATCH_ENABLE_USDT) && DEVICE_WATCH_ENABLE_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+// defined in usdt.cc, sys/sdt.h records their addresses in the probe notes
+#define DEVICE_WATCH_PROBE_SEMAPHORE(name) \
+  extern "C" unsigned short adb_device_watch_##name##_semaphore;
+
+DEVICE_WATCH_PROBES(DEVICE_WATCH_PROBE_SEMAPHORE)
+
+#undef DEVICE_WATCH_PROBE_SEMAPHORE
+
+#define DEVICE_WATCH_PROBE_ENABLED(name) \
+  __builtin_expect(adb_device_watch_##name##_semaphore != 0, 0)
+
+#define DEVICE_WATCH_PROBE(name, ...) \
+  do { \
+    if (DEVICE_WATCH_PROBE_ENABLED(name)) { \
+      STAP_PROBEV(adb_device_watch, name __VA_OPT__(,) __VA_ARGS__); \
+    } \
+  } while (0)
+
+// start timestamp for a duration argument, 0 while the probe is not attached
+#define DEVICE_WATCH_PROBE_NOW(name) \
+  (DEVICE_WATCH_PROBE_ENABLED(name) ? ::tracing::probe_now_ns() : uint64_t(0))
+
+#define DEVICE_WATCH_PROBE_SINCE(start) ::tracing::probe_since_ns(start)
+
+namespace tracing {
+
+inline uint64_t probe_now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint64_t probe_since_ns(uint64_t start) {
+  return start ? probe_now_ns() - start : 0;
+}
+
+} // namespace tracing
+
+#else
+
+#define DEVICE_WATCH_PROBE_ENABLED(name) false
+#define DEVICE_WATCH_PROBE(...) ((void)0)
+#define DEVICE_WATCH_PROBE_NOW(name) uint64_t(0)
+#define DEVICE_WATCH_PROBE_SINCE(start) uint64_t(0)
+
+#endif